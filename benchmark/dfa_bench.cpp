@@ -1,5 +1,9 @@
 #include <benchmark/benchmark.h>
 
+#include <cstdlib>
+#include <string>
+#include <vector>
+
 extern "C" {
 #include <refa.h>
 }
@@ -129,10 +133,490 @@ static void join_dfa_blow(benchmark::State& state) {
 
 }
 
+/* random DFA that is much larger than the last level cache */
+static void build_dfa_random(struct dfa *dfa, size_t state_cnt)
+{
+	dfa_alloc2(dfa, state_cnt);
+	dfa_add_n_state(dfa, state_cnt, NULL);
+
+	srand(1);
+	for (size_t i = 0; i < state_cnt; i++)
+		for (int j = 0; j < 256; j++)
+			dfa_add_trans(dfa, i, j, rand() % state_cnt);
+}
+
+static void scan_dfa_single(benchmark::State& state) {
+	struct dfa dfa;
+	const size_t stream_cnt = 16, stream_len = 4096;
+	std::vector<unsigned char> data(stream_cnt * stream_len);
+
+	build_dfa_random(&dfa, 1 << 16);
+	for (auto &c : data)
+		c = rand();
+
+	for (auto _ : state) {
+		for (size_t i = 0; i < stream_cnt; i++) {
+			size_t dfa_state = dfa.first_index;
+			benchmark::DoNotOptimize(dfa_scan(&dfa, &dfa_state,
+					&data[i * stream_len], stream_len));
+		}
+	}
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+	dfa_free(&dfa);
+}
+
+static void scan_dfa_multi(benchmark::State& state) {
+	struct dfa dfa;
+	const size_t stream_cnt = 16, stream_len = 4096;
+	std::vector<unsigned char> data(stream_cnt * stream_len);
+	struct dfa_stream streams[stream_cnt];
+
+	build_dfa_random(&dfa, 1 << 16);
+	for (auto &c : data)
+		c = rand();
+
+	for (auto _ : state) {
+		for (size_t i = 0; i < stream_cnt; i++)
+			dfa_stream_init(&dfa, &streams[i],
+					&data[i * stream_len], stream_len);
+		dfa_scan_multi(&dfa, streams, stream_cnt);
+		benchmark::DoNotOptimize(streams);
+	}
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+	dfa_free(&dfa);
+}
+
+static void scan_dfa_batch(benchmark::State& state) {
+	struct dfa dfa;
+	const size_t stream_cnt = 1024, stream_len = 256;
+	std::vector<unsigned char> data(stream_cnt * stream_len);
+	std::vector<struct dfa_stream> streams(stream_cnt);
+	enum dfa_scan_kernel kernel = (enum dfa_scan_kernel)state.range(0);
+
+	build_dfa_random(&dfa, 1 << 16);
+	for (auto &c : data)
+		c = rand();
+
+	if (!dfa_scan_kernel_supported(&dfa, kernel)) {
+		state.SkipWithError("kernel is not supported");
+		dfa_free(&dfa);
+		return;
+	}
+
+	for (auto _ : state) {
+		for (size_t i = 0; i < stream_cnt; i++)
+			dfa_stream_init(&dfa, &streams[i],
+					&data[i * stream_len], stream_len);
+		dfa_scan_batch(&dfa, streams.data(), stream_cnt, kernel);
+		benchmark::DoNotOptimize(streams.data());
+	}
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+	dfa_free(&dfa);
+}
+
+static void scan_dfa_parallel(benchmark::State& state) {
+	struct regexp_tree *re_tree;
+	struct nfa nfa;
+	struct dfa dfa;
+	std::vector<unsigned char> data(1 << 24);
+
+	re_tree = regexp_to_tree("/(a.*b|c.*d|e.*f|g.*h|j.*k|l.*m)x{8}/", NULL);
+
+	nfa_alloc(&nfa);
+	convert_tree_to_lambdanfa(&nfa, re_tree);
+	regexp_tree_free(re_tree);
+	nfa_rebuild(&nfa);
+
+	dfa_alloc(&dfa);
+	convert_nfa_to_dfa(&dfa, &nfa);
+	nfa_free(&nfa);
+	dfa_minimize(&dfa);
+
+	for (auto &c : data)
+		c = 'a' + rand() % 16;
+
+	for (auto _ : state) {
+		size_t dfa_state = dfa.first_index;
+		size_t match;
+
+		dfa_scan_parallel(&dfa, &dfa_state, data.data(), data.size(),
+				  state.range(0), &match);
+		benchmark::DoNotOptimize(match);
+	}
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+	dfa_free(&dfa);
+}
+
+static void scan_dfa_accel(benchmark::State& state) {
+	struct regexp_tree *re_tree;
+	struct nfa nfa;
+	struct dfa dfa;
+	std::vector<unsigned char> data(1 << 20);
+
+	re_tree = regexp_to_tree("/(needle|haystack)[0-9]/", NULL);
+
+	nfa_alloc(&nfa);
+	convert_tree_to_lambdanfa(&nfa, re_tree);
+	regexp_tree_free(re_tree);
+	nfa_rebuild(&nfa);
+
+	dfa_alloc(&dfa);
+	convert_nfa_to_dfa(&dfa, &nfa);
+	nfa_free(&nfa);
+	dfa_minimize(&dfa);
+
+	if (state.range(0))
+		dfa_accelerate(&dfa);
+
+	for (auto &c : data)
+		c = "abcdefghijklmnopqrstuvwxyz \n"[rand() % 28];
+
+	for (auto _ : state) {
+		size_t dfa_state = dfa.first_index;
+
+		benchmark::DoNotOptimize(dfa_scan(&dfa, &dfa_state,
+						  data.data(), data.size()));
+	}
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+	dfa_free(&dfa);
+}
+
+static void scan_dfa_stride(benchmark::State& state) {
+	struct regexp_tree *re_tree;
+	struct nfa nfa;
+	struct dfa dfa;
+	struct dfa_stride ds;
+	std::vector<unsigned char> data(1 << 20);
+
+	re_tree = regexp_to_tree("/(GET|POST|HEAD) \\/[a-z]+ HTTP\\/1\\.[01]/",
+				 NULL);
+
+	nfa_alloc(&nfa);
+	convert_tree_to_lambdanfa(&nfa, re_tree);
+	regexp_tree_free(re_tree);
+	nfa_rebuild(&nfa);
+
+	dfa_alloc(&dfa);
+	convert_nfa_to_dfa(&dfa, &nfa);
+	nfa_free(&nfa);
+	dfa_minimize(&dfa);
+	dfa_compress(&dfa);
+	dfa_stride_alloc(&ds, &dfa, 1 << 20);
+
+	for (auto &c : data)
+		c = "GETPOSTHEAD/ \n"[rand() % 14];
+
+	for (auto _ : state) {
+		size_t dfa_state = dfa.first_index;
+
+		if (state.range(0))
+			benchmark::DoNotOptimize(dfa_stride_scan(&ds,
+					&dfa_state, data.data(), data.size()));
+		else
+			benchmark::DoNotOptimize(dfa_scan(&dfa, &dfa_state,
+					data.data(), data.size()));
+	}
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+	state.counters["table_bytes"] = ds.size;
+	dfa_stride_free(&ds);
+	dfa_free(&dfa);
+}
+
+static void scan_dfa_nibble(benchmark::State& state) {
+	std::vector<std::string> regexps;
+	std::vector<struct regexp_tree *> trees;
+	struct dfa dfa;
+	struct dfa_nibble dn;
+	std::vector<unsigned char> data(1 << 20);
+
+	/* thousands of states with sparse rows */
+	for (int i = 0; i < 500; i++)
+		regexps.push_back("/" + std::to_string(i * 7919) + "x" +
+				  std::to_string(i * 104729) + "/");
+	for (auto &regexp : regexps)
+		trees.push_back(regexp_to_tree(regexp.c_str(), NULL));
+
+	dfa_alloc(&dfa);
+	convert_trees_to_dfa(&dfa, trees.data(), trees.size());
+	for (auto tree : trees)
+		regexp_tree_free(tree);
+	dfa_nibble_alloc(&dn, &dfa);
+
+	for (auto &c : data)
+		c = "0123456789abcdef"[rand() % 16];
+
+	for (auto _ : state) {
+		size_t dfa_state = dfa.first_index;
+
+		if (state.range(0))
+			benchmark::DoNotOptimize(dfa_nibble_scan(&dn,
+					&dfa_state, data.data(), data.size()));
+		else
+			benchmark::DoNotOptimize(dfa_scan(&dfa, &dfa_state,
+					data.data(), data.size()));
+	}
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+	state.counters["states"] = dfa.state_cnt;
+	state.counters["table_bytes"] = state.range(0) ? dn.size :
+					dfa.state_cnt * dfa.state_size;
+	dfa_nibble_free(&dn);
+	dfa_free(&dfa);
+}
+
+static void scan_dfa_bndm(benchmark::State& state) {
+	const char *regexp = "/(Content-Type|Content-Length): [0-9a-z]+/";
+	struct regexp_tree *re_tree;
+	struct dfa_bndm bm;
+	std::vector<unsigned char> data(1 << 20);
+
+	re_tree = regexp_to_tree(regexp, NULL);
+	dfa_bndm_alloc(&bm, re_tree);
+	regexp_tree_free(re_tree);
+
+	for (auto &c : data)
+		c = "abcdefghijklmnopqrstuvwxyz \n"[rand() % 28];
+
+	for (auto _ : state) {
+		size_t dfa_state = bm.dfa.first_index;
+
+		if (state.range(0))
+			benchmark::DoNotOptimize(dfa_bndm_scan(&bm,
+					data.data(), data.size()));
+		else
+			benchmark::DoNotOptimize(dfa_scan(&bm.dfa, &dfa_state,
+					data.data(), data.size()));
+	}
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+	state.counters["window"] = bm.window;
+	dfa_bndm_free(&bm);
+}
+
+static int scan_lexer_cb(size_t, size_t, size_t, void *ctx)
+{
+	(*(size_t *)ctx)++;
+
+	return 0;
+}
+
+static void scan_lexer(benchmark::State& state) {
+	const char *rules[] = {
+		"/[0-9]{4}-[0-9]{2}-[0-9]{2}/", "/[0-9]+(\\.[0-9]+)?/",
+		"/(INFO|WARN|ERROR)/", "/[A-Za-z_][A-Za-z_0-9]*/", "/[ \t]+/",
+		"/\n/", "/([:=,]|\\[|\\])/", "/\"[^\"]*\"/"
+	};
+	const char *line = "2024-01-15 12:34:56 WARN [worker] id=42, "
+			   "msg=\"slow request\", took=1.25\n";
+	std::string data;
+	struct lexer lx;
+	size_t tokens = 0;
+
+	lexer_alloc(&lx);
+	for (auto rule : rules)
+		lexer_add(&lx, rule, NULL);
+	lexer_compile(&lx);
+
+	while (data.size() < (1 << 20))
+		data += line;
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(lexer_scan(&lx, data.data(),
+				data.size(), scan_lexer_cb, &tokens));
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+	state.counters["states"] = lx.dfa.state_cnt;
+	state.counters["tokens"] = tokens / state.iterations();
+	lexer_free(&lx);
+}
+
+static int scan_prefilter_cb(size_t, size_t, void *)
+{
+	return 0;
+}
+
+static void scan_prefilter(benchmark::State& state) {
+	const char *regexps[] = {
+		"/Needle[0-9]+/", "/Haystack(Hay|Stack)/", "/X-Forwarded-For/i",
+		"/select.*from/", "/<script>/", "/cmd\\.exe/", "/%00/", "/\\.\\.\\//"
+	};
+	struct prefilter pf;
+	struct prefilter_stat stat;
+	std::vector<unsigned char> data(1 << 20);
+
+	prefilter_alloc(&pf);
+	for (auto regexp : regexps)
+		prefilter_add(&pf, regexp, NULL);
+	prefilter_compile(&pf);
+
+	for (auto &c : data)
+		c = "abcdefghijklmnopqrstuvwxyz \n"[rand() % 28];
+
+	for (auto _ : state)
+		prefilter_scan(&pf, data.data(), data.size(), scan_prefilter_cb,
+			       NULL, &stat);
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+	state.counters["dfa_bytes"] = stat.dfa_bytes;
+	prefilter_free(&pf);
+}
+
+static void scan_teddy(benchmark::State& state) {
+	struct teddy td;
+	std::vector<unsigned char> data(1 << 20);
+
+	teddy_alloc(&td);
+	for (int64_t i = 0; i < state.range(0); i++) {
+		std::string lit = "X" + std::to_string(i * 7919) + "-Q";
+
+		teddy_add(&td, lit.data(), lit.size(), false, NULL);
+	}
+	teddy_compile(&td);
+
+	for (auto &c : data)
+		c = "abcdefghijklmnopqrstuvwxyz \n"[rand() % 28];
+
+	for (auto _ : state)
+		teddy_scan(&td, data.data(), data.size(), scan_prefilter_cb,
+			   NULL);
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+	teddy_free(&td);
+}
+
+static void scan_bitnfa(benchmark::State& state) {
+	const char *regexps[] = {
+		"/Needle[0-9]+/", "/Hay(Hay|Stack){2,4}/", "/a[bc]{5}d/",
+		"/x.*yz/", "/^GET /"
+	};
+	struct bitnfa bn;
+	std::vector<unsigned char> data(1 << 20);
+
+	bitnfa_alloc(&bn);
+	for (auto regexp : regexps) {
+		struct regexp_tree *re_tree = regexp_to_tree(regexp, NULL);
+
+		bitnfa_add(&bn, re_tree, NULL);
+		regexp_tree_free(re_tree);
+	}
+	bitnfa_compile(&bn);
+
+	for (auto &c : data)
+		c = "abcdefghijklmnopqrstuvwxyz \n"[rand() % 28];
+
+	for (auto _ : state)
+		bitnfa_scan(&bn, data.data(), data.size(), scan_prefilter_cb,
+			    NULL);
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+	bitnfa_free(&bn);
+}
+
+static void scan_nfa(benchmark::State& state) {
+	struct regexp_tree *re_tree;
+	struct nfa nfa;
+	struct nfa_scan ns;
+	struct nfa_scan_state st;
+	std::vector<unsigned char> data(1 << 20);
+
+	/* the DFA of the regexp has more than 2^20 states */
+	re_tree = regexp_to_tree("/a.{20}b/", NULL);
+
+	nfa_alloc(&nfa);
+	convert_tree_to_lambdanfa(&nfa, re_tree);
+	regexp_tree_free(re_tree);
+	nfa_rebuild(&nfa);
+
+	nfa_scan_alloc(&ns, &nfa);
+	nfa_scan_state_alloc(&ns, &st);
+
+	for (auto &c : data)
+		c = "cdefghijklmnopqrstuvwxyz \n"[rand() % 26];
+	data[data.size() / 2] = 'a';
+
+	for (auto _ : state) {
+		nfa_scan_state_reset(&ns, &st);
+		benchmark::DoNotOptimize(nfa_scan(&ns, &st, data.data(),
+						  data.size()));
+	}
+
+	state.SetBytesProcessed(state.iterations() * data.size());
+	nfa_scan_state_free(&st);
+	nfa_scan_free(&ns);
+	nfa_free(&nfa);
+}
+
+static void build_dfa_literals(benchmark::State& state) {
+	std::vector<std::string> regexps;
+	std::vector<struct regexp_tree *> trees;
+
+	for (int i = 0; i < 100; i++)
+		regexps.push_back("/lit" + std::to_string(i * 7919) + "x/");
+
+	for (auto &regexp : regexps)
+		trees.push_back(regexp_to_tree(regexp.c_str(), NULL));
+
+	for (auto _ : state) {
+		struct dfa dfa;
+
+		if (state.range(0)) {
+			dfa_alloc(&dfa);
+			convert_trees_to_dfa(&dfa, trees.data(), trees.size());
+			dfa_free(&dfa);
+			continue;
+		}
+
+		for (size_t i = 0; i < trees.size(); i++) {
+			struct nfa nfa;
+			struct dfa next;
+
+			nfa_alloc(&nfa);
+			convert_tree_to_lambdanfa(&nfa, trees[i]);
+			nfa_rebuild(&nfa);
+			dfa_alloc(i == 0 ? &dfa : &next);
+			convert_nfa_to_dfa(i == 0 ? &dfa : &next, &nfa);
+			nfa_free(&nfa);
+
+			if (i != 0) {
+				dfa_join(&dfa, &next);
+				dfa_free(&next);
+				dfa_minimize(&dfa);
+			}
+		}
+		dfa_free(&dfa);
+	}
+
+	for (auto tree : trees)
+		regexp_tree_free(tree);
+}
+
 BENCHMARK(build_dfa_blow1);
 BENCHMARK(build_dfa_blow1_minimize);
 BENCHMARK(build_dfa_blow2);
 BENCHMARK(build_dfa_blow2_minimize);
 BENCHMARK(join_dfa_blow);
+BENCHMARK(build_dfa_literals)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(scan_dfa_single);
+BENCHMARK(scan_dfa_multi);
+BENCHMARK(scan_dfa_batch)
+	->Arg(DFA_SCAN_KERNEL_SCALAR)
+	->Arg(DFA_SCAN_KERNEL_AVX2)
+	->Arg(DFA_SCAN_KERNEL_AVX512);
+BENCHMARK(scan_dfa_accel)->Arg(0)->Arg(1);
+BENCHMARK(scan_dfa_stride)->Arg(0)->Arg(1);
+BENCHMARK(scan_dfa_nibble)->Arg(0)->Arg(1);
+BENCHMARK(scan_dfa_bndm)->Arg(0)->Arg(1);
+BENCHMARK(scan_lexer);
+BENCHMARK(scan_dfa_parallel)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+BENCHMARK(scan_prefilter);
+BENCHMARK(scan_teddy)->Arg(16)->Arg(1000);
+BENCHMARK(scan_bitnfa);
+BENCHMARK(scan_nfa);
 
 BENCHMARK_MAIN();
@@ -0,0 +1,529 @@
+/*
+ * Bit-parallel simulation of Glushkov automata.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitnfa.h"
+#include "literal.h"
+#include "dfa_scan_inner.h"
+
+/**
+ * @brief Set of positions.
+ */
+typedef uint64_t bitnfa_set[BITNFA_MAX_WORDS];
+
+/**
+ * @brief Part of the Glushkov automaton built from a subexpression.
+ */
+struct bitnfa_frag {
+	/**
+	 * @brief Positions that may read the first character.
+	 */
+	bitnfa_set first;
+
+	/**
+	 * @brief Positions that may read the last character.
+	 */
+	bitnfa_set last;
+
+	/**
+	 * @brief Subexpression matches the empty string.
+	 */
+	bool nullable;
+};
+
+/**
+ * @brief Add one set of positions to another.
+ *
+ * @param dst	destination set
+ * @param src	added set
+ */
+static inline void bitnfa_set_or(uint64_t *dst, const uint64_t *src)
+{
+	for (size_t w = 0; w < BITNFA_MAX_WORDS; w++)
+		dst[w] |= src[w];
+}
+
+/**
+ * @brief Check if the set of positions is empty.
+ *
+ * @param set	set of positions
+ * @return	true if the set is empty
+ */
+static inline bool bitnfa_set_empty(const uint64_t *set)
+{
+	for (size_t w = 0; w < BITNFA_MAX_WORDS; w++)
+		if (set[w] != 0)
+			return false;
+
+	return true;
+}
+
+/**
+ * @brief Make fragment of the empty string.
+ *
+ * @param frag	pointer to the fragment
+ */
+static void bitnfa_frag_empty(struct bitnfa_frag *frag)
+{
+	memset(frag, 0x00, sizeof(*frag));
+	frag->nullable = true;
+}
+
+/**
+ * @brief Append one fragment to another.
+ *
+ * Last positions of the first fragment are followed by the first
+ * positions of the second fragment.
+ *
+ * @param bn	pointer to the bitnfa structure
+ * @param dst	pointer to the first fragment and the result
+ * @param src	pointer to the second fragment
+ */
+static void bitnfa_frag_concat(struct bitnfa *bn, struct bitnfa_frag *dst,
+			       const struct bitnfa_frag *src)
+{
+	for (size_t p = 0; p < bn->pos_cnt; p++)
+		if ((dst->last[p / 64] >> (p % 64)) & 1)
+			bitnfa_set_or(bn->follow[p], src->first);
+
+	if (dst->nullable)
+		bitnfa_set_or(dst->first, src->first);
+
+	if (src->nullable) {
+		bitnfa_set_or(dst->last, src->last);
+	} else {
+		memcpy(dst->last, src->last, sizeof(bitnfa_set));
+	}
+
+	dst->nullable = dst->nullable && src->nullable;
+}
+
+/**
+ * @brief Make fragment repeated any number of times.
+ *
+ * @param bn	pointer to the bitnfa structure
+ * @param frag	pointer to the fragment
+ */
+static void bitnfa_frag_loop(struct bitnfa *bn, const struct bitnfa_frag *frag)
+{
+	for (size_t p = 0; p < bn->pos_cnt; p++)
+		if ((frag->last[p / 64] >> (p % 64)) & 1)
+			bitnfa_set_or(bn->follow[p], frag->first);
+}
+
+static int bitnfa_frag_node(struct bitnfa *bn, const struct regexp_node *node,
+			    struct bitnfa_frag *frag);
+
+/**
+ * @brief Build fragment of one repetition of the node.
+ *
+ * @param bn	pointer to the bitnfa structure
+ * @param node	pointer to the node
+ * @param frag	place for the fragment
+ * @return	0 on success, -1 if there are too many positions
+ */
+static int bitnfa_frag_base(struct bitnfa *bn, const struct regexp_node *node,
+			    struct bitnfa_frag *frag)
+{
+	struct bitnfa_frag child;
+	size_t p;
+
+	switch (node->type) {
+	case RE_CHAR:
+	case RE_CHARCLASS:
+		if (bn->pos_cnt == BITNFA_MAX_POSITIONS)
+			return -1;
+
+		p = bn->pos_cnt++;
+		memset(bn->cls[p], 0x00, sizeof(bitnfa_set));
+		memset(bn->follow[p], 0x00, sizeof(bitnfa_set));
+
+		for (int c = 0; c < 256; c++)
+			if (node->type == RE_CHAR ?
+			    c == node->data.c_val :
+			    GET_BIT(node->data.cc_data.data, c) !=
+			    node->data.cc_data.inverse)
+				bn->cls[p][c / 64] |= (uint64_t)1 << (c % 64);
+
+		memset(frag, 0x00, sizeof(*frag));
+		frag->first[p / 64] = (uint64_t)1 << (p % 64);
+		frag->last[p / 64] = (uint64_t)1 << (p % 64);
+		frag->nullable = false;
+		break;
+	case RE_CONCAT:
+		bitnfa_frag_empty(frag);
+		for (int i = 0; i < node->data.childs.cnt; i++) {
+			if (bitnfa_frag_node(bn, node->data.childs.ptr[i],
+					     &child) != 0)
+				return -1;
+			bitnfa_frag_concat(bn, frag, &child);
+		}
+		break;
+	case RE_UNION:
+		memset(frag, 0x00, sizeof(*frag));
+		for (int i = 0; i < node->data.childs.cnt; i++) {
+			if (bitnfa_frag_node(bn, node->data.childs.ptr[i],
+					     &child) != 0)
+				return -1;
+			bitnfa_set_or(frag->first, child.first);
+			bitnfa_set_or(frag->last, child.last);
+			frag->nullable = frag->nullable || child.nullable;
+		}
+		break;
+	case RE_EMPTY:
+		bitnfa_frag_empty(frag);
+		break;
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Build fragment of the node with its repetitions.
+ *
+ * Repetitions are expanded: x{2,4} is built as x x x? x?, x{2,} as x x+.
+ *
+ * @param bn	pointer to the bitnfa structure
+ * @param node	pointer to the node
+ * @param frag	place for the fragment
+ * @return	0 on success, -1 if there are too many positions
+ */
+static int bitnfa_frag_node(struct bitnfa *bn, const struct regexp_node *node,
+			    struct bitnfa_frag *frag)
+{
+	int min = node->repeat.min, max = node->repeat.max;
+	struct bitnfa_frag inst;
+
+	bitnfa_frag_empty(frag);
+
+	for (int i = 0; i < min; i++) {
+		if (bitnfa_frag_base(bn, node, &inst) != 0)
+			return -1;
+		if (max < 0 && i + 1 == min)
+			bitnfa_frag_loop(bn, &inst);
+		bitnfa_frag_concat(bn, frag, &inst);
+	}
+
+	if (max < 0 && min == 0) {
+		if (bitnfa_frag_base(bn, node, &inst) != 0)
+			return -1;
+		bitnfa_frag_loop(bn, &inst);
+		inst.nullable = true;
+		bitnfa_frag_concat(bn, frag, &inst);
+	}
+
+	for (int i = min; i < max; i++) {
+		if (bitnfa_frag_base(bn, node, &inst) != 0)
+			return -1;
+		inst.nullable = true;
+		bitnfa_frag_concat(bn, frag, &inst);
+	}
+
+	return 0;
+}
+
+int bitnfa_alloc(struct bitnfa *bn)
+{
+	memset(bn, 0x00, sizeof(*bn));
+
+	return 0;
+}
+
+void bitnfa_free(struct bitnfa *bn)
+{
+	free(bn->table);
+	free(bn->table_chunk);
+	free(bn->pats);
+	memset(bn, 0x00, sizeof(*bn));
+}
+
+int bitnfa_add(struct bitnfa *bn, const struct regexp_tree *re_tree,
+	       size_t *id)
+{
+	const struct regexp_node *core;
+	struct bitnfa_pattern *pat;
+	struct bitnfa_frag frag;
+	size_t start = bn->pos_cnt;
+	bool floating;
+
+	if (bn->cnt == bn->malloc_cnt) {
+		size_t new_cnt = bn->malloc_cnt != 0 ? bn->malloc_cnt * 2 : 16;
+		struct bitnfa_pattern *tmp;
+
+		tmp = realloc(bn->pats, sizeof(struct bitnfa_pattern) * new_cnt);
+		if (tmp == NULL)
+			return -1;
+
+		bn->pats = tmp;
+		bn->malloc_cnt = new_cnt;
+	}
+
+	core = regexp_tree_core(re_tree, &floating);
+
+	if (bitnfa_frag_node(bn, core, &frag) != 0) {
+		bn->pos_cnt = start;
+		return -1;
+	}
+
+	pat = &bn->pats[bn->cnt];
+	memset(pat, 0x00, sizeof(*pat));
+	memcpy(pat->first, frag.first, sizeof(bitnfa_set));
+	memcpy(pat->last, frag.last, sizeof(bitnfa_set));
+	pat->floating = floating;
+	pat->nullable = frag.nullable;
+
+	for (size_t p = start; p < bn->pos_cnt; p++)
+		pat->all[p / 64] |= (uint64_t)1 << (p % 64);
+
+	if (id != NULL)
+		*id = bn->cnt;
+	bn->cnt++;
+	bn->compiled = false;
+
+	return 0;
+}
+
+int bitnfa_compile(struct bitnfa *bn)
+{
+	bitnfa_set irregular[BITNFA_MAX_POSITIONS];
+	size_t chunk_cnt = (bn->pos_cnt + BITNFA_CHUNK - 1) / BITNFA_CHUNK;
+
+	bn->words = bn->pos_cnt <= 64 ? 1 : bn->pos_cnt <= 128 ? 2 : 4;
+
+	memset(bn->mask, 0x00, sizeof(bn->mask));
+	memset(bn->shift, 0x00, sizeof(bn->shift));
+	memset(bn->first_float, 0x00, sizeof(bn->first_float));
+	memset(bn->first_start, 0x00, sizeof(bn->first_start));
+	memset(bn->last_all, 0x00, sizeof(bn->last_all));
+
+	for (size_t i = 0; i < bn->cnt; i++) {
+		const struct bitnfa_pattern *pat = &bn->pats[i];
+
+		bitnfa_set_or(pat->floating ? bn->first_float : bn->first_start,
+			      pat->first);
+		bitnfa_set_or(bn->last_all, pat->last);
+	}
+
+	/* transitions to the next position are simulated by the shift */
+	for (size_t p = 0; p < bn->pos_cnt; p++) {
+		size_t next = p + 1;
+
+		memcpy(irregular[p], bn->follow[p], sizeof(bitnfa_set));
+		if (next < bn->pos_cnt &&
+		    ((irregular[p][next / 64] >> (next % 64)) & 1)) {
+			irregular[p][next / 64] &= ~((uint64_t)1 << (next % 64));
+			bn->shift[p / 64] |= (uint64_t)1 << (p % 64);
+		}
+
+		for (int c = 0; c < 256; c++)
+			if ((bn->cls[p][c / 64] >> (c % 64)) & 1)
+				bn->mask[c][p / 64] |= (uint64_t)1 << (p % 64);
+	}
+
+	free(bn->table);
+	free(bn->table_chunk);
+	bn->table = malloc(sizeof(*bn->table) * (chunk_cnt + 1));
+	bn->table_chunk = malloc(sizeof(size_t) * (chunk_cnt + 1));
+	bn->table_cnt = 0;
+	if (bn->table == NULL || bn->table_chunk == NULL)
+		return -1;
+
+	for (size_t k = 0; k < chunk_cnt; k++) {
+		size_t first = k * BITNFA_CHUNK;
+		bool needed = false;
+
+		for (size_t p = first; p < first + BITNFA_CHUNK &&
+		     p < bn->pos_cnt; p++)
+			needed = needed || !bitnfa_set_empty(irregular[p]);
+
+		if (!needed)
+			continue;
+
+		memset(bn->table[bn->table_cnt], 0x00, sizeof(*bn->table));
+		for (int bits = 1; bits < 256; bits++)
+			for (size_t b = 0; b < BITNFA_CHUNK; b++)
+				if (((bits >> b) & 1) && first + b < bn->pos_cnt)
+					bitnfa_set_or(bn->table[bn->table_cnt]
+							       [bits],
+						      irregular[first + b]);
+
+		bn->table_chunk[bn->table_cnt++] = k;
+	}
+
+	bn->compiled = true;
+
+	return 0;
+}
+
+/**
+ * @brief Report patterns whose last positions are active.
+ *
+ * @param bn		pointer to the bitnfa structure
+ * @param state		active positions, positions of the reported patterns
+ *			are removed from it
+ * @param alive		positions of the patterns that did not match yet
+ * @param matched	flags of the reported patterns
+ * @param end		offset just past the last read byte
+ * @param remaining	pointer to the number of patterns that did not match
+ * @param cb		callback for the matches
+ * @param ctx		user's context of the callback
+ * @return		non-zero if the scan must be stopped
+ */
+static int bitnfa_report(const struct bitnfa *bn, uint64_t *state,
+			 uint64_t *alive, bool *matched, size_t end,
+			 size_t *remaining, dfa_match_cb cb, void *ctx)
+{
+	for (size_t i = 0; i < bn->cnt; i++) {
+		const struct bitnfa_pattern *pat = &bn->pats[i];
+		bool hit = false;
+
+		if (matched[i])
+			continue;
+
+		for (size_t w = 0; w < bn->words; w++)
+			hit = hit || (state[w] & pat->last[w]) != 0;
+
+		if (!hit)
+			continue;
+
+		matched[i] = true;
+		(*remaining)--;
+		for (size_t w = 0; w < bn->words; w++) {
+			state[w] &= ~pat->all[w];
+			alive[w] &= ~pat->all[w];
+		}
+
+		if (cb(i, end, ctx) != 0)
+			return 1;
+	}
+
+	return *remaining == 0;
+}
+
+/**
+ * @brief Scan loop specialized for one width of the state vector.
+ *
+ * @param bn		pointer to the bitnfa structure
+ * @param data		data to be scanned
+ * @param len		size of the data
+ * @param alive		positions of the patterns that did not match yet
+ * @param matched	flags of the reported patterns
+ * @param remaining	number of patterns that did not match
+ * @param cb		callback for the matches
+ * @param ctx		user's context of the callback
+ * @param words		number of 64-bit words in the state vector
+ */
+DFA_ALWAYS_INLINE void bitnfa_scan_loop(const struct bitnfa *bn,
+					const unsigned char *data, size_t len,
+					uint64_t *alive, bool *matched,
+					size_t remaining, dfa_match_cb cb,
+					void *ctx, const size_t words)
+{
+	uint64_t state[BITNFA_MAX_WORDS] = {0};
+
+	for (size_t i = 0; i < len; i++) {
+		uint64_t next[BITNFA_MAX_WORDS];
+		uint64_t carry = 0, hit = 0, active = 0;
+
+		for (size_t w = 0; w < words; w++) {
+			uint64_t moved = state[w] & bn->shift[w];
+
+			next[w] = (moved << 1) | carry | bn->first_float[w];
+			carry = moved >> 63;
+			if (i == 0)
+				next[w] |= bn->first_start[w];
+		}
+
+		for (size_t t = 0; t < bn->table_cnt; t++) {
+			size_t k = bn->table_chunk[t];
+			unsigned bits = (state[k / 8] >> (8 * (k % 8))) & 0xFF;
+
+			if (bits != 0)
+				for (size_t w = 0; w < words; w++)
+					next[w] |= bn->table[t][bits][w];
+		}
+
+		for (size_t w = 0; w < words; w++) {
+			state[w] = next[w] & bn->mask[data[i]][w] & alive[w];
+			hit |= state[w] & bn->last_all[w];
+			active |= state[w] | (bn->first_float[w] & alive[w]);
+		}
+
+		if (hit != 0 && bitnfa_report(bn, state, alive, matched, i + 1,
+					      &remaining, cb, ctx) != 0)
+			return;
+
+		/* only anchored patterns are left and all of them failed */
+		if (active == 0)
+			return;
+	}
+}
+
+int bitnfa_scan(const struct bitnfa *bn, const void *data, size_t len,
+		dfa_match_cb cb, void *ctx)
+{
+	uint64_t alive[BITNFA_MAX_WORDS] = {0};
+	size_t remaining = bn->cnt;
+	bool *matched;
+
+	if (!bn->compiled)
+		return -1;
+
+	matched = calloc(bn->cnt + 1, sizeof(bool));
+	if (matched == NULL)
+		return -1;
+
+	for (size_t i = 0; i < bn->cnt; i++)
+		bitnfa_set_or(alive, bn->pats[i].all);
+
+	/*
+	 * the empty string is accepted with the first byte, as the initial
+	 * state of the DFA built by convert_nfa_to_dfa() is never final
+	 */
+	for (size_t i = 0; i < bn->cnt && len != 0; i++) {
+		if (!bn->pats[i].nullable)
+			continue;
+
+		matched[i] = true;
+		remaining--;
+		for (size_t w = 0; w < BITNFA_MAX_WORDS; w++)
+			alive[w] &= ~bn->pats[i].all[w];
+
+		if (cb(i, 1, ctx) != 0) {
+			remaining = 0;
+			break;
+		}
+	}
+
+	if (remaining != 0) {
+		switch (bn->words) {
+		case 1:
+			bitnfa_scan_loop(bn, data, len, alive, matched,
+					 remaining, cb, ctx, 1);
+			break;
+		case 2:
+			bitnfa_scan_loop(bn, data, len, alive, matched,
+					 remaining, cb, ctx, 2);
+			break;
+		default:
+			bitnfa_scan_loop(bn, data, len, alive, matched,
+					 remaining, cb, ctx, 4);
+			break;
+		}
+	}
+
+	free(matched);
+
+	return 0;
+}
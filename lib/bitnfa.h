@@ -0,0 +1,215 @@
+/*
+ * Bit-parallel simulation of Glushkov automata.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup bitnfa bitnfa
+ * @{
+ */
+
+#ifndef REFA_BITNFA_H
+#define REFA_BITNFA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "dfa_scan.h"
+#include "parser.h"
+
+/** maximum number of positions of all patterns */
+#define BITNFA_MAX_POSITIONS	(256)
+
+/** maximum number of 64-bit words in the state vector */
+#define BITNFA_MAX_WORDS	(BITNFA_MAX_POSITIONS / 64)
+
+/** number of positions that share one table of irregular transitions */
+#define BITNFA_CHUNK		(8)
+
+/**
+ * structure that represents one pattern packed into the state vector
+ */
+struct bitnfa_pattern {
+	/**
+	 * positions of the pattern
+	 */
+	uint64_t all[BITNFA_MAX_WORDS];
+
+	/**
+	 * positions that end the pattern's match
+	 */
+	uint64_t last[BITNFA_MAX_WORDS];
+
+	/**
+	 * positions that start the pattern's match
+	 */
+	uint64_t first[BITNFA_MAX_WORDS];
+
+	/**
+	 * beginning of the pattern is not anchored
+	 */
+	bool floating;
+
+	/**
+	 * pattern matches the empty string
+	 */
+	bool nullable;
+};
+
+/**
+ * structure that represents set of patterns simulated with one bit vector
+ *
+ * Every position (character or character class of the regular expression
+ * with repetitions expanded) has one bit in the state vector. The bit is
+ * set if the position's character was just read by some path of
+ * the Glushkov automaton.
+ */
+struct bitnfa {
+	/**
+	 * number of positions
+	 */
+	size_t pos_cnt;
+
+	/**
+	 * number of 64-bit words in the state vector (1, 2 or 4)
+	 */
+	size_t words;
+
+	/**
+	 * characters of the positions
+	 */
+	uint64_t cls[BITNFA_MAX_POSITIONS][BITNFA_MAX_WORDS];
+
+	/**
+	 * positions that may follow the position
+	 */
+	uint64_t follow[BITNFA_MAX_POSITIONS][BITNFA_MAX_WORDS];
+
+	/**
+	 * positions that may read the byte, indexed by bytes
+	 */
+	uint64_t mask[256][BITNFA_MAX_WORDS];
+
+	/**
+	 * positions that are followed by the next position,
+	 * these transitions are simulated by the shift of the vector
+	 */
+	uint64_t shift[BITNFA_MAX_WORDS];
+
+	/**
+	 * first positions of the floating patterns
+	 */
+	uint64_t first_float[BITNFA_MAX_WORDS];
+
+	/**
+	 * first positions of the anchored patterns
+	 */
+	uint64_t first_start[BITNFA_MAX_WORDS];
+
+	/**
+	 * last positions of all patterns
+	 */
+	uint64_t last_all[BITNFA_MAX_WORDS];
+
+	/**
+	 * tables of the other transitions, one table per chunk of
+	 * BITNFA_CHUNK positions, indexed by the chunk's bits
+	 */
+	uint64_t (*table)[256][BITNFA_MAX_WORDS];
+
+	/**
+	 * chunks of the tables
+	 */
+	size_t *table_chunk;
+
+	/**
+	 * number of tables
+	 */
+	size_t table_cnt;
+
+	/**
+	 * array of patterns
+	 */
+	struct bitnfa_pattern *pats;
+
+	/**
+	 * number of patterns
+	 */
+	size_t cnt;
+
+	/**
+	 * number of allocated patterns
+	 */
+	size_t malloc_cnt;
+
+	/**
+	 * tables are built after the last added pattern
+	 */
+	bool compiled;
+};
+
+/**
+ * Allocate bit-parallel automaton.
+ *
+ * @param bn	pointer to the bitnfa structure
+ * @return	0 on success
+ */
+int bitnfa_alloc(struct bitnfa *bn);
+
+/**
+ * Free bit-parallel automaton.
+ *
+ * @param bn	pointer to the bitnfa structure
+ */
+void bitnfa_free(struct bitnfa *bn);
+
+/**
+ * Add regexp tree to bit-parallel automaton.
+ *
+ * Builds the Glushkov automaton of the regular expression: repetitions
+ * are expanded into copies of the repeated subexpressions, so the number
+ * of positions is the number of characters after the expansion. The '.*'
+ * nodes around unanchored expressions do not need positions.
+ *
+ * @param bn		pointer to the bitnfa structure
+ * @param re_tree	pointer to the regexp tree
+ * @param id		place for the identifier of the pattern, may be NULL
+ * @return		0 on success, -1 if all patterns need more than
+ *			BITNFA_MAX_POSITIONS positions
+ */
+int bitnfa_add(struct bitnfa *bn, const struct regexp_tree *re_tree,
+	       size_t *id);
+
+/**
+ * Compile bit-parallel automaton.
+ *
+ * Chooses the width of the state vector (64, 128 or 256 bits) and builds
+ * the masks of the bytes and the tables of the transitions that are not
+ * simulated by the shift.
+ *
+ * @param bn	pointer to the bitnfa structure
+ * @return	0 on success
+ */
+int bitnfa_compile(struct bitnfa *bn);
+
+/**
+ * Scan data with bit-parallel automaton.
+ *
+ * Each byte costs a constant number of word operations regardless of
+ * the data and the patterns. For every matched pattern the callback gets
+ * the end of its first match, exactly as dfa_scan() with the pattern's
+ * DFA would report it.
+ *
+ * @param bn	pointer to the compiled bitnfa structure
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @param cb	callback for the matches
+ * @param ctx	user's context of the callback
+ * @return	0 on success, -1 on error
+ */
+int bitnfa_scan(const struct bitnfa *bn, const void *data, size_t len,
+		dfa_match_cb cb, void *ctx);
+
+#endif /** REFA_BITNFA_H @} */
@@ -11,9 +11,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdbool.h>
 
 #include <stdio.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #ifdef USE_ZLIB
 #include <zlib.h>
 #define DFA_ZLIB_CHUNK_SIZE	(4096 * 16)
@@ -21,10 +27,31 @@
 #endif
 
 #include "dfa.h"
+#include "dfa_block.h"
+#include "dfa_checkpoint.h"
+#include "dfa_extern.h"
+#include "dfa_storage.h"
+#include "endian_inner.h"
 
 #define DFA_CHUNK_SIZE		(32)
 
-#define _ALIGN_TO(a, b)	((((a) + (b) - 1) / (b)) * (b))
+/* longest name of the entry accepted from the file (with \0) */
+#define DFA_ENTRY_NAME_MAX	(4096)
+
+/* size of the header of the mappable file */
+#define DFA_MAP_HEADER_SIZE	(128)
+
+/* bits of the last byte of the version of the dfa file */
+#define DFA_FILE_ENTRIES	(0x01)
+#define DFA_FILE_BLOCKS		(0x04)
+
+/*
+ * most states stored in one byte of the dfa file: a state takes at least
+ * 257 bytes before the compression, zlib does not compress more than
+ * 1032 times
+ */
+#define DFA_FILE_STATES_PER_BYTE	(4)
+
 #define _4CHAR_TO_UINT(a,b,c,d) (a + b * 256 + c * 256 * 256 + d * 256 * 256 * 256)
 
 #define GET_BIT(a,b) (((a)[(b) / 8] >> ((b) % 8)) & 1)
@@ -36,6 +63,9 @@
 
 static int dfa_state_set_deadend(struct dfa *dfa, size_t state, int deadend);
 static int dfa_state_calc_deadend(struct dfa *dfa, size_t state);
+static int dfa_open_map(struct dfa *dst, char *filename, bool copy);
+static int dfa_open_map_fd(struct dfa *dst, int fd, uint64_t offset,
+			   uint64_t size, bool copy);
 
 static int max_to_bps(size_t max)
 {
@@ -88,6 +118,12 @@ int dfa_alloc(struct dfa *dfa)
 	dfa->trans = NULL;
 	dfa->flags = NULL;
 	dfa->first_index = 0;
+	dfa->accel = NULL;
+	dfa->entries = NULL;
+	dfa->entry_cnt = 0;
+	dfa->map = NULL;
+	dfa->map_size = 0;
+	dfa->storage = NULL;
 
 	return 0;
 }
@@ -104,6 +140,12 @@ int dfa_alloc2(struct dfa *dfa, size_t max_cnt)
 	dfa->trans = NULL;
 	dfa->flags = NULL;
 	dfa->first_index = 0;
+	dfa->accel = NULL;
+	dfa->entries = NULL;
+	dfa->entry_cnt = 0;
+	dfa->map = NULL;
+	dfa->map_size = 0;
+	dfa->storage = NULL;
 
 	return 0;
 }
@@ -118,6 +160,8 @@ int dfa_change_max_size(struct dfa *dfa, size_t max_cnt)
 
 	if (dfa->bps == max_to_bps(max_cnt)) {
 		dfa->state_max_cnt = max_cnt;
+	} else if (dfa->map != NULL) {
+		return -1;
 	} else {
 		int	bps_new = max_to_bps(max_cnt);
 		size_t	state_size_new = 256 * ((bps_new + 7) / 8);
@@ -127,9 +171,15 @@ int dfa_change_max_size(struct dfa *dfa, size_t max_cnt)
 					size_t	to = dfa_get_trans(dfa, i, j);
 					dfa_add_trans_native(dfa, state_size_new, bps_new, i, j, to);
 				}
-			dfa->trans = realloc(dfa->trans, state_size_new * dfa->state_malloc_cnt);
+			if (dfa->storage == NULL)
+				dfa->trans = realloc(dfa->trans, state_size_new * dfa->state_malloc_cnt);
 		} else {
-			dfa->trans = realloc(dfa->trans, state_size_new * dfa->state_malloc_cnt);
+			if (dfa->storage != NULL) {
+				if (dfa_storage_reserve(dfa, state_size_new * dfa->state_malloc_cnt) != 0)
+					return -1;
+			} else {
+				dfa->trans = realloc(dfa->trans, state_size_new * dfa->state_malloc_cnt);
+			}
 			for (size_t i = dfa->state_cnt; i > 0; i--)
 				for (int j = 255; j > -1; j--) {
 					size_t	to = dfa_get_trans(dfa, i - 1, j);
@@ -148,12 +198,43 @@ int dfa_change_max_size(struct dfa *dfa, size_t max_cnt)
 void dfa_free(struct dfa *dfa)
 {
 	if (dfa != NULL) {
-		free(dfa->trans);
-		free(dfa->flags);
+		if (dfa->map != NULL) {
+			munmap(dfa->map, dfa->map_size);
+		} else {
+			if (dfa->storage != NULL)
+				dfa_storage_free(dfa);
+			else
+				free(dfa->trans);
+			free(dfa->flags);
+		}
 		free(dfa->comment);
+		free(dfa->accel);
+		for (size_t i = 0; i < dfa->entry_cnt; i++)
+			free(dfa->entries[i].name);
+		free(dfa->entries);
 	}
 }
 
+/**
+ * @brief Remove acceleration of states.
+ *
+ * Escape bytes become invalid when transitions are rebuilt, so they are
+ * dropped and have to be recalculated with dfa_accelerate().
+ *
+ * @param dfa	pointer to the dfa structure
+ */
+static void dfa_accel_drop(struct dfa *dfa)
+{
+	if (dfa->accel == NULL)
+		return;
+
+	for (size_t i = 0; i < dfa->state_cnt; i++)
+		dfa->flags[i] &= 0xFF ^ DFA_FLAG_ACCEL;
+
+	free(dfa->accel);
+	dfa->accel = NULL;
+}
+
 int dfa_join(struct dfa *dst, const struct dfa *src)
 {
 	struct dfa dfa_joined;
@@ -172,7 +253,167 @@ int dfa_join(struct dfa *dst, const struct dfa *src)
 	return result;
 }
 
+/**
+ * @brief Mix the DFA into the tag of the join.
+ *
+ * The flags without the acceleration and every transition are mixed in,
+ * so the DFAs of the same size but with other states differ.
+ *
+ * @param tag	tag of the previous values
+ * @param dfa	the DFA
+ * @return	the new tag
+ */
+static uint64_t dfa_join_tag_dfa(uint64_t tag, const struct dfa *dfa)
+{
+	tag = dfa_checkpoint_tag(tag, dfa->state_cnt);
+	tag = dfa_checkpoint_tag(tag, dfa->first_index);
+
+	for (size_t i = 0; i < dfa->state_cnt; i++) {
+		tag = dfa_checkpoint_tag(tag, dfa->flags[i] &
+					 (0xFF ^ DFA_FLAG_ACCEL));
+		for (int c = 0; c < 256; c++)
+			tag = dfa_checkpoint_tag(tag, dfa_get_trans(dfa, i, c));
+	}
+
+	return tag;
+}
+
+/**
+ * @brief Tag of the joined DFAs stored in the checkpoint.
+ *
+ * @param dfa1	the larger DFA
+ * @param dfa2	the smaller DFA
+ * @return	the tag
+ */
+static uint64_t dfa_join_tag(const struct dfa *dfa1, const struct dfa *dfa2)
+{
+	return dfa_join_tag_dfa(dfa_join_tag_dfa(0, dfa1), dfa2);
+}
+
+/**
+ * @brief Save the state of the join.
+ *
+ * The pairs of the source states are stored in the order of the joined
+ * states, the lists of pairs_2 are rebuilt from them.
+ *
+ * @param cp	pointer to the checkpoint
+ * @param tag	tag of the sources
+ * @param dst	the DFA built so far
+ * @param pairs	pairs of the source states
+ * @param cnt	number of the pairs
+ * @param done	number of the processed states
+ * @return	0 on success
+ */
+static int dfa_join_save(struct dfa_checkpoint *cp, uint64_t tag,
+			 const struct dfa *dst, const size_t *pairs, size_t cnt,
+			 size_t done)
+{
+	bool failure;
+
+	failure = dfa_checkpoint_begin(cp, DFA_CHECKPOINT_JOIN, tag, done) != 0;
+
+	for (size_t i = 0; i < cnt * 2 && !failure; i++)
+		failure = dfa_checkpoint_put(cp, pairs[i]) != 0;
+
+	if (failure) {
+		dfa_checkpoint_close(cp);
+		return -1;
+	}
+
+	return dfa_checkpoint_commit(cp, dst);
+}
+
+/**
+ * @brief Restore the state of the join from the checkpoint.
+ *
+ * @param cp		pointer to the checkpoint
+ * @param tag		tag of the sources
+ * @param dst		the destination DFA, replaced with the saved one
+ * @param dfa1		the larger DFA
+ * @param dfa2		the smaller DFA
+ * @param pairs		place for the pairs of the source states
+ * @param pairs_2	empty lists of the pairs by the first state
+ * @param pairs_cnt	sizes of the lists
+ * @param cnt		place for the number of the pairs
+ * @param done		place for the number of the processed states
+ * @return		0 on success, 1 if there is no checkpoint,
+ *			-1 on failure
+ */
+static int dfa_join_resume(struct dfa_checkpoint *cp, uint64_t tag,
+			   struct dfa *dst, const struct dfa *dfa1,
+			   const struct dfa *dfa2, size_t **pairs,
+			   size_t **pairs_2, size_t *pairs_cnt, size_t *cnt,
+			   size_t *done)
+{
+	size_t *saved = NULL;
+	uint64_t saved_done, val;
+	struct dfa dfa;
+	bool failure;
+	int ret;
+
+	ret = dfa_checkpoint_resume(cp, DFA_CHECKPOINT_JOIN, tag, &saved_done,
+				    &dfa);
+	if (ret != 0)
+		return ret;
+
+	failure = dfa.bps != dst->bps || dfa.state_cnt > dst->state_max_cnt ||
+		  dfa.state_cnt == 0 || saved_done > dfa.state_cnt ||
+		  cp->data_cnt != (uint64_t)dfa.state_cnt * 2 ||
+		  (saved = malloc(sizeof(size_t) * 2 * dfa.state_cnt)) == NULL;
+
+	for (size_t i = 0; i < dfa.state_cnt * 2 && !failure; i++) {
+		failure = dfa_checkpoint_get(cp, &val) != 0 ||
+			  val >= (i % 2 == 0 ? dfa1 : dfa2)->state_cnt;
+		saved[i] = val;
+	}
+
+	/* the lists are filled in the order the pairs were found */
+	for (size_t i = 0; i < dfa.state_cnt && !failure; i++) {
+		size_t first = saved[i * 2], *list;
+
+		list = realloc(pairs_2[first],
+			       sizeof(size_t) * 2 * (pairs_cnt[first] + 1));
+		failure = list == NULL;
+		if (!failure) {
+			pairs_2[first] = list;
+			list[pairs_cnt[first] * 2] = saved[i * 2 + 1];
+			list[pairs_cnt[first] * 2 + 1] = i;
+			pairs_cnt[first]++;
+		}
+	}
+
+	dfa_checkpoint_close(cp);
+
+	if (failure) {
+		free(saved);
+		dfa_free(&dfa);
+		return -1;
+	}
+
+	free(*pairs);
+	*pairs = saved;
+	*cnt = dfa.state_cnt;
+	*done = saved_done;
+
+	/* the comment is set when the join is finished */
+	free(dfa.comment);
+	dfa.comment = NULL;
+	dfa.comment_size = 0;
+
+	dfa.state_max_cnt = dst->state_max_cnt;
+	dfa_free(dst);
+	*dst = dfa;
+
+	return 0;
+}
+
 int dfa_join2(struct dfa *dst, const struct dfa *src1, const struct dfa *src2)
+{
+	return dfa_join_checkpoint(dst, src1, src2, NULL) == 0 ? 0 : -1;
+}
+
+int dfa_join_checkpoint(struct dfa *dst, const struct dfa *src1,
+			const struct dfa *src2, struct dfa_checkpoint *cp)
 {
 /* TODO: refactor */
 	const struct dfa *dfa1 = src1, *dfa2 = src2;
@@ -198,18 +439,44 @@ int dfa_join2(struct dfa *dst, const struct dfa *src1, const struct dfa *src2)
 	size_t cur[2];
 	size_t next[2];
 
-	pairs[0] = dfa1->first_index;
-	pairs[1] = dfa2->first_index;
-	pairs_2[dfa1->first_index] = realloc(pairs_2[dfa1->first_index],
-					  ++pairs_cnt[dfa1->first_index] * 2 * sizeof(size_t));
-	pairs_2[dfa1->first_index][(pairs_cnt[dfa1->first_index] - 1) * 2] = dfa2->first_index;
-	pairs_2[dfa1->first_index][(pairs_cnt[dfa1->first_index] - 1) * 2 + 1] = cnt;
-	cnt++;
-
-	dfa_add_state(dst, NULL);
-	dfa_state_set_final(dst, 0, dfa_state_is_final(dfa1, dfa1->first_index) ||
-				  dfa_state_is_final(dfa2, dfa2->first_index));
-	for (size_t cur_index = 0; cur_index < cnt; cur_index++) {
+	uint64_t tag = dfa_join_tag(dfa1, dfa2);
+	size_t start = 0;
+	int resumed = 1;
+	bool stopped = false;
+
+	if (cp != NULL)
+		resumed = dfa_join_resume(cp, tag, dst, dfa1, dfa2, &pairs,
+					  pairs_2, pairs_cnt, &cnt, &start);
+
+	if (resumed == 1) {
+		pairs[0] = dfa1->first_index;
+		pairs[1] = dfa2->first_index;
+		pairs_2[dfa1->first_index] = realloc(pairs_2[dfa1->first_index],
+						  ++pairs_cnt[dfa1->first_index] * 2 * sizeof(size_t));
+		pairs_2[dfa1->first_index][(pairs_cnt[dfa1->first_index] - 1) * 2] = dfa2->first_index;
+		pairs_2[dfa1->first_index][(pairs_cnt[dfa1->first_index] - 1) * 2 + 1] = cnt;
+		cnt++;
+
+		dfa_add_state(dst, NULL);
+		dfa_state_set_final(dst, 0, dfa_state_is_final(dfa1, dfa1->first_index) ||
+					  dfa_state_is_final(dfa2, dfa2->first_index));
+	}
+	for (size_t cur_index = start; cur_index < cnt && resumed >= 0;
+	     cur_index++) {
+		if (cp != NULL && cur_index != start) {
+			if (cp->limit != 0 && cur_index - start == cp->limit) {
+				stopped = true;
+				if (dfa_join_save(cp, tag, dst, pairs, cnt,
+						  cur_index) != 0)
+					resumed = -1;
+				break;
+			}
+
+			/* the failed checkpoint does not break the join */
+			if (cp->interval != 0 && cur_index % cp->interval == 0)
+				dfa_join_save(cp, tag, dst, pairs, cnt, cur_index);
+		}
+
 		tmp_cnt = 0;
 		cur[0] = pairs[cur_index * 2];
 		cur[1] = pairs[cur_index * 2 + 1];
@@ -286,9 +553,16 @@ if (!dfa_state_is_final(dst, cur_index))
 
 	free(tmp_pairs);
 
+	if (resumed < 0)
+		return -1;
+	if (stopped)
+		return 1;
+	if (cp != NULL)
+		dfa_checkpoint_remove(cp);
+
 /* copy comments to result dfa */
 
-	dst->comment_size = src1->comment_size + src1->comment_size;
+	dst->comment_size = src1->comment_size + src2->comment_size;
 	dst->comment = malloc(dst->comment_size);
 	memcpy(dst->comment, src1->comment, src1->comment_size);
 	memcpy(dst->comment + src1->comment_size, src2->comment,
@@ -301,6 +575,76 @@ if (!dfa_state_is_final(dst, cur_index))
 	return 0;
 }
 
+int dfa_join_extern(struct dfa *dst, const struct dfa *src1,
+		    const struct dfa *src2, struct dfa_extern *ext,
+		    const char *filename)
+{
+	const struct dfa *dfa1 = src1, *dfa2 = src2;
+	size_t cur[2], next[2], index, len;
+	const size_t *key;
+	char *comment;
+	size_t comment_size;
+	bool failure;
+	int ret = 0;
+
+	/* the same order of the sources as in dfa_join2() */
+	if (src1->state_cnt < src2->state_cnt) {
+		dfa1 = src2;
+		dfa2 = src1;
+	}
+
+	cur[0] = dfa1->first_index;
+	cur[1] = dfa2->first_index;
+	failure = dfa_extern_begin(ext, dst, filename, true, cur, 2,
+				   dfa_state_is_final(dfa1, cur[0]) ||
+				   dfa_state_is_final(dfa2, cur[1])) != 0;
+
+	while (!failure &&
+	       (ret = dfa_extern_next(ext, &key, &len, &index)) == 0) {
+		cur[0] = key[0];
+		cur[1] = key[1];
+
+		if ((dfa_state_is_deadend(dfa1, cur[0]) && dfa_state_is_final(dfa1, cur[0])) ||
+		    (dfa_state_is_deadend(dfa2, cur[1]) && dfa_state_is_final(dfa2, cur[1])) ||
+		    (dfa_state_is_deadend(dfa1, cur[0]) && dfa_state_is_deadend(dfa2, cur[1]))) {
+			for (int i = 0; i < 256 && !failure; i++)
+				failure = dfa_extern_trans_index(ext, i, index) != 0;
+			continue;
+		}
+
+		for (int i = 0; i < 256 && !failure; i++) {
+			next[0] = dfa_get_trans(dfa1, cur[0], i);
+			next[1] = dfa_get_trans(dfa2, cur[1], i);
+
+			failure = dfa_extern_trans(ext, i, next, 2,
+						   dfa_state_is_final(dfa1, next[0]) ||
+						   dfa_state_is_final(dfa2, next[1])) != 0;
+		}
+	}
+
+	if (failure || ret < 0) {
+		dfa_extern_abort(ext);
+		return -1;
+	}
+
+	comment_size = src1->comment_size + src2->comment_size;
+	comment = malloc(comment_size + 1);
+	if (comment == NULL) {
+		dfa_extern_abort(ext);
+		return -1;
+	}
+
+	memcpy(comment, src1->comment, src1->comment_size);
+	memcpy(comment + src1->comment_size, src2->comment, src2->comment_size);
+	if (src1->comment_size > 0 && src2->comment_size > 0)
+		comment[src1->comment_size - 1] = '\n';
+
+	ret = dfa_extern_finish(ext, dst, comment, comment_size);
+	free(comment);
+
+	return ret;
+}
+
 int dfa_append(struct dfa *first, struct dfa *second)
 {
 	uint64_t m_index = 0;
@@ -320,6 +664,8 @@ int dfa_append(struct dfa *first, struct dfa *second)
 	if (!m_found)
 		return -1;
 
+	dfa_accel_drop(first);
+
 	uint64_t offset;
 	uint64_t sf_index = second->first_index;
 	dfa_add_n_state(first, second->state_cnt - 1, &offset);
@@ -405,6 +751,8 @@ int dfa_minimize(struct dfa *dfa)
 	size_t max_cnt = dfa->state_cnt,
 	       class_cnt = 2;
 
+	dfa_accel_drop(dfa);
+
 	class_elements = malloc(sizeof(size_t) * max_cnt);
 	class_offset = malloc(sizeof(size_t) * 2 * max_cnt);
 	element_class = malloc(sizeof(size_t) * max_cnt);
@@ -658,6 +1006,9 @@ int dfa_minimize(struct dfa *dfa)
 			}
 
 
+	for (size_t i = 0; i < dfa->entry_cnt; i++)
+		dfa->entries[i].state = class_elements[dfa->entries[i].state];
+
 	dfa->state_cnt	= class_cnt;
 	dfa->first_index = 0;
 
@@ -690,6 +1041,104 @@ int dfa_compress(struct dfa *dfa)
 	return 0;
 }
 
+size_t dfa_byte_classes(const struct dfa *dfa, uint8_t *classes)
+{
+	int rep[256];
+	size_t cnt = 0;
+
+	for (int c = 0; c < 256; c++) {
+		size_t k;
+
+		for (k = 0; k < cnt; k++) {
+			size_t i;
+
+			for (i = 0; i < dfa->state_cnt; i++)
+				if (dfa_get_trans(dfa, i, c) !=
+				    dfa_get_trans(dfa, i, rep[k]))
+					break;
+
+			if (i == dfa->state_cnt)
+				break;
+		}
+
+		if (k == cnt)
+			rep[cnt++] = c;
+
+		classes[c] = k;
+	}
+
+	return cnt;
+}
+
+int dfa_set_entry(struct dfa *dfa, const char *name, size_t state)
+{
+	struct dfa_entry *tmp;
+	size_t size = strlen(name) + 1;
+
+	if (state >= dfa->state_cnt)
+		return -1;
+
+	for (size_t i = 0; i < dfa->entry_cnt; i++)
+		if (strcmp(dfa->entries[i].name, name) == 0) {
+			dfa->entries[i].state = state;
+			return 0;
+		}
+
+	tmp = realloc(dfa->entries, sizeof(*tmp) * (dfa->entry_cnt + 1));
+	if (tmp == NULL)
+		return -1;
+	dfa->entries = tmp;
+
+	tmp = &dfa->entries[dfa->entry_cnt];
+	tmp->name = malloc(size);
+	if (tmp->name == NULL)
+		return -1;
+
+	memcpy(tmp->name, name, size);
+	tmp->state = state;
+	dfa->entry_cnt++;
+
+	return 0;
+}
+
+int dfa_add_entry(struct dfa *dst, const char *name, const struct dfa *src)
+{
+	size_t offset = dst->state_cnt;
+
+	if (offset + src->state_cnt > dst->state_max_cnt &&
+	    dfa_change_max_size(dst, offset + src->state_cnt) != 0)
+		return -1;
+
+	dfa_accel_drop(dst);
+
+	dfa_add_n_state(dst, src->state_cnt, NULL);
+	if (dst->state_cnt != offset + src->state_cnt)
+		return -1;
+
+	for (size_t i = 0; i < src->state_cnt; i++) {
+		dst->flags[offset + i] = src->flags[i] & (0xFF ^ DFA_FLAG_ACCEL);
+		for (int j = 0; j < 256; j++)
+			dfa_add_trans(dst, offset + i, j,
+				      offset + dfa_get_trans(src, i, j));
+	}
+
+	if (offset == 0)
+		dst->first_index = src->first_index;
+
+	return dfa_set_entry(dst, name, offset + src->first_index);
+}
+
+int dfa_get_entry(const struct dfa *dfa, const char *name, size_t *state)
+{
+	for (size_t i = 0; i < dfa->entry_cnt; i++)
+		if (strcmp(dfa->entries[i].name, name) == 0) {
+			*state = dfa->entries[i].state;
+			return 0;
+		}
+
+	return -1;
+}
+
 int dfa_add_trans_native(struct dfa *dfa, size_t state_size, int bps, size_t from, unsigned char mark, size_t to)
 {
 	void *state;
@@ -819,10 +1268,13 @@ int dfa_state_calc_deadend(struct dfa *dfa, size_t state)
 
 int dfa_add_state(struct dfa *dfa, size_t *index)
 {
-	if (dfa->state_cnt >= dfa->state_max_cnt)
+	if (dfa->state_cnt >= dfa->state_max_cnt || dfa->map != NULL)
 		return -1;
 
-	if (dfa->state_malloc_cnt == dfa->state_cnt) {
+	if (dfa->state_malloc_cnt == dfa->state_cnt && dfa->storage != NULL) {
+		if (dfa_storage_grow(dfa, dfa->state_cnt + 1) != 0)
+			return -1;
+	} else if (dfa->state_malloc_cnt == dfa->state_cnt) {
 		dfa->state_malloc_cnt = MIN(dfa->state_malloc_cnt + DFA_CHUNK_SIZE,
 					    dfa->state_max_cnt);
 
@@ -834,6 +1286,9 @@ int dfa_add_state(struct dfa *dfa, size_t *index)
 		*index = dfa->state_cnt;
 
 	dfa->flags[dfa->state_cnt] = 0x00;
+	/* unfinished DFA is saved in checkpoints and its targets are checked */
+	memset((char *)dfa->trans + dfa->state_cnt * dfa->state_size, 0x00,
+	       dfa->state_size);
 
 	dfa->state_cnt++;
 
@@ -851,13 +1306,20 @@ int dfa_add_n_state(struct dfa *dfa, size_t cnt, size_t *index)
 	return 0;
 }
 
-int dfa_save_to_file(const struct dfa *src, char *filename)
+int dfa_save_header(const struct dfa *src, FILE *dst, const char *alg)
 {
-	FILE *dst = fopen(filename, "w");
+	unsigned char ver[8] = "ver#\x00\x01\x00\x02";
 
 	fwrite("\x57""DFA\x16\x16\x16\x16", 8, 1, dst);
-	fwrite("ver#", 4, 1, dst);
-	fwrite("\x00\x01\x00\x02", 4, 1, dst);
+	/*
+	 * the older versions read only the files without the bits: without
+	 * entries and with the states that are not stored in blocks
+	 */
+	if (src->entry_cnt != 0)
+		ver[7] |= DFA_FILE_ENTRIES;
+	if (memcmp(alg, "blks", 4) == 0)
+		ver[7] |= DFA_FILE_BLOCKS;
+	fwrite(ver, 8, 1, dst);
 	fwrite("cnt#", 4, 1, dst);
 	uint64_t tmp64;
 	tmp64 = src->state_cnt;
@@ -874,74 +1336,432 @@ int dfa_save_to_file(const struct dfa *src, char *filename)
 	fwrite(&tmp64, sizeof(tmp64), 1, dst);
 	fwrite(src->comment, 1, src->comment_size, dst);
 
-#ifdef USE_ZLIB
-	fwrite("alg:gzip", 8, 1, dst);
-#else
-	fwrite("alg:flat", 8, 1, dst);
-#endif
+	if (src->entry_cnt != 0) {
+		fwrite("ent#", 4, 1, dst);
+		tmp64 = src->entry_cnt;
+		fwrite(&tmp64, sizeof(tmp64), 1, dst);
+
+		for (size_t i = 0; i < src->entry_cnt; i++) {
+			tmp64 = src->entries[i].state;
+			fwrite(&tmp64, sizeof(tmp64), 1, dst);
+			tmp64 = strlen(src->entries[i].name) + 1;
+			fwrite(&tmp64, sizeof(tmp64), 1, dst);
+			fwrite(src->entries[i].name, 1, tmp64, dst);
+		}
+	}
 
-	unsigned char in[256 * 8 + 8];
-#ifdef USE_ZLIB
-	unsigned char out[DFA_ZLIB_CHUNK_SIZE];
-	int zret;
+	fwrite("alg:", 4, 1, dst);
+	fwrite(alg, 4, 1, dst);
 
-	z_stream zstrm;
+	return !ferror(dst) ? 0 : -1;
+}
 
-	zstrm.zalloc = Z_NULL;
-	zstrm.zfree = Z_NULL;
-	zstrm.opaque = Z_NULL;
+int dfa_save_to_file(const struct dfa *src, char *filename)
+{
+	return dfa_save_to_file2(src, filename, 1, NULL);
+}
 
-	zret = deflateInit(&zstrm, DFA_ZLIB_LEVEL);
-	if (zret != Z_OK)
-		goto out_err;
-#endif
-	for (size_t i = 0; i < src->state_cnt; i++) {
-#ifdef USE_ZLIB
-		int flush = (i == src->state_cnt - 1 ? Z_FINISH : Z_NO_FLUSH);
-#endif
-		in[0] = src->flags[i];
+int dfa_save_to_file2(const struct dfa *src, char *filename,
+		      size_t thread_cnt, const char *codec)
+{
+	FILE *dst = fopen(filename, "w");
+	bool failure;
 
-		for (int j = 0; j < 256; j++)
-			((uint64_t *)in)[j + 1] = dfa_get_trans(src, i, j);
-#ifdef USE_ZLIB
-		zstrm.avail_in = sizeof(uint64_t) * (256 + 1);
-		zstrm.next_in = in;
+	if (dst == NULL) {
+		perror(filename);
+		return -1;
+	}
 
-		do {
-			zstrm.avail_out = DFA_ZLIB_CHUNK_SIZE;
-			zstrm.next_out = out;
-
-			zret = deflate(&zstrm, flush);
-			/* check error (zret) */
-			/* need check */
-			fwrite(out, 1, DFA_ZLIB_CHUNK_SIZE - zstrm.avail_out, dst);
-		} while (zstrm.avail_out == 0);
-#else
-		fwrite(in, 1, sizeof(uint64_t) * (256 + 1), dst);
-#endif
+	failure = dfa_save_header(src, dst, "blks") != 0 ||
+		  dfa_block_save(src, dst, thread_cnt, codec) != 0;
+	failure = fclose(dst) != 0 || failure;
+
+	return !failure ? 0 : -1;
+}
+
+/**
+ * @brief Check that the section lies inside the file.
+ *
+ * @param offset	offset of the section
+ * @param len		size of the section
+ * @param size		size of the file
+ * @return		true if the section is inside the file
+ */
+static bool dfa_map_section_ok(uint64_t offset, uint64_t len, size_t size)
+{
+	return offset <= size && len <= size - offset;
+}
+
+int dfa_save_to_map_file(const struct dfa *src, char *filename)
+{
+	bool failure;
+	FILE *dst;
+
+	dst = fopen(filename, "w");
+	if (dst == NULL)
+		return -1;
+
+	failure = dfa_save_map(src, dst) != 0;
+	failure = fclose(dst) != 0 || failure;
+
+	return !failure ? 0 : -1;
+}
+
+int dfa_save_map_header(const struct dfa *src, FILE *dst,
+			uint64_t comment_off, uint64_t entry_off,
+			uint64_t entry_size, uint64_t flags_off,
+			uint64_t trans_off)
+{
+	unsigned char header[DFA_MAP_HEADER_SIZE];
+
+	memset(header, 0x00, sizeof(header));
+	memcpy(header, "\x57""DFA\x16\x16\x16\x16", 8);
+	memcpy(header + 8, "ver#\x00\x02\x00\x00", 8);
+	put_le64(header + 16, src->state_cnt);
+	put_le64(header + 24, src->bps);
+	put_le64(header + 32, src->first_index);
+	put_le64(header + 40, comment_off);
+	put_le64(header + 48, src->comment_size);
+	put_le64(header + 56, entry_off);
+	put_le64(header + 64, src->entry_cnt);
+	put_le64(header + 72, entry_size);
+	put_le64(header + 80, flags_off);
+	put_le64(header + 88, src->state_cnt);
+	put_le64(header + 96, trans_off);
+	put_le64(header + 104, (uint64_t)src->state_cnt * src->state_size);
+
+	return fwrite(header, sizeof(header), 1, dst) == 1 ? 0 : -1;
+}
+
+int dfa_save_map(const struct dfa *src, FILE *dst)
+{
+	uint64_t entry_off, entry_size = 0, flags_off, trans_off, trans_size;
+	unsigned char buf[256 * 8];
+	bool failure = false;
+
+	for (size_t i = 0; i < src->entry_cnt; i++)
+		entry_size += 16 + strlen(src->entries[i].name) + 1;
+
+	entry_off = _ALIGN_TO(DFA_MAP_HEADER_SIZE + src->comment_size, 8);
+	flags_off = _ALIGN_TO(entry_off + entry_size, DFA_MAP_ALIGN);
+	trans_off = _ALIGN_TO(flags_off + src->state_cnt, DFA_MAP_ALIGN);
+	trans_size = (uint64_t)src->state_cnt * src->state_size;
+
+	failure = dfa_save_map_header(src, dst, DFA_MAP_HEADER_SIZE, entry_off,
+				      entry_size, flags_off, trans_off) != 0 ||
+		  fwrite(src->comment, 1, src->comment_size, dst) !=
+		  src->comment_size ||
+		  write_pad(dst, DFA_MAP_HEADER_SIZE + src->comment_size,
+				entry_off) != 0;
+
+	for (size_t i = 0; i < src->entry_cnt && !failure; i++) {
+		size_t len = strlen(src->entries[i].name) + 1;
+
+		put_le64(buf, src->entries[i].state);
+		put_le64(buf + 8, len);
+		failure = fwrite(buf, 16, 1, dst) != 1 ||
+			  fwrite(src->entries[i].name, 1, len, dst) != len;
 	}
 
-#ifdef USE_ZLIB
-	deflateEnd(&zstrm);
-out_err:
-#endif
+	failure = failure ||
+		  write_pad(dst, entry_off + entry_size, flags_off) != 0;
+
+	/* acceleration is not stored, it depends on the scanner's CPU */
+	for (size_t i = 0; i < src->state_cnt && !failure; i += sizeof(buf)) {
+		size_t len = MIN(src->state_cnt - i, sizeof(buf));
+
+		for (size_t j = 0; j < len; j++)
+			buf[j] = src->flags[i + j] & (0xFF ^ DFA_FLAG_ACCEL);
+		failure = fwrite(buf, 1, len, dst) != len;
+	}
+
+	failure = failure ||
+		  write_pad(dst, flags_off + src->state_cnt, trans_off) != 0;
+
+	if (host_is_le()) {
+		failure = failure ||
+			  fwrite(src->trans, 1, trans_size, dst) != trans_size;
+	} else {
+		for (size_t i = 0; i < src->state_cnt && !failure; i++) {
+			for (int j = 0; j < 256; j++)
+				put_le(buf + j * (src->bps / 8),
+				       dfa_get_trans(src, i, j), src->bps / 8);
+			failure = fwrite(buf, 1, src->state_size, dst) !=
+				  src->state_size;
+		}
+	}
+
+	return !failure ? 0 : -1;
+}
+
+/**
+ * @brief Read DFA from the mappable file.
+ *
+ * Fills everything but the transitions and flags, they are left
+ * in the file.
+ *
+ * @param dst		pointer to the allocated empty dfa structure
+ * @param base		contents of the file
+ * @param size		size of the file
+ * @param flags		place for the pointer to the flags
+ * @param trans		place for the pointer to the transitions
+ * @return		0 on success, -1 if the file is corrupted
+ */
+static int dfa_map_parse(struct dfa *dst, const unsigned char *base,
+			 size_t size, const unsigned char **flags,
+			 const unsigned char **trans)
+{
+	uint64_t state_cnt, bps, first_index, state_size;
+	uint64_t comment_off, comment_size, entry_off, entry_cnt, entry_size;
+	uint64_t flags_off, flags_size, trans_off, trans_size;
+	const unsigned char *entry;
+
+	if (size < DFA_MAP_HEADER_SIZE ||
+	    memcmp(base, "\x57""DFA\x16\x16\x16\x16", 8) != 0 ||
+	    memcmp(base + 8, "ver#\x00\x02\x00\x00", 8) != 0)
+		return -1;
+
+	state_cnt = get_le64(base + 16);
+	bps = get_le64(base + 24);
+	first_index = get_le64(base + 32);
+	comment_off = get_le64(base + 40);
+	comment_size = get_le64(base + 48);
+	entry_off = get_le64(base + 56);
+	entry_cnt = get_le64(base + 64);
+	entry_size = get_le64(base + 72);
+	flags_off = get_le64(base + 80);
+	flags_size = get_le64(base + 88);
+	trans_off = get_le64(base + 96);
+	trans_size = get_le64(base + 104);
+
+	if (bps > 64 || bps_to_max(bps) == 0 || state_cnt > bps_to_max(bps) ||
+	    (state_cnt != 0 && first_index >= state_cnt))
+		return -1;
+
+	state_size = 256 * (bps / 8);
+
+	if (!dfa_map_section_ok(comment_off, comment_size, size) ||
+	    !dfa_map_section_ok(entry_off, entry_size, size) ||
+	    !dfa_map_section_ok(flags_off, flags_size, size) ||
+	    !dfa_map_section_ok(trans_off, trans_size, size) ||
+	    flags_size != state_cnt || state_cnt > size / state_size ||
+	    trans_size != state_cnt * state_size ||
+	    trans_off % DFA_MAP_ALIGN != 0)
+		return -1;
 
-	fclose(dst);
+	dst->bps = bps;
+	dst->state_size = state_size;
+	dst->state_max_cnt = bps_to_max(bps);
+	dst->state_cnt = state_cnt;
+	dst->state_malloc_cnt = state_cnt;
+	dst->first_index = first_index;
+
+	dst->comment = malloc(comment_size);
+	if (dst->comment == NULL && comment_size != 0)
+		return -1;
+	memcpy(dst->comment, base + comment_off, comment_size);
+	dst->comment_size = comment_size;
+
+	entry = base + entry_off;
+	for (uint64_t i = 0; i < entry_cnt; i++) {
+		uint64_t len, state;
+
+		if (entry_size < 16)
+			return -1;
+
+		state = get_le64(entry);
+		len = get_le64(entry + 8);
+		if (len == 0 || len > entry_size - 16 ||
+		    entry[16 + len - 1] != '\0' ||
+		    dfa_set_entry(dst, (const char *)entry + 16, state) != 0)
+			return -1;
+
+		entry += 16 + len;
+		entry_size -= 16 + len;
+	}
+
+	*flags = base + flags_off;
+	*trans = base + trans_off;
 
 	return 0;
 }
 
-/* rewrite! */
+/**
+ * @brief Drop the flags of acceleration read from the file.
+ *
+ * The tables of acceleration are not stored, so the flag left in
+ * the file by mistake would make the scanner use the missing table.
+ * Only the flags that are set are written, the other pages of the
+ * mapping stay shared.
+ *
+ * @param flags	flags of the states
+ * @param cnt	number of the states
+ */
+static void dfa_map_clear_accel(uint8_t *flags, size_t cnt)
+{
+	for (size_t i = 0; i < cnt; i++)
+		if (flags[i] & DFA_FLAG_ACCEL)
+			flags[i] &= 0xFF ^ DFA_FLAG_ACCEL;
+}
 
-int dfa_load_from_file(struct dfa *dst, char *filename)
+/**
+ * @brief Check that the transitions lead to the existing states.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @return	0 if all transitions are valid
+ */
+static int dfa_check_trans(const struct dfa *dfa)
 {
-	FILE *src = fopen(filename, "r");
+	for (size_t i = 0; i < dfa->state_cnt; i++)
+		for (int c = 0; c < 256; c++)
+			if (dfa_get_trans(dfa, i, c) >= dfa->state_cnt)
+				return -1;
 
-	if (src == NULL) {
+	return 0;
+}
+
+/**
+ * @brief Open the mappable file.
+ *
+ * @param dst		pointer to the dfa structure
+ * @param filename	path to the file
+ * @param copy		copy the transitions and flags into the allocated
+ *			memory instead of using the mapping
+ * @return		0 on success
+ */
+static int dfa_open_map(struct dfa *dst, char *filename, bool copy)
+{
+	struct stat st;
+	int fd, ret;
+
+	dfa_alloc(dst);
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
 		perror(filename);
 		return -1;
 	}
 
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	ret = dfa_open_map_fd(dst, fd, 0, st.st_size, copy);
+	close(fd);
+
+	return ret;
+}
+
+/**
+ * @brief Open the mappable image of DFA stored in the part of the file.
+ *
+ * @param dst		pointer to the dfa structure
+ * @param fd		descriptor of the file opened for reading
+ * @param offset	offset of the image in the file
+ * @param size		size of the image
+ * @param copy		copy the transitions and flags into the allocated
+ *			memory instead of using the mapping
+ * @return		0 on success
+ */
+static int dfa_open_map_fd(struct dfa *dst, int fd, uint64_t offset,
+			   uint64_t size, bool copy)
+{
+	const unsigned char *flags, *trans;
+	size_t delta, map_size;
+	long page;
+	void *map;
+
+	dfa_alloc(dst);
+
+	page = sysconf(_SC_PAGESIZE);
+	if (page <= 0 || size < DFA_MAP_HEADER_SIZE || size > SIZE_MAX - page)
+		return -1;
+
+	/* the mapping has to start at the page boundary */
+	delta = offset % page;
+	map_size = size + delta;
+
+	/*
+	 * the mapping is private, so the scanner may set the flags of
+	 * acceleration, only the written pages stop being shared
+	 */
+	map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		   fd, offset - delta);
+	if (map == MAP_FAILED)
+		return -1;
+
+	if (dfa_map_parse(dst, (unsigned char *)map + delta, size,
+			  &flags, &trans) != 0 ||
+	    (!copy && !host_is_le())) {
+		munmap(map, map_size);
+		dfa_free(dst);
+		return -1;
+	}
+
+	/* the mapped transitions are trusted, they are not read on open */
+	if (!copy) {
+		dst->map = map;
+		dst->map_size = map_size;
+		dst->flags = (uint8_t *)flags;
+		dst->trans = (void *)trans;
+		dfa_map_clear_accel(dst->flags, dst->state_cnt);
+
+		return 0;
+	}
+
+	dst->flags = malloc(dst->state_cnt);
+	dst->trans = malloc(dst->state_cnt * dst->state_size);
+	if ((dst->flags == NULL || dst->trans == NULL) && dst->state_cnt != 0) {
+		munmap(map, map_size);
+		dfa_free(dst);
+		return -1;
+	}
+
+	memcpy(dst->flags, flags, dst->state_cnt);
+	if (host_is_le()) {
+		memcpy(dst->trans, trans, dst->state_cnt * dst->state_size);
+	} else {
+		for (size_t i = 0; i < dst->state_cnt; i++)
+			for (int j = 0; j < 256; j++) {
+				const unsigned char *ptr = trans + i * dst->state_size +
+							   j * (dst->bps / 8);
+
+				dfa_add_trans(dst, i, j,
+					      get_le(ptr, dst->bps / 8));
+			}
+	}
+
+	munmap(map, map_size);
+
+	dfa_map_clear_accel(dst->flags, dst->state_cnt);
+	if (dfa_check_trans(dst) != 0) {
+		dfa_free(dst);
+		return -1;
+	}
+
+	return 0;
+}
+
+int dfa_map_file(struct dfa *dst, char *filename)
+{
+	return dfa_open_map(dst, filename, false);
+}
+
+int dfa_map_fd(struct dfa *dst, int fd, uint64_t offset, uint64_t size)
+{
+	return dfa_open_map_fd(dst, fd, offset, size, false);
+}
+
+int dfa_load_map_fd(struct dfa *dst, int fd, uint64_t offset, uint64_t size)
+{
+	return dfa_open_map_fd(dst, fd, offset, size, true);
+}
+
+/* rewrite! */
+
+int dfa_load_header(struct dfa *dst, FILE *src, char *alg)
+{
 	dfa_alloc(dst);
 
 	unsigned char buffer[8], *ptr = buffer;
@@ -951,8 +1771,11 @@ int dfa_load_from_file(struct dfa *dst, char *filename)
 	if (size != 8 || strncmp("\x57""DFA", (char *)buffer, 4))
 		goto out_err;
 	size = fread(buffer, 1, 8, src);
-	if (size != 8 || strncmp("ver#\x00\x01\x00\x02", (char *)buffer, 8))
+	if (size != 8 || memcmp("ver#\x00\x01\x00", buffer, 7) ||
+	    (buffer[7] & ~(DFA_FILE_ENTRIES | DFA_FILE_BLOCKS)) != 0x02)
 		goto out_err;
+	int has_entries = buffer[7] & DFA_FILE_ENTRIES;
+	bool has_blocks = buffer[7] & DFA_FILE_BLOCKS;
 	size = fread(buffer, 1, 4, src);
 	if (size != 4 || strncmp("cnt#", (char *)buffer, 4))
 		goto out_err;
@@ -965,10 +1788,28 @@ int dfa_load_from_file(struct dfa *dst, char *filename)
 		goto out_err;
 	uint32_t bps = ((uint32_t *)ptr)[0];
 
+	if (bps_to_max(bps) == 0 || state_cnt > bps_to_max(bps))
+		goto out_err;
+
+	/* the count is checked before the table is allocated for it */
+	struct stat st;
+	if (state_cnt > SIZE_MAX / (bps / 8 * 256) ||
+	    fstat(fileno(src), &st) != 0 ||
+	    state_cnt / DFA_FILE_STATES_PER_BYTE > (uint64_t)st.st_size)
+		goto out_err;
+
 	dfa_change_max_size(dst, bps_to_max(bps));
 
+	/* all states at once, the table of a big DFA is not reallocated */
+	free(dst->trans);
+	dst->trans = malloc(dst->state_size * state_cnt);
+	dst->flags = calloc(state_cnt, sizeof(*dst->flags));
+	if (state_cnt != 0 && (dst->trans == NULL || dst->flags == NULL))
+		goto out_err;
+	dst->state_cnt = state_cnt;
+	dst->state_malloc_cnt = state_cnt;
+
 	ptr = buffer;
-	dfa_add_n_state(dst, state_cnt, NULL);
 
 	size = fread(buffer, 1, 4, src);
 	if (size != 4 || strncmp("fst#", (char *)buffer, 4))
@@ -991,29 +1832,99 @@ int dfa_load_from_file(struct dfa *dst, char *filename)
 	if (size != tmp64)
 		goto out_err;
 
+	if (has_entries) {
+		uint64_t entry_cnt;
+		char *name;
+
+		size = fread(buffer, 1, 4, src);
+		if (size != 4 || strncmp("ent#", (char *)buffer, 4))
+			goto out_err;
+		if (!fread(&entry_cnt, sizeof(entry_cnt), 1, src))
+			goto out_err;
+
+		for (uint64_t i = 0; i < entry_cnt; i++) {
+			uint64_t state;
+
+			if (!fread(&state, sizeof(state), 1, src) ||
+			    !fread(&tmp64, sizeof(tmp64), 1, src) ||
+			    tmp64 == 0 || tmp64 > DFA_ENTRY_NAME_MAX)
+				goto out_err;
+
+			name = malloc(tmp64);
+			if (name == NULL)
+				goto out_err;
+
+			if (fread(name, 1, tmp64, src) != tmp64 ||
+			    name[tmp64 - 1] != '\0' ||
+			    dfa_set_entry(dst, name, state) != 0) {
+				free(name);
+				goto out_err;
+			}
+
+			free(name);
+		}
+	}
+
 	size = fread(buffer, 1, 8, src);
 	if (size != 8)
 		goto out_err;
 
-	switch (_4CHAR_TO_UINT(buffer[4], buffer[5], buffer[6], buffer[7])) {
+	if (strncmp("alg:", (char *)buffer, 4) ||
+	    has_blocks != (memcmp(buffer + 4, "blks", 4) == 0))
+		goto out_err;
+	memcpy(alg, buffer + 4, 4);
+
+	return 0;
+out_err:
+	dfa_free(dst);
+
+	return -1;
+}
+
+int dfa_load_from_file(struct dfa *dst, char *filename)
+{
+	return dfa_load_from_file2(dst, filename, 1);
+}
+
+int dfa_load_from_file2(struct dfa *dst, char *filename, size_t thread_cnt)
+{
+	FILE *src = fopen(filename, "r");
+	unsigned char buffer[16];
+	char alg[4];
+
+	if (src == NULL) {
+		perror(filename);
+		return -1;
+	}
+
+	if (fread(buffer, 1, 16, src) == 16 &&
+	    memcmp("ver#\x00\x02", buffer + 8, 6) == 0) {
+		fclose(src);
+		return dfa_open_map(dst, filename, true);
+	}
+
+	rewind(src);
+	if (dfa_load_header(dst, src, alg) != 0) {
+		fclose(src);
+		return -1;
+	}
+
+	switch (_4CHAR_TO_UINT(alg[0], alg[1], alg[2], alg[3])) {
 	case _4CHAR_TO_UINT('f','l','a','t'):
 	{
+		unsigned char in[sizeof(uint64_t) * (256 + 1)];
 
-/*		size_t	read = 0, total = 0;
+		for (size_t state = 0; state < dst->state_cnt; state++) {
+			if (fread(in, sizeof(in), 1, src) != 1)
+				goto out_err;
 
-		while ((read = fread(((void *)dst->nodes) + total, 1,
-				     sizeof(dst->nodes[0]) * dst->node_cnt - total,
-				     src)) != 0) {
-			total += read;
-			if (sizeof(dst->nodes[0]) * dst->node_cnt - total == 0)
-				break;
+			dst->flags[state] = in[0];
+			for (int j = 0; j < 256; j++)
+				dfa_add_trans(dst, state, j, ((uint64_t *)in)[j + 1]);
+			dfa_state_calc_deadend(dst, state);
 		}
 
-		if (sizeof(dst->nodes[0]) * dst->node_cnt - total != 0)
-			goto out_err;
-
-		break;*/
-		goto out_err;
+		break;
 	}
 #ifdef USE_ZLIB
 	case _4CHAR_TO_UINT('g', 'z', 'i', 'p'):
@@ -1070,6 +1981,10 @@ int dfa_load_from_file(struct dfa *dst, char *filename)
 		break;
 	}
 #endif
+	case _4CHAR_TO_UINT('b', 'l', 'k', 's'):
+		if (dfa_block_load(dst, src, thread_cnt) != 0)
+			goto out_err;
+		break;
 	default:
 		goto out_err;
 		break;
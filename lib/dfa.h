@@ -20,6 +20,55 @@
 #define DFA_FLAG_FINAL		(0x01)
 /** flag that shows if the state has only transitions to itself */
 #define DFA_FLAG_DEADEND	(0x02)
+/** flag that shows if the state leaves itself only by a few bytes */
+#define DFA_FLAG_ACCEL		(0x04)
+
+/** alignment of the flags and transitions in the mappable file */
+#define DFA_MAP_ALIGN		(4096)
+
+/**
+ * structure that holds escape bytes of the accelerated state
+ * (bytes that lead out of the state)
+ */
+struct dfa_accel {
+	/**
+	 * number of escape bytes
+	 */
+	uint16_t cnt;
+
+	/**
+	 * the lowest escape byte, used for search when it is the only one
+	 */
+	uint8_t byte;
+
+	/**
+	 * set of escape bytes less than 0x80: bit ((c >> 4) & 7) of
+	 * lo[c & 0x0F] is set if c is an escape byte
+	 */
+	uint8_t lo[16];
+
+	/**
+	 * the same as lo but for escape bytes greater or equal to 0x80
+	 */
+	uint8_t hi[16];
+};
+
+/**
+ * structure that represents named initial state of the DFA
+ */
+struct dfa_entry {
+	/**
+	 * zero-terminated name of the entry
+	 */
+	char *name;
+
+	/**
+	 * index of the state where the scan starts
+	 */
+	size_t state;
+};
+
+struct dfa_storage;
 
 /**
  * structure that represents Deterministic Finite-state Automaton (DFA)
@@ -78,6 +127,39 @@ struct dfa {
 	 * index of the first (initial) state
 	 */
 	size_t first_index;
+
+	/**
+	 * escape bytes of the states with DFA_FLAG_ACCEL, indexed by states,
+	 * NULL if the DFA was not accelerated
+	 */
+	struct dfa_accel *accel;
+
+	/**
+	 * named initial states in addition to the first one
+	 */
+	struct dfa_entry *entries;
+
+	/**
+	 * number of named initial states
+	 */
+	size_t entry_cnt;
+
+	/**
+	 * mapping of the file that holds the transitions and the flags,
+	 * NULL if they are allocated
+	 */
+	void *map;
+
+	/**
+	 * size of the mapping
+	 */
+	size_t map_size;
+
+	/**
+	 * storage of the transitions (see dfa_storage.h),
+	 * NULL if they are allocated
+	 */
+	struct dfa_storage *storage;
 };
 
 /**
@@ -146,6 +228,52 @@ int dfa_join(struct dfa *dst, const struct dfa *src);
  */
 int dfa_join2(struct dfa *dst, const struct dfa *src1, const struct dfa *src2);
 
+struct dfa_checkpoint;
+
+/**
+ * Join two DFA with checkpoints.
+ *
+ * Same as dfa_join2(), but saves the state of the join to the checkpoint
+ * every cp->interval processed states (see dfa_checkpoint.h). If the
+ * checkpoint file exists, the join is resumed from it and builds the same
+ * DFA as the uninterrupted one. The checkpoint file is removed when
+ * the join is finished. If cp->limit states were processed, the checkpoint
+ * is saved and the join stops: dst holds the unfinished DFA and has to be
+ * freed.
+ *
+ * @param dst	pointer to the existing and initialized empty DFA for the result
+ * @param src1	pointer to the first dfa structure that will be joined
+ * @param src2	pointer to the second dfa structure that will be joined
+ * @param cp	pointer to the checkpoint or NULL
+ * @return	0 on success, 1 if the join is stopped,
+ *		-1 on failure or if the checkpoint is not of these DFAs
+ */
+int dfa_join_checkpoint(struct dfa *dst, const struct dfa *src1,
+			const struct dfa *src2, struct dfa_checkpoint *cp);
+
+struct dfa_extern;
+
+/**
+ * Join two DFA in the external memory.
+ *
+ * Same as dfa_join2(), but the map of the pairs of states and the queue of
+ * the unprocessed pairs are kept on disk and the batches of states take
+ * about ext->mem_size bytes (see dfa_extern.h). The DFA is the same as
+ * the one built by dfa_join2(), its transitions are written straight into
+ * the mappable image and dst is replaced with the mapping of the image.
+ *
+ * @param dst		pointer to the existing and initialized empty DFA
+ *			for the result
+ * @param src1		pointer to the first dfa structure that will be joined
+ * @param src2		pointer to the second dfa structure that will be joined
+ * @param ext		pointer to the external-memory construction
+ * @param filename	path to the DFA's image, NULL for the temporary file
+ * @return		0 on success
+ */
+int dfa_join_extern(struct dfa *dst, const struct dfa *src1,
+		    const struct dfa *src2, struct dfa_extern *ext,
+		    const char *filename);
+
 /**
  * Append one DFA to another.
  *
@@ -178,6 +306,63 @@ int dfa_minimize(struct dfa *dfa);
  */
 int dfa_compress(struct dfa *dfa);
 
+/**
+ * Split bytes into classes.
+ *
+ * Bytes that lead to the same state from every state of the DFA share
+ * one class, classes are numbered in the order of their first bytes.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param classes	place for the classes of all 256 bytes
+ * @return		number of classes
+ */
+size_t dfa_byte_classes(const struct dfa *dfa, uint8_t *classes);
+
+/**
+ * Name the state of DFA as an entry.
+ *
+ * Scan of the entry starts from the named state instead of the first one.
+ * The name of the existing entry is moved to the new state.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param name	zero-terminated name of the entry
+ * @param state	index of the DFA's state
+ * @return	0 on success
+ */
+int dfa_set_entry(struct dfa *dfa, const char *name, size_t state);
+
+/**
+ * Add DFA as a named entry of another DFA.
+ *
+ * Copies all states of src to dst and names the copy of src's initial
+ * state. Entries are built as one DFA, so dfa_minimize() after the last
+ * added entry merges the states that are equivalent in different entries
+ * (e.g. the states after the anchor of the anchored and unanchored
+ * variants of a regexp or the rules that are shared by several contexts).
+ * If dst is empty src's initial state also becomes the first state.
+ * Entries are kept by dfa_minimize(), dfa_compress() and the file format,
+ * the DFA produced by dfa_join() has no entries.
+ *
+ * @param dst	pointer to the dfa structure that gets the entry
+ * @param name	zero-terminated name of the entry
+ * @param src	pointer to the dfa structure of the entry
+ * @return	0 on success
+ */
+int dfa_add_entry(struct dfa *dst, const char *name, const struct dfa *src);
+
+/**
+ * Find named entry of DFA.
+ *
+ * The found state is passed to dfa_scan() (or set as the state of
+ * dfa_stream) to scan data in the context of the entry.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param name	zero-terminated name of the entry
+ * @param state	place for the index of the entry's state
+ * @return	0 on success, -1 if there is no such entry
+ */
+int dfa_get_entry(const struct dfa *dfa, const char *name, size_t *state);
+
 /**
  * Add transition to DFA.
  *
@@ -266,7 +451,11 @@ int dfa_add_n_state(struct dfa *dfa, size_t cnt, size_t *index);
 /**
  * Save the dfa to the file.
  *
- * Saves the DFA structure to the given file.
+ * Saves the DFA structure to the given file. States are stored in
+ * independently compressed blocks (see dfa_block.h), so the file can be
+ * loaded in parallel or lazily. The version of the file tells that
+ * the states are in blocks, so the older versions reject the file instead
+ * of reading the blocks as states.
  *
  * @param dfa		pointer to the dfa structure
  * @param filename	path where dfa structure must be saved
@@ -274,10 +463,145 @@ int dfa_add_n_state(struct dfa *dfa, size_t cnt, size_t *index);
  */
 int dfa_save_to_file(const struct dfa *dfa, char *filename);
 
+/**
+ * Save the dfa to the file with multiple threads.
+ *
+ * The same as dfa_save_to_file() but the blocks of states are compressed
+ * by thread_cnt threads with the codec (see dfa_block_save()).
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param filename	path where dfa structure must be saved
+ * @param thread_cnt	number of threads
+ * @param codec		"rowd", "zlib" or "none", NULL for "rowd"
+ * @return		0 on success
+ */
+int dfa_save_to_file2(const struct dfa *dfa, char *filename,
+		      size_t thread_cnt, const char *codec);
+
+/**
+ * Save the header of the dfa file.
+ *
+ * Writes everything that precedes the states' data: the size of the DFA,
+ * the comment and the entries, followed by the name of the storage
+ * algorithm of the states.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param file		file opened for writing
+ * @param alg		four characters of the storage algorithm's name
+ * @return		0 on success
+ */
+int dfa_save_header(const struct dfa *dfa, FILE *file, const char *alg);
+
+/**
+ * Save the dfa to the mappable file.
+ *
+ * Saves the DFA structure in the format that is read without any
+ * conversion (version 0.2): transitions are stored with the DFA's bits
+ * per state in little-endian order and the flags and transitions start
+ * at page-aligned offsets. The file is not compressed, so it is as large
+ * as the transition table.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param filename	path where dfa structure must be saved
+ * @return		0 on success
+ */
+int dfa_save_to_map_file(const struct dfa *dfa, char *filename);
+
+/**
+ * Write the mappable image of the dfa to the file.
+ *
+ * Writes the same data as dfa_save_to_map_file() at the current position
+ * of the file, the offsets inside the image are relative to its start.
+ * The image can be mapped only if it starts at the offset aligned to
+ * DFA_MAP_ALIGN.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param file		file opened for writing
+ * @return		0 on success
+ */
+int dfa_save_map(const struct dfa *dfa, FILE *file);
+
+/**
+ * Write the header of the mappable image to the file.
+ *
+ * The sizes are taken from the dfa, the sections may be placed in any
+ * order after the header. Used by the constructions that write
+ * the transitions straight into the image (see dfa_extern.h).
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param file		file opened for writing
+ * @param comment_off	offset of the comment
+ * @param entry_off	offset of the entries
+ * @param entry_size	size of the entries
+ * @param flags_off	offset of the flags
+ * @param trans_off	offset of the transitions, aligned to DFA_MAP_ALIGN
+ * @return		0 on success
+ */
+int dfa_save_map_header(const struct dfa *dfa, FILE *file,
+			uint64_t comment_off, uint64_t entry_off,
+			uint64_t entry_size, uint64_t flags_off,
+			uint64_t trans_off);
+
+/**
+ * Map the dfa from the mappable file.
+ *
+ * Maps the file saved by dfa_save_to_map_file() into memory, the
+ * transitions and flags of the DFA point into the mapping. Opening reads
+ * only the header and the flags (one byte per state), the transitions are
+ * read on demand and the page cache is shared by all processes that map
+ * the file.
+ * The mapping is private: the file is never changed and the pages that
+ * are written (e.g. the flags by dfa_accelerate()) are copied. States
+ * cannot be added to the mapped DFA. The mapping is released by
+ * dfa_free(). Only little-endian hosts can map the file, others have
+ * to load it with dfa_load_from_file().
+ *
+ * The flags of acceleration are cleared, the transitions are not read,
+ * so the file must be trusted: the transitions to the missing states make
+ * the scanner read outside the mapping. dfa_load_map_fd() checks them.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param filename	path to the file with the saved dfa
+ * @return		0 on success
+ */
+int dfa_map_file(struct dfa *dfa, char *filename);
+
+/**
+ * Map the dfa from the part of the file.
+ *
+ * The same as dfa_map_file() for the image written by dfa_save_map()
+ * that lies inside the larger file. The descriptor may be closed after
+ * the call.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param fd		descriptor of the file opened for reading
+ * @param offset	offset of the image, aligned to DFA_MAP_ALIGN
+ * @param size		size of the image
+ * @return		0 on success
+ */
+int dfa_map_fd(struct dfa *dfa, int fd, uint64_t offset, uint64_t size);
+
+/**
+ * Load the dfa from the part of the file.
+ *
+ * The same as dfa_map_fd() but the DFA is copied into the allocated
+ * memory, so it works on any host and the states can be added. The file
+ * does not have to be trusted, the transitions are checked.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param fd		descriptor of the file opened for reading
+ * @param offset	offset of the image
+ * @param size		size of the image
+ * @return		0 on success
+ */
+int dfa_load_map_fd(struct dfa *dfa, int fd, uint64_t offset, uint64_t size);
+
 /**
  * Load the dfa from the file.
  *
- * Loads the DFA structure from the given file.
+ * Loads the DFA structure from the given file. Both the compressed
+ * and the mappable formats are accepted, the latter is copied into
+ * the allocated memory.
  *
  * @param dfa		pointer to the dfa structure
  * @param filename	path to the file with the saved dfa
@@ -285,6 +609,33 @@ int dfa_save_to_file(const struct dfa *dfa, char *filename);
  */
 int dfa_load_from_file(struct dfa *dfa, char *filename);
 
+/**
+ * Load the dfa from the file with multiple threads.
+ *
+ * The same as dfa_load_from_file() but the blocks of states are
+ * decompressed by thread_cnt threads.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param filename	path to the file with the saved dfa
+ * @param thread_cnt	number of threads
+ * @return		0 on success
+ */
+int dfa_load_from_file2(struct dfa *dfa, char *filename, size_t thread_cnt);
+
+/**
+ * Load the header of the dfa file.
+ *
+ * Reads everything that precedes the states' data and allocates
+ * the states, their flags and transitions are not initialized.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param file		file opened for reading
+ * @param alg		place for four characters of the storage
+ *			algorithm's name
+ * @return		0 on success
+ */
+int dfa_load_header(struct dfa *dfa, FILE *file, char *alg);
+
 /**
  * Print the dfa in Graphviz format.
  *
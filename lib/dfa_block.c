@@ -0,0 +1,996 @@
+/*
+ * Block-compressed storage of DFA states.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "dfa_block.h"
+#include "dfa_scan.h"
+#include "endian_inner.h"
+
+/**
+ * @brief Compression level of the blocks.
+ *
+ * Blocks are small, so the highest level does not make them much smaller
+ * but makes the compression several times slower.
+ */
+#define DFA_BLOCK_ZLIB_LEVEL	(6)
+
+/**
+ * @brief Number of blocks that are processed by one thread at once.
+ */
+#define DFA_BLOCK_BATCH		(4)
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+/**
+ * @brief Batch of blocks processed by one thread.
+ */
+struct dfa_block_job {
+	/**
+	 * @brief DFA whose states are saved.
+	 */
+	const struct dfa *src;
+
+	/**
+	 * @brief DFA whose states are loaded.
+	 */
+	struct dfa *dst;
+
+	/**
+	 * @brief Codec of the blocks.
+	 */
+	const char *codec;
+
+	/**
+	 * @brief The first block of the batch.
+	 */
+	size_t first;
+
+	/**
+	 * @brief Number of blocks of the batch.
+	 */
+	size_t cnt;
+
+	/**
+	 * @brief Blocks of the thread are first + i * step.
+	 */
+	size_t step;
+
+	/**
+	 * @brief Encoded blocks of the batch (indexed from the first one).
+	 */
+	unsigned char **buf;
+
+	/**
+	 * @brief Sizes of the encoded blocks.
+	 */
+	size_t *len;
+
+	/**
+	 * @brief Set if any block of the thread failed.
+	 */
+	int error;
+
+	/**
+	 * @brief Thread that processes the blocks.
+	 */
+	pthread_t thread;
+};
+
+/**
+ * @brief Get the number of states in the block.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param block	index of the block
+ * @return	number of states
+ */
+static size_t dfa_block_states(const struct dfa *dfa, size_t block)
+{
+	return MIN(DFA_BLOCK_STATES, dfa->state_cnt - block * DFA_BLOCK_STATES);
+}
+
+/**
+ * @brief Check if the blocks of the codec can be encoded and decoded.
+ *
+ * @param codec	four characters of the codec's name
+ * @return	true if the codec is supported
+ */
+static bool dfa_block_codec_known(const char *codec)
+{
+#ifdef USE_ZLIB
+	if (memcmp(codec, "zlib", 4) == 0)
+		return true;
+#endif
+	return memcmp(codec, "rowd", 4) == 0 || memcmp(codec, "none", 4) == 0;
+}
+
+/**
+ * @brief Store transition in the raw row of transitions.
+ *
+ * @param row	row of transitions
+ * @param bps	bits per state
+ * @param mark	label of transition
+ * @param to	destination of the transition
+ */
+static inline void dfa_block_put(void *row, int bps, int mark, uint64_t to)
+{
+	switch (bps) {
+	case 8:
+		((uint8_t *)row)[mark] = to;
+		break;
+	case 16:
+		((uint16_t *)row)[mark] = to;
+		break;
+	case 32:
+		((uint32_t *)row)[mark] = to;
+		break;
+	default:
+		((uint64_t *)row)[mark] = to;
+		break;
+	}
+}
+
+/**
+ * @brief Write unsigned LEB128 number.
+ *
+ * @param out	place for the number, moved past it
+ * @param val	the number
+ */
+static inline void dfa_varint_put(unsigned char **out, uint64_t val)
+{
+	while (val >= 0x80) {
+		*(*out)++ = (val & 0x7F) | 0x80;
+		val >>= 7;
+	}
+	*(*out)++ = val;
+}
+
+/**
+ * @brief Read unsigned LEB128 number.
+ *
+ * @param in	encoded number, moved past it
+ * @param end	end of the encoded data
+ * @param val	place for the number
+ * @return	0 on success, -1 if the number is truncated or too long
+ */
+static inline int dfa_varint_get(const unsigned char **in,
+				 const unsigned char *end, uint64_t *val)
+{
+	*val = 0;
+
+	for (int shift = 0; shift < 64 && *in < end; shift += 7) {
+		unsigned char byte = *(*in)++;
+
+		*val |= (uint64_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return 0;
+	}
+
+	return -1;
+}
+
+/**
+ * @brief Types of the runs of the row-delta codec.
+ */
+enum dfa_rowd_run {
+	/**
+	 * @brief Transitions are the same as in the previous row.
+	 */
+	DFA_ROWD_COPY = 0,
+
+	/**
+	 * @brief Transitions lead to one state.
+	 */
+	DFA_ROWD_FILL = 1,
+
+	/**
+	 * @brief Transitions differ from the previous row by one number.
+	 */
+	DFA_ROWD_DELTA = 2,
+
+	/**
+	 * @brief Transitions lead to one state given by its index.
+	 */
+	DFA_ROWD_FILL_ABS = 3
+};
+
+/**
+ * @brief Write zigzag varint of the signed number.
+ *
+ * @param out	place for the number, moved past it
+ * @param val	the number
+ */
+static inline void dfa_zigzag_put(unsigned char **out, uint64_t val)
+{
+	dfa_varint_put(out, (val << 1) ^ -(val >> 63));
+}
+
+/**
+ * @brief Encode the block with row-delta codec.
+ *
+ * The flags are stored as they are. Every row of transitions is a list of
+ * runs, each run starts with the varint (length - 1) * 4 + type (see
+ * dfa_rowd_run). Fill runs are followed by the zigzag varint of their
+ * destination relative to the state, delta runs by the zigzag varint of
+ * the difference from the previous row. The first row of the block has
+ * only fill runs, so every block is decoded independently.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param first	the first state of the block
+ * @param cnt	number of states of the block
+ * @param flags	flags of the states
+ * @param out	place for the encoded block
+ * @param len	place for the size of the encoded block
+ * @return	0 on success
+ */
+static int dfa_block_rowd_encode(const struct dfa *dfa, size_t first,
+				 size_t cnt, const uint8_t *flags,
+				 unsigned char **out, size_t *len)
+{
+	uint64_t row[256], prev[256] = {0};
+	unsigned char *ptr;
+
+	/* a run per transition with the longest varints */
+	*out = malloc(cnt + cnt * 256 * 12);
+	if (*out == NULL)
+		return -1;
+
+	memcpy(*out, flags, cnt);
+	ptr = *out + cnt;
+
+	for (size_t i = 0; i < cnt; i++) {
+		size_t state = first + i;
+
+		for (int c = 0; c < 256; c++)
+			row[c] = dfa_get_trans(dfa, state, c);
+
+		for (int c = 0; c < 256;) {
+			uint64_t delta = row[c] - prev[c];
+			int copy = 0, fill = 1, diff = 1;
+
+			while (i > 0 && c + copy < 256 &&
+			       row[c + copy] == prev[c + copy])
+				copy++;
+
+			while (c + fill < 256 && row[c + fill] == row[c])
+				fill++;
+
+			while (i > 0 && c + diff < 256 &&
+			       row[c + diff] - prev[c + diff] == delta)
+				diff++;
+
+			if (i > 0 && copy >= fill && copy >= diff) {
+				dfa_varint_put(&ptr, (uint64_t)(copy - 1) << 2 |
+						     DFA_ROWD_COPY);
+				c += copy;
+			} else if (i > 0 && diff > fill) {
+				dfa_varint_put(&ptr, (uint64_t)(diff - 1) << 2 |
+						     DFA_ROWD_DELTA);
+				dfa_zigzag_put(&ptr, delta);
+				c += diff;
+			} else if (row[c] < (state > row[c] ? state - row[c] :
+						row[c] - state) * 2) {
+				/* states near the beginning, e.g. the initial one */
+				dfa_varint_put(&ptr, (uint64_t)(fill - 1) << 2 |
+						     DFA_ROWD_FILL_ABS);
+				dfa_varint_put(&ptr, row[c]);
+				c += fill;
+			} else {
+				dfa_varint_put(&ptr, (uint64_t)(fill - 1) << 2 |
+						     DFA_ROWD_FILL);
+				dfa_zigzag_put(&ptr, row[c] - state);
+				c += fill;
+			}
+		}
+
+		memcpy(prev, row, sizeof(row));
+	}
+
+	*len = ptr - *out;
+
+	/* the buffer is kept until the whole batch is written */
+	ptr = realloc(*out, *len);
+	if (ptr != NULL)
+		*out = ptr;
+
+	return 0;
+}
+
+/**
+ * @brief Decode the block encoded with row-delta codec.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param first	the first state of the block
+ * @param cnt	number of states of the block
+ * @param in	encoded block
+ * @param len	size of the encoded block
+ * @return	0 on success, -1 if the block is corrupted
+ */
+static int dfa_block_rowd_decode(struct dfa *dfa, size_t first, size_t cnt,
+				 const unsigned char *in, size_t len)
+{
+	const unsigned char *end = in + len;
+	uint64_t row[256];
+
+	if (len < cnt)
+		return -1;
+
+	memcpy(dfa->flags + first, in, cnt);
+	in += cnt;
+
+	for (size_t i = 0; i < cnt; i++) {
+		size_t state = first + i;
+		void *dst = (char *)dfa->trans + state * dfa->state_size;
+
+		for (int c = 0; c < 256;) {
+			uint64_t op, run, zz, val;
+
+			if (dfa_varint_get(&in, end, &op) != 0)
+				return -1;
+
+			run = (op >> 2) + 1;
+			if (run > (uint64_t)(256 - c) ||
+			    (i == 0 && ((op & 3) == DFA_ROWD_COPY ||
+					(op & 3) == DFA_ROWD_DELTA)))
+				return -1;
+
+			if ((op & 3) == DFA_ROWD_COPY) {
+				c += run;
+				continue;
+			}
+
+			if (dfa_varint_get(&in, end, &zz) != 0)
+				return -1;
+			val = (zz >> 1) ^ -(zz & 1);
+
+			switch (op & 3) {
+			case DFA_ROWD_FILL:
+				for (uint64_t k = 0; k < run; k++)
+					row[c + k] = state + val;
+				break;
+			case DFA_ROWD_DELTA:
+				for (uint64_t k = 0; k < run; k++)
+					row[c + k] += val;
+				break;
+			default:
+				for (uint64_t k = 0; k < run; k++)
+					row[c + k] = zz;
+				break;
+			}
+
+			c += run;
+		}
+
+		for (int c = 0; c < 256; c++)
+			dfa_block_put(dst, dfa->bps, c, row[c]);
+	}
+
+	return in == end ? 0 : -1;
+}
+
+/**
+ * @brief Copy the flags and the little-endian transitions of the states.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param first	index of the first state
+ * @param cnt	number of states
+ * @param flags	stored flags of the states
+ * @return	allocated copy or NULL on error
+ */
+static unsigned char *dfa_block_raw(const struct dfa *dfa, size_t first,
+				    size_t cnt, const uint8_t *flags)
+{
+	size_t trans_len = cnt * dfa->state_size;
+	unsigned char *raw = malloc(cnt + trans_len);
+	unsigned char *trans;
+
+	if (raw == NULL)
+		return NULL;
+
+	memcpy(raw, flags, cnt);
+	trans = raw + cnt;
+
+	if (host_is_le()) {
+		memcpy(trans, (char *)dfa->trans + first * dfa->state_size,
+		       trans_len);
+	} else {
+		for (size_t i = 0; i < cnt; i++)
+			for (int c = 0; c < 256; c++)
+				put_le(trans + i * dfa->state_size +
+				       c * (dfa->bps / 8),
+				       dfa_get_trans(dfa, first + i, c),
+				       dfa->bps / 8);
+	}
+
+	return raw;
+}
+
+/**
+ * @brief Encode the block.
+ *
+ * The block is the flags of its states followed by their transitions.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param block	index of the block
+ * @param codec	codec of the block
+ * @param out	place for the encoded block
+ * @param len	place for the size of the encoded block
+ * @return	0 on success
+ */
+static int dfa_block_encode(const struct dfa *dfa, size_t block,
+			    const char *codec, unsigned char **out, size_t *len)
+{
+	size_t first = block * DFA_BLOCK_STATES;
+	size_t cnt = dfa_block_states(dfa, block);
+	size_t trans_len = cnt * dfa->state_size;
+	uint8_t flags[DFA_BLOCK_STATES];
+	unsigned char *raw;
+
+	/* acceleration is not stored, it depends on the scanner's CPU */
+	for (size_t i = 0; i < cnt; i++)
+		flags[i] = dfa->flags[first + i] & (0xFF ^ DFA_FLAG_ACCEL);
+
+	if (memcmp(codec, "rowd", 4) == 0)
+		return dfa_block_rowd_encode(dfa, first, cnt, flags, out, len);
+
+	raw = dfa_block_raw(dfa, first, cnt, flags);
+	if (raw == NULL)
+		return -1;
+
+	if (memcmp(codec, "none", 4) == 0) {
+		*out = raw;
+		*len = cnt + trans_len;
+
+		return 0;
+	}
+
+#ifdef USE_ZLIB
+	z_stream zstrm;
+	int zret;
+
+	zstrm.zalloc = Z_NULL;
+	zstrm.zfree = Z_NULL;
+	zstrm.opaque = Z_NULL;
+
+	if (deflateInit(&zstrm, DFA_BLOCK_ZLIB_LEVEL) != Z_OK) {
+		free(raw);
+		return -1;
+	}
+
+	*len = deflateBound(&zstrm, cnt + trans_len);
+	*out = malloc(*len);
+	if (*out == NULL) {
+		deflateEnd(&zstrm);
+		free(raw);
+		return -1;
+	}
+
+	zstrm.next_out = *out;
+	zstrm.avail_out = *len;
+	zstrm.next_in = raw;
+	zstrm.avail_in = cnt + trans_len;
+	zret = deflate(&zstrm, Z_FINISH);
+
+	*len -= zstrm.avail_out;
+	deflateEnd(&zstrm);
+	free(raw);
+
+	if (zret != Z_STREAM_END) {
+		free(*out);
+		*out = NULL;
+		return -1;
+	}
+
+	return 0;
+#else
+	free(raw);
+	return -1;
+#endif
+}
+
+/**
+ * @brief Decode the block.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param block	index of the block
+ * @param codec	codec of the block
+ * @param in	encoded block
+ * @param len	size of the encoded block
+ * @return	0 on success, -1 if the block is corrupted
+ */
+static int dfa_block_decode(struct dfa *dfa, size_t block, const char *codec,
+			    const unsigned char *in, size_t len)
+{
+	size_t first = block * DFA_BLOCK_STATES;
+	size_t cnt = dfa_block_states(dfa, block);
+	size_t trans_len = cnt * dfa->state_size;
+	uint8_t *flags = dfa->flags + first;
+	unsigned char *trans = (unsigned char *)dfa->trans +
+			       first * dfa->state_size;
+
+	if (memcmp(codec, "rowd", 4) == 0) {
+		if (dfa_block_rowd_decode(dfa, first, cnt, in, len) != 0)
+			return -1;
+	} else if (memcmp(codec, "none", 4) == 0) {
+		if (len != cnt + trans_len)
+			return -1;
+
+		memcpy(flags, in, cnt);
+		memcpy(trans, in + cnt, trans_len);
+	} else {
+#ifdef USE_ZLIB
+		z_stream zstrm;
+		int zret;
+
+		zstrm.zalloc = Z_NULL;
+		zstrm.zfree = Z_NULL;
+		zstrm.opaque = Z_NULL;
+		zstrm.next_in = (unsigned char *)in;
+		zstrm.avail_in = len;
+
+		if (inflateInit(&zstrm) != Z_OK)
+			return -1;
+
+		zstrm.next_out = flags;
+		zstrm.avail_out = cnt;
+		zret = inflate(&zstrm, Z_SYNC_FLUSH);
+
+		if (zret == Z_OK && zstrm.avail_out == 0) {
+			zstrm.next_out = trans;
+			zstrm.avail_out = trans_len;
+			zret = inflate(&zstrm, Z_FINISH);
+		}
+
+		inflateEnd(&zstrm);
+
+		if (zret != Z_STREAM_END || zstrm.avail_out != 0 ||
+		    zstrm.avail_in != 0)
+			return -1;
+#else
+		return -1;
+#endif
+	}
+
+	/* only the row-delta codec stores the targets, not the bytes */
+	if (memcmp(codec, "rowd", 4) != 0 && !host_is_le()) {
+		for (size_t i = 0; i < trans_len; i += dfa->bps / 8)
+			dfa_add_trans(dfa, first + i / dfa->state_size,
+				      i % dfa->state_size / (dfa->bps / 8),
+				      get_le(trans + i, dfa->bps / 8));
+	}
+
+	for (size_t i = 0; i < cnt; i++) {
+		size_t state = first + i;
+		bool deadend = true;
+
+		/* every target is checked, the block may be corrupted */
+		for (int c = 0; c < 256; c++) {
+			size_t to = dfa_get_trans(dfa, state, c);
+
+			if (to >= dfa->state_cnt)
+				return -1;
+			deadend = deadend && to == state;
+		}
+
+		flags[i] &= 0xFF ^ (DFA_FLAG_ACCEL | DFA_FLAG_DEADEND);
+		if (deadend)
+			flags[i] |= DFA_FLAG_DEADEND;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Encode the blocks of the thread.
+ *
+ * @param arg	pointer to the job
+ * @return	NULL
+ */
+static void *dfa_block_encode_run(void *arg)
+{
+	struct dfa_block_job *job = arg;
+
+	for (size_t i = 0; i < job->cnt && !job->error; i += job->step)
+		job->error = dfa_block_encode(job->src, job->first + i,
+					      job->codec, &job->buf[i],
+					      &job->len[i]) != 0;
+
+	return NULL;
+}
+
+/**
+ * @brief Decode the blocks of the thread.
+ *
+ * @param arg	pointer to the job
+ * @return	NULL
+ */
+static void *dfa_block_decode_run(void *arg)
+{
+	struct dfa_block_job *job = arg;
+
+	for (size_t i = 0; i < job->cnt && !job->error; i += job->step)
+		job->error = dfa_block_decode(job->dst, job->first + i,
+					      job->codec, job->buf[i],
+					      job->len[i]) != 0;
+
+	return NULL;
+}
+
+/**
+ * @brief Process the batch of blocks with multiple threads.
+ *
+ * The first job is done by the calling thread.
+ *
+ * @param jobs		array of jobs, one per thread
+ * @param thread_cnt	number of threads
+ * @param run		function of the threads
+ * @return		0 on success
+ */
+static int dfa_block_run(struct dfa_block_job *jobs, size_t thread_cnt,
+			 void *(*run)(void *))
+{
+	size_t started = 1;
+	bool failure = false;
+
+	for (; started < thread_cnt; started++)
+		if (pthread_create(&jobs[started].thread, NULL, run,
+				   &jobs[started]) != 0)
+			break;
+
+	/* blocks of the threads that failed to start are done here */
+	for (size_t i = started; i < thread_cnt; i++)
+		run(&jobs[i]);
+	run(&jobs[0]);
+
+	for (size_t i = 1; i < started; i++)
+		pthread_join(jobs[i].thread, NULL);
+
+	for (size_t i = 0; i < thread_cnt; i++)
+		failure |= jobs[i].error != 0;
+
+	return !failure ? 0 : -1;
+}
+
+/**
+ * @brief Prepare jobs for the batch of blocks.
+ *
+ * @param jobs		array of jobs, one per thread
+ * @param thread_cnt	number of threads
+ * @param first		the first block of the batch
+ * @param cnt		number of blocks of the batch
+ * @param buf		encoded blocks of the batch
+ * @param len		sizes of the encoded blocks
+ */
+static void dfa_block_jobs_init(struct dfa_block_job *jobs, size_t thread_cnt,
+				size_t first, size_t cnt, unsigned char **buf,
+				size_t *len)
+{
+	for (size_t i = 0; i < thread_cnt; i++) {
+		jobs[i].first = first + i;
+		jobs[i].cnt = i < cnt ? cnt - i : 0;
+		jobs[i].step = thread_cnt;
+		jobs[i].buf = buf + i;
+		jobs[i].len = len + i;
+		jobs[i].error = 0;
+	}
+}
+
+int dfa_block_save(const struct dfa *dfa, FILE *file, size_t thread_cnt,
+		   const char *codec)
+{
+	size_t block_cnt = (dfa->state_cnt + DFA_BLOCK_STATES - 1) /
+			   DFA_BLOCK_STATES;
+	size_t batch;
+	uint32_t block_states = DFA_BLOCK_STATES;
+	uint64_t tmp64, *offset;
+	struct dfa_block_job *jobs;
+	unsigned char **buf;
+	size_t *len;
+	long index;
+	bool failure = false;
+
+	if (codec == NULL)
+		codec = "rowd";
+	if (strlen(codec) != 4 || !dfa_block_codec_known(codec))
+		return -1;
+
+	if (thread_cnt == 0)
+		thread_cnt = 1;
+	batch = thread_cnt * DFA_BLOCK_BATCH;
+
+	offset = calloc(block_cnt + 1, sizeof(uint64_t));
+	jobs = calloc(thread_cnt, sizeof(struct dfa_block_job));
+	buf = calloc(batch, sizeof(unsigned char *));
+	len = calloc(batch, sizeof(size_t));
+	failure = offset == NULL || jobs == NULL || buf == NULL || len == NULL;
+
+	for (size_t i = 0; i < thread_cnt && !failure; i++) {
+		jobs[i].src = dfa;
+		jobs[i].codec = codec;
+	}
+
+	tmp64 = block_cnt;
+	failure = failure || fwrite(codec, 4, 1, file) != 1 ||
+		  fwrite(&block_states, sizeof(block_states), 1, file) != 1 ||
+		  fwrite(&tmp64, sizeof(tmp64), 1, file) != 1;
+
+	/* the offsets are known only after the compression */
+	index = ftell(file);
+	failure = failure || index < 0 ||
+		  fwrite(offset, sizeof(uint64_t), block_cnt + 1, file) !=
+		  block_cnt + 1;
+
+	for (size_t first = 0; first < block_cnt && !failure; first += batch) {
+		size_t cnt = MIN(batch, block_cnt - first);
+
+		dfa_block_jobs_init(jobs, thread_cnt, first, cnt, buf, len);
+		failure = dfa_block_run(jobs, thread_cnt,
+					dfa_block_encode_run) != 0;
+
+		for (size_t i = 0; i < cnt; i++) {
+			failure = failure ||
+				  fwrite(buf[i], 1, len[i], file) != len[i];
+			offset[first + i + 1] = offset[first + i] + len[i];
+			free(buf[i]);
+			buf[i] = NULL;
+		}
+	}
+
+	failure = failure || fseek(file, index, SEEK_SET) != 0 ||
+		  fwrite(offset, sizeof(uint64_t), block_cnt + 1, file) !=
+		  block_cnt + 1 ||
+		  fseek(file, 0, SEEK_END) != 0;
+
+	free(offset);
+	free(jobs);
+	free(buf);
+	free(len);
+
+	return !failure ? 0 : -1;
+}
+
+/**
+ * @brief Read codec and offsets of the blocks.
+ *
+ * @param dfa		pointer to the dfa structure with loaded header
+ * @param file		file positioned after the header
+ * @param codec		place for the codec's name
+ * @param block_cnt	place for the number of blocks
+ * @param offset	place for the allocated offsets of the blocks
+ * @return		0 on success
+ */
+static int dfa_block_read_index(const struct dfa *dfa, FILE *file,
+				char *codec, size_t *block_cnt,
+				uint64_t **offset)
+{
+	uint32_t block_states;
+	uint64_t tmp64;
+
+	if (fread(codec, 4, 1, file) != 1 ||
+	    fread(&block_states, sizeof(block_states), 1, file) != 1 ||
+	    fread(&tmp64, sizeof(tmp64), 1, file) != 1)
+		return -1;
+
+	/* other sizes of blocks may be accepted in the future */
+	if (block_states != DFA_BLOCK_STATES ||
+	    tmp64 != (dfa->state_cnt + DFA_BLOCK_STATES - 1) / DFA_BLOCK_STATES)
+		return -1;
+
+	if (!dfa_block_codec_known(codec))
+		return -1;
+
+	*block_cnt = tmp64;
+	*offset = malloc(sizeof(uint64_t) * (*block_cnt + 1));
+	if (*offset == NULL)
+		return -1;
+
+	if (fread(*offset, sizeof(uint64_t), *block_cnt + 1, file) !=
+	    *block_cnt + 1 || (*offset)[0] != 0) {
+		free(*offset);
+		return -1;
+	}
+
+	for (size_t i = 0; i < *block_cnt; i++)
+		if ((*offset)[i + 1] < (*offset)[i]) {
+			free(*offset);
+			return -1;
+		}
+
+	return 0;
+}
+
+int dfa_block_load(struct dfa *dfa, FILE *file, size_t thread_cnt)
+{
+	struct dfa_block_job *jobs;
+	unsigned char **buf, *data = NULL;
+	size_t *len, block_cnt, batch;
+	uint64_t *offset;
+	char codec[4];
+	bool failure;
+
+	if (dfa_block_read_index(dfa, file, codec, &block_cnt, &offset) != 0)
+		return -1;
+
+	if (thread_cnt == 0)
+		thread_cnt = 1;
+	batch = thread_cnt * DFA_BLOCK_BATCH;
+
+	jobs = calloc(thread_cnt, sizeof(struct dfa_block_job));
+	buf = calloc(batch, sizeof(unsigned char *));
+	len = calloc(batch, sizeof(size_t));
+	failure = jobs == NULL || buf == NULL || len == NULL;
+
+	for (size_t i = 0; i < thread_cnt && !failure; i++) {
+		jobs[i].dst = dfa;
+		jobs[i].codec = codec;
+	}
+
+	for (size_t first = 0; first < block_cnt && !failure; first += batch) {
+		size_t cnt = MIN(batch, block_cnt - first);
+		size_t size = offset[first + cnt] - offset[first];
+		unsigned char *tmp;
+
+		tmp = realloc(data, size);
+		if (tmp == NULL && size != 0) {
+			failure = true;
+			break;
+		}
+		data = tmp;
+
+		if (fread(data, 1, size, file) != size) {
+			failure = true;
+			break;
+		}
+
+		for (size_t i = 0; i < cnt; i++) {
+			buf[i] = data + offset[first + i] - offset[first];
+			len[i] = offset[first + i + 1] - offset[first + i];
+		}
+
+		dfa_block_jobs_init(jobs, thread_cnt, first, cnt, buf, len);
+		failure = dfa_block_run(jobs, thread_cnt,
+					dfa_block_decode_run) != 0;
+	}
+
+	free(data);
+	free(offset);
+	free(jobs);
+	free(buf);
+	free(len);
+
+	return !failure ? 0 : -1;
+}
+
+int dfa_lazy_open(struct dfa_lazy *lz, char *filename)
+{
+	char alg[4];
+
+	lz->file = fopen(filename, "r");
+	if (lz->file == NULL) {
+		perror(filename);
+		return -1;
+	}
+
+	if (dfa_load_header(&lz->dfa, lz->file, alg) != 0) {
+		fclose(lz->file);
+		return -1;
+	}
+
+	if (memcmp(alg, "blks", 4) != 0 ||
+	    dfa_block_read_index(&lz->dfa, lz->file, lz->codec,
+				 &lz->block_cnt, &lz->offset) != 0) {
+		dfa_free(&lz->dfa);
+		fclose(lz->file);
+		return -1;
+	}
+
+	lz->data_offset = ftell(lz->file);
+	lz->loaded = calloc(lz->block_cnt + 1, sizeof(uint8_t));
+	lz->loaded_cnt = 0;
+
+	if (lz->data_offset < 0 || lz->loaded == NULL) {
+		free(lz->offset);
+		free(lz->loaded);
+		dfa_free(&lz->dfa);
+		fclose(lz->file);
+		return -1;
+	}
+
+	return 0;
+}
+
+void dfa_lazy_free(struct dfa_lazy *lz)
+{
+	if (lz == NULL)
+		return;
+
+	dfa_free(&lz->dfa);
+	free(lz->offset);
+	free(lz->loaded);
+	fclose(lz->file);
+}
+
+int dfa_lazy_load(struct dfa_lazy *lz, size_t state)
+{
+	size_t block = state / DFA_BLOCK_STATES;
+	size_t len;
+	unsigned char *buf;
+	bool failure;
+
+	if (state >= lz->dfa.state_cnt)
+		return -1;
+
+	if (lz->loaded[block])
+		return 0;
+
+	len = lz->offset[block + 1] - lz->offset[block];
+	buf = malloc(len);
+	if (buf == NULL && len != 0)
+		return -1;
+
+	failure = fseek(lz->file, lz->data_offset + lz->offset[block],
+			SEEK_SET) != 0 ||
+		  fread(buf, 1, len, lz->file) != len ||
+		  dfa_block_decode(&lz->dfa, block, lz->codec, buf, len) != 0;
+
+	free(buf);
+
+	if (failure)
+		return -1;
+
+	lz->loaded[block] = 1;
+	lz->loaded_cnt++;
+
+	return 0;
+}
+
+size_t dfa_lazy_scan(struct dfa_lazy *lz, size_t *state,
+		     const void *data, size_t len)
+{
+	const unsigned char *ptr = data;
+	const struct dfa *dfa = &lz->dfa;
+	size_t cur = *state;
+
+	if (dfa_lazy_load(lz, cur) != 0)
+		return DFA_SCAN_NO_MATCH;
+
+	if (dfa->flags[cur] & DFA_FLAG_FINAL)
+		return 0;
+
+	for (size_t i = 0; i < len; i++) {
+		if (dfa->flags[cur] & DFA_FLAG_DEADEND)
+			break;
+
+		cur = dfa_get_trans(dfa, cur, ptr[i]);
+
+		if (!lz->loaded[cur / DFA_BLOCK_STATES] &&
+		    dfa_lazy_load(lz, cur) != 0)
+			break;
+
+		if (dfa->flags[cur] & DFA_FLAG_FINAL) {
+			*state = cur;
+			return i + 1;
+		}
+	}
+
+	*state = cur;
+
+	return DFA_SCAN_NO_MATCH;
+}
@@ -0,0 +1,157 @@
+/*
+ * Block-compressed storage of DFA states.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup dfa_block dfa_block
+ * @{
+ */
+
+#ifndef REFA_DFA_BLOCK_H
+#define REFA_DFA_BLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "dfa.h"
+
+/** number of states in one block */
+#define DFA_BLOCK_STATES	(4096)
+
+/**
+ * structure that represents DFA loaded from the file on demand
+ *
+ * Blocks of states are decompressed when the scan reaches them for
+ * the first time. The memory of the transition table is allocated
+ * at once but the pages of the blocks that were never reached are
+ * never touched.
+ */
+struct dfa_lazy {
+	/**
+	 * DFA, transitions and flags are valid only in the loaded blocks
+	 */
+	struct dfa dfa;
+
+	/**
+	 * file with the DFA
+	 */
+	FILE *file;
+
+	/**
+	 * name of the blocks' codec
+	 */
+	char codec[4];
+
+	/**
+	 * number of blocks
+	 */
+	size_t block_cnt;
+
+	/**
+	 * offsets of the blocks from the first one, block_cnt + 1 offsets
+	 */
+	uint64_t *offset;
+
+	/**
+	 * offset of the first block in the file
+	 */
+	long data_offset;
+
+	/**
+	 * flags of the loaded blocks
+	 */
+	uint8_t *loaded;
+
+	/**
+	 * number of the loaded blocks
+	 */
+	size_t loaded_cnt;
+};
+
+/**
+ * Save states of DFA in blocks.
+ *
+ * Writes the states after the header of the file: every DFA_BLOCK_STATES
+ * states are encoded independently and the offsets of all blocks are stored
+ * before them. Blocks are encoded by thread_cnt threads with the codec:
+ *   "rowd" - row-delta codec, runs of equal or shifted transitions and
+ *            varint targets (the default);
+ *   "zlib" - zlib stream of the flags and the little-endian transitions,
+ *            only with zlib support;
+ *   "none" - the flags and the little-endian transitions as they are.
+ * The row-delta codec needs no library and is written about three times
+ * faster than zlib, but its files are larger: 135 KB vs 96 KB for the
+ * 16385 states of /a[ab]{13}c/ and 24 KB vs 20 KB for /x.{10}y/. Use zlib
+ * when the size of the file matters more than the time of saving.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param file		seekable file opened for writing
+ * @param thread_cnt	number of threads
+ * @param codec		four characters of the codec's name, NULL for "rowd"
+ * @return		0 on success, -1 on error or unknown codec
+ */
+int dfa_block_save(const struct dfa *dfa, FILE *file, size_t thread_cnt,
+		   const char *codec);
+
+/**
+ * Load states of DFA from blocks.
+ *
+ * Reads the states written by dfa_block_save(), blocks are decompressed
+ * by thread_cnt threads.
+ *
+ * @param dfa		pointer to the dfa structure with loaded header
+ *			(see dfa_load_header())
+ * @param file		file opened for reading
+ * @param thread_cnt	number of threads
+ * @return		0 on success
+ */
+int dfa_block_load(struct dfa *dfa, FILE *file, size_t thread_cnt);
+
+/**
+ * Open the dfa file for the lazy loading.
+ *
+ * Loads the header and the offsets of the blocks only. The file must be
+ * saved by dfa_save_to_file() and stays open until dfa_lazy_free().
+ *
+ * @param lz		pointer to the dfa_lazy structure
+ * @param filename	path to the file with the saved dfa
+ * @return		0 on success
+ */
+int dfa_lazy_open(struct dfa_lazy *lz, char *filename);
+
+/**
+ * Free the lazily loaded DFA.
+ *
+ * @param lz	pointer to the dfa_lazy structure
+ */
+void dfa_lazy_free(struct dfa_lazy *lz);
+
+/**
+ * Load the block of the state.
+ *
+ * @param lz	pointer to the dfa_lazy structure
+ * @param state	index of the DFA's state
+ * @return	0 on success
+ */
+int dfa_lazy_load(struct dfa_lazy *lz, size_t state);
+
+/**
+ * Scan data with the lazily loaded DFA.
+ *
+ * The same as dfa_scan() but the blocks of the reached states are loaded
+ * first. The scan stops without a match if a block can not be loaded.
+ *
+ * @param lz	pointer to the dfa_lazy structure
+ * @param state	pointer to the current state's index
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @return	offset just past the byte that led to an accepting state
+ *		or DFA_SCAN_NO_MATCH
+ */
+size_t dfa_lazy_scan(struct dfa_lazy *lz, size_t *state,
+		     const void *data, size_t len);
+
+#endif /** REFA_DFA_BLOCK_H @} */
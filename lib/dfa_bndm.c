@@ -0,0 +1,285 @@
+/*
+ * Backward skipping search with reverse factor automaton.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfa_bndm.h"
+#include "dfa_scan.h"
+#include "literal.h"
+#include "nfa_to_dfa.h"
+#include "tree_to_nfa.h"
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+/**
+ * @brief Length of the shortest string accepted by lambda-free NFA.
+ *
+ * @param nfa	pointer to the nfa structure
+ * @return	length or SIZE_MAX if NFA accepts nothing
+ */
+static size_t dfa_bndm_min_len(const struct nfa *nfa)
+{
+	size_t *dist, *queue;
+	size_t head = 0, tail = 0, len = SIZE_MAX;
+
+	dist = malloc(sizeof(size_t) * nfa->node_cnt);
+	queue = malloc(sizeof(size_t) * nfa->node_cnt);
+	if (dist == NULL || queue == NULL) {
+		free(dist);
+		free(queue);
+		return SIZE_MAX;
+	}
+
+	for (size_t i = 0; i < nfa->node_cnt; i++)
+		dist[i] = SIZE_MAX;
+
+	dist[nfa->first_index] = 0;
+	queue[tail++] = nfa->first_index;
+
+	while (head < tail && len == SIZE_MAX) {
+		size_t cur = queue[head++];
+		const struct nfa_node *node = &nfa->nodes[cur];
+
+		if (node->isfinal) {
+			len = dist[cur];
+			break;
+		}
+
+		for (int c = 0; c < 256; c++)
+			for (size_t k = 0; k < node->trans_cnt[c]; k++) {
+				size_t to = node->trans[c][k];
+
+				if (dist[to] == SIZE_MAX) {
+					dist[to] = dist[cur] + 1;
+					queue[tail++] = to;
+				}
+			}
+	}
+
+	free(dist);
+	free(queue);
+
+	return len;
+}
+
+/**
+ * @brief Build NFA of the reversed factors of the prefixes.
+ *
+ * States are pairs of the NFA state and the depth of the prefix, only
+ * the pairs that are reached from the initial state are used. A new
+ * initial state has the transitions of all pairs, the final state is
+ * the pair of the initial state and the zero depth.
+ *
+ * @param dst		pointer to the empty nfa structure
+ * @param src		pointer to the lambda-free nfa structure
+ * @param window	length of the prefixes
+ * @return		0 on success
+ */
+static int dfa_bndm_factor_nfa(struct nfa *dst, const struct nfa *src,
+			       size_t window)
+{
+	size_t cnt = src->node_cnt;
+	bool *reached;
+	size_t first;
+	bool failure = false;
+
+	reached = calloc(cnt * (window + 1), sizeof(bool));
+	if (reached == NULL)
+		return -1;
+
+	failure = nfa_add_node_n(dst, cnt * (window + 1), NULL) != 0 ||
+		  nfa_add_node(dst, &first) != 0;
+
+	reached[src->first_index] = true;
+
+	for (size_t d = 0; d < window && !failure; d++) {
+		for (size_t q = 0; q < cnt && !failure; q++) {
+			const struct nfa_node *node = &src->nodes[q];
+
+			if (!reached[d * cnt + q])
+				continue;
+
+			for (int c = 0; c < 256 && !failure; c++)
+				for (size_t k = 0; k < node->trans_cnt[c]; k++) {
+					size_t to = (d + 1) * cnt +
+						    node->trans[c][k];
+
+					reached[to] = true;
+					failure = failure ||
+						  nfa_add_trans(dst, to, c,
+							d * cnt + q) != 0 ||
+						  nfa_add_trans(dst, first, c,
+							d * cnt + q) != 0;
+				}
+		}
+	}
+
+	free(reached);
+
+	if (failure)
+		return -1;
+
+	dst->first_index = first;
+	dst->nodes[src->first_index].isfinal = true;
+
+	return nfa_rebuild(dst);
+}
+
+int dfa_bndm_alloc(struct dfa_bndm *bm, const struct regexp_tree *re_tree)
+{
+	const struct regexp_node *core;
+	struct nfa nfa, factor;
+	bool floating, failure = false;
+	size_t min_len = 0;
+
+	memset(bm, 0x00, sizeof(*bm));
+	dfa_alloc(&bm->dfa);
+	dfa_alloc(&bm->anchored);
+	dfa_alloc2(&bm->factor, DFA_BNDM_MAX_STATES);
+
+	core = regexp_tree_core(re_tree, &floating);
+
+	nfa_alloc(&nfa);
+	nfa_alloc(&factor);
+
+	failure = !floating || convert_node_to_lambdanfa(&nfa, core) != 0 ||
+		  nfa_rebuild(&nfa) != 0;
+
+	if (!failure) {
+		min_len = dfa_bndm_min_len(&nfa);
+		failure = min_len < DFA_BNDM_MIN_WINDOW || min_len == SIZE_MAX;
+		bm->window = min_len < DFA_BNDM_MAX_WINDOW ?
+			     min_len : DFA_BNDM_MAX_WINDOW;
+	}
+
+	failure = failure ||
+		  dfa_bndm_factor_nfa(&factor, &nfa, bm->window) != 0 ||
+		  convert_nfa_to_dfa(&bm->factor, &factor) != 0 ||
+		  dfa_minimize(&bm->factor) != 0 ||
+		  dfa_compress(&bm->factor) != 0 ||
+		  convert_nfa_to_dfa(&bm->anchored, &nfa) != 0 ||
+		  dfa_minimize(&bm->anchored) != 0 ||
+		  dfa_compress(&bm->anchored) != 0;
+
+	nfa_free(&factor);
+	nfa_free(&nfa);
+
+	if (!failure) {
+		nfa_alloc(&nfa);
+		failure = convert_tree_to_lambdanfa(&nfa,
+				(struct regexp_tree *)re_tree) != 0 ||
+			  nfa_rebuild(&nfa) != 0 ||
+			  convert_nfa_to_dfa(&bm->dfa, &nfa) != 0 ||
+			  dfa_minimize(&bm->dfa) != 0 ||
+			  dfa_compress(&bm->dfa) != 0;
+		nfa_free(&nfa);
+	}
+
+	if (failure) {
+		dfa_bndm_free(bm);
+		return -1;
+	}
+
+	return 0;
+}
+
+void dfa_bndm_free(struct dfa_bndm *bm)
+{
+	dfa_free(&bm->factor);
+	dfa_free(&bm->anchored);
+	dfa_free(&bm->dfa);
+	memset(bm, 0x00, sizeof(*bm));
+}
+
+/**
+ * @brief Find the first match that starts at the candidate.
+ *
+ * No match starts before the candidate, so the first match of the data
+ * ends not later than the shortest match from the candidate and it is
+ * found by the regexp's DFA from the candidate up to that end.
+ *
+ * The anchored DFA reads at most DFA_BNDM_MAX_CHECK bytes. If it is still
+ * alive, the regexp's DFA scans the rest of the data and its result is
+ * the result of the search.
+ *
+ * @param bm	pointer to the dfa_bndm structure
+ * @param data	scanned data
+ * @param len	size of the data
+ * @param pos	offset of the candidate
+ * @param done	set to true if the rest of the data is scanned
+ * @return	end of the first match or DFA_SCAN_NO_MATCH
+ */
+static size_t dfa_bndm_verify(const struct dfa_bndm *bm,
+			      const unsigned char *data, size_t len,
+			      size_t pos, bool *done)
+{
+	size_t state = bm->anchored.first_index;
+	size_t check = MIN(len - pos, DFA_BNDM_MAX_CHECK);
+	size_t end;
+
+	end = dfa_scan(&bm->anchored, &state, data + pos, check);
+	if (end == DFA_SCAN_NO_MATCH) {
+		if (check == len - pos ||
+		    (bm->anchored.flags[state] & DFA_FLAG_DEADEND))
+			return DFA_SCAN_NO_MATCH;
+
+		/* the match may be long, the later candidates are not checked */
+		*done = true;
+		end = len - pos;
+	}
+
+	state = bm->dfa.first_index;
+	end = dfa_scan(&bm->dfa, &state, data + pos, end);
+
+	return end != DFA_SCAN_NO_MATCH ? pos + end : DFA_SCAN_NO_MATCH;
+}
+
+size_t dfa_bndm_scan(const struct dfa_bndm *bm, const void *data, size_t len)
+{
+	const unsigned char *ptr = data;
+	const struct dfa *factor = &bm->factor;
+	const size_t window = bm->window;
+	size_t pos = 0;
+
+	while (pos + window <= len) {
+		size_t state = factor->first_index;
+		size_t j = window, last = window;
+
+		while (j > 0) {
+			state = dfa_get_trans(factor, state, ptr[pos + j - 1]);
+			j--;
+
+			if (factor->flags[state] & DFA_FLAG_DEADEND)
+				break;
+
+			if (!(factor->flags[state] & DFA_FLAG_FINAL))
+				continue;
+
+			/* the read part of the window is a prefix */
+			if (j > 0) {
+				last = j;
+			} else {
+				bool done = false;
+				size_t end = dfa_bndm_verify(bm, ptr, len, pos,
+							     &done);
+
+				if (end != DFA_SCAN_NO_MATCH || done)
+					return end;
+			}
+		}
+
+		pos += last;
+	}
+
+	return DFA_SCAN_NO_MATCH;
+}
@@ -0,0 +1,103 @@
+/*
+ * Backward skipping search with reverse factor automaton.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup scan scan
+ * @{
+ */
+
+#ifndef REFA_DFA_BNDM_H
+#define REFA_DFA_BNDM_H
+
+#include <stddef.h>
+
+#include "dfa.h"
+#include "parser.h"
+
+/** minimum length of matches that makes the backward search profitable */
+#define DFA_BNDM_MIN_WINDOW	(4)
+
+/** maximum length of the search window */
+#define DFA_BNDM_MAX_WINDOW	(32)
+
+/** maximum number of states of the factor automaton */
+#define DFA_BNDM_MAX_STATES	(4096)
+
+/** maximum length of the check of a candidate before the forward scan */
+#define DFA_BNDM_MAX_CHECK	(256)
+
+/**
+ * structure that represents backward search of one regexp
+ *
+ * Every match of the regexp starts with a string of the window's length
+ * from the set of prefixes P. The window of the data is read backwards
+ * with DFA of the reversed factors of P: when the automaton dies, no match
+ * starts inside of the read part of the window and the window is shifted
+ * past it. Only the windows that are prefixes from P are verified with
+ * forward DFA. If a match from the candidate may be longer than
+ * DFA_BNDM_MAX_CHECK bytes, the rest of the data is scanned forward once
+ * instead of checking every later candidate up to the end of the data.
+ */
+struct dfa_bndm {
+	/**
+	 * length of the window, not greater than the minimum match length
+	 */
+	size_t window;
+
+	/**
+	 * DFA of the reversed factors of the prefixes of the window's length,
+	 * final states are reached when the read part is a prefix itself
+	 */
+	struct dfa factor;
+
+	/**
+	 * DFA of the regexp anchored at the window's start
+	 */
+	struct dfa anchored;
+
+	/**
+	 * DFA of the regexp
+	 */
+	struct dfa dfa;
+};
+
+/**
+ * Build backward search of regexp tree.
+ *
+ * Fails if the search is not expected to be faster than dfa_scan():
+ * the regexp is anchored at the beginning, its matches are shorter than
+ * DFA_BNDM_MIN_WINDOW bytes or the factor automaton needs more than
+ * DFA_BNDM_MAX_STATES states.
+ *
+ * @param bm		pointer to the dfa_bndm structure
+ * @param re_tree	pointer to the regexp tree
+ * @return		0 on success, -1 if the backward search is not
+ *			profitable or on error
+ */
+int dfa_bndm_alloc(struct dfa_bndm *bm, const struct regexp_tree *re_tree);
+
+/**
+ * Free backward search.
+ *
+ * @param bm	pointer to the dfa_bndm structure
+ */
+void dfa_bndm_free(struct dfa_bndm *bm);
+
+/**
+ * Scan data with backward search.
+ *
+ * The result is the same as the result of dfa_scan() of the whole data
+ * with the DFA of the regexp.
+ *
+ * @param bm	pointer to the dfa_bndm structure
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @return	offset just past the byte that led to an accepting state
+ *		or DFA_SCAN_NO_MATCH
+ */
+size_t dfa_bndm_scan(const struct dfa_bndm *bm, const void *data, size_t len);
+
+#endif /** REFA_DFA_BNDM_H @} */
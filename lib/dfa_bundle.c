@@ -0,0 +1,382 @@
+/*
+ * Bundle of named DFAs in one file.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "dfa_bundle.h"
+#include "endian_inner.h"
+
+/**
+ * @brief Size of the bundle's header.
+ */
+#define DFA_BUNDLE_HEADER_SIZE	(64)
+
+/**
+ * @brief Number of items allocated at once.
+ */
+#define DFA_BUNDLE_CHUNK	(64)
+
+/**
+ * @brief Compare items by names.
+ */
+static int dfa_bundle_item_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct dfa_bundle_item *)a)->name,
+		      ((const struct dfa_bundle_item *)b)->name);
+}
+
+/**
+ * @brief Initialize the empty bundle.
+ *
+ * @param bundle	pointer to the dfa_bundle structure
+ */
+static void dfa_bundle_init(struct dfa_bundle *bundle)
+{
+	bundle->file = NULL;
+	bundle->fd = -1;
+	bundle->meta = NULL;
+	bundle->meta_size = 0;
+	bundle->items = NULL;
+	bundle->cnt = 0;
+	bundle->malloc_cnt = 0;
+	bundle->size = 0;
+	bundle->failed = false;
+}
+
+int dfa_bundle_create(struct dfa_bundle *bundle, char *filename,
+		      const void *meta, size_t meta_size)
+{
+	static const unsigned char header[DFA_BUNDLE_HEADER_SIZE];
+	bool failure;
+
+	dfa_bundle_init(bundle);
+
+	bundle->file = fopen(filename, "w+");
+	if (bundle->file == NULL) {
+		perror(filename);
+		return -1;
+	}
+
+	/* the header is written by dfa_bundle_finish() */
+	failure = fwrite(header, sizeof(header), 1, bundle->file) != 1 ||
+		  fwrite(meta, 1, meta_size, bundle->file) != meta_size;
+	bundle->meta_size = meta_size;
+	bundle->size = DFA_BUNDLE_HEADER_SIZE + meta_size;
+
+	if (failure) {
+		dfa_bundle_free(bundle);
+		return -1;
+	}
+
+	return 0;
+}
+
+int dfa_bundle_add(struct dfa_bundle *bundle, const char *name,
+		   const struct dfa *dfa)
+{
+	struct dfa_bundle_item *item;
+	uint64_t offset;
+	long end;
+
+	if (bundle->file == NULL || bundle->failed || name == NULL ||
+	    name[0] == '\0')
+		return -1;
+
+	if (bundle->cnt == bundle->malloc_cnt) {
+		struct dfa_bundle_item *tmp;
+
+		tmp = realloc(bundle->items, sizeof(struct dfa_bundle_item) *
+				(bundle->malloc_cnt + DFA_BUNDLE_CHUNK));
+		if (tmp == NULL)
+			return -1;
+		bundle->items = tmp;
+		bundle->malloc_cnt += DFA_BUNDLE_CHUNK;
+	}
+
+	item = &bundle->items[bundle->cnt];
+	item->name = strdup(name);
+	if (item->name == NULL)
+		return -1;
+
+	offset = _ALIGN_TO(bundle->size, DFA_MAP_ALIGN);
+	if (write_pad(bundle->file, bundle->size, offset) != 0 ||
+	    dfa_save_map(dfa, bundle->file) != 0 ||
+	    (end = ftell(bundle->file)) < 0) {
+		/* a part of the DFA may be written already */
+		bundle->failed = true;
+		free(item->name);
+		return -1;
+	}
+
+	item->offset = offset;
+	item->size = end - offset;
+
+	bundle->size = end;
+	bundle->cnt++;
+
+	return 0;
+}
+
+int dfa_bundle_finish(struct dfa_bundle *bundle)
+{
+	unsigned char header[DFA_BUNDLE_HEADER_SIZE], buf[24];
+	uint64_t dir_offset, dir_size = 0;
+	bool failure = bundle->file == NULL || bundle->failed;
+
+	if (bundle->cnt != 0)
+		qsort(bundle->items, bundle->cnt,
+		      sizeof(struct dfa_bundle_item), dfa_bundle_item_cmp);
+
+	for (size_t i = 1; i < bundle->cnt && !failure; i++)
+		failure = strcmp(bundle->items[i - 1].name,
+				 bundle->items[i].name) == 0;
+
+	dir_offset = _ALIGN_TO(bundle->size, 8);
+	failure = failure ||
+		  write_pad(bundle->file, bundle->size, dir_offset) != 0;
+
+	for (size_t i = 0; i < bundle->cnt && !failure; i++) {
+		const struct dfa_bundle_item *item = &bundle->items[i];
+		size_t len = strlen(item->name) + 1;
+
+		put_le64(buf, item->offset);
+		put_le64(buf + 8, item->size);
+		put_le64(buf + 16, len);
+		failure = fwrite(buf, sizeof(buf), 1, bundle->file) != 1 ||
+			  fwrite(item->name, 1, len, bundle->file) != len;
+		dir_size += sizeof(buf) + len;
+	}
+
+	memset(header, 0x00, sizeof(header));
+	memcpy(header, "\x57""DFAbndl", 8);
+	memcpy(header + 8, "ver#\x00\x01\x00\x00", 8);
+	put_le64(header + 16, bundle->cnt);
+	put_le64(header + 24, dir_offset);
+	put_le64(header + 32, dir_size);
+	put_le64(header + 40, DFA_BUNDLE_HEADER_SIZE);
+	put_le64(header + 48, bundle->meta_size);
+
+	failure = failure || fseek(bundle->file, 0, SEEK_SET) != 0 ||
+		  fwrite(header, sizeof(header), 1, bundle->file) != 1;
+	failure = fclose(bundle->file) != 0 || failure;
+	bundle->file = NULL;
+
+	dfa_bundle_free(bundle);
+
+	return !failure ? 0 : -1;
+}
+
+/**
+ * @brief Read the part of the opened file.
+ *
+ * @param fd		descriptor of the file
+ * @param dst		place for the data
+ * @param len		size of the data
+ * @param offset	offset of the data
+ * @return		0 on success
+ */
+static int dfa_bundle_read(int fd, void *dst, size_t len, uint64_t offset)
+{
+	while (len != 0) {
+		ssize_t ret = pread(fd, dst, len, offset);
+
+		if (ret <= 0)
+			return -1;
+		dst = (char *)dst + ret;
+		len -= ret;
+		offset += ret;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Parse the directory of the bundle.
+ *
+ * @param bundle	pointer to the dfa_bundle structure
+ * @param dir		contents of the directory
+ * @param dir_size	size of the directory
+ * @param cnt		number of DFAs
+ * @param file_size	size of the file
+ * @return		0 on success, -1 if the directory is corrupted
+ */
+static int dfa_bundle_parse(struct dfa_bundle *bundle,
+			    const unsigned char *dir, uint64_t dir_size,
+			    uint64_t cnt, uint64_t file_size)
+{
+	/* every item takes at least 25 bytes */
+	if (cnt > dir_size / 25)
+		return -1;
+
+	bundle->items = calloc(cnt, sizeof(struct dfa_bundle_item));
+	if (bundle->items == NULL && cnt != 0)
+		return -1;
+	bundle->malloc_cnt = cnt;
+
+	for (uint64_t i = 0; i < cnt; i++) {
+		struct dfa_bundle_item *item = &bundle->items[i];
+		uint64_t len;
+
+		if (dir_size < 24)
+			return -1;
+
+		item->offset = get_le64(dir);
+		item->size = get_le64(dir + 8);
+		len = get_le64(dir + 16);
+		if (len == 0 || len > dir_size - 24 || dir[24 + len - 1] != '\0' ||
+		    strlen((const char *)dir + 24) != len - 1 ||
+		    item->offset % DFA_MAP_ALIGN != 0 ||
+		    item->offset > file_size ||
+		    item->size > file_size - item->offset)
+			return -1;
+
+		item->name = strdup((const char *)dir + 24);
+		if (item->name == NULL)
+			return -1;
+		bundle->cnt++;
+
+		/* sorted names make the lookup a binary search */
+		if (i != 0 && strcmp(bundle->items[i - 1].name, item->name) >= 0)
+			return -1;
+
+		dir += 24 + len;
+		dir_size -= 24 + len;
+	}
+
+	return 0;
+}
+
+int dfa_bundle_open(struct dfa_bundle *bundle, char *filename)
+{
+	unsigned char header[DFA_BUNDLE_HEADER_SIZE], *dir = NULL;
+	uint64_t cnt, dir_offset, dir_size, meta_offset, meta_size;
+	struct stat st;
+	bool failure;
+
+	dfa_bundle_init(bundle);
+
+	bundle->fd = open(filename, O_RDONLY);
+	if (bundle->fd < 0) {
+		perror(filename);
+		return -1;
+	}
+
+	failure = fstat(bundle->fd, &st) != 0 ||
+		  dfa_bundle_read(bundle->fd, header, sizeof(header), 0) != 0 ||
+		  memcmp(header, "\x57""DFAbndl", 8) != 0 ||
+		  memcmp(header + 8, "ver#\x00\x01\x00\x00", 8) != 0;
+
+	if (!failure) {
+		cnt = get_le64(header + 16);
+		dir_offset = get_le64(header + 24);
+		dir_size = get_le64(header + 32);
+		meta_offset = get_le64(header + 40);
+		meta_size = get_le64(header + 48);
+
+		failure = dir_offset > (uint64_t)st.st_size ||
+			  dir_size > st.st_size - dir_offset ||
+			  meta_offset > (uint64_t)st.st_size ||
+			  meta_size > st.st_size - meta_offset;
+	}
+
+	if (!failure) {
+		bundle->meta = malloc(meta_size);
+		dir = malloc(dir_size);
+		failure = (bundle->meta == NULL && meta_size != 0) ||
+			  (dir == NULL && dir_size != 0);
+	}
+
+	if (!failure) {
+		bundle->meta_size = meta_size;
+		failure = dfa_bundle_read(bundle->fd, bundle->meta, meta_size,
+					  meta_offset) != 0 ||
+			  dfa_bundle_read(bundle->fd, dir, dir_size,
+					  dir_offset) != 0 ||
+			  dfa_bundle_parse(bundle, dir, dir_size, cnt,
+					   st.st_size) != 0;
+	}
+
+	free(dir);
+
+	if (failure) {
+		dfa_bundle_free(bundle);
+		return -1;
+	}
+
+	return 0;
+}
+
+int dfa_bundle_find(const struct dfa_bundle *bundle, const char *name,
+		    size_t *index)
+{
+	size_t lo = 0, hi = bundle->cnt;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int cmp = strcmp(name, bundle->items[mid].name);
+
+		if (cmp == 0) {
+			*index = mid;
+			return 0;
+		}
+
+		if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return -1;
+}
+
+int dfa_bundle_map(const struct dfa_bundle *bundle, const char *name,
+		   struct dfa *dfa)
+{
+	size_t i;
+
+	if (bundle->fd < 0 || dfa_bundle_find(bundle, name, &i) != 0)
+		return -1;
+
+	return dfa_map_fd(dfa, bundle->fd, bundle->items[i].offset,
+			  bundle->items[i].size);
+}
+
+int dfa_bundle_load(const struct dfa_bundle *bundle, const char *name,
+		    struct dfa *dfa)
+{
+	size_t i;
+
+	if (bundle->fd < 0 || dfa_bundle_find(bundle, name, &i) != 0)
+		return -1;
+
+	return dfa_load_map_fd(dfa, bundle->fd, bundle->items[i].offset,
+			       bundle->items[i].size);
+}
+
+void dfa_bundle_free(struct dfa_bundle *bundle)
+{
+	if (bundle->file != NULL)
+		fclose(bundle->file);
+	if (bundle->fd >= 0)
+		close(bundle->fd);
+
+	for (size_t i = 0; i < bundle->cnt; i++)
+		free(bundle->items[i].name);
+	free(bundle->items);
+	free(bundle->meta);
+
+	dfa_bundle_init(bundle);
+}
@@ -0,0 +1,196 @@
+/*
+ * Bundle of named DFAs in one file.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup dfa_bundle dfa_bundle
+ * @{
+ */
+
+#ifndef REFA_DFA_BUNDLE_H
+#define REFA_DFA_BUNDLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "dfa.h"
+
+/**
+ * structure that represents one DFA of the bundle
+ */
+struct dfa_bundle_item {
+	/**
+	 * name of the DFA
+	 */
+	char *name;
+
+	/**
+	 * offset of the DFA's mappable image in the file
+	 */
+	uint64_t offset;
+
+	/**
+	 * size of the DFA's mappable image
+	 */
+	uint64_t size;
+};
+
+/**
+ * structure that represents the file with many named DFAs
+ *
+ * Every DFA is stored as the mappable image (see dfa_save_map()) at
+ * the page-aligned offset, the directory of the names and offsets is
+ * sorted by names. The bundle also holds metadata shared by all DFAs.
+ * The structure is either being written (dfa_bundle_create()) or opened
+ * for reading (dfa_bundle_open()).
+ */
+struct dfa_bundle {
+	/**
+	 * file being written, NULL if the bundle is opened for reading
+	 */
+	FILE *file;
+
+	/**
+	 * descriptor of the file opened for reading, -1 otherwise
+	 */
+	int fd;
+
+	/**
+	 * metadata shared by all DFAs
+	 */
+	void *meta;
+
+	/**
+	 * size of the metadata
+	 */
+	size_t meta_size;
+
+	/**
+	 * directory, sorted by names in the opened bundle
+	 */
+	struct dfa_bundle_item *items;
+
+	/**
+	 * number of DFAs
+	 */
+	size_t cnt;
+
+	/**
+	 * number of allocated items
+	 */
+	size_t malloc_cnt;
+
+	/**
+	 * size of the data written so far
+	 */
+	uint64_t size;
+
+	/**
+	 * true if a write failed, the bundle can not be finished
+	 */
+	bool failed;
+};
+
+/**
+ * Create the bundle file.
+ *
+ * @param bundle	pointer to the dfa_bundle structure
+ * @param filename	path to the file
+ * @param meta		metadata shared by all DFAs, may be NULL
+ * @param meta_size	size of the metadata
+ * @return		0 on success
+ */
+int dfa_bundle_create(struct dfa_bundle *bundle, char *filename,
+		      const void *meta, size_t meta_size);
+
+/**
+ * Add DFA to the bundle being written.
+ *
+ * If the DFA is not written, the file is left in an unknown state, so
+ * the later calls of dfa_bundle_add() and dfa_bundle_finish() fail.
+ *
+ * @param bundle	pointer to the dfa_bundle structure
+ * @param name		unique name of the DFA
+ * @param dfa		pointer to the dfa structure
+ * @return		0 on success
+ */
+int dfa_bundle_add(struct dfa_bundle *bundle, const char *name,
+		   const struct dfa *dfa);
+
+/**
+ * Finish the bundle being written.
+ *
+ * Writes the directory and closes the file, the structure is freed
+ * in any case. The file is not valid until this call succeeds.
+ *
+ * @param bundle	pointer to the dfa_bundle structure
+ * @return		0 on success, -1 on error or if the names
+ *			are not unique
+ */
+int dfa_bundle_finish(struct dfa_bundle *bundle);
+
+/**
+ * Open the bundle file.
+ *
+ * Reads the metadata and the directory only, the DFAs are mapped
+ * or loaded by their names.
+ *
+ * @param bundle	pointer to the dfa_bundle structure
+ * @param filename	path to the file
+ * @return		0 on success
+ */
+int dfa_bundle_open(struct dfa_bundle *bundle, char *filename);
+
+/**
+ * Find DFA in the opened bundle.
+ *
+ * @param bundle	pointer to the dfa_bundle structure
+ * @param name		name of the DFA
+ * @param index		place for the index of the DFA's item
+ * @return		0 on success, -1 if there is no such DFA
+ */
+int dfa_bundle_find(const struct dfa_bundle *bundle, const char *name,
+		    size_t *index);
+
+/**
+ * Map DFA from the opened bundle.
+ *
+ * The same as dfa_map_file() for the DFA of the bundle, the DFA stays
+ * valid after dfa_bundle_free().
+ *
+ * @param bundle	pointer to the dfa_bundle structure
+ * @param name		name of the DFA
+ * @param dfa		pointer to the dfa structure
+ * @return		0 on success
+ */
+int dfa_bundle_map(const struct dfa_bundle *bundle, const char *name,
+		   struct dfa *dfa);
+
+/**
+ * Load DFA from the opened bundle.
+ *
+ * The same as dfa_bundle_map() but the DFA is copied into the allocated
+ * memory.
+ *
+ * @param bundle	pointer to the dfa_bundle structure
+ * @param name		name of the DFA
+ * @param dfa		pointer to the dfa structure
+ * @return		0 on success
+ */
+int dfa_bundle_load(const struct dfa_bundle *bundle, const char *name,
+		    struct dfa *dfa);
+
+/**
+ * Free the bundle.
+ *
+ * Closes the file, the bundle being written is left unfinished.
+ *
+ * @param bundle	pointer to the dfa_bundle structure
+ */
+void dfa_bundle_free(struct dfa_bundle *bundle);
+
+#endif /** REFA_DFA_BUNDLE_H @} */
@@ -0,0 +1,242 @@
+/*
+ * On-disk cache of compiled patterns.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "dfa_bundle.h"
+#include "dfa_cache.h"
+#include "nfa.h"
+#include "nfa_to_dfa.h"
+#include "parser.h"
+#include "tree_to_nfa.h"
+
+#ifndef PACKAGE_VERSION
+#define PACKAGE_VERSION	"unknown"
+#endif
+
+/**
+ * @brief Version of the cache's entries.
+ *
+ * Must be changed together with the changes of the compilation that
+ * make the DFAs different.
+ */
+#define DFA_CACHE_VERSION	"1"
+
+/**
+ * @brief Name of the DFA inside the entry.
+ */
+#define DFA_CACHE_ITEM		"dfa"
+
+/**
+ * @brief Build the key of the pattern.
+ *
+ * The modifiers of the pattern are sorted and deduplicated, so "/a/im"
+ * and "/a/mi" have the same key.
+ *
+ * @param regexp	the pattern
+ * @param options	options of the compilation
+ * @param len		place for the size of the key (with \0)
+ * @return		the allocated key or NULL
+ */
+static char *dfa_cache_key(const char *regexp, const char *options,
+			   size_t *len)
+{
+	static const char mods[] = "ims";
+	const char *end = strrchr(regexp, '/');
+	size_t body;
+	char *key, *ptr;
+
+	if (end == NULL || end == regexp || regexp[0] != '/' ||
+	    strspn(end + 1, mods) != strlen(end + 1))
+		end = regexp + strlen(regexp);
+	body = end - regexp;
+
+	*len = sizeof("refa " PACKAGE_VERSION " cache " DFA_CACHE_VERSION "\n") +
+	       strlen(options) + 1 + body + sizeof(mods);
+	key = malloc(*len);
+	if (key == NULL)
+		return NULL;
+
+	ptr = key + sprintf(key, "refa %s cache %s\n%s\n", PACKAGE_VERSION,
+			    DFA_CACHE_VERSION, options);
+	memcpy(ptr, regexp, body);
+	ptr += body;
+
+	if (*end == '/') {
+		*ptr++ = '/';
+		for (const char *m = mods; *m != '\0'; m++)
+			if (strchr(end + 1, *m) != NULL)
+				*ptr++ = *m;
+	}
+	*ptr++ = '\0';
+	*len = ptr - key;
+
+	return key;
+}
+
+/**
+ * @brief Build the path to the entry.
+ *
+ * The name of the entry is 64-bit FNV-1a hash of the key.
+ *
+ * @param cache		pointer to the dfa_cache structure
+ * @param key		key of the entry
+ * @param len		size of the key
+ * @param suffix	suffix of the file's name
+ * @return		the allocated path or NULL
+ */
+static char *dfa_cache_path(const struct dfa_cache *cache, const char *key,
+			    size_t len, const char *suffix)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	char *path;
+	size_t size;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char)key[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	size = strlen(cache->dir) + strlen(suffix) + 32;
+	path = malloc(size);
+	if (path != NULL)
+		snprintf(path, size, "%s/%016llx%s", cache->dir,
+			 (unsigned long long)hash, suffix);
+
+	return path;
+}
+
+int dfa_cache_open(struct dfa_cache *cache, const char *dir)
+{
+	cache->dir = strdup(dir);
+	if (cache->dir == NULL)
+		return -1;
+
+	if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+		perror(dir);
+		dfa_cache_free(cache);
+		return -1;
+	}
+
+	return 0;
+}
+
+void dfa_cache_free(struct dfa_cache *cache)
+{
+	free(cache->dir);
+	cache->dir = NULL;
+}
+
+int dfa_cache_get(const struct dfa_cache *cache, const char *regexp,
+		  const char *options, struct dfa *dfa)
+{
+	struct dfa_bundle bundle;
+	char *key, *path = NULL;
+	size_t len;
+	int ret = -1;
+
+	key = dfa_cache_key(regexp, options, &len);
+	if (key != NULL)
+		path = dfa_cache_path(cache, key, len, ".bndl");
+
+	/* quiet miss, dfa_bundle_open() complains about missing files */
+	if (path != NULL && access(path, R_OK) == 0 &&
+	    dfa_bundle_open(&bundle, path) == 0) {
+		if (bundle.meta_size == len &&
+		    memcmp(bundle.meta, key, len) == 0)
+			ret = dfa_bundle_map(&bundle, DFA_CACHE_ITEM, dfa);
+		dfa_bundle_free(&bundle);
+	}
+
+	free(path);
+	free(key);
+
+	return ret;
+}
+
+int dfa_cache_put(const struct dfa_cache *cache, const char *regexp,
+		  const char *options, const struct dfa *dfa)
+{
+	struct dfa_bundle bundle;
+	char *key, *path = NULL, *tmp = NULL, suffix[32];
+	size_t len;
+	int ret = -1;
+
+	snprintf(suffix, sizeof(suffix), ".tmp%ld", (long)getpid());
+
+	key = dfa_cache_key(regexp, options, &len);
+	if (key != NULL) {
+		path = dfa_cache_path(cache, key, len, ".bndl");
+		tmp = dfa_cache_path(cache, key, len, suffix);
+	}
+
+	if (path != NULL && tmp != NULL &&
+	    dfa_bundle_create(&bundle, tmp, key, len) == 0) {
+		if (dfa_bundle_add(&bundle, DFA_CACHE_ITEM, dfa) != 0)
+			dfa_bundle_free(&bundle);
+		else if (dfa_bundle_finish(&bundle) == 0)
+			ret = rename(tmp, path);
+
+		if (ret != 0)
+			unlink(tmp);
+	}
+
+	free(tmp);
+	free(path);
+	free(key);
+
+	return ret;
+}
+
+int dfa_cache_compile(const struct dfa_cache *cache, const char *regexp,
+		      bool minimize, struct dfa *dfa)
+{
+	const char *options = minimize ? "minimize" : "";
+	struct regexp_tree *re_tree;
+	struct nfa nfa;
+	int ret;
+
+	if (dfa_cache_get(cache, regexp, options, dfa) == 0)
+		return 0;
+
+	re_tree = regexp_to_tree(regexp, NULL);
+	if (re_tree == NULL)
+		return -1;
+
+	nfa_alloc(&nfa);
+	ret = convert_tree_to_lambdanfa(&nfa, re_tree);
+	regexp_tree_free(re_tree);
+	if (ret == 0)
+		ret = nfa_rebuild(&nfa);
+
+	dfa_alloc(dfa);
+	if (ret == 0)
+		ret = convert_nfa_to_dfa(dfa, &nfa);
+	nfa_free(&nfa);
+
+	if (ret == 0 && minimize)
+		ret = dfa_minimize(dfa);
+
+	if (ret != 0) {
+		dfa_free(dfa);
+		return -1;
+	}
+
+	/* the failure to cache does not break the compilation */
+	dfa_cache_put(cache, regexp, options, dfa);
+
+	return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * On-disk cache of compiled patterns.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup dfa_cache dfa_cache
+ * @{
+ */
+
+#ifndef REFA_DFA_CACHE_H
+#define REFA_DFA_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "dfa.h"
+
+/**
+ * structure that represents the directory with compiled patterns
+ *
+ * Every entry is a bundle (see dfa_bundle.h) with one mappable DFA,
+ * its name is the hash of the key: the normalized pattern, the options
+ * of the compilation and the version of the library. The key itself is
+ * the bundle's metadata, so the collisions of the hashes are detected
+ * and look like misses. Entries are written to the temporary files and
+ * renamed, so many processes may share the cache.
+ */
+struct dfa_cache {
+	/**
+	 * path to the directory
+	 */
+	char *dir;
+};
+
+/**
+ * Open the cache.
+ *
+ * @param cache		pointer to the dfa_cache structure
+ * @param dir		path to the directory, it is created if missing
+ * @return		0 on success
+ */
+int dfa_cache_open(struct dfa_cache *cache, const char *dir);
+
+/**
+ * Free the cache structure.
+ *
+ * @param cache		pointer to the dfa_cache structure
+ */
+void dfa_cache_free(struct dfa_cache *cache);
+
+/**
+ * Get DFA of the pattern from the cache.
+ *
+ * The DFA is mapped from the entry (see dfa_map_file()).
+ *
+ * @param cache		pointer to the dfa_cache structure
+ * @param regexp	the pattern
+ * @param options	options the DFA was compiled with
+ * @param dfa		pointer to the dfa structure
+ * @return		0 on success, -1 if there is no such entry
+ */
+int dfa_cache_get(const struct dfa_cache *cache, const char *regexp,
+		  const char *options, struct dfa *dfa);
+
+/**
+ * Put DFA of the pattern into the cache.
+ *
+ * @param cache		pointer to the dfa_cache structure
+ * @param regexp	the pattern
+ * @param options	options the DFA was compiled with
+ * @param dfa		pointer to the dfa structure
+ * @return		0 on success
+ */
+int dfa_cache_put(const struct dfa_cache *cache, const char *regexp,
+		  const char *options, const struct dfa *dfa);
+
+/**
+ * Compile the pattern using the cache.
+ *
+ * Gets the DFA from the cache or builds it (regexp_to_tree(),
+ * nfa_rebuild(), convert_nfa_to_dfa() and dfa_minimize() if requested)
+ * and puts it into the cache.
+ *
+ * @param cache		pointer to the dfa_cache structure
+ * @param regexp	the pattern
+ * @param minimize	minimize the DFA
+ * @param dfa		pointer to the dfa structure
+ * @return		0 on success, -1 if the pattern can not be compiled
+ */
+int dfa_cache_compile(const struct dfa_cache *cache, const char *regexp,
+		      bool minimize, struct dfa *dfa);
+
+#endif /** REFA_DFA_CACHE_H @} */
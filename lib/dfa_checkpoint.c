@@ -0,0 +1,255 @@
+/*
+ * Checkpoints of the long-running DFA constructions.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "dfa_checkpoint.h"
+#include "endian_inner.h"
+
+/**
+ * @brief Size of the checkpoint's header.
+ */
+#define DFA_CHECKPOINT_HEADER_SIZE	(64)
+
+int dfa_checkpoint_open(struct dfa_checkpoint *cp, const char *path,
+			size_t interval)
+{
+	cp->interval = interval;
+	cp->limit = 0;
+	cp->save_cnt = 0;
+	cp->file = NULL;
+	cp->writing = false;
+	cp->data_cnt = 0;
+
+	cp->path = strdup(path);
+	cp->tmp = malloc(strlen(path) + sizeof(".tmp"));
+	if (cp->path == NULL || cp->tmp == NULL) {
+		dfa_checkpoint_free(cp);
+		return -1;
+	}
+	sprintf(cp->tmp, "%s.tmp", path);
+
+	return 0;
+}
+
+void dfa_checkpoint_free(struct dfa_checkpoint *cp)
+{
+	dfa_checkpoint_close(cp);
+
+	free(cp->path);
+	free(cp->tmp);
+	cp->path = NULL;
+	cp->tmp = NULL;
+}
+
+int dfa_checkpoint_remove(struct dfa_checkpoint *cp)
+{
+	if (unlink(cp->path) != 0 && errno != ENOENT)
+		return -1;
+
+	return 0;
+}
+
+uint64_t dfa_checkpoint_tag(uint64_t tag, uint64_t val)
+{
+	if (tag == 0)
+		tag = 0xcbf29ce484222325ULL;
+
+	for (int i = 0; i < 8; i++) {
+		tag ^= (val >> (8 * i)) & 0xFF;
+		tag *= 0x100000001b3ULL;
+	}
+
+	return tag;
+}
+
+int dfa_checkpoint_begin(struct dfa_checkpoint *cp, uint64_t kind,
+			 uint64_t tag, uint64_t done)
+{
+	unsigned char header[DFA_CHECKPOINT_HEADER_SIZE];
+
+	dfa_checkpoint_close(cp);
+
+	cp->file = fopen(cp->tmp, "w");
+	if (cp->file == NULL) {
+		perror(cp->tmp);
+		return -1;
+	}
+	cp->writing = true;
+	cp->data_cnt = 0;
+
+	/* the rest of the header is written by dfa_checkpoint_commit() */
+	memset(header, 0x00, sizeof(header));
+	put_le64(header + 16, kind);
+	put_le64(header + 24, tag);
+	put_le64(header + 32, done);
+
+	if (fwrite(header, sizeof(header), 1, cp->file) != 1) {
+		dfa_checkpoint_close(cp);
+		return -1;
+	}
+
+	return 0;
+}
+
+int dfa_checkpoint_put(struct dfa_checkpoint *cp, uint64_t val)
+{
+	unsigned char buf[8];
+
+	if (cp->file == NULL || !cp->writing)
+		return -1;
+
+	put_le64(buf, val);
+	if (fwrite(buf, sizeof(buf), 1, cp->file) != 1)
+		return -1;
+	cp->data_cnt++;
+
+	return 0;
+}
+
+int dfa_checkpoint_commit(struct dfa_checkpoint *cp, const struct dfa *dfa)
+{
+	static const unsigned char zero[64];
+	unsigned char buf[8];
+	uint64_t pos, dfa_offset;
+	long end = 0;
+	bool failure;
+
+	if (cp->file == NULL || !cp->writing)
+		return -1;
+
+	pos = DFA_CHECKPOINT_HEADER_SIZE + cp->data_cnt * 8;
+	dfa_offset = _ALIGN_TO(pos, DFA_MAP_ALIGN);
+
+	failure = false;
+	for (; pos < dfa_offset && !failure; pos += sizeof(zero)) {
+		size_t len = dfa_offset - pos < sizeof(zero) ?
+			     dfa_offset - pos : sizeof(zero);
+
+		failure = fwrite(zero, 1, len, cp->file) != len;
+	}
+
+	failure = failure || dfa_save_map(dfa, cp->file) != 0 ||
+		  (end = ftell(cp->file)) < 0;
+
+	if (!failure) {
+		failure = fseek(cp->file, 0, SEEK_SET) != 0 ||
+			  fwrite("\x57""DFAchkp""ver#\x00\x01\x00\x00", 16, 1,
+				 cp->file) != 1 ||
+			  fseek(cp->file, 40, SEEK_SET) != 0;
+
+		put_le64(buf, cp->data_cnt);
+		failure = failure || fwrite(buf, 8, 1, cp->file) != 1;
+		put_le64(buf, dfa_offset);
+		failure = failure || fwrite(buf, 8, 1, cp->file) != 1;
+		put_le64(buf, end - dfa_offset);
+		failure = failure || fwrite(buf, 8, 1, cp->file) != 1;
+	}
+
+	/* the checkpoint replaces the previous one only when it is on disk */
+	failure = failure || fflush(cp->file) != 0 ||
+		  fsync(fileno(cp->file)) != 0;
+	failure = fclose(cp->file) != 0 || failure;
+	cp->file = NULL;
+	cp->writing = false;
+
+	failure = failure || rename(cp->tmp, cp->path) != 0;
+	if (failure) {
+		unlink(cp->tmp);
+		return -1;
+	}
+
+	cp->save_cnt++;
+
+	return 0;
+}
+
+int dfa_checkpoint_resume(struct dfa_checkpoint *cp, uint64_t kind,
+			  uint64_t tag, uint64_t *done, struct dfa *dfa)
+{
+	unsigned char header[DFA_CHECKPOINT_HEADER_SIZE];
+	uint64_t data_cnt, dfa_offset, dfa_size;
+	struct stat st;
+	bool failure;
+
+	dfa_checkpoint_close(cp);
+
+	cp->file = fopen(cp->path, "r");
+	if (cp->file == NULL) {
+		if (errno == ENOENT)
+			return 1;
+		perror(cp->path);
+		return -1;
+	}
+
+	failure = fstat(fileno(cp->file), &st) != 0 ||
+		  fread(header, sizeof(header), 1, cp->file) != 1 ||
+		  memcmp(header, "\x57""DFAchkp", 8) != 0 ||
+		  memcmp(header + 8, "ver#\x00\x01\x00\x00", 8) != 0 ||
+		  get_le64(header + 16) != kind ||
+		  get_le64(header + 24) != tag;
+
+	if (!failure) {
+		*done = get_le64(header + 32);
+		data_cnt = get_le64(header + 40);
+		dfa_offset = get_le64(header + 48);
+		dfa_size = get_le64(header + 56);
+
+		failure = dfa_offset < DFA_CHECKPOINT_HEADER_SIZE ||
+			  data_cnt > (dfa_offset - DFA_CHECKPOINT_HEADER_SIZE) / 8 ||
+			  dfa_offset > (uint64_t)st.st_size ||
+			  dfa_size > (uint64_t)st.st_size - dfa_offset ||
+			  dfa_load_map_fd(dfa, fileno(cp->file), dfa_offset,
+					  dfa_size) != 0;
+	}
+
+	if (failure) {
+		fprintf(stderr, "%s: bad checkpoint\n", cp->path);
+		dfa_checkpoint_close(cp);
+		return -1;
+	}
+
+	cp->data_cnt = data_cnt;
+
+	return 0;
+}
+
+int dfa_checkpoint_get(struct dfa_checkpoint *cp, uint64_t *val)
+{
+	unsigned char buf[8];
+
+	if (cp->file == NULL || cp->writing || cp->data_cnt == 0 ||
+	    fread(buf, sizeof(buf), 1, cp->file) != 1)
+		return -1;
+
+	*val = get_le64(buf);
+	cp->data_cnt--;
+
+	return 0;
+}
+
+void dfa_checkpoint_close(struct dfa_checkpoint *cp)
+{
+	if (cp->file == NULL)
+		return;
+
+	fclose(cp->file);
+	if (cp->writing)
+		unlink(cp->tmp);
+
+	cp->file = NULL;
+	cp->writing = false;
+	cp->data_cnt = 0;
+}
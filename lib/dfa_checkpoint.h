@@ -0,0 +1,193 @@
+/*
+ * Checkpoints of the long-running DFA constructions.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup dfa_checkpoint dfa_checkpoint
+ * @{
+ */
+
+#ifndef REFA_DFA_CHECKPOINT_H
+#define REFA_DFA_CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "dfa.h"
+
+/**
+ * kind of the checkpoint made by convert_nfa_to_dfa_checkpoint()
+ */
+#define DFA_CHECKPOINT_NFA_TO_DFA	(1)
+
+/**
+ * kind of the checkpoint made by dfa_join_checkpoint()
+ */
+#define DFA_CHECKPOINT_JOIN		(2)
+
+/**
+ * structure that represents the checkpoint file of the construction
+ *
+ * The construction that gets the checkpoint saves its state every
+ * interval processed states: the DFA built so far and the construction's
+ * own data (the table of the found states). The file is replaced
+ * atomically, so the crash leaves the previous checkpoint intact.
+ * The next run with the same checkpoint and the same sources resumes
+ * from the saved state and builds the same DFA.
+ */
+struct dfa_checkpoint {
+	/**
+	 * path to the checkpoint file
+	 */
+	char *path;
+
+	/**
+	 * path to the file being written
+	 */
+	char *tmp;
+
+	/**
+	 * number of the processed states between the checkpoints,
+	 * 0 disables the periodic checkpoints
+	 */
+	size_t interval;
+
+	/**
+	 * number of the states processed by one call, then the checkpoint
+	 * is saved and the construction stops, 0 is unlimited
+	 */
+	size_t limit;
+
+	/**
+	 * number of the checkpoints saved
+	 */
+	size_t save_cnt;
+
+	/**
+	 * file being written or read, NULL otherwise
+	 */
+	FILE *file;
+
+	/**
+	 * the file is being written
+	 */
+	bool writing;
+
+	/**
+	 * number of the data words written or left to read
+	 */
+	uint64_t data_cnt;
+};
+
+/**
+ * Initialize the checkpoint.
+ *
+ * The file is not touched until the construction starts.
+ *
+ * @param cp		pointer to the dfa_checkpoint structure
+ * @param path		path to the checkpoint file
+ * @param interval	number of the processed states between
+ *			the checkpoints, 0 disables them
+ * @return		0 on success
+ */
+int dfa_checkpoint_open(struct dfa_checkpoint *cp, const char *path,
+			size_t interval);
+
+/**
+ * Free the checkpoint structure, the file is kept.
+ *
+ * @param cp	pointer to the dfa_checkpoint structure
+ */
+void dfa_checkpoint_free(struct dfa_checkpoint *cp);
+
+/**
+ * Remove the checkpoint file.
+ *
+ * @param cp	pointer to the dfa_checkpoint structure
+ * @return	0 on success or if there is no file
+ */
+int dfa_checkpoint_remove(struct dfa_checkpoint *cp);
+
+/**
+ * Mix the value into the tag of the sources.
+ *
+ * The tag is stored in the checkpoint and compared on resume, so
+ * the checkpoint of the other sources is not used by mistake.
+ *
+ * @param tag	tag of the previous values, 0 for the first one
+ * @param val	the value
+ * @return	the new tag
+ */
+uint64_t dfa_checkpoint_tag(uint64_t tag, uint64_t val);
+
+/**
+ * Start writing the checkpoint.
+ *
+ * @param cp	pointer to the dfa_checkpoint structure
+ * @param kind	kind of the construction
+ * @param tag	tag of the sources
+ * @param done	number of the processed states
+ * @return	0 on success
+ */
+int dfa_checkpoint_begin(struct dfa_checkpoint *cp, uint64_t kind,
+			 uint64_t tag, uint64_t done);
+
+/**
+ * Write one word of the construction's data.
+ *
+ * @param cp	pointer to the dfa_checkpoint structure
+ * @param val	the word
+ * @return	0 on success
+ */
+int dfa_checkpoint_put(struct dfa_checkpoint *cp, uint64_t val);
+
+/**
+ * Finish writing the checkpoint and replace the previous one.
+ *
+ * The file is closed even on failure.
+ *
+ * @param cp	pointer to the dfa_checkpoint structure
+ * @param dfa	the DFA built so far
+ * @return	0 on success
+ */
+int dfa_checkpoint_commit(struct dfa_checkpoint *cp, const struct dfa *dfa);
+
+/**
+ * Open the saved checkpoint.
+ *
+ * The construction's data is read by dfa_checkpoint_get(), then
+ * the file is closed by dfa_checkpoint_close().
+ *
+ * @param cp	pointer to the dfa_checkpoint structure
+ * @param kind	kind of the construction
+ * @param tag	tag of the sources
+ * @param done	place for the number of the processed states
+ * @param dfa	place for the DFA built so far
+ * @return	0 on success, 1 if there is no checkpoint,
+ *		-1 if the checkpoint is corrupted or made by the other
+ *		construction
+ */
+int dfa_checkpoint_resume(struct dfa_checkpoint *cp, uint64_t kind,
+			  uint64_t tag, uint64_t *done, struct dfa *dfa);
+
+/**
+ * Read one word of the construction's data.
+ *
+ * @param cp	pointer to the dfa_checkpoint structure
+ * @param val	place for the word
+ * @return	0 on success, -1 if there is no more data
+ */
+int dfa_checkpoint_get(struct dfa_checkpoint *cp, uint64_t *val);
+
+/**
+ * Close the file being read or drop the file being written.
+ *
+ * @param cp	pointer to the dfa_checkpoint structure
+ */
+void dfa_checkpoint_close(struct dfa_checkpoint *cp);
+
+#endif /** REFA_DFA_CHECKPOINT_H @} */
@@ -0,0 +1,939 @@
+/*
+ * External-memory construction of DFA.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include "dfa_extern.h"
+#include "endian_inner.h"
+
+/**
+ * @brief Largest number of runs, the run i holds at least 2^i keys.
+ */
+#define DFA_EXTERN_RUN_MAX	(64)
+
+/**
+ * @brief Transition of the batch to the known state.
+ */
+#define DFA_EXTERN_INDEX	((size_t)1 << (sizeof(size_t) * 8 - 1))
+
+/**
+ * @brief Index of the candidate that is not resolved yet.
+ */
+#define DFA_EXTERN_UNKNOWN	((size_t)-1)
+
+/**
+ * @brief Key of the successor of the batch.
+ */
+struct dfa_extern_cand {
+	/**
+	 * @brief Key, valid while the batch is resolved.
+	 */
+	const size_t *key;
+
+	/**
+	 * @brief Offset of the key in the batch's words.
+	 */
+	size_t off;
+
+	/**
+	 * @brief Size of the key.
+	 */
+	size_t len;
+
+	/**
+	 * @brief Index of the state or DFA_EXTERN_UNKNOWN.
+	 */
+	size_t index;
+
+	/**
+	 * @brief The first candidate with the same key.
+	 */
+	size_t rep;
+
+	/**
+	 * @brief The state is final.
+	 */
+	bool final;
+};
+
+/**
+ * @brief Construction in progress.
+ */
+struct dfa_extern_work {
+	/**
+	 * @brief Bits per state of the transitions.
+	 */
+	int bps;
+
+	/**
+	 * @brief Size of the transitions of one state.
+	 */
+	size_t state_size;
+
+	/**
+	 * @brief Maximum number of states.
+	 */
+	size_t state_max_cnt;
+
+	/**
+	 * @brief Calculate the deadend flags.
+	 */
+	bool deadend;
+
+	/**
+	 * @brief Image of the DFA, the transitions start at DFA_MAP_ALIGN.
+	 */
+	FILE *out;
+
+	/**
+	 * @brief Path to the image given by the caller, NULL for
+	 * the temporary file.
+	 */
+	char *path;
+
+	/**
+	 * @brief Path to the image being written, it is renamed to path
+	 * when the image is complete and removed otherwise.
+	 */
+	char *tmp;
+
+	/**
+	 * @brief Keys of the unprocessed states in the order of indices.
+	 */
+	FILE *queue;
+
+	/**
+	 * @brief Offset of the next key to read from the queue.
+	 */
+	long queue_pos;
+
+	/**
+	 * @brief The queue is being appended.
+	 */
+	bool queue_writing;
+
+	/**
+	 * @brief Flags of all states.
+	 */
+	uint8_t *flags;
+
+	/**
+	 * @brief Capacity of the flags.
+	 */
+	size_t flags_malloc;
+
+	/**
+	 * @brief Number of the states.
+	 */
+	size_t state_cnt;
+
+	/**
+	 * @brief Number of the states taken for processing.
+	 */
+	size_t done;
+
+	/**
+	 * @brief Key of the current state.
+	 */
+	size_t *key;
+
+	/**
+	 * @brief Capacity of the key.
+	 */
+	size_t key_malloc;
+
+	/**
+	 * @brief Keys of the batch's candidates.
+	 */
+	size_t *words;
+
+	/**
+	 * @brief Number of the words.
+	 */
+	size_t word_cnt;
+
+	/**
+	 * @brief Capacity of the words.
+	 */
+	size_t word_malloc;
+
+	/**
+	 * @brief Candidates of the batch in the order they were found.
+	 */
+	struct dfa_extern_cand *cands;
+
+	/**
+	 * @brief Number of the candidates.
+	 */
+	size_t cand_cnt;
+
+	/**
+	 * @brief Capacity of the candidates.
+	 */
+	size_t cand_malloc;
+
+	/**
+	 * @brief Transitions of the batch: candidates or DFA_EXTERN_INDEX
+	 * with the index.
+	 */
+	size_t *refs;
+
+	/**
+	 * @brief Number of the states in the batch.
+	 */
+	size_t batch_states;
+
+	/**
+	 * @brief Capacity of the refs in states.
+	 */
+	size_t batch_malloc;
+
+	/**
+	 * @brief Sorted runs of (key, index), the last is the newest.
+	 */
+	FILE *runs[DFA_EXTERN_RUN_MAX];
+
+	/**
+	 * @brief Number of keys in the runs.
+	 */
+	size_t run_keys[DFA_EXTERN_RUN_MAX];
+
+	/**
+	 * @brief Number of the runs.
+	 */
+	size_t run_cnt;
+
+	/**
+	 * @brief Buffers of the records read from the runs.
+	 */
+	size_t *rec[2];
+
+	/**
+	 * @brief Capacities of the buffers.
+	 */
+	size_t rec_malloc[2];
+};
+
+/**
+ * @brief Grow the array to hold at least cnt elements.
+ *
+ * @param ptr		pointer to the array
+ * @param malloc_cnt	capacity of the array
+ * @param cnt		required number of the elements
+ * @param size		size of one element
+ * @return		0 on success
+ */
+static int dfa_extern_reserve(void *ptr, size_t *malloc_cnt, size_t cnt,
+			      size_t size)
+{
+	size_t new_cnt = *malloc_cnt != 0 ? *malloc_cnt : 16;
+	void *mem;
+
+	if (cnt <= *malloc_cnt)
+		return 0;
+
+	while (new_cnt < cnt)
+		new_cnt *= 2;
+
+	mem = realloc(*(void **)ptr, new_cnt * size);
+	if (mem == NULL)
+		return -1;
+
+	*(void **)ptr = mem;
+	*malloc_cnt = new_cnt;
+
+	return 0;
+}
+
+/**
+ * @brief Create the temporary file, it is removed when closed.
+ *
+ * @param dir	directory of the file
+ * @return	the file opened for reading and writing or NULL
+ */
+static FILE *dfa_extern_tmpfile(const char *dir)
+{
+	char *path;
+	FILE *file = NULL;
+	int fd;
+
+	path = malloc(strlen(dir) + sizeof("/refa-XXXXXX"));
+	if (path == NULL)
+		return NULL;
+	sprintf(path, "%s/refa-XXXXXX", dir);
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror(path);
+	} else {
+		unlink(path);
+		file = fdopen(fd, "w+");
+		if (file == NULL)
+			close(fd);
+	}
+
+	free(path);
+
+	return file;
+}
+
+/**
+ * @brief Compare two keys.
+ *
+ * @return	negative, 0 or positive if the first key is less, equal
+ *		or greater than the second one
+ */
+static int dfa_extern_cmp(const size_t *a, size_t a_len,
+			  const size_t *b, size_t b_len)
+{
+	size_t len = a_len < b_len ? a_len : b_len;
+
+	for (size_t i = 0; i < len; i++)
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+
+	return a_len < b_len ? -1 : a_len > b_len;
+}
+
+/**
+ * @brief Compare candidates by keys, the equal ones in the order they
+ * were found.
+ */
+static int dfa_extern_cand_cmp(const void *a, const void *b)
+{
+	const struct dfa_extern_cand *c1 = *(struct dfa_extern_cand * const *)a;
+	const struct dfa_extern_cand *c2 = *(struct dfa_extern_cand * const *)b;
+	int cmp;
+
+	cmp = dfa_extern_cmp(c1->key, c1->len, c2->key, c2->len);
+	if (cmp != 0)
+		return cmp;
+
+	return c1 < c2 ? -1 : c1 > c2;
+}
+
+/**
+ * @brief Compare candidates by the order they were found.
+ */
+static int dfa_extern_cand_order(const void *a, const void *b)
+{
+	const struct dfa_extern_cand *c1 = *(struct dfa_extern_cand * const *)a;
+	const struct dfa_extern_cand *c2 = *(struct dfa_extern_cand * const *)b;
+
+	return c1 < c2 ? -1 : c1 > c2;
+}
+
+/**
+ * @brief Write the record: the size of the key, the key and the index.
+ *
+ * @param file	the file
+ * @param key	the key
+ * @param len	size of the key
+ * @param index	index of the state, omitted if DFA_EXTERN_UNKNOWN
+ * @return	0 on success
+ */
+static int dfa_extern_write(FILE *file, const size_t *key, size_t len,
+			    size_t index)
+{
+	return fwrite(&len, sizeof(len), 1, file) != 1 ||
+	       fwrite(key, sizeof(size_t), len, file) != len ||
+	       (index != DFA_EXTERN_UNKNOWN &&
+		fwrite(&index, sizeof(index), 1, file) != 1) ? -1 : 0;
+}
+
+/**
+ * @brief Read the record written by dfa_extern_write().
+ *
+ * @param file		the file
+ * @param buf		buffer for the key followed by the index
+ * @param malloc_cnt	capacity of the buffer
+ * @param len		place for the size of the key
+ * @param index		read the index
+ * @return		0 on success, 1 at the end of the file, -1 on failure
+ */
+static int dfa_extern_read(FILE *file, size_t **buf, size_t *malloc_cnt,
+			   size_t *len, bool index)
+{
+	if (fread(len, sizeof(*len), 1, file) != 1)
+		return feof(file) ? 1 : -1;
+
+	if (dfa_extern_reserve(buf, malloc_cnt, *len + 1, sizeof(size_t)) != 0 ||
+	    fread(*buf, sizeof(size_t), *len + index, file) != *len + index)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * @brief Append the key of the new state to the queue.
+ *
+ * @param work	the construction
+ * @param key	the key
+ * @param len	size of the key
+ * @return	0 on success
+ */
+static int dfa_extern_push(struct dfa_extern_work *work, const size_t *key,
+			   size_t len)
+{
+	if (!work->queue_writing) {
+		work->queue_pos = ftell(work->queue);
+		if (work->queue_pos < 0 || fseek(work->queue, 0, SEEK_END) != 0)
+			return -1;
+		work->queue_writing = true;
+	}
+
+	return dfa_extern_write(work->queue, key, len, DFA_EXTERN_UNKNOWN);
+}
+
+/**
+ * @brief Add the new state.
+ *
+ * @param work	the construction
+ * @param key	key of the state
+ * @param len	size of the key
+ * @param final	the state is final
+ * @return	0 on success
+ */
+static int dfa_extern_add_state(struct dfa_extern_work *work,
+				const size_t *key, size_t len, bool final)
+{
+	if (work->state_cnt >= work->state_max_cnt ||
+	    dfa_extern_reserve(&work->flags, &work->flags_malloc,
+			       work->state_cnt + 1, sizeof(uint8_t)) != 0 ||
+	    dfa_extern_push(work, key, len) != 0)
+		return -1;
+
+	work->flags[work->state_cnt++] = final ? DFA_FLAG_FINAL : 0x00;
+
+	return 0;
+}
+
+/**
+ * @brief Merge two newest runs.
+ *
+ * @param ext	pointer to the dfa_extern structure
+ * @return	0 on success
+ */
+static int dfa_extern_merge(struct dfa_extern *ext)
+{
+	struct dfa_extern_work *work = ext->work;
+	FILE *src[2], *dst;
+	size_t len[2];
+	int ret[2];
+	bool failure;
+
+	src[0] = work->runs[work->run_cnt - 2];
+	src[1] = work->runs[work->run_cnt - 1];
+
+	dst = dfa_extern_tmpfile(ext->dir);
+	if (dst == NULL)
+		return -1;
+
+	failure = fseek(src[0], 0, SEEK_SET) != 0 ||
+		  fseek(src[1], 0, SEEK_SET) != 0;
+
+	for (int i = 0; i < 2 && !failure; i++) {
+		ret[i] = dfa_extern_read(src[i], &work->rec[i],
+					 &work->rec_malloc[i], &len[i], true);
+		failure = ret[i] < 0;
+	}
+
+	/* the runs have no common keys */
+	while (!failure && (ret[0] == 0 || ret[1] == 0)) {
+		int i;
+
+		if (ret[0] != 0)
+			i = 1;
+		else if (ret[1] != 0)
+			i = 0;
+		else
+			i = dfa_extern_cmp(work->rec[0], len[0],
+					   work->rec[1], len[1]) > 0;
+
+		failure = dfa_extern_write(dst, work->rec[i], len[i],
+					   work->rec[i][len[i]]) != 0;
+		ret[i] = dfa_extern_read(src[i], &work->rec[i],
+					 &work->rec_malloc[i], &len[i], true);
+		failure = failure || ret[i] < 0;
+	}
+
+	if (failure) {
+		fclose(dst);
+		return -1;
+	}
+
+	fclose(src[0]);
+	fclose(src[1]);
+	work->run_cnt--;
+	work->runs[work->run_cnt - 1] = dst;
+	work->run_keys[work->run_cnt - 1] += work->run_keys[work->run_cnt];
+
+	return 0;
+}
+
+/**
+ * @brief Add the run of the new keys.
+ *
+ * @param ext	pointer to the dfa_extern structure
+ * @param cands	new candidates sorted by keys
+ * @param cnt	number of the candidates
+ * @return	0 on success
+ */
+static int dfa_extern_add_run(struct dfa_extern *ext,
+			      struct dfa_extern_cand **cands, size_t cnt)
+{
+	struct dfa_extern_work *work = ext->work;
+	FILE *run;
+	bool failure = false;
+
+	if (cnt == 0)
+		return 0;
+
+	run = dfa_extern_tmpfile(ext->dir);
+	if (run == NULL)
+		return -1;
+
+	for (size_t i = 0; i < cnt && !failure; i++)
+		failure = dfa_extern_write(run, cands[i]->key, cands[i]->len,
+					   cands[i]->index) != 0;
+
+	if (failure || work->run_cnt == DFA_EXTERN_RUN_MAX) {
+		fclose(run);
+		return -1;
+	}
+
+	work->runs[work->run_cnt] = run;
+	work->run_keys[work->run_cnt] = cnt;
+	work->run_cnt++;
+
+	/* the runs are kept decreasing in size */
+	while (!failure && work->run_cnt >= 2 &&
+	       work->run_keys[work->run_cnt - 1] >=
+	       work->run_keys[work->run_cnt - 2])
+		failure = dfa_extern_merge(ext) != 0;
+
+	if (work->run_cnt > ext->run_max)
+		ext->run_max = work->run_cnt;
+
+	return !failure ? 0 : -1;
+}
+
+/**
+ * @brief Find the keys of the candidates in the run.
+ *
+ * @param work	the construction
+ * @param run	the run
+ * @param cands	candidates with the unique keys sorted by keys
+ * @param cnt	number of the candidates
+ * @return	0 on success
+ */
+static int dfa_extern_lookup(struct dfa_extern_work *work, FILE *run,
+			     struct dfa_extern_cand **cands, size_t cnt)
+{
+	size_t pos = 0, len;
+	int ret = 0;
+
+	if (fseek(run, 0, SEEK_SET) != 0)
+		return -1;
+
+	while (pos < cnt && (ret = dfa_extern_read(run, &work->rec[0],
+						   &work->rec_malloc[0],
+						   &len, true)) == 0) {
+		int cmp = -1;
+
+		while (pos < cnt && (cmp = dfa_extern_cmp(cands[pos]->key,
+							  cands[pos]->len,
+							  work->rec[0],
+							  len)) < 0)
+			pos++;
+
+		if (pos < cnt && cmp == 0)
+			cands[pos++]->index = work->rec[0][len];
+	}
+
+	return pos == cnt || ret >= 0 ? 0 : -1;
+}
+
+/**
+ * @brief Resolve the candidates of the batch and write its transitions.
+ *
+ * @param ext	pointer to the dfa_extern structure
+ * @return	0 on success
+ */
+static int dfa_extern_resolve(struct dfa_extern *ext)
+{
+	struct dfa_extern_work *work = ext->work;
+	struct dfa_extern_cand **sorted, **fresh;
+	size_t uniq_cnt = 0, fresh_cnt = 0, first;
+	unsigned char *row;
+	bool failure = false;
+
+	sorted = malloc(sizeof(*sorted) * (work->cand_cnt + 1));
+	fresh = malloc(sizeof(*fresh) * (work->cand_cnt + 1));
+	row = malloc(work->state_size);
+	if (sorted == NULL || fresh == NULL || row == NULL) {
+		free(sorted);
+		free(fresh);
+		free(row);
+		return -1;
+	}
+
+	for (size_t i = 0; i < work->cand_cnt; i++) {
+		work->cands[i].key = work->words + work->cands[i].off;
+		sorted[i] = &work->cands[i];
+	}
+
+	qsort(sorted, work->cand_cnt, sizeof(*sorted), dfa_extern_cand_cmp);
+
+	/* the first found candidate represents the equal keys */
+	for (size_t i = 0; i < work->cand_cnt; i++) {
+		struct dfa_extern_cand *cand = sorted[i];
+
+		if (uniq_cnt != 0 &&
+		    dfa_extern_cmp(sorted[uniq_cnt - 1]->key,
+				   sorted[uniq_cnt - 1]->len,
+				   cand->key, cand->len) == 0) {
+			cand->rep = sorted[uniq_cnt - 1] - work->cands;
+		} else {
+			cand->rep = cand - work->cands;
+			sorted[uniq_cnt++] = cand;
+		}
+	}
+
+	for (size_t i = 0; i < work->run_cnt && !failure; i++)
+		failure = dfa_extern_lookup(work, work->runs[i], sorted,
+					    uniq_cnt) != 0;
+
+	for (size_t i = 0; i < uniq_cnt; i++)
+		if (sorted[i]->index == DFA_EXTERN_UNKNOWN)
+			sorted[fresh_cnt++] = sorted[i];
+
+	/* the new states are numbered as the in-memory construction does */
+	memcpy(fresh, sorted, sizeof(*fresh) * fresh_cnt);
+	qsort(fresh, fresh_cnt, sizeof(*fresh), dfa_extern_cand_order);
+
+	for (size_t i = 0; i < fresh_cnt && !failure; i++) {
+		fresh[i]->index = work->state_cnt;
+		failure = dfa_extern_add_state(work, fresh[i]->key,
+					       fresh[i]->len,
+					       fresh[i]->final) != 0;
+	}
+
+	failure = failure || dfa_extern_add_run(ext, sorted, fresh_cnt) != 0;
+
+	first = work->done - work->batch_states;
+	for (size_t i = 0; i < work->batch_states && !failure; i++) {
+		const size_t *refs = work->refs + i * 256;
+		bool deadend = true;
+
+		for (int j = 0; j < 256; j++) {
+			size_t to = refs[j];
+
+			if (to & DFA_EXTERN_INDEX)
+				to &= ~DFA_EXTERN_INDEX;
+			else
+				to = work->cands[work->cands[to].rep].index;
+
+			put_le(row + j * (work->bps / 8), to, work->bps / 8);
+			deadend = deadend && to == first + i;
+		}
+
+		if (work->deadend && deadend)
+			work->flags[first + i] |= DFA_FLAG_DEADEND;
+
+		failure = fwrite(row, work->state_size, 1, work->out) != 1;
+	}
+
+	free(sorted);
+	free(fresh);
+	free(row);
+
+	work->word_cnt = 0;
+	work->cand_cnt = 0;
+	work->batch_states = 0;
+	ext->batch_cnt++;
+
+	return !failure ? 0 : -1;
+}
+
+int dfa_extern_open(struct dfa_extern *ext, const char *dir, size_t mem_size)
+{
+	ext->mem_size = mem_size;
+	ext->batch_cnt = 0;
+	ext->run_max = 0;
+	ext->work = NULL;
+
+	ext->dir = strdup(dir);
+
+	return ext->dir != NULL ? 0 : -1;
+}
+
+void dfa_extern_free(struct dfa_extern *ext)
+{
+	dfa_extern_abort(ext);
+
+	free(ext->dir);
+	ext->dir = NULL;
+}
+
+void dfa_extern_abort(struct dfa_extern *ext)
+{
+	struct dfa_extern_work *work = ext->work;
+
+	if (work == NULL)
+		return;
+
+	if (work->out != NULL)
+		fclose(work->out);
+	if (work->queue != NULL)
+		fclose(work->queue);
+	for (size_t i = 0; i < work->run_cnt; i++)
+		fclose(work->runs[i]);
+
+	/* the incomplete image is not left under the caller's name */
+	if (work->tmp != NULL)
+		unlink(work->tmp);
+	free(work->path);
+	free(work->tmp);
+
+	free(work->flags);
+	free(work->key);
+	free(work->words);
+	free(work->cands);
+	free(work->refs);
+	free(work->rec[0]);
+	free(work->rec[1]);
+	free(work);
+
+	ext->work = NULL;
+}
+
+int dfa_extern_begin(struct dfa_extern *ext, const struct dfa *dst,
+		     const char *filename, bool deadend, const size_t *key,
+		     size_t len, bool final)
+{
+	static const unsigned char zero[DFA_MAP_ALIGN];
+	struct dfa_extern_work *work;
+	bool failure;
+
+	dfa_extern_abort(ext);
+
+	if (dst->state_cnt != 0 || dst->map != NULL)
+		return -1;
+
+	work = calloc(1, sizeof(*work));
+	if (work == NULL)
+		return -1;
+	ext->work = work;
+	ext->batch_cnt = 0;
+	ext->run_max = 0;
+
+	work->bps = dst->bps;
+	work->state_size = dst->state_size;
+	work->state_max_cnt = dst->state_max_cnt;
+	work->deadend = deadend;
+
+	if (filename != NULL) {
+		work->path = strdup(filename);
+		work->tmp = malloc(strlen(filename) + sizeof(".tmp"));
+		if (work->path == NULL || work->tmp == NULL) {
+			dfa_extern_abort(ext);
+			return -1;
+		}
+		sprintf(work->tmp, "%s.tmp", filename);
+
+		work->out = fopen(work->tmp, "w+");
+		if (work->out == NULL)
+			perror(work->tmp);
+	} else {
+		work->out = dfa_extern_tmpfile(ext->dir);
+	}
+	work->queue = dfa_extern_tmpfile(ext->dir);
+
+	/* the header is written by dfa_extern_finish() */
+	failure = work->out == NULL || work->queue == NULL ||
+		  fwrite(zero, sizeof(zero), 1, work->out) != 1 ||
+		  dfa_extern_add_state(work, key, len, final) != 0;
+
+	if (!failure) {
+		struct dfa_extern_cand cand = {.key = key, .len = len,
+					       .index = 0};
+		struct dfa_extern_cand *cands = &cand;
+
+		failure = dfa_extern_add_run(ext, &cands, 1) != 0;
+	}
+
+	if (failure) {
+		dfa_extern_abort(ext);
+		return -1;
+	}
+
+	return 0;
+}
+
+int dfa_extern_next(struct dfa_extern *ext, const size_t **key, size_t *len,
+		    size_t *index)
+{
+	struct dfa_extern_work *work = ext->work;
+	size_t batch_size;
+
+	if (work == NULL)
+		return -1;
+
+	batch_size = work->word_cnt * sizeof(size_t) +
+		     work->cand_cnt * (sizeof(struct dfa_extern_cand) +
+				       2 * sizeof(void *)) +
+		     work->batch_states * 256 * sizeof(size_t);
+
+	/* the states found by the batch are known after it is resolved */
+	if (work->batch_states != 0 &&
+	    (work->done == work->state_cnt || batch_size >= ext->mem_size) &&
+	    dfa_extern_resolve(ext) != 0)
+		return -1;
+
+	if (work->done == work->state_cnt)
+		return 1;
+
+	if (work->queue_writing) {
+		if (fseek(work->queue, work->queue_pos, SEEK_SET) != 0)
+			return -1;
+		work->queue_writing = false;
+	}
+
+	if (dfa_extern_read(work->queue, &work->key, &work->key_malloc, len,
+			    false) != 0 ||
+	    dfa_extern_reserve(&work->refs, &work->batch_malloc,
+			       work->batch_states + 1,
+			       256 * sizeof(size_t)) != 0)
+		return -1;
+
+	for (int i = 0; i < 256; i++)
+		work->refs[work->batch_states * 256 + i] =
+			work->done | DFA_EXTERN_INDEX;
+
+	*key = work->key;
+	*index = work->done;
+	work->done++;
+	work->batch_states++;
+
+	return 0;
+}
+
+int dfa_extern_trans(struct dfa_extern *ext, unsigned char mark,
+		     const size_t *key, size_t len, bool final)
+{
+	struct dfa_extern_work *work = ext->work;
+	struct dfa_extern_cand *cand = NULL;
+
+	if (work == NULL || work->batch_states == 0)
+		return -1;
+
+	/* neighbouring marks usually lead to the same state */
+	if (work->cand_cnt != 0)
+		cand = &work->cands[work->cand_cnt - 1];
+	if (cand == NULL || cand->len != len ||
+	    memcmp(work->words + cand->off, key, len * sizeof(size_t)) != 0) {
+		if (dfa_extern_reserve(&work->words, &work->word_malloc,
+				       work->word_cnt + len,
+				       sizeof(size_t)) != 0 ||
+		    dfa_extern_reserve(&work->cands, &work->cand_malloc,
+				       work->cand_cnt + 1,
+				       sizeof(struct dfa_extern_cand)) != 0)
+			return -1;
+
+		cand = &work->cands[work->cand_cnt++];
+		cand->off = work->word_cnt;
+		cand->len = len;
+		cand->index = DFA_EXTERN_UNKNOWN;
+		cand->final = final;
+
+		memcpy(work->words + work->word_cnt, key, len * sizeof(size_t));
+		work->word_cnt += len;
+	}
+
+	work->refs[(work->batch_states - 1) * 256 + mark] = cand - work->cands;
+
+	return 0;
+}
+
+int dfa_extern_trans_index(struct dfa_extern *ext, unsigned char mark,
+			   size_t index)
+{
+	struct dfa_extern_work *work = ext->work;
+
+	if (work == NULL || work->batch_states == 0 || index >= work->state_cnt)
+		return -1;
+
+	work->refs[(work->batch_states - 1) * 256 + mark] =
+		index | DFA_EXTERN_INDEX;
+
+	return 0;
+}
+
+int dfa_extern_finish(struct dfa_extern *ext, struct dfa *dst,
+		      const char *comment, size_t comment_size)
+{
+	struct dfa_extern_work *work = ext->work;
+	uint64_t trans_off, flags_off, comment_off, end;
+	struct dfa image;
+	bool failure;
+	int fd;
+
+	if (work == NULL)
+		return -1;
+
+	failure = (work->batch_states != 0 && dfa_extern_resolve(ext) != 0) ||
+		  work->done != work->state_cnt;
+
+	trans_off = DFA_MAP_ALIGN;
+	flags_off = trans_off + (uint64_t)work->state_cnt * work->state_size;
+	comment_off = flags_off + work->state_cnt;
+	end = comment_off + comment_size;
+
+	image = *dst;
+	image.state_cnt = work->state_cnt;
+	image.first_index = 0;
+	image.comment_size = comment_size;
+	image.entry_cnt = 0;
+
+	failure = failure ||
+		  fwrite(work->flags, 1, work->state_cnt, work->out) !=
+		  work->state_cnt ||
+		  fwrite(comment, 1, comment_size, work->out) != comment_size ||
+		  fseek(work->out, 0, SEEK_SET) != 0 ||
+		  dfa_save_map_header(&image, work->out, comment_off, end, 0,
+				      flags_off, trans_off) != 0 ||
+		  fflush(work->out) != 0 ||
+		  (work->tmp != NULL && rename(work->tmp, work->path) != 0);
+
+	/* the image is complete, it is kept */
+	if (!failure) {
+		free(work->tmp);
+		work->tmp = NULL;
+	}
+
+	if (!failure) {
+		fd = fileno(work->out);
+		dfa_free(dst);
+		/* the big-endian hosts cannot map the image */
+		failure = dfa_map_fd(dst, fd, 0, end) != 0 &&
+			  dfa_load_map_fd(dst, fd, 0, end) != 0;
+		if (failure)
+			dfa_alloc(dst);
+	}
+
+	dfa_extern_abort(ext);
+
+	return !failure ? 0 : -1;
+}
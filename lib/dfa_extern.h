@@ -0,0 +1,167 @@
+/*
+ * External-memory construction of DFA.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup dfa_extern dfa_extern
+ * @{
+ */
+
+#ifndef REFA_DFA_EXTERN_H
+#define REFA_DFA_EXTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "dfa.h"
+
+struct dfa_extern_work;
+
+/**
+ * structure that represents the external-memory construction of DFA
+ *
+ * Every state of the constructed DFA has the key: the set of NFA states
+ * or the pair of states of the joined DFAs. The states are processed
+ * in the order of their indices by batches that take about mem_size
+ * bytes. The keys of the batch's successors are sorted and merged with
+ * the sorted runs of the known keys on disk, the unknown keys become
+ * the new states in the order they were found, so the DFA is the same
+ * as the one built in memory. The runs are merged as the digits of
+ * the binary counter, so there are at most log2 of them. The keys of
+ * the unprocessed states wait in the queue file and the transitions are
+ * written to the DFA's mappable image sequentially, only the batch and
+ * one byte of flags per state are kept in memory.
+ */
+struct dfa_extern {
+	/**
+	 * directory for the temporary files
+	 */
+	char *dir;
+
+	/**
+	 * memory for one batch of states in bytes
+	 */
+	size_t mem_size;
+
+	/**
+	 * number of batches of the last construction
+	 */
+	size_t batch_cnt;
+
+	/**
+	 * largest number of runs of the known keys of the last construction
+	 */
+	size_t run_max;
+
+	/**
+	 * construction in progress, NULL otherwise
+	 */
+	struct dfa_extern_work *work;
+};
+
+/**
+ * Initialize the external-memory construction.
+ *
+ * @param ext		pointer to the dfa_extern structure
+ * @param dir		directory for the temporary files
+ * @param mem_size	memory for one batch of states in bytes
+ * @return		0 on success
+ */
+int dfa_extern_open(struct dfa_extern *ext, const char *dir, size_t mem_size);
+
+/**
+ * Free the structure and drop the construction in progress.
+ *
+ * @param ext	pointer to the dfa_extern structure
+ */
+void dfa_extern_free(struct dfa_extern *ext);
+
+/**
+ * Start the construction.
+ *
+ * The initial state gets the index 0. The image is written to
+ * filename.tmp, dfa_extern_finish() renames it to filename when it is
+ * complete, so the failed construction does not leave the incomplete image
+ * under the name.
+ *
+ * @param ext		pointer to the dfa_extern structure
+ * @param dst		initialized empty DFA, defines the size of
+ *			the transitions
+ * @param filename	path to the DFA's image, NULL for the temporary
+ *			file
+ * @param deadend	calculate the deadend flags of the states
+ * @param key		key of the initial state
+ * @param len		size of the key in words
+ * @param final		the initial state is final
+ * @return		0 on success
+ */
+int dfa_extern_begin(struct dfa_extern *ext, const struct dfa *dst,
+		     const char *filename, bool deadend, const size_t *key,
+		     size_t len, bool final);
+
+/**
+ * Take the next state to process.
+ *
+ * All 256 transitions of the previous state have to be added.
+ *
+ * @param ext	pointer to the dfa_extern structure
+ * @param key	place for the key of the state, valid until the next call
+ * @param len	place for the size of the key
+ * @param index	place for the index of the state
+ * @return	0 on success, 1 if all states are processed, -1 on failure
+ */
+int dfa_extern_next(struct dfa_extern *ext, const size_t **key, size_t *len,
+		    size_t *index);
+
+/**
+ * Add the transition of the current state to the state with the key.
+ *
+ * @param ext	pointer to the dfa_extern structure
+ * @param mark	transition mark
+ * @param key	key of the target state
+ * @param len	size of the key in words
+ * @param final	the target state is final
+ * @return	0 on success
+ */
+int dfa_extern_trans(struct dfa_extern *ext, unsigned char mark,
+		     const size_t *key, size_t len, bool final);
+
+/**
+ * Add the transition of the current state to the known state.
+ *
+ * @param ext	pointer to the dfa_extern structure
+ * @param mark	transition mark
+ * @param index	index of the target state
+ * @return	0 on success
+ */
+int dfa_extern_trans_index(struct dfa_extern *ext, unsigned char mark,
+			   size_t index);
+
+/**
+ * Finish the construction and map the DFA's image.
+ *
+ * The construction is dropped on failure.
+ *
+ * @param ext		pointer to the dfa_extern structure
+ * @param dst		the DFA passed to dfa_extern_begin(), replaced
+ *			with the mapped image
+ * @param comment	comment of the DFA
+ * @param comment_size	size of the comment
+ * @return		0 on success
+ */
+int dfa_extern_finish(struct dfa_extern *ext, struct dfa *dst,
+		      const char *comment, size_t comment_size);
+
+/**
+ * Drop the construction in progress.
+ *
+ * The incomplete image is removed.
+ *
+ * @param ext	pointer to the dfa_extern structure
+ */
+void dfa_extern_abort(struct dfa_extern *ext);
+
+#endif /** REFA_DFA_EXTERN_H @} */
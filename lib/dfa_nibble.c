@@ -0,0 +1,258 @@
+/*
+ * Scanning of data with nibble-split transition tables.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfa_nibble.h"
+
+/**
+ * @brief Maximum number of states, offsets of their rows fit into 31 bits.
+ */
+#define DFA_NIBBLE_MAX_STATES	((size_t)1 << 27)
+
+/**
+ * @brief Maximum number of nodes, offsets of their rows fit into 31 bits.
+ */
+#define DFA_NIBBLE_MAX_NODES	((size_t)1 << 27)
+
+/**
+ * @brief Marker of the empty slot of the hash table.
+ */
+#define DFA_NIBBLE_EMPTY	((size_t)-1)
+
+/**
+ * @brief Distinct nodes found while the tables are built.
+ */
+struct dfa_nibble_nodes {
+	/**
+	 * @brief Hash table of nodes' indexes.
+	 */
+	size_t *slots;
+
+	/**
+	 * @brief Size of the hash table, a power of 2.
+	 */
+	size_t slot_cnt;
+
+	/**
+	 * @brief Number of nodes allocated in lo.
+	 */
+	size_t node_max;
+};
+
+/**
+ * @brief Hash of the node's transitions.
+ *
+ * @param node	16 entries of the node
+ * @return	hash value
+ */
+static size_t dfa_nibble_hash(const uint32_t *node)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (int i = 0; i < 16; i++) {
+		hash ^= node[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash ^ (hash >> 29);
+}
+
+/**
+ * @brief Double the hash table of nodes.
+ *
+ * @param dn	pointer to the dfa_nibble structure
+ * @param nodes	pointer to the distinct nodes
+ * @return	0 on success
+ */
+static int dfa_nibble_rehash(struct dfa_nibble *dn,
+			     struct dfa_nibble_nodes *nodes)
+{
+	size_t slot_cnt = nodes->slot_cnt * 2, *slots;
+
+	slots = malloc(sizeof(size_t) * slot_cnt);
+	if (slots == NULL)
+		return -1;
+	memset(slots, 0xFF, sizeof(size_t) * slot_cnt);
+
+	for (size_t i = 0; i < dn->node_cnt; i++) {
+		size_t slot = dfa_nibble_hash(&dn->lo[i * 16]) & (slot_cnt - 1);
+
+		while (slots[slot] != DFA_NIBBLE_EMPTY)
+			slot = (slot + 1) & (slot_cnt - 1);
+		slots[slot] = i;
+	}
+
+	free(nodes->slots);
+	nodes->slots = slots;
+	nodes->slot_cnt = slot_cnt;
+
+	return 0;
+}
+
+/**
+ * @brief Find the same node or add the new one.
+ *
+ * The nodes and the hash table grow geometrically, so the memory is
+ * proportional to the number of the distinct nodes.
+ *
+ * @param dn		pointer to the dfa_nibble structure
+ * @param nodes		pointer to the distinct nodes
+ * @param node		16 entries of the node
+ * @param offset	place for the offset of the node's row
+ * @return		0 on success, -1 if there are too many nodes
+ */
+static int dfa_nibble_node(struct dfa_nibble *dn,
+			   struct dfa_nibble_nodes *nodes,
+			   const uint32_t *node, uint32_t *offset)
+{
+	size_t slot_mask = nodes->slot_cnt - 1;
+	size_t slot = dfa_nibble_hash(node) & slot_mask;
+
+	for (; nodes->slots[slot] != DFA_NIBBLE_EMPTY;
+	     slot = (slot + 1) & slot_mask)
+		if (memcmp(&dn->lo[nodes->slots[slot] * 16], node,
+			   sizeof(uint32_t) * 16) == 0) {
+			*offset = nodes->slots[slot] * 16;
+			return 0;
+		}
+
+	if (dn->node_cnt == DFA_NIBBLE_MAX_NODES)
+		return -1;
+
+	if (dn->node_cnt == nodes->node_max) {
+		size_t node_max = nodes->node_max * 2;
+		uint32_t *lo;
+
+		lo = realloc(dn->lo, sizeof(uint32_t) * 16 * node_max);
+		if (lo == NULL)
+			return -1;
+		dn->lo = lo;
+		nodes->node_max = node_max;
+	}
+
+	nodes->slots[slot] = dn->node_cnt;
+	memcpy(&dn->lo[dn->node_cnt * 16], node, sizeof(uint32_t) * 16);
+	*offset = dn->node_cnt++ * 16;
+
+	/* the table is kept at most half full */
+	if (dn->node_cnt * 2 > nodes->slot_cnt)
+		return dfa_nibble_rehash(dn, nodes);
+
+	return 0;
+}
+
+int dfa_nibble_alloc(struct dfa_nibble *dn, const struct dfa *dfa)
+{
+	struct dfa_nibble_nodes nodes;
+	bool failure = false;
+	uint32_t *lo;
+
+	memset(dn, 0x00, sizeof(*dn));
+
+	if (dfa->state_cnt == 0 || dfa->state_cnt > DFA_NIBBLE_MAX_STATES)
+		return -1;
+
+	nodes.slot_cnt = 64;
+	nodes.node_max = 16;
+
+	dn->state_cnt = dfa->state_cnt;
+	dn->hi = malloc(sizeof(uint32_t) * 16 * dn->state_cnt);
+	dn->lo = malloc(sizeof(uint32_t) * 16 * nodes.node_max);
+	dn->flags = malloc(dn->state_cnt);
+	nodes.slots = malloc(sizeof(size_t) * nodes.slot_cnt);
+	if (dn->hi == NULL || dn->lo == NULL || dn->flags == NULL ||
+	    nodes.slots == NULL) {
+		free(nodes.slots);
+		dfa_nibble_free(dn);
+		return -1;
+	}
+
+	memset(nodes.slots, 0xFF, sizeof(size_t) * nodes.slot_cnt);
+
+	for (size_t i = 0; i < dn->state_cnt; i++)
+		dn->flags[i] = dfa->flags[i] &
+			       (DFA_FLAG_FINAL | DFA_FLAG_DEADEND);
+
+	for (size_t i = 0; i < dn->state_cnt && !failure; i++) {
+		for (int h = 0; h < 16 && !failure; h++) {
+			uint32_t node[16];
+
+			for (int l = 0; l < 16; l++) {
+				size_t to = dfa_get_trans(dfa, i, h << 4 | l);
+
+				node[l] = to * 16;
+				if (dn->flags[to] != 0)
+					node[l] |= DFA_NIBBLE_STOP;
+			}
+
+			failure = dfa_nibble_node(dn, &nodes, node,
+						  &dn->hi[i * 16 + h]) != 0;
+		}
+	}
+
+	free(nodes.slots);
+
+	if (failure) {
+		dfa_nibble_free(dn);
+		return -1;
+	}
+
+	/* only the distinct nodes are kept */
+	lo = realloc(dn->lo, sizeof(uint32_t) * 16 * dn->node_cnt);
+	if (lo != NULL)
+		dn->lo = lo;
+
+	dn->size = sizeof(uint32_t) * 16 * (dn->state_cnt + dn->node_cnt) +
+		   dn->state_cnt;
+
+	return 0;
+}
+
+void dfa_nibble_free(struct dfa_nibble *dn)
+{
+	free(dn->hi);
+	free(dn->lo);
+	free(dn->flags);
+	memset(dn, 0x00, sizeof(*dn));
+}
+
+size_t dfa_nibble_scan(const struct dfa_nibble *dn, size_t *state,
+		       const void *data, size_t len)
+{
+	const unsigned char *ptr = data;
+	const uint32_t *hi = dn->hi, *lo = dn->lo;
+	size_t cur = *state * 16;
+
+	if (dn->flags[*state] & DFA_FLAG_FINAL)
+		return 0;
+
+	if (dn->flags[*state] & DFA_FLAG_DEADEND)
+		return DFA_SCAN_NO_MATCH;
+
+	for (size_t i = 0; i < len; i++) {
+		uint32_t entry = lo[hi[cur + (ptr[i] >> 4)] + (ptr[i] & 0x0F)];
+
+		cur = entry & DFA_NIBBLE_ROW;
+
+		if (entry & DFA_NIBBLE_STOP) {
+			*state = cur / 16;
+
+			return (dn->flags[*state] & DFA_FLAG_FINAL) ?
+			       i + 1 : DFA_SCAN_NO_MATCH;
+		}
+	}
+
+	*state = cur / 16;
+
+	return DFA_SCAN_NO_MATCH;
+}
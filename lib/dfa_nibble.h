@@ -0,0 +1,101 @@
+/*
+ * Scanning of data with nibble-split transition tables.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup scan scan
+ * @{
+ */
+
+#ifndef REFA_DFA_NIBBLE_H
+#define REFA_DFA_NIBBLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dfa.h"
+#include "dfa_scan.h"
+
+/** the low nibble leads to a final or a deadend state */
+#define DFA_NIBBLE_STOP		(0x80000000u)
+
+/** mask of the row offset in the entry of the table */
+#define DFA_NIBBLE_ROW		(0x7FFFFFFFu)
+
+/**
+ * structure that represents DFA with rows split by nibbles
+ *
+ * The high nibble of the byte selects an intermediate node of the state,
+ * the low nibble selects the next state in the node. Nodes with the same
+ * transitions are stored once, so a sparse 256-wide row usually turns
+ * into one or two distinct 16-wide nodes.
+ */
+struct dfa_nibble {
+	/**
+	 * number of states
+	 */
+	size_t state_cnt;
+
+	/**
+	 * number of distinct intermediate nodes
+	 */
+	size_t node_cnt;
+
+	/**
+	 * offsets of the nodes' rows, indexed by state * 16 + high nibble
+	 */
+	uint32_t *hi;
+
+	/**
+	 * offsets of the next states' rows with DFA_NIBBLE_STOP, indexed by
+	 * node's offset + low nibble
+	 */
+	uint32_t *lo;
+
+	/**
+	 * flags of the states (DFA_FLAG_FINAL and DFA_FLAG_DEADEND)
+	 */
+	uint8_t *flags;
+
+	/**
+	 * memory used by the tables in bytes
+	 */
+	size_t size;
+};
+
+/**
+ * Build nibble-split tables of DFA.
+ *
+ * @param dn	pointer to the dfa_nibble structure
+ * @param dfa	pointer to the source dfa structure
+ * @return	0 on success, -1 on error or if the DFA has more than
+ *		2^27 states or distinct nodes
+ */
+int dfa_nibble_alloc(struct dfa_nibble *dn, const struct dfa *dfa);
+
+/**
+ * Free nibble-split tables.
+ *
+ * @param dn	pointer to the dfa_nibble structure
+ */
+void dfa_nibble_free(struct dfa_nibble *dn);
+
+/**
+ * Scan data with nibble-split tables.
+ *
+ * Works as dfa_scan() with the source DFA (states are the same) with
+ * two dependent loads from 16-entry rows per byte.
+ *
+ * @param dn	pointer to the dfa_nibble structure
+ * @param state	pointer to the current state, it is updated
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @return	offset just past the byte that led to an accepting state
+ *		or DFA_SCAN_NO_MATCH
+ */
+size_t dfa_nibble_scan(const struct dfa_nibble *dn, size_t *state,
+		       const void *data, size_t len);
+
+#endif /** REFA_DFA_NIBBLE_H @} */
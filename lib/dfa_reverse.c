@@ -0,0 +1,144 @@
+/*
+ * Reverse automata for the recovery of match start offsets.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfa_reverse.h"
+#include "dfa_scan.h"
+#include "literal.h"
+#include "nfa_to_dfa.h"
+#include "tree_to_nfa.h"
+
+int nfa_reverse(struct nfa *dst, const struct nfa *src)
+{
+	size_t offset, first;
+	bool failure = false;
+
+	if (src->node_cnt == 0)
+		return -1;
+
+	if (nfa_add_node_n(dst, src->node_cnt, &offset) != 0 ||
+	    nfa_add_node(dst, &first) != 0)
+		return -1;
+
+	for (size_t i = 0; i < src->node_cnt && !failure; i++) {
+		if (src->nodes[i].lambda_cnt != 0)
+			return -1;
+
+		for (int c = 0; c < 256; c++)
+			for (size_t k = 0; k < src->nodes[i].trans_cnt[c]; k++)
+				failure = failure ||
+					  nfa_add_trans(dst,
+						offset + src->nodes[i].trans[c][k],
+						c, offset + i) != 0;
+	}
+
+	/* the new initial state starts from all final states at once */
+	for (size_t i = 0; i < src->node_cnt && !failure; i++) {
+		if (!src->nodes[i].isfinal)
+			continue;
+
+		for (int c = 0; c < 256; c++) {
+			const struct nfa_node *node = &dst->nodes[offset + i];
+
+			for (size_t k = 0; k < node->trans_cnt[c]; k++)
+				failure = failure ||
+					  nfa_add_trans(dst, first, c,
+							node->trans[c][k]) != 0;
+		}
+	}
+
+	if (failure)
+		return -1;
+
+	dst->first_index = first;
+	dst->nodes[offset + src->first_index].isfinal = true;
+	dst->nodes[first].isfinal = src->nodes[src->first_index].isfinal;
+
+	return nfa_rebuild(dst);
+}
+
+int dfa_reverse(struct dfa *dst, const struct regexp_tree *re_tree)
+{
+	const struct regexp_node *core;
+	struct nfa nfa, rev;
+	bool floating, nullable = false;
+	bool failure = false;
+
+	core = regexp_tree_core(re_tree, &floating);
+
+	nfa_alloc(&nfa);
+	nfa_alloc(&rev);
+
+	failure = convert_node_to_lambdanfa(&nfa, core) != 0 ||
+		  nfa_rebuild(&nfa) != 0 || nfa_reverse(&rev, &nfa) != 0;
+
+	if (!failure) {
+		nullable = rev.nodes[rev.first_index].isfinal;
+		failure = convert_nfa_to_dfa(dst, &rev) != 0;
+	}
+
+	/* the initial state of the converted DFA is never final */
+	if (!failure && nullable)
+		dfa_state_set_final(dst, dst->first_index, 1);
+
+	failure = failure || dfa_minimize(dst) != 0 || dfa_compress(dst) != 0;
+
+	if (!failure && re_tree->comment_size != 0) {
+		char *comment = realloc(dst->comment, re_tree->comment_size);
+
+		failure = comment == NULL;
+		if (!failure) {
+			memcpy(comment, re_tree->comment, re_tree->comment_size);
+			dst->comment = comment;
+			dst->comment_size = re_tree->comment_size;
+		}
+	}
+
+	nfa_free(&rev);
+	nfa_free(&nfa);
+
+	return !failure ? 0 : -1;
+}
+
+size_t dfa_reverse_scan(const struct dfa *rev, const void *data, size_t end)
+{
+	const unsigned char *ptr = data;
+	size_t state = rev->first_index;
+	size_t start = DFA_SCAN_NO_MATCH;
+
+	if (rev->flags[state] & DFA_FLAG_FINAL)
+		start = end;
+
+	for (size_t i = end; i > 0; i--) {
+		if (rev->flags[state] & DFA_FLAG_DEADEND)
+			break;
+
+		state = dfa_get_trans(rev, state, ptr[i - 1]);
+		if (rev->flags[state] & DFA_FLAG_FINAL)
+			start = i - 1;
+	}
+
+	return start;
+}
+
+size_t dfa_scan_span(const struct dfa *fwd, const struct dfa *rev,
+		     const void *data, size_t len, size_t *start)
+{
+	size_t state = fwd->first_index;
+	size_t end;
+
+	end = dfa_scan(fwd, &state, data, len);
+	*start = end != DFA_SCAN_NO_MATCH ?
+		 dfa_reverse_scan(rev, data, end) : DFA_SCAN_NO_MATCH;
+
+	return end;
+}
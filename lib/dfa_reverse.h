@@ -0,0 +1,77 @@
+/*
+ * Reverse automata for the recovery of match start offsets.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup conversion conversion
+ * @{
+ */
+
+#ifndef REFA_DFA_REVERSE_H
+#define REFA_DFA_REVERSE_H
+
+#include <stddef.h>
+
+#include "dfa.h"
+#include "nfa.h"
+#include "parser.h"
+
+/**
+ * Reverse NFA.
+ *
+ * Builds NFA that accepts the reversed strings of the source NFA.
+ * The source NFA must not have lambda-transitions (see nfa_rebuild()).
+ *
+ * @param dst	pointer to the existing and initialized empty NFA
+ * @param src	pointer to the source lambda-free NFA
+ * @return	0 on success
+ */
+int nfa_reverse(struct nfa *dst, const struct nfa *src);
+
+/**
+ * Build reverse DFA of regexp tree.
+ *
+ * The result accepts the reversed matches of the regular expression
+ * without the '.*' around unanchored expressions, it is meant to be run
+ * backwards from the end of a match with dfa_reverse_scan().
+ *
+ * @param dst		pointer to the existing and initialized empty DFA
+ * @param re_tree	pointer to the source regexp tree
+ * @return		0 on success
+ */
+int dfa_reverse(struct dfa *dst, const struct regexp_tree *re_tree);
+
+/**
+ * Find start of the match.
+ *
+ * Runs reverse DFA backwards from the end of the match and returns
+ * the leftmost offset where a match that ends at the end starts.
+ *
+ * @param rev	pointer to the reverse DFA (see dfa_reverse())
+ * @param data	scanned data
+ * @param end	offset just past the last byte of the match
+ * @return	offset of the first byte of the match
+ *		or DFA_SCAN_NO_MATCH if no match ends at the end
+ */
+size_t dfa_reverse_scan(const struct dfa *rev, const void *data, size_t end);
+
+/**
+ * Find span of the first match.
+ *
+ * Finds the end of the first match as dfa_scan() with the forward DFA
+ * and its leftmost start with the reverse DFA of the same regexp.
+ *
+ * @param fwd	pointer to the forward DFA
+ * @param rev	pointer to the reverse DFA
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @param start	place for the offset of the first byte of the match
+ * @return	offset just past the last byte of the match
+ *		or DFA_SCAN_NO_MATCH
+ */
+size_t dfa_scan_span(const struct dfa *fwd, const struct dfa *rev,
+		     const void *data, size_t len, size_t *start);
+
+#endif /** REFA_DFA_REVERSE_H @} */
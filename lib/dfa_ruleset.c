@@ -0,0 +1,277 @@
+/*
+ * Set of patterns joined into one DFA with incremental updates.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfa_ruleset.h"
+
+/**
+ * @brief Kinds of the nodes' DFAs.
+ */
+enum dfa_ruleset_kind {
+	/**
+	 * @brief Node matches nothing.
+	 */
+	DFA_RULESET_EMPTY = 0,
+
+	/**
+	 * @brief Node holds its own DFA.
+	 */
+	DFA_RULESET_OWN = 1,
+
+	/**
+	 * @brief Node's DFA is the DFA of the left child.
+	 */
+	DFA_RULESET_LEFT = 2,
+
+	/**
+	 * @brief Node's DFA is the DFA of the right child.
+	 */
+	DFA_RULESET_RIGHT = 3,
+
+	/**
+	 * @brief Leaf without a pattern.
+	 */
+	DFA_RULESET_FREE = 4
+};
+
+/**
+ * @brief Get the DFA of the node.
+ *
+ * @param rs	pointer to the dfa_ruleset structure
+ * @param node	index of the node
+ * @return	pointer to the DFA or NULL if the node matches nothing
+ */
+static const struct dfa *dfa_ruleset_node(const struct dfa_ruleset *rs,
+					  size_t node)
+{
+	for (;;) {
+		switch (rs->kind[node]) {
+		case DFA_RULESET_OWN:
+			return &rs->nodes[node];
+		case DFA_RULESET_LEFT:
+			node = 2 * node;
+			break;
+		case DFA_RULESET_RIGHT:
+			node = 2 * node + 1;
+			break;
+		default:
+			return NULL;
+		}
+	}
+}
+
+/**
+ * @brief Free the node's own DFA.
+ *
+ * @param rs	pointer to the dfa_ruleset structure
+ * @param node	index of the node
+ */
+static void dfa_ruleset_clear(struct dfa_ruleset *rs, size_t node)
+{
+	if (rs->kind[node] == DFA_RULESET_OWN)
+		dfa_free(&rs->nodes[node]);
+	rs->kind[node] = DFA_RULESET_EMPTY;
+}
+
+/**
+ * @brief Mark the path from the leaf's parent to the root.
+ *
+ * @param rs	pointer to the dfa_ruleset structure
+ * @param id	id of the leaf
+ */
+static void dfa_ruleset_mark(struct dfa_ruleset *rs, size_t id)
+{
+	/* ancestors of the marked node are already marked */
+	for (size_t node = (rs->cap + id) / 2; node >= 1 && !rs->dirty[node];
+	     node /= 2)
+		rs->dirty[node] = 1;
+}
+
+/**
+ * @brief Double the number of leaves.
+ *
+ * The old tree becomes the left subtree of the new root: the node
+ * at the level that starts at the index L moves from i to i + L.
+ *
+ * @param rs	pointer to the dfa_ruleset structure
+ * @return	0 on success
+ */
+static int dfa_ruleset_grow(struct dfa_ruleset *rs)
+{
+	size_t cap = rs->cap != 0 ? rs->cap * 2 : 1;
+	struct dfa *nodes;
+	uint8_t *kind, *dirty;
+	size_t *free_ids;
+
+	nodes = calloc(2 * cap, sizeof(struct dfa));
+	kind = calloc(2 * cap, sizeof(uint8_t));
+	dirty = calloc(2 * cap, sizeof(uint8_t));
+	free_ids = realloc(rs->free_ids, sizeof(size_t) * cap);
+	if (free_ids != NULL)
+		rs->free_ids = free_ids;
+	if (nodes == NULL || kind == NULL || dirty == NULL || free_ids == NULL) {
+		free(nodes);
+		free(kind);
+		free(dirty);
+		return -1;
+	}
+
+	for (size_t level = 1; level < rs->cap * 2; level *= 2)
+		for (size_t i = level; i < level * 2; i++) {
+			nodes[i + level] = rs->nodes[i];
+			kind[i + level] = rs->kind[i];
+			dirty[i + level] = rs->dirty[i];
+		}
+
+	/* the lowest ids are taken first */
+	for (size_t id = cap; id > rs->cap; id--) {
+		kind[cap + id - 1] = DFA_RULESET_FREE;
+		rs->free_ids[rs->free_cnt++] = id - 1;
+	}
+	dirty[1] = rs->cap != 0;
+
+	free(rs->nodes);
+	free(rs->kind);
+	free(rs->dirty);
+	rs->nodes = nodes;
+	rs->kind = kind;
+	rs->dirty = dirty;
+	rs->cap = cap;
+
+	return 0;
+}
+
+/**
+ * @brief Rebuild the inner node from its children.
+ *
+ * @param rs	pointer to the dfa_ruleset structure
+ * @param node	index of the node
+ * @return	0 on success
+ */
+static int dfa_ruleset_rebuild(struct dfa_ruleset *rs, size_t node)
+{
+	const struct dfa *left = dfa_ruleset_node(rs, 2 * node),
+			 *right = dfa_ruleset_node(rs, 2 * node + 1);
+	struct dfa *dst = &rs->nodes[node];
+
+	dfa_ruleset_clear(rs, node);
+
+	if (left == NULL || right == NULL) {
+		if (left != NULL)
+			rs->kind[node] = DFA_RULESET_LEFT;
+		else if (right != NULL)
+			rs->kind[node] = DFA_RULESET_RIGHT;
+		return 0;
+	}
+
+	dfa_alloc(dst);
+	if (dfa_join2(dst, left, right) != 0 ||
+	    (rs->minimize && dfa_minimize(dst) != 0) ||
+	    dfa_compress(dst) != 0) {
+		dfa_free(dst);
+		return -1;
+	}
+
+	rs->kind[node] = DFA_RULESET_OWN;
+	rs->join_cnt++;
+
+	return 0;
+}
+
+int dfa_ruleset_alloc(struct dfa_ruleset *rs, bool minimize)
+{
+	rs->nodes = NULL;
+	rs->kind = NULL;
+	rs->dirty = NULL;
+	rs->cap = 0;
+	rs->cnt = 0;
+	rs->free_ids = NULL;
+	rs->free_cnt = 0;
+	rs->minimize = minimize;
+	rs->join_cnt = 0;
+
+	return 0;
+}
+
+void dfa_ruleset_free(struct dfa_ruleset *rs)
+{
+	for (size_t i = 1; i < rs->cap * 2; i++)
+		dfa_ruleset_clear(rs, i);
+
+	free(rs->nodes);
+	free(rs->kind);
+	free(rs->dirty);
+	free(rs->free_ids);
+
+	dfa_ruleset_alloc(rs, rs->minimize);
+}
+
+int dfa_ruleset_add(struct dfa_ruleset *rs, struct dfa *dfa, size_t *id)
+{
+	size_t leaf;
+
+	if (rs->free_cnt == 0 && dfa_ruleset_grow(rs) != 0)
+		return -1;
+
+	leaf = rs->free_ids[--rs->free_cnt];
+	if (id != NULL)
+		*id = leaf;
+
+	rs->nodes[rs->cap + leaf] = *dfa;
+	rs->kind[rs->cap + leaf] = DFA_RULESET_OWN;
+
+	/* the DFA without states matches nothing */
+	if (dfa->state_cnt == 0)
+		dfa_ruleset_clear(rs, rs->cap + leaf);
+
+	rs->cnt++;
+	dfa_ruleset_mark(rs, leaf);
+
+	return 0;
+}
+
+int dfa_ruleset_remove(struct dfa_ruleset *rs, size_t id)
+{
+	if (id >= rs->cap || rs->kind[rs->cap + id] == DFA_RULESET_FREE)
+		return -1;
+
+	dfa_ruleset_clear(rs, rs->cap + id);
+	rs->kind[rs->cap + id] = DFA_RULESET_FREE;
+	rs->free_ids[rs->free_cnt++] = id;
+
+	rs->cnt--;
+	dfa_ruleset_mark(rs, id);
+
+	return 0;
+}
+
+int dfa_ruleset_update(struct dfa_ruleset *rs)
+{
+	/* children have greater indices, so they are rebuilt first */
+	for (size_t node = rs->cap; node-- > 1;) {
+		if (!rs->dirty[node])
+			continue;
+		if (dfa_ruleset_rebuild(rs, node) != 0)
+			return -1;
+		rs->dirty[node] = 0;
+	}
+
+	return 0;
+}
+
+const struct dfa *dfa_ruleset_get(struct dfa_ruleset *rs)
+{
+	if (rs->cap == 0 || dfa_ruleset_update(rs) != 0)
+		return NULL;
+
+	return dfa_ruleset_node(rs, 1);
+}
@@ -0,0 +1,137 @@
+/*
+ * Set of patterns joined into one DFA with incremental updates.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup dfa_ruleset dfa_ruleset
+ * @{
+ */
+
+#ifndef REFA_DFA_RULESET_H
+#define REFA_DFA_RULESET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "dfa.h"
+
+/**
+ * structure that represents the set of patterns and their joined DFA
+ *
+ * DFAs of the patterns are the leaves of the balanced binary tree, every
+ * inner node holds the join of its children's DFAs and the root holds
+ * the join of all patterns. Adding or removing a pattern marks the path
+ * from its leaf to the root, dfa_ruleset_update() rebuilds the marked
+ * nodes only: a change of one pattern costs about log2(cap) joins instead
+ * of cnt - 1. Nodes with one non-empty child share the child's DFA.
+ */
+struct dfa_ruleset {
+	/**
+	 * nodes of the tree, nodes[1] is the root and nodes[cap + id]
+	 * is the leaf of the pattern id
+	 */
+	struct dfa *nodes;
+
+	/**
+	 * kinds of the nodes' DFAs (empty, own or shared with a child)
+	 */
+	uint8_t *kind;
+
+	/**
+	 * nodes that must be rebuilt
+	 */
+	uint8_t *dirty;
+
+	/**
+	 * number of leaves, power of two
+	 */
+	size_t cap;
+
+	/**
+	 * number of patterns
+	 */
+	size_t cnt;
+
+	/**
+	 * ids of the free leaves
+	 */
+	size_t *free_ids;
+
+	/**
+	 * number of the free leaves
+	 */
+	size_t free_cnt;
+
+	/**
+	 * minimize the joined DFAs
+	 */
+	bool minimize;
+
+	/**
+	 * number of joins done by all updates
+	 */
+	size_t join_cnt;
+};
+
+/**
+ * Allocate the empty ruleset.
+ *
+ * @param rs		pointer to the dfa_ruleset structure
+ * @param minimize	minimize the joined DFAs
+ * @return		0 on success
+ */
+int dfa_ruleset_alloc(struct dfa_ruleset *rs, bool minimize);
+
+/**
+ * Free the ruleset and DFAs of all patterns.
+ *
+ * @param rs	pointer to the dfa_ruleset structure
+ */
+void dfa_ruleset_free(struct dfa_ruleset *rs);
+
+/**
+ * Add the pattern to the ruleset.
+ *
+ * The ruleset takes the DFA, the caller must not use or free it.
+ * The ids of the removed patterns are reused.
+ *
+ * @param rs	pointer to the dfa_ruleset structure
+ * @param dfa	pointer to the DFA of the pattern
+ * @param id	place for the id of the pattern, may be NULL
+ * @return	0 on success
+ */
+int dfa_ruleset_add(struct dfa_ruleset *rs, struct dfa *dfa, size_t *id);
+
+/**
+ * Remove the pattern from the ruleset.
+ *
+ * @param rs	pointer to the dfa_ruleset structure
+ * @param id	id of the pattern
+ * @return	0 on success, -1 if there is no such pattern
+ */
+int dfa_ruleset_remove(struct dfa_ruleset *rs, size_t id);
+
+/**
+ * Rebuild the joined DFA after the changes of the ruleset.
+ *
+ * @param rs	pointer to the dfa_ruleset structure
+ * @return	0 on success
+ */
+int dfa_ruleset_update(struct dfa_ruleset *rs);
+
+/**
+ * Get the joined DFA of all patterns.
+ *
+ * Calls dfa_ruleset_update() if needed. The DFA belongs to the ruleset
+ * and is valid until the next change of the ruleset.
+ *
+ * @param rs	pointer to the dfa_ruleset structure
+ * @return	pointer to the joined DFA, NULL if the ruleset is empty
+ *		or on error
+ */
+const struct dfa *dfa_ruleset_get(struct dfa_ruleset *rs);
+
+#endif /** REFA_DFA_RULESET_H @} */
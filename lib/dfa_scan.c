@@ -0,0 +1,434 @@
+/*
+ * Scanning of data with deterministic finite automaton.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfa_scan.h"
+#include "dfa_scan_inner.h"
+
+/**
+ * @brief Flags of the states where scanning of a stream has to stop.
+ */
+#define DFA_SCAN_STOP_FLAGS	(DFA_FLAG_FINAL | DFA_FLAG_DEADEND)
+
+/**
+ * @brief Maximum number of escape bytes of an accelerated state.
+ *
+ * States with more escape bytes leave themselves too often for the skip
+ * to pay off.
+ */
+#define DFA_ACCEL_MAX_ESCAPES	(16)
+
+/**
+ * @brief Maximum number of states for the gather-based kernels.
+ *
+ * Gather instructions use signed 32-bit indexes of transitions.
+ */
+#define DFA_SCAN_GATHER_MAX_STATES	((size_t)1 << 23)
+
+/**
+ * @brief Maximum size of the transition table for automatic choice of
+ * the gather-based kernels.
+ *
+ * Tables that do not fit in cache are scanned faster by the interleaved
+ * scalar loop: its prefetches keep more misses in flight than gathers do.
+ */
+#define DFA_SCAN_GATHER_AUTO_MAX_SIZE	((size_t)1 << 20)
+
+/**
+ * @brief Get address of the transition in the raw transition table.
+ *
+ * @param trans	transition table
+ * @param bps	bits per state
+ * @param from	source state's index
+ * @param mark	label of transition
+ * @return	address of the transition
+ */
+DFA_ALWAYS_INLINE const void *dfa_scan_addr(const void *trans, int bps,
+					    size_t from, unsigned char mark)
+{
+	return (const char *)trans + (from * 256 + mark) * (bps / 8);
+}
+
+/**
+ * @brief Check if the scan must not be started at all.
+ *
+ * Handles the states where the scan of a stream is already finished:
+ * accepting states (empty match) and non-accepting deadends.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param state	current state
+ * @param match	place for the match offset
+ * @return	true if nothing has to be scanned
+ */
+bool dfa_scan_stopped(const struct dfa *dfa, size_t state, size_t *match)
+{
+	uint8_t flags = dfa->flags[state];
+
+	*match = DFA_SCAN_NO_MATCH;
+
+	if (flags & DFA_FLAG_FINAL) {
+		*match = 0;
+		return true;
+	}
+
+	return (flags & DFA_FLAG_DEADEND) != 0;
+}
+
+/**
+ * @brief Skip bytes that keep DFA in the accelerated state.
+ *
+ * @param accel	escape bytes of the state
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @return	offset of the first escape byte or len if there is none
+ */
+size_t dfa_scan_skip(const struct dfa_accel *accel,
+		     const unsigned char *data, size_t len)
+{
+	const unsigned char *found;
+	size_t i;
+
+	if (accel->cnt == 1) {
+		found = memchr(data, accel->byte, len);
+		return found != NULL ? (size_t)(found - data) : len;
+	}
+
+#ifdef DFA_SCAN_X86_SIMD
+	if (__builtin_cpu_supports("avx2"))
+		return dfa_scan_skip_avx2(accel, data, len);
+	if (__builtin_cpu_supports("ssse3"))
+		return dfa_scan_skip_ssse3(accel, data, len);
+#endif
+
+	for (i = 0; i < len; i++)
+		if (dfa_accel_is_escape(accel, data[i]))
+			break;
+
+	return i;
+}
+
+/**
+ * @brief Scan loop specialized for one transition width.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param state	pointer to the current state's index
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @param bps	bits per state
+ * @return	offset of the match or DFA_SCAN_NO_MATCH
+ */
+DFA_ALWAYS_INLINE size_t dfa_scan_loop(const struct dfa *dfa, size_t *state,
+				       const unsigned char *data, size_t len,
+				       const int bps)
+{
+	const void *trans = dfa->trans;
+	const uint8_t *flags = dfa->flags;
+	size_t cur = *state;
+	size_t match = DFA_SCAN_NO_MATCH;
+	size_t i = 0;
+
+	if (flags[cur] & DFA_FLAG_ACCEL)
+		i = dfa_scan_skip(&dfa->accel[cur], data, len);
+
+	for (; i < len; i++) {
+		cur = dfa_scan_next(trans, bps, cur, data[i]);
+
+		if (flags[cur] & (DFA_SCAN_STOP_FLAGS | DFA_FLAG_ACCEL)) {
+			if (flags[cur] & DFA_FLAG_ACCEL) {
+				i += dfa_scan_skip(&dfa->accel[cur],
+						   data + i + 1, len - i - 1);
+				continue;
+			}
+			if (flags[cur] & DFA_FLAG_FINAL)
+				match = i + 1;
+			break;
+		}
+	}
+
+	*state = cur;
+
+	return match;
+}
+
+int dfa_accelerate(struct dfa *dfa)
+{
+	struct dfa_accel *accel;
+
+	accel = realloc(dfa->accel, sizeof(struct dfa_accel) * dfa->state_cnt);
+	if (accel == NULL && dfa->state_cnt != 0)
+		return -1;
+	dfa->accel = accel;
+
+	for (size_t i = 0; i < dfa->state_cnt; i++) {
+		struct dfa_accel *cur = &accel[i];
+
+		dfa->flags[i] &= 0xFF ^ DFA_FLAG_ACCEL;
+		memset(cur, 0x00, sizeof(*cur));
+
+		if (dfa->flags[i] & DFA_SCAN_STOP_FLAGS)
+			continue;
+
+		for (int c = 255; c >= 0; c--) {
+			if (dfa_get_trans(dfa, i, c) == i)
+				continue;
+
+			cur->cnt++;
+			cur->byte = c;
+			if (c & 0x80)
+				cur->hi[c & 0x0F] |= 1 << ((c >> 4) & 0x07);
+			else
+				cur->lo[c & 0x0F] |= 1 << ((c >> 4) & 0x07);
+		}
+
+		if (cur->cnt > 0 && cur->cnt <= DFA_ACCEL_MAX_ESCAPES)
+			dfa->flags[i] |= DFA_FLAG_ACCEL;
+	}
+
+	return 0;
+}
+
+void dfa_stream_init(const struct dfa *dfa, struct dfa_stream *stream,
+		     const void *data, size_t len)
+{
+	stream->data = data;
+	stream->len = len;
+	stream->state = dfa->first_index;
+	stream->match = DFA_SCAN_NO_MATCH;
+}
+
+size_t dfa_scan(const struct dfa *dfa, size_t *state,
+		const void *data, size_t len)
+{
+	size_t match;
+
+	if (dfa_scan_stopped(dfa, *state, &match))
+		return match;
+
+	switch (dfa->bps) {
+	case 8:
+		return dfa_scan_loop(dfa, state, data, len, 8);
+	case 16:
+		return dfa_scan_loop(dfa, state, data, len, 16);
+	case 32:
+		return dfa_scan_loop(dfa, state, data, len, 32);
+	case 64:
+		return dfa_scan_loop(dfa, state, data, len, 64);
+	default:
+		return DFA_SCAN_NO_MATCH;
+	}
+}
+
+/**
+ * @brief One stream that is currently advanced by the multi-stream scanner.
+ */
+struct dfa_scan_lane {
+	/**
+	 * @brief Data of the stream.
+	 */
+	const unsigned char *data;
+
+	/**
+	 * @brief Offset of the next byte.
+	 */
+	size_t pos;
+
+	/**
+	 * @brief Size of the data.
+	 */
+	size_t len;
+
+	/**
+	 * @brief Current state.
+	 */
+	size_t state;
+
+	/**
+	 * @brief Original stream structure.
+	 */
+	struct dfa_stream *stream;
+};
+
+/**
+ * @brief Attach the next non-trivial stream to the lane.
+ *
+ * Streams that need no scanning at all are finished right here.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param lane		lane to be filled
+ * @param streams	array of streams
+ * @param next		index of the next unprocessed stream
+ * @param cnt		number of streams
+ * @param bps		bits per state
+ * @return		true if the lane was filled
+ */
+DFA_ALWAYS_INLINE bool dfa_scan_lane_fill(const struct dfa *dfa,
+					  struct dfa_scan_lane *lane,
+					  struct dfa_stream *streams,
+					  size_t *next, size_t cnt,
+					  const int bps)
+{
+	while (*next < cnt) {
+		struct dfa_stream *stream = &streams[(*next)++];
+
+		if (dfa_scan_stopped(dfa, stream->state, &stream->match) ||
+		    stream->len == 0)
+			continue;
+
+		lane->data = stream->data;
+		lane->pos = 0;
+		lane->len = stream->len;
+		lane->state = stream->state;
+		lane->stream = stream;
+
+		DFA_PREFETCH(dfa_scan_addr(dfa->trans, bps, lane->state,
+					   lane->data[0]));
+
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Multi-stream scan loop specialized for one transition width.
+ *
+ * Each round advances every active lane by one byte and prefetches
+ * the transition that the lane will need in the next round.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param streams	array of streams
+ * @param cnt		number of streams
+ * @param bps		bits per state
+ */
+DFA_ALWAYS_INLINE void dfa_scan_multi_loop(const struct dfa *dfa,
+					   struct dfa_stream *streams,
+					   size_t cnt, const int bps)
+{
+	struct dfa_scan_lane lanes[DFA_SCAN_LANES];
+	const void *trans = dfa->trans;
+	const uint8_t *flags = dfa->flags;
+	size_t active = 0;
+	size_t next = 0;
+
+	while (active < DFA_SCAN_LANES &&
+	       dfa_scan_lane_fill(dfa, &lanes[active], streams, &next, cnt, bps))
+		active++;
+
+	while (active > 0) {
+		size_t l = 0;
+
+		while (l < active) {
+			struct dfa_scan_lane *lane = &lanes[l];
+			size_t cur;
+
+			cur = dfa_scan_next(trans, bps, lane->state,
+					    lane->data[lane->pos]);
+			lane->pos++;
+
+			if (!(flags[cur] & DFA_SCAN_STOP_FLAGS) &&
+			    lane->pos < lane->len) {
+				lane->state = cur;
+				DFA_PREFETCH(dfa_scan_addr(trans, bps, cur,
+						lane->data[lane->pos]));
+				l++;
+				continue;
+			}
+
+			lane->stream->state = cur;
+			if (flags[cur] & DFA_FLAG_FINAL)
+				lane->stream->match = lane->pos;
+
+			if (dfa_scan_lane_fill(dfa, lane, streams, &next,
+					       cnt, bps)) {
+				l++;
+			} else {
+				*lane = lanes[--active];
+			}
+		}
+	}
+}
+
+int dfa_scan_multi(const struct dfa *dfa, struct dfa_stream *streams,
+		   size_t cnt)
+{
+	switch (dfa->bps) {
+	case 8:
+		dfa_scan_multi_loop(dfa, streams, cnt, 8);
+		break;
+	case 16:
+		dfa_scan_multi_loop(dfa, streams, cnt, 16);
+		break;
+	case 32:
+		dfa_scan_multi_loop(dfa, streams, cnt, 32);
+		break;
+	case 64:
+		dfa_scan_multi_loop(dfa, streams, cnt, 64);
+		break;
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+
+int dfa_scan_kernel_supported(const struct dfa *dfa,
+			      enum dfa_scan_kernel kernel)
+{
+	switch (kernel) {
+	case DFA_SCAN_KERNEL_AUTO:
+	case DFA_SCAN_KERNEL_SCALAR:
+		return 1;
+	case DFA_SCAN_KERNEL_AVX2:
+	case DFA_SCAN_KERNEL_AVX512:
+		if (dfa->bps != 16 && dfa->bps != 32)
+			return 0;
+		if (dfa->state_cnt > DFA_SCAN_GATHER_MAX_STATES)
+			return 0;
+		return dfa_scan_cpu_supports(kernel);
+	default:
+		return 0;
+	}
+}
+
+int dfa_scan_batch(const struct dfa *dfa, struct dfa_stream *streams,
+		   size_t cnt, enum dfa_scan_kernel kernel)
+{
+	if (kernel == DFA_SCAN_KERNEL_AUTO) {
+		if (dfa->state_cnt * dfa->state_size >
+		    DFA_SCAN_GATHER_AUTO_MAX_SIZE)
+			kernel = DFA_SCAN_KERNEL_SCALAR;
+		else if (dfa_scan_kernel_supported(dfa, DFA_SCAN_KERNEL_AVX512))
+			kernel = DFA_SCAN_KERNEL_AVX512;
+		else if (dfa_scan_kernel_supported(dfa, DFA_SCAN_KERNEL_AVX2))
+			kernel = DFA_SCAN_KERNEL_AVX2;
+		else
+			kernel = DFA_SCAN_KERNEL_SCALAR;
+	}
+
+	if (!dfa_scan_kernel_supported(dfa, kernel))
+		return -1;
+
+	switch (kernel) {
+#ifdef DFA_SCAN_X86_SIMD
+	case DFA_SCAN_KERNEL_AVX2:
+		dfa_scan_batch_avx2(dfa, streams, cnt);
+		return 0;
+	case DFA_SCAN_KERNEL_AVX512:
+		dfa_scan_batch_avx512(dfa, streams, cnt);
+		return 0;
+#endif
+	default:
+		return dfa_scan_multi(dfa, streams, cnt);
+	}
+}
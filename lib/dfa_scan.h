@@ -0,0 +1,203 @@
+/*
+ * Scanning of data with deterministic finite automaton.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup scan scan
+ * @{
+ */
+
+#ifndef REFA_DFA_SCAN_H
+#define REFA_DFA_SCAN_H
+
+#include <stddef.h>
+
+#include "dfa.h"
+
+/** match offset when no accepting state was reached */
+#define DFA_SCAN_NO_MATCH	((size_t)-1)
+
+/** maximum number of streams that are advanced in lockstep */
+#define DFA_SCAN_LANES		(16)
+
+/**
+ * structure that represents one independent stream of data for the scanner
+ */
+struct dfa_stream {
+	/**
+	 * data to be scanned
+	 */
+	const unsigned char *data;
+
+	/**
+	 * size of the data
+	 */
+	size_t len;
+
+	/**
+	 * current DFA state, must be initialized with the initial state
+	 * before the first chunk of the stream is scanned
+	 */
+	size_t state;
+
+	/**
+	 * offset just past the byte that led to an accepting state
+	 * or DFA_SCAN_NO_MATCH if there was no such byte
+	 */
+	size_t match;
+};
+
+/**
+ * callback that is called for every reported match
+ *
+ * @param id	identifier of the matched pattern
+ * @param end	offset just past the last byte of the match
+ * @param ctx	user's context
+ * @return	0 to continue the scan, other values stop it
+ */
+typedef int (*dfa_match_cb)(size_t id, size_t end, void *ctx);
+
+/**
+ * implementations of the batch scanner
+ */
+enum dfa_scan_kernel {
+	/**
+	 * the fastest kernel supported by the CPU and the DFA
+	 */
+	DFA_SCAN_KERNEL_AUTO	= 0,
+	/**
+	 * interleaved scalar loop, supported everywhere
+	 */
+	DFA_SCAN_KERNEL_SCALAR	= 1,
+	/**
+	 * AVX2 gathers of 8 streams at once (16 and 32 bits per state)
+	 */
+	DFA_SCAN_KERNEL_AVX2	= 2,
+	/**
+	 * AVX-512 gathers of 16 streams at once (16 and 32 bits per state)
+	 */
+	DFA_SCAN_KERNEL_AVX512	= 3
+};
+
+/**
+ * Accelerate states of DFA.
+ *
+ * Finds states that loop to themselves on all bytes but a few escape bytes
+ * (e.g. the initial state of an unanchored regexp), marks them with
+ * DFA_FLAG_ACCEL and stores their escape bytes. dfa_scan() skips data
+ * in such states with memchr() or a SIMD set lookup instead of stepping
+ * by single transitions. Acceleration is dropped by dfa_minimize() and
+ * has to be recalculated after any manual change of transitions.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @return	0 on success
+ */
+int dfa_accelerate(struct dfa *dfa);
+
+/**
+ * Initialize stream.
+ *
+ * Sets the stream to the initial state of the DFA and attaches data to it.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param stream	pointer to the stream structure
+ * @param data		data to be scanned
+ * @param len		size of the data
+ */
+void dfa_stream_init(const struct dfa *dfa, struct dfa_stream *stream,
+		     const void *data, size_t len);
+
+/**
+ * Scan data with DFA.
+ *
+ * Feeds bytes to the DFA starting from the state *state until an accepting
+ * state is reached or the data is over. The state is updated, so the scan
+ * of a stream can be continued with its next chunk.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param state	pointer to the current state's index
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @return	offset just past the byte that led to an accepting state
+ *		or DFA_SCAN_NO_MATCH
+ */
+size_t dfa_scan(const struct dfa *dfa, size_t *state,
+		const void *data, size_t len);
+
+/**
+ * Scan multiple independent streams with DFA.
+ *
+ * Advances up to DFA_SCAN_LANES streams in lockstep, so the loads of their
+ * transitions are interleaved and prefetched and multiple cache misses are
+ * in flight at once. Any number of streams can be passed, finished streams
+ * are replaced by the next ones. Each stream is processed as if
+ * it was scanned with dfa_scan().
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param streams	array of streams
+ * @param cnt		number of streams
+ * @return		0 on success
+ */
+int dfa_scan_multi(const struct dfa *dfa, struct dfa_stream *streams,
+		   size_t cnt);
+
+/**
+ * Check if the batch scanner's kernel can be used.
+ *
+ * Checks both the CPU features and the DFA layout: SIMD kernels support
+ * only 16 and 32 bits per state and tables with less than 2^23 states.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param kernel	kernel to check
+ * @return		1 if the kernel can be used, 0 otherwise
+ */
+int dfa_scan_kernel_supported(const struct dfa *dfa,
+			      enum dfa_scan_kernel kernel);
+
+/**
+ * Scan many independent records with DFA.
+ *
+ * Does the same as dfa_scan_multi() but with the explicitly chosen kernel.
+ * SIMD kernels keep states of 8 or 16 streams in one vector register and
+ * fetch their transitions with one gather instruction. With
+ * DFA_SCAN_KERNEL_AUTO the kernel is chosen at runtime, so the same binary
+ * works on every CPU; SIMD kernels are chosen only for small tables.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param streams	array of streams
+ * @param cnt		number of streams
+ * @param kernel	kernel to be used
+ * @return		0 on success, -1 if the kernel is not supported
+ */
+int dfa_scan_batch(const struct dfa *dfa, struct dfa_stream *streams,
+		   size_t cnt, enum dfa_scan_kernel kernel);
+
+/**
+ * Scan one large buffer with DFA in parallel.
+ *
+ * Splits the buffer into chunks and scans them in separate threads.
+ * The state at the beginning of a chunk is not known in advance, so
+ * every chunk is scanned speculatively from all states (small DFA) or from
+ * a few likely states, paths that converge to the same state are merged.
+ * Then the results of the chunks are stitched together by mapping the real
+ * state at the beginning of every chunk to its result, chunks whose real
+ * state was not guessed are rescanned. Chunks whose paths do not converge
+ * or whose thread can not be started are scanned sequentially, so the
+ * result is exactly the same as the result of dfa_scan().
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param state		pointer to the current state's index
+ * @param data		data to be scanned
+ * @param len		size of the data
+ * @param thread_cnt	maximum number of threads
+ * @param match		place for the offset just past the byte that led
+ *			to an accepting state or DFA_SCAN_NO_MATCH
+ * @return		0 on success
+ */
+int dfa_scan_parallel(const struct dfa *dfa, size_t *state,
+		      const void *data, size_t len, int thread_cnt,
+		      size_t *match);
+
+#endif /** REFA_DFA_SCAN_H @} */
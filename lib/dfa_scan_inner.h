@@ -0,0 +1,79 @@
+/*
+ * DFA scanner's inner functions.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#ifndef REFA_DFA_SCAN_INNER_H
+#define REFA_DFA_SCAN_INNER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "dfa_scan.h"
+
+/* SIMD kernels are built only for x86-64 compilers with target attributes */
+#if defined(__x86_64__) && defined(__GNUC__)
+#define DFA_SCAN_X86_SIMD	1
+#endif
+
+/* always inlined helpers and prefetch hint of the scan loops */
+#if defined(__GNUC__)
+#define DFA_ALWAYS_INLINE	static inline __attribute__((always_inline))
+#define DFA_PREFETCH(ptr)	__builtin_prefetch((ptr))
+#else
+#define DFA_ALWAYS_INLINE	static inline
+#define DFA_PREFETCH(ptr)	((void)(ptr))
+#endif
+
+/*
+ * get transition's destination from the raw transition table, it is
+ * inlined with the constant bps, so every scan loop is specialized
+ * for one transition width
+ */
+DFA_ALWAYS_INLINE size_t dfa_scan_next(const void *trans, int bps,
+				       size_t from, unsigned char mark)
+{
+	switch (bps) {
+	case 8:
+		return ((const uint8_t *)trans)[from * 256 + mark];
+	case 16:
+		return ((const uint16_t *)trans)[from * 256 + mark];
+	case 32:
+		return ((const uint32_t *)trans)[from * 256 + mark];
+	default:
+		return ((const uint64_t *)trans)[from * 256 + mark];
+	}
+}
+
+/* check if the scan of the stream must not be started at all */
+extern bool dfa_scan_stopped(const struct dfa *dfa, size_t state,
+			     size_t *match);
+
+/* check if the CPU and the OS support the instruction set of the kernel */
+extern bool dfa_scan_cpu_supports(enum dfa_scan_kernel kernel);
+
+/* check if the byte leads out of the accelerated state */
+static inline bool dfa_accel_is_escape(const struct dfa_accel *accel,
+				       unsigned char c)
+{
+	const uint8_t *set = (c & 0x80) ? accel->hi : accel->lo;
+
+	return (set[c & 0x0F] >> ((c >> 4) & 0x07)) & 1;
+}
+
+/* search of escape bytes, return offset of the first one or len */
+extern size_t dfa_scan_skip(const struct dfa_accel *accel,
+			    const unsigned char *data, size_t len);
+extern size_t dfa_scan_skip_ssse3(const struct dfa_accel *accel,
+				  const unsigned char *data, size_t len);
+extern size_t dfa_scan_skip_avx2(const struct dfa_accel *accel,
+				 const unsigned char *data, size_t len);
+
+/* gather-based kernels, they support only 16 and 32 bits per state */
+extern void dfa_scan_batch_avx2(const struct dfa *dfa,
+				struct dfa_stream *streams, size_t cnt);
+extern void dfa_scan_batch_avx512(const struct dfa *dfa,
+				  struct dfa_stream *streams, size_t cnt);
+
+#endif /* REFA_DFA_SCAN_INNER_H */
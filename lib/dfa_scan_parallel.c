@@ -0,0 +1,447 @@
+/*
+ * Speculative parallel scanning of one buffer with deterministic finite
+ * automaton.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <pthread.h>
+
+#include "dfa_scan.h"
+#include "dfa_scan_inner.h"
+
+/**
+ * @brief Minimum size of one chunk, smaller buffers are split into
+ * fewer chunks.
+ */
+#define DFA_SCAN_PARALLEL_MIN_CHUNK	((size_t)1 << 16)
+
+/**
+ * @brief Maximum number of states for starting a chunk from all states.
+ */
+#define DFA_SCAN_PARALLEL_ALL_STATES	((size_t)1 << 12)
+
+/**
+ * @brief Size of the data before a chunk that is used to guess
+ * the likely starting states of the chunk.
+ */
+#define DFA_SCAN_PARALLEL_LOOKBACK	((size_t)1 << 12)
+
+/**
+ * @brief Maximum number of likely starting states.
+ */
+#define DFA_SCAN_PARALLEL_LIKELY	(2)
+
+/**
+ * @brief Number of bytes after which the paths of a chunk that did not
+ * converge to one are given up, the chunk is then scanned sequentially.
+ */
+#define DFA_SCAN_PARALLEL_CONVERGE	((size_t)1 << 12)
+
+/**
+ * @brief Marker of the unused entries.
+ */
+#define DFA_SCAN_PARALLEL_NONE		((size_t)-1)
+
+/**
+ * @brief One chunk of the buffer scanned from several candidate states.
+ *
+ * Every candidate starts its own path. Paths that reach the same state at
+ * the same offset have the same future, so they are merged and the chunk
+ * is scanned only by the distinct paths.
+ */
+struct dfa_scan_chunk {
+	/**
+	 * @brief Pointer to the dfa structure.
+	 */
+	const struct dfa *dfa;
+
+	/**
+	 * @brief Data of the chunk.
+	 */
+	const unsigned char *data;
+
+	/**
+	 * @brief Size of the chunk.
+	 */
+	size_t len;
+
+	/**
+	 * @brief Candidate starting states, NULL if all states are candidates.
+	 */
+	size_t *cand;
+
+	/**
+	 * @brief Number of candidates.
+	 */
+	size_t cand_cnt;
+
+	/**
+	 * @brief Current or final states of the paths.
+	 */
+	size_t *state;
+
+	/**
+	 * @brief Match offsets of the paths.
+	 */
+	size_t *match;
+
+	/**
+	 * @brief Paths that paths were merged into, or their own indexes.
+	 */
+	size_t *parent;
+
+	/**
+	 * @brief Paths that are still being scanned.
+	 */
+	size_t *alive;
+
+	/**
+	 * @brief Path that occupies the state at the current step, it is
+	 * indexed by the states. Allocated only if all states are candidates,
+	 * the few likely paths are compared directly.
+	 */
+	size_t *owner;
+
+	/**
+	 * @brief The paths are not known, the chunk has to be scanned
+	 * sequentially: they did not converge or the memory was not
+	 * allocated.
+	 */
+	bool unresolved;
+
+	/**
+	 * @brief The thread was started.
+	 */
+	bool running;
+
+	/**
+	 * @brief Thread that scans the chunk.
+	 */
+	pthread_t thread;
+};
+
+/**
+ * @brief Free memory of the chunk.
+ *
+ * @param chunk	pointer to the chunk
+ */
+static void dfa_scan_chunk_free(struct dfa_scan_chunk *chunk)
+{
+	free(chunk->cand);
+	free(chunk->state);
+	free(chunk->match);
+	free(chunk->parent);
+	free(chunk->alive);
+	free(chunk->owner);
+}
+
+/**
+ * @brief Get the path that the path was merged into.
+ *
+ * @param chunk	pointer to the chunk
+ * @param path	index of the path
+ * @return	index of the path that represents the path
+ */
+static size_t dfa_scan_chunk_find(struct dfa_scan_chunk *chunk, size_t path)
+{
+	size_t root = path;
+
+	while (chunk->parent[root] != root)
+		root = chunk->parent[root];
+
+	while (chunk->parent[path] != root) {
+		size_t next = chunk->parent[path];
+
+		chunk->parent[path] = root;
+		path = next;
+	}
+
+	return root;
+}
+
+/**
+ * @brief Get the path that occupies the state at the current step.
+ *
+ * @param chunk	pointer to the chunk
+ * @param kept	number of the paths already advanced at this step
+ * @param state	the state
+ * @return	index of the path or DFA_SCAN_PARALLEL_NONE
+ */
+static size_t dfa_scan_chunk_owner(const struct dfa_scan_chunk *chunk,
+				   size_t kept, size_t state)
+{
+	if (chunk->owner != NULL)
+		return chunk->owner[state];
+
+	for (size_t a = 0; a < kept; a++)
+		if (chunk->state[chunk->alive[a]] == state)
+			return chunk->alive[a];
+
+	return DFA_SCAN_PARALLEL_NONE;
+}
+
+/**
+ * @brief Scan the chunk from all candidate states.
+ *
+ * Paths are advanced in lockstep until only one of them is alive,
+ * the rest of the chunk is scanned with dfa_scan(). If the paths do not
+ * converge in DFA_SCAN_PARALLEL_CONVERGE bytes, the chunk is left
+ * unresolved.
+ *
+ * @param arg	pointer to the chunk
+ * @return	NULL
+ */
+static void *dfa_scan_chunk_run(void *arg)
+{
+	struct dfa_scan_chunk *chunk = arg;
+	const struct dfa *dfa = chunk->dfa;
+	size_t alive_cnt = 0;
+	size_t i;
+
+	chunk->state = malloc(sizeof(size_t) * chunk->cand_cnt);
+	chunk->match = malloc(sizeof(size_t) * chunk->cand_cnt);
+	chunk->parent = malloc(sizeof(size_t) * chunk->cand_cnt);
+	chunk->alive = malloc(sizeof(size_t) * chunk->cand_cnt);
+	if (chunk->cand == NULL)
+		chunk->owner = malloc(sizeof(size_t) * dfa->state_cnt);
+
+	if (chunk->state == NULL || chunk->match == NULL ||
+	    chunk->parent == NULL || chunk->alive == NULL ||
+	    (chunk->cand == NULL && chunk->owner == NULL)) {
+		chunk->unresolved = true;
+		return NULL;
+	}
+
+	if (chunk->owner != NULL)
+		for (size_t s = 0; s < dfa->state_cnt; s++)
+			chunk->owner[s] = DFA_SCAN_PARALLEL_NONE;
+
+	for (size_t p = 0; p < chunk->cand_cnt; p++) {
+		size_t state = chunk->cand != NULL ? chunk->cand[p] : p;
+
+		chunk->state[p] = state;
+		chunk->parent[p] = p;
+
+		if (!dfa_scan_stopped(dfa, state, &chunk->match[p]))
+			chunk->alive[alive_cnt++] = p;
+	}
+
+	for (i = 0; i < chunk->len && alive_cnt > 1; i++) {
+		size_t kept = 0;
+
+		if (i == DFA_SCAN_PARALLEL_CONVERGE) {
+			chunk->unresolved = true;
+			return NULL;
+		}
+
+		for (size_t a = 0; a < alive_cnt; a++) {
+			size_t p = chunk->alive[a];
+			size_t next, owner;
+			uint8_t flags;
+
+			next = dfa_scan_next(dfa->trans, dfa->bps,
+					     chunk->state[p], chunk->data[i]);
+			flags = dfa->flags[next];
+			chunk->state[p] = next;
+
+			if (flags & (DFA_FLAG_FINAL | DFA_FLAG_DEADEND)) {
+				if (flags & DFA_FLAG_FINAL)
+					chunk->match[p] = i + 1;
+				continue;
+			}
+
+			owner = dfa_scan_chunk_owner(chunk, kept, next);
+			if (owner != DFA_SCAN_PARALLEL_NONE) {
+				chunk->parent[p] = owner;
+			} else {
+				if (chunk->owner != NULL)
+					chunk->owner[next] = p;
+				chunk->alive[kept++] = p;
+			}
+		}
+
+		alive_cnt = kept;
+		for (size_t a = 0; a < alive_cnt && chunk->owner != NULL; a++)
+			chunk->owner[chunk->state[chunk->alive[a]]] =
+				DFA_SCAN_PARALLEL_NONE;
+	}
+
+	if (alive_cnt == 1 && i < chunk->len) {
+		size_t p = chunk->alive[0];
+		size_t match;
+
+		match = dfa_scan(dfa, &chunk->state[p], chunk->data + i,
+				 chunk->len - i);
+		if (match != DFA_SCAN_NO_MATCH)
+			chunk->match[p] = i + match;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Get the result of the chunk for the starting state.
+ *
+ * @param chunk		pointer to the chunk
+ * @param state		pointer to the starting state, it is replaced
+ *			with the final state of the chunk
+ * @param match		place for the match offset
+ * @return		false if the state was not a candidate or the chunk
+ *			is unresolved
+ */
+static bool dfa_scan_chunk_result(struct dfa_scan_chunk *chunk,
+				  size_t *state, size_t *match)
+{
+	size_t path = DFA_SCAN_PARALLEL_NONE;
+
+	if (chunk->unresolved)
+		return false;
+
+	if (chunk->cand == NULL) {
+		path = *state;
+	} else {
+		for (size_t p = 0; p < chunk->cand_cnt; p++)
+			if (chunk->cand[p] == *state)
+				path = p;
+	}
+
+	if (path == DFA_SCAN_PARALLEL_NONE)
+		return false;
+
+	path = dfa_scan_chunk_find(chunk, path);
+	*state = chunk->state[path];
+	*match = chunk->match[path];
+
+	return true;
+}
+
+/**
+ * @brief Choose candidate starting states of the chunk.
+ *
+ * Small DFA are started from all states. Large DFA are started from
+ * the initial state and from the state reached after the data just
+ * before the chunk, as DFA usually converge quickly to the same state.
+ *
+ * @param chunk	pointer to the chunk
+ * @param data	whole buffer
+ * @param start	offset of the chunk
+ * @return	0 on success
+ */
+static int dfa_scan_chunk_prepare(struct dfa_scan_chunk *chunk,
+				  const unsigned char *data, size_t start)
+{
+	const struct dfa *dfa = chunk->dfa;
+	size_t lookback, state;
+
+	if (dfa->state_cnt <= DFA_SCAN_PARALLEL_ALL_STATES) {
+		chunk->cand = NULL;
+		chunk->cand_cnt = dfa->state_cnt;
+		return 0;
+	}
+
+	chunk->cand = malloc(sizeof(size_t) * DFA_SCAN_PARALLEL_LIKELY);
+	if (chunk->cand == NULL)
+		return -1;
+
+	lookback = start < DFA_SCAN_PARALLEL_LOOKBACK ?
+		   start : DFA_SCAN_PARALLEL_LOOKBACK;
+	state = dfa->first_index;
+	dfa_scan(dfa, &state, data + start - lookback, lookback);
+
+	chunk->cand[0] = dfa->first_index;
+	chunk->cand_cnt = 1;
+	if (state != dfa->first_index)
+		chunk->cand[chunk->cand_cnt++] = state;
+
+	return 0;
+}
+
+int dfa_scan_parallel(const struct dfa *dfa, size_t *state,
+		      const void *data, size_t len, int thread_cnt,
+		      size_t *match)
+{
+	struct dfa_scan_chunk *chunks;
+	size_t chunk_cnt, chunk_len;
+
+	*match = DFA_SCAN_NO_MATCH;
+
+	chunk_cnt = len / DFA_SCAN_PARALLEL_MIN_CHUNK;
+	if (thread_cnt < 1)
+		thread_cnt = 1;
+	if (chunk_cnt > (size_t)thread_cnt)
+		chunk_cnt = thread_cnt;
+
+	if (chunk_cnt > 1 && !dfa_scan_stopped(dfa, *state, match))
+		chunks = calloc(chunk_cnt, sizeof(struct dfa_scan_chunk));
+	else
+		chunks = NULL;
+
+	/* nothing to speculate on, the buffer is scanned sequentially */
+	if (chunks == NULL) {
+		if (*match == DFA_SCAN_NO_MATCH)
+			*match = dfa_scan(dfa, state, data, len);
+		return 0;
+	}
+
+	chunk_len = len / chunk_cnt;
+
+	/*
+	 * the first chunk is scanned by the caller from the known state,
+	 * the chunks whose thread was not started are left unresolved
+	 */
+	for (size_t i = 1; i < chunk_cnt; i++) {
+		struct dfa_scan_chunk *chunk = &chunks[i];
+
+		chunk->dfa = dfa;
+		chunk->data = (const unsigned char *)data + i * chunk_len;
+		chunk->len = i + 1 < chunk_cnt ? chunk_len :
+			     len - i * chunk_len;
+
+		chunk->running =
+			dfa_scan_chunk_prepare(chunk, data, i * chunk_len) == 0 &&
+			pthread_create(&chunk->thread, NULL, dfa_scan_chunk_run,
+				       chunk) == 0;
+		chunk->unresolved = !chunk->running;
+	}
+
+	*match = dfa_scan(dfa, state, data, chunk_len);
+
+	for (size_t i = 1; i < chunk_cnt; i++)
+		if (chunks[i].running)
+			pthread_join(chunks[i].thread, NULL);
+
+	/*
+	 * stitch the chunks: find the result of every chunk for the real
+	 * state, the unresolved chunks are scanned from it sequentially
+	 */
+	for (size_t i = 1; i < chunk_cnt; i++) {
+		struct dfa_scan_chunk *chunk = &chunks[i];
+		size_t chunk_match;
+
+		if (*match != DFA_SCAN_NO_MATCH ||
+		    (dfa->flags[*state] & DFA_FLAG_DEADEND))
+			break;
+
+		if (!dfa_scan_chunk_result(chunk, state, &chunk_match))
+			chunk_match = dfa_scan(dfa, state, chunk->data,
+					       chunk->len);
+
+		if (chunk_match != DFA_SCAN_NO_MATCH)
+			*match = i * chunk_len + chunk_match;
+	}
+
+	for (size_t i = 1; i < chunk_cnt; i++)
+		dfa_scan_chunk_free(&chunks[i]);
+	free(chunks);
+
+	return 0;
+}
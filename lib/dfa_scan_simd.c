@@ -0,0 +1,591 @@
+/*
+ * SIMD kernels of the DFA scanner.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "dfa_scan_inner.h"
+
+#ifdef DFA_SCAN_X86_SIMD
+
+#include <immintrin.h>
+
+/**
+ * @brief Number of vector registers of states advanced in one round.
+ *
+ * Gathers of independent registers are issued back to back, so more
+ * cache misses are in flight at once.
+ */
+#define DFA_SIMD_GROUPS		(2)
+
+/**
+ * @brief Maximum number of lanes in one vector register.
+ */
+#define DFA_SIMD_REG_LANES	(16)
+
+/**
+ * @brief Maximum number of lanes of the kernel.
+ */
+#define DFA_SIMD_MAX_LANES	(DFA_SIMD_GROUPS * DFA_SIMD_REG_LANES)
+
+/**
+ * @brief Flags of the states where scanning of a stream has to stop.
+ */
+#define DFA_SIMD_STOP_FLAGS	(DFA_FLAG_FINAL | DFA_FLAG_DEADEND)
+
+/**
+ * @brief Streams that are currently processed by the SIMD kernel.
+ *
+ * States, marks and counters are kept as 32-bit integers, so they can be
+ * loaded directly to the vector registers.
+ */
+struct dfa_simd_lanes {
+	/**
+	 * @brief Current states of the lanes.
+	 */
+	uint32_t state[DFA_SIMD_MAX_LANES] __attribute__((aligned(64)));
+
+	/**
+	 * @brief Next bytes of the lanes.
+	 */
+	uint32_t mark[DFA_SIMD_MAX_LANES] __attribute__((aligned(64)));
+
+	/**
+	 * @brief Number of bytes to be scanned before the lane is checked
+	 * by the scalar code, it is the remaining size capped by UINT32_MAX.
+	 */
+	uint32_t left[DFA_SIMD_MAX_LANES] __attribute__((aligned(64)));
+
+	/**
+	 * @brief Data of the lanes' streams.
+	 */
+	const unsigned char *data[DFA_SIMD_MAX_LANES];
+
+	/**
+	 * @brief Offsets of the next bytes.
+	 */
+	size_t pos[DFA_SIMD_MAX_LANES];
+
+	/**
+	 * @brief Sizes of the data.
+	 */
+	size_t len[DFA_SIMD_MAX_LANES];
+
+	/**
+	 * @brief Original stream structures.
+	 */
+	struct dfa_stream *stream[DFA_SIMD_MAX_LANES];
+
+	/**
+	 * @brief Bit mask of the lanes with attached streams.
+	 */
+	uint32_t active;
+
+	/**
+	 * @brief All streams of the batch.
+	 */
+	struct dfa_stream *streams;
+
+	/**
+	 * @brief Index of the next unprocessed stream.
+	 */
+	size_t next;
+
+	/**
+	 * @brief Number of streams in the batch.
+	 */
+	size_t cnt;
+};
+
+/**
+ * @brief Get number of bytes until the next scalar check of the lane.
+ *
+ * @param lanes	lanes of the kernel
+ * @param l	index of the lane
+ * @return	remaining size of the data capped by UINT32_MAX
+ */
+static inline uint32_t dfa_simd_lane_left(const struct dfa_simd_lanes *lanes,
+					  int l)
+{
+	size_t left = lanes->len[l] - lanes->pos[l];
+
+	return left < UINT32_MAX ? (uint32_t)left : UINT32_MAX;
+}
+
+/**
+ * @brief Attach the next non-trivial stream to the lane.
+ *
+ * Deactivates the lane if there are no more streams.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param lanes	lanes of the kernel
+ * @param l	index of the lane
+ */
+static void dfa_simd_lane_fill(const struct dfa *dfa,
+			       struct dfa_simd_lanes *lanes, int l)
+{
+	while (lanes->next < lanes->cnt) {
+		struct dfa_stream *stream = &lanes->streams[lanes->next++];
+
+		if (dfa_scan_stopped(dfa, stream->state, &stream->match) ||
+		    stream->len == 0)
+			continue;
+
+		lanes->state[l] = stream->state;
+		lanes->data[l] = stream->data;
+		lanes->pos[l] = 0;
+		lanes->len[l] = stream->len;
+		lanes->left[l] = dfa_simd_lane_left(lanes, l);
+		lanes->stream[l] = stream;
+		lanes->active |= 1u << l;
+
+		return;
+	}
+
+	lanes->state[l] = 0;
+	lanes->mark[l] = 0;
+	lanes->left[l] = 0;
+	lanes->active &= ~(1u << l);
+}
+
+/**
+ * @brief Initialize lanes of the kernel.
+ *
+ * @param dfa		pointer to the dfa structure
+ * @param lanes		lanes of the kernel
+ * @param streams	array of streams
+ * @param cnt		number of streams
+ * @param width		number of lanes
+ */
+static void dfa_simd_lanes_init(const struct dfa *dfa,
+				struct dfa_simd_lanes *lanes,
+				struct dfa_stream *streams, size_t cnt,
+				int width)
+{
+	lanes->active = 0;
+	lanes->streams = streams;
+	lanes->next = 0;
+	lanes->cnt = cnt;
+
+	for (int l = 0; l < DFA_SIMD_MAX_LANES; l++) {
+		lanes->state[l] = 0;
+		lanes->mark[l] = 0;
+		lanes->left[l] = 0;
+	}
+
+	for (int l = 0; l < width; l++)
+		dfa_simd_lane_fill(dfa, lanes, l);
+}
+
+/**
+ * @brief Load the next byte of every active lane.
+ *
+ * Positions are advanced right away, so after the step they point
+ * just past the consumed bytes.
+ *
+ * @param lanes	lanes of the kernel
+ * @param width	number of lanes
+ */
+static inline void dfa_simd_lanes_load(struct dfa_simd_lanes *lanes,
+				       int width)
+{
+	for (int l = 0; l < width; l++)
+		if (lanes->active & (1u << l))
+			lanes->mark[l] = lanes->data[l][lanes->pos[l]++];
+}
+
+/**
+ * @brief Finish the lanes that were stopped by the vector check.
+ *
+ * Finishes the streams that reached an accepting state, a deadend or
+ * the end of data and replaces them with the next streams. Lanes that
+ * were stopped only because their counter was capped continue the scan.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param lanes	lanes of the kernel
+ * @param stop	bit mask of the stopped lanes
+ */
+static void dfa_simd_lanes_finish(const struct dfa *dfa,
+				  struct dfa_simd_lanes *lanes, uint32_t stop)
+{
+	for (int l = 0; stop != 0; l++, stop >>= 1) {
+		uint8_t flags;
+
+		if (!(stop & 1))
+			continue;
+
+		flags = dfa->flags[lanes->state[l]];
+
+		if (!(flags & DFA_SIMD_STOP_FLAGS) &&
+		    lanes->pos[l] < lanes->len[l]) {
+			lanes->left[l] = dfa_simd_lane_left(lanes, l);
+			continue;
+		}
+
+		lanes->stream[l]->state = lanes->state[l];
+		if (flags & DFA_FLAG_FINAL)
+			lanes->stream[l]->match = lanes->pos[l];
+
+		dfa_simd_lane_fill(dfa, lanes, l);
+	}
+}
+
+/**
+ * @brief Fix the lanes that point to the very last 16-bit transition.
+ *
+ * 16-bit transitions are gathered as 32-bit values, so the last one can not
+ * be gathered without reading past the end of the table.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param lanes	lanes of the kernel
+ * @param edge	bit mask of lanes to be fixed
+ */
+static void dfa_simd_lanes_fix_edge(const struct dfa *dfa,
+				    struct dfa_simd_lanes *lanes,
+				    uint32_t edge)
+{
+	const uint16_t *trans = dfa->trans;
+
+	for (int l = 0; edge != 0; l++, edge >>= 1)
+		if (edge & 1)
+			lanes->state[l] = trans[dfa->state_cnt * 256 - 1];
+}
+
+/**
+ * @brief Check flags of the lanes whose flags can not be gathered.
+ *
+ * Flags are gathered as 32-bit values, so the last three states
+ * are checked one by one.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param lanes	lanes of the kernel
+ * @param edge	bit mask of lanes to be checked
+ * @return	bit mask of lanes in the accepting or deadend states
+ */
+static uint32_t dfa_simd_lanes_edge_flags(const struct dfa *dfa,
+					  const struct dfa_simd_lanes *lanes,
+					  uint32_t edge)
+{
+	uint32_t stop = 0;
+
+	for (int l = 0; edge != 0; l++, edge >>= 1)
+		if ((edge & 1) &&
+		    (dfa->flags[lanes->state[l]] & DFA_SIMD_STOP_FLAGS))
+			stop |= 1u << l;
+
+	return stop;
+}
+
+/**
+ * @brief Advance one register of AVX2 lanes by one byte.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param lanes	lanes of the kernel
+ * @param g	index of the register
+ * @return	bit mask of the lanes that must be checked by the scalar code
+ */
+__attribute__((target("avx2")))
+static inline uint32_t dfa_simd_step_avx2(const struct dfa *dfa,
+					  struct dfa_simd_lanes *lanes, int g)
+{
+	const int *trans = dfa->trans;
+	const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	const __m256i zero = _mm256_setzero_si256();
+	uint32_t *state = &lanes->state[g * 8];
+	uint32_t *left = &lanes->left[g * 8];
+	uint32_t active = (lanes->active >> (g * 8)) & 0xFF;
+	uint32_t edge_mask, stop_mask;
+	__m256i vstate, vmark, vidx, vmask, vnext, vleft, vflags, edge;
+
+	vstate = _mm256_load_si256((const __m256i *)state);
+	vmark = _mm256_load_si256((const __m256i *)&lanes->mark[g * 8]);
+	vidx = _mm256_add_epi32(_mm256_slli_epi32(vstate, 8), vmark);
+	vmask = _mm256_and_si256(_mm256_set1_epi32(active), bits);
+	vmask = _mm256_cmpeq_epi32(vmask, bits);
+
+	if (dfa->bps == 16) {
+		edge = _mm256_cmpeq_epi32(vidx, _mm256_set1_epi32(
+				(int)(dfa->state_cnt * 256 - 1)));
+		edge_mask = _mm256_movemask_ps(_mm256_castsi256_ps(edge))
+			    & active;
+		vnext = _mm256_mask_i32gather_epi32(vstate, trans, vidx,
+				_mm256_andnot_si256(edge, vmask), 2);
+		vnext = _mm256_and_si256(vnext, _mm256_set1_epi32(0xFFFF));
+		_mm256_store_si256((__m256i *)state, vnext);
+
+		if (edge_mask != 0) {
+			dfa_simd_lanes_fix_edge(dfa, lanes,
+						edge_mask << (g * 8));
+			vnext = _mm256_load_si256((const __m256i *)state);
+		}
+	} else {
+		vnext = _mm256_mask_i32gather_epi32(vstate, trans, vidx,
+						    vmask, 4);
+		_mm256_store_si256((__m256i *)state, vnext);
+	}
+
+	vleft = _mm256_load_si256((const __m256i *)left);
+	vleft = _mm256_sub_epi32(vleft, _mm256_set1_epi32(1));
+	_mm256_store_si256((__m256i *)left, vleft);
+	stop_mask = _mm256_movemask_ps(_mm256_castsi256_ps(
+			_mm256_cmpeq_epi32(vleft, zero)));
+
+	edge = _mm256_cmpgt_epi32(vnext,
+			_mm256_set1_epi32((int)dfa->state_cnt - 4));
+	edge_mask = _mm256_movemask_ps(_mm256_castsi256_ps(edge)) & active;
+	vflags = _mm256_mask_i32gather_epi32(zero, (const int *)dfa->flags,
+			vnext, _mm256_andnot_si256(edge, vmask), 1);
+	vflags = _mm256_and_si256(vflags,
+				  _mm256_set1_epi32(DFA_SIMD_STOP_FLAGS));
+	stop_mask |= ~_mm256_movemask_ps(_mm256_castsi256_ps(
+			_mm256_cmpeq_epi32(vflags, zero)));
+	stop_mask &= active;
+
+	if (edge_mask != 0)
+		stop_mask |= dfa_simd_lanes_edge_flags(dfa, lanes,
+				edge_mask << (g * 8)) >> (g * 8);
+
+	return stop_mask << (g * 8);
+}
+
+__attribute__((target("avx2")))
+void dfa_scan_batch_avx2(const struct dfa *dfa, struct dfa_stream *streams,
+			 size_t cnt)
+{
+	struct dfa_simd_lanes lanes;
+	const int width = DFA_SIMD_GROUPS * 8;
+
+	dfa_simd_lanes_init(dfa, &lanes, streams, cnt, width);
+
+	while (lanes.active != 0) {
+		uint32_t stop = 0;
+
+		dfa_simd_lanes_load(&lanes, width);
+
+		for (int g = 0; g < DFA_SIMD_GROUPS; g++)
+			stop |= dfa_simd_step_avx2(dfa, &lanes, g);
+
+		if (stop != 0)
+			dfa_simd_lanes_finish(dfa, &lanes, stop);
+	}
+}
+
+/**
+ * @brief Advance one register of AVX-512 lanes by one byte.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @param lanes	lanes of the kernel
+ * @param g	index of the register
+ * @return	bit mask of the lanes that must be checked by the scalar code
+ */
+__attribute__((target("avx512f")))
+static inline uint32_t dfa_simd_step_avx512(const struct dfa *dfa,
+					    struct dfa_simd_lanes *lanes,
+					    int g)
+{
+	const int *trans = dfa->trans;
+	const __m512i zero = _mm512_setzero_si512();
+	uint32_t *state = &lanes->state[g * 16];
+	uint32_t *left = &lanes->left[g * 16];
+	__mmask16 kmask = (__mmask16)(lanes->active >> (g * 16));
+	__mmask16 edge, stop;
+	__m512i vstate, vmark, vidx, vnext, vleft, vflags;
+
+	vstate = _mm512_load_si512(state);
+	vmark = _mm512_load_si512(&lanes->mark[g * 16]);
+	vidx = _mm512_add_epi32(_mm512_slli_epi32(vstate, 8), vmark);
+
+	if (dfa->bps == 16) {
+		edge = _mm512_mask_cmpeq_epi32_mask(kmask, vidx,
+				_mm512_set1_epi32(
+					(int)(dfa->state_cnt * 256 - 1)));
+		vnext = _mm512_mask_i32gather_epi32(vstate, kmask & ~edge,
+						    vidx, trans, 2);
+		vnext = _mm512_and_si512(vnext, _mm512_set1_epi32(0xFFFF));
+		_mm512_store_si512(state, vnext);
+
+		if (edge != 0) {
+			dfa_simd_lanes_fix_edge(dfa, lanes,
+						(uint32_t)edge << (g * 16));
+			vnext = _mm512_load_si512(state);
+		}
+	} else {
+		vnext = _mm512_mask_i32gather_epi32(vstate, kmask,
+						    vidx, trans, 4);
+		_mm512_store_si512(state, vnext);
+	}
+
+	vleft = _mm512_sub_epi32(_mm512_load_si512(left), _mm512_set1_epi32(1));
+	_mm512_store_si512(left, vleft);
+	stop = _mm512_mask_cmpeq_epi32_mask(kmask, vleft, zero);
+
+	edge = _mm512_mask_cmpgt_epi32_mask(kmask, vnext,
+			_mm512_set1_epi32((int)dfa->state_cnt - 4));
+	vflags = _mm512_mask_i32gather_epi32(zero, kmask & ~edge,
+					     vnext, dfa->flags, 1);
+	stop |= _mm512_mask_test_epi32_mask(kmask, vflags,
+			_mm512_set1_epi32(DFA_SIMD_STOP_FLAGS));
+
+	if (edge != 0)
+		stop |= dfa_simd_lanes_edge_flags(dfa, lanes,
+				(uint32_t)edge << (g * 16)) >> (g * 16);
+
+	return (uint32_t)stop << (g * 16);
+}
+
+__attribute__((target("avx512f")))
+void dfa_scan_batch_avx512(const struct dfa *dfa, struct dfa_stream *streams,
+			   size_t cnt)
+{
+	struct dfa_simd_lanes lanes;
+	const int width = DFA_SIMD_GROUPS * 16;
+
+	dfa_simd_lanes_init(dfa, &lanes, streams, cnt, width);
+
+	while (lanes.active != 0) {
+		uint32_t stop = 0;
+
+		dfa_simd_lanes_load(&lanes, width);
+
+		for (int g = 0; g < DFA_SIMD_GROUPS; g++)
+			stop |= dfa_simd_step_avx512(dfa, &lanes, g);
+
+		if (stop != 0)
+			dfa_simd_lanes_finish(dfa, &lanes, stop);
+	}
+}
+
+/**
+ * @brief Find escape bytes among 16 bytes.
+ *
+ * Low nibble of a byte selects the bit mask of its high nibbles from
+ * the lo (bytes below 0x80) or hi (bytes from 0x80) table, then the bit
+ * of the high nibble is checked.
+ *
+ * @param v	bytes to be checked
+ * @param lo	set of escape bytes below 0x80
+ * @param hi	set of escape bytes from 0x80
+ * @return	bit mask of escape bytes
+ */
+__attribute__((target("ssse3")))
+static inline uint32_t dfa_simd_escape_sse(__m128i v, __m128i lo, __m128i hi)
+{
+	const __m128i bitsel = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+					     1, 2, 4, 8, 16, 32, 64, -128);
+	__m128i set, bit;
+
+	set = _mm_or_si128(_mm_shuffle_epi8(lo, v),
+			   _mm_shuffle_epi8(hi, _mm_xor_si128(v,
+					    _mm_set1_epi8((char)0x80))));
+	bit = _mm_shuffle_epi8(bitsel, _mm_and_si128(_mm_srli_epi16(v, 4),
+						     _mm_set1_epi8(0x07)));
+	set = _mm_cmpeq_epi8(_mm_and_si128(set, bit), _mm_setzero_si128());
+
+	return ~(uint32_t)_mm_movemask_epi8(set) & 0xFFFF;
+}
+
+__attribute__((target("ssse3")))
+size_t dfa_scan_skip_ssse3(const struct dfa_accel *accel,
+			   const unsigned char *data, size_t len)
+{
+	const __m128i lo = _mm_loadu_si128((const __m128i *)accel->lo);
+	const __m128i hi = _mm_loadu_si128((const __m128i *)accel->hi);
+	size_t i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+		uint32_t mask = dfa_simd_escape_sse(v, lo, hi);
+
+		if (mask != 0)
+			return i + __builtin_ctz(mask);
+	}
+
+	for (; i < len; i++)
+		if (dfa_accel_is_escape(accel, data[i]))
+			break;
+
+	return i;
+}
+
+/**
+ * @brief Find escape bytes among 32 bytes.
+ *
+ * @param v	bytes to be checked
+ * @param lo	set of escape bytes below 0x80 in both halves
+ * @param hi	set of escape bytes from 0x80 in both halves
+ * @return	bit mask of escape bytes
+ */
+__attribute__((target("avx2")))
+static inline uint32_t dfa_simd_escape_avx2(__m256i v, __m256i lo, __m256i hi)
+{
+	const __m256i bitsel = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+						1, 2, 4, 8, 16, 32, 64, -128,
+						1, 2, 4, 8, 16, 32, 64, -128,
+						1, 2, 4, 8, 16, 32, 64, -128);
+	__m256i set, bit;
+
+	set = _mm256_or_si256(_mm256_shuffle_epi8(lo, v),
+			      _mm256_shuffle_epi8(hi, _mm256_xor_si256(v,
+					_mm256_set1_epi8((char)0x80))));
+	bit = _mm256_shuffle_epi8(bitsel,
+			_mm256_and_si256(_mm256_srli_epi16(v, 4),
+					 _mm256_set1_epi8(0x07)));
+	set = _mm256_cmpeq_epi8(_mm256_and_si256(set, bit),
+				_mm256_setzero_si256());
+
+	return ~(uint32_t)_mm256_movemask_epi8(set);
+}
+
+__attribute__((target("avx2")))
+size_t dfa_scan_skip_avx2(const struct dfa_accel *accel,
+			  const unsigned char *data, size_t len)
+{
+	const __m256i lo = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i *)accel->lo));
+	const __m256i hi = _mm256_broadcastsi128_si256(
+			_mm_loadu_si128((const __m128i *)accel->hi));
+	size_t i;
+
+	for (i = 0; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+		uint32_t mask = dfa_simd_escape_avx2(v, lo, hi);
+
+		if (mask != 0)
+			return i + __builtin_ctz(mask);
+	}
+
+	for (; i < len; i++)
+		if (dfa_accel_is_escape(accel, data[i]))
+			break;
+
+	return i;
+}
+
+bool dfa_scan_cpu_supports(enum dfa_scan_kernel kernel)
+{
+	switch (kernel) {
+	case DFA_SCAN_KERNEL_AVX2:
+		return __builtin_cpu_supports("avx2");
+	case DFA_SCAN_KERNEL_AVX512:
+		return __builtin_cpu_supports("avx512f");
+	default:
+		return true;
+	}
+}
+
+#else /* DFA_SCAN_X86_SIMD */
+
+bool dfa_scan_cpu_supports(enum dfa_scan_kernel kernel)
+{
+	return kernel == DFA_SCAN_KERNEL_AUTO ||
+	       kernel == DFA_SCAN_KERNEL_SCALAR;
+}
+
+#endif /* DFA_SCAN_X86_SIMD */
@@ -0,0 +1,347 @@
+/*
+ * Growable storage of the transitions of DFA.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* mremap() and MREMAP_MAYMOVE */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "dfa_storage.h"
+#include "endian_inner.h"
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS	MAP_ANON
+#endif
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE	(0)
+#endif
+
+/**
+ * @brief Smallest capacity of the storage in states.
+ */
+#define DFA_STORAGE_MIN_CNT	(32)
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+/**
+ * @brief Size of the page.
+ *
+ * @return	the size, at least 1
+ */
+static size_t dfa_storage_page(void)
+{
+	long page = sysconf(_SC_PAGESIZE);
+
+	return page > 0 ? page : DFA_MAP_ALIGN;
+}
+
+/**
+ * @brief Check that the DFA may get the storage.
+ *
+ * The DFA has to be empty, its allocated table is released.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @return	0 on success
+ */
+static int dfa_storage_prepare(struct dfa *dfa)
+{
+	if (dfa->state_cnt != 0 || dfa->map != NULL || dfa->storage != NULL)
+		return -1;
+
+	free(dfa->trans);
+	free(dfa->flags);
+	dfa->trans = NULL;
+	dfa->flags = NULL;
+	dfa->state_malloc_cnt = 0;
+
+	return 0;
+}
+
+int dfa_storage_vm(struct dfa *dfa, size_t reserve)
+{
+	struct dfa_storage *st;
+	size_t page = dfa_storage_page();
+
+	if (dfa_storage_prepare(dfa) != 0)
+		return -1;
+
+	if (reserve == 0)
+		reserve = DFA_STORAGE_RESERVE;
+	/* the table can not be larger */
+	if (dfa->state_max_cnt < SIZE_MAX / dfa->state_size)
+		reserve = MIN(reserve, dfa->state_max_cnt * dfa->state_size);
+	if (reserve > SIZE_MAX - page)
+		return -1;
+	reserve = _ALIGN_TO(MAX(reserve, 1), page);
+
+	st = malloc(sizeof(*st));
+	if (st == NULL)
+		return -1;
+
+	st->base = mmap(NULL, reserve, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (st->base == MAP_FAILED) {
+		free(st);
+		return -1;
+	}
+	st->kind = DFA_STORAGE_VM;
+	st->fd = -1;
+	st->size = reserve;
+	st->offset = 0;
+	st->file_size = 0;
+
+	dfa->storage = st;
+	dfa->trans = st->base;
+
+	return 0;
+}
+
+int dfa_storage_file(struct dfa *dfa, const char *filename)
+{
+	struct dfa_storage *st;
+	size_t size = _ALIGN_TO(DFA_MAP_ALIGN, dfa_storage_page());
+
+	if (dfa_storage_prepare(dfa) != 0)
+		return -1;
+
+	st = malloc(sizeof(*st));
+	if (st == NULL)
+		return -1;
+
+	/* the first page is left for the header of the image */
+	st->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (st->fd < 0) {
+		perror(filename);
+		free(st);
+		return -1;
+	}
+
+	if (ftruncate(st->fd, size) != 0 ||
+	    (st->base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			     st->fd, 0)) == MAP_FAILED) {
+		close(st->fd);
+		free(st);
+		return -1;
+	}
+	st->kind = DFA_STORAGE_FILE;
+	st->size = size;
+	st->offset = DFA_MAP_ALIGN;
+	st->file_size = size;
+
+	dfa->storage = st;
+	dfa->trans = (char *)st->base + st->offset;
+
+	return 0;
+}
+
+/**
+ * @brief Move the mapping to the larger address space.
+ *
+ * The pages are moved without copying where mremap() is available.
+ * Otherwise the file is mapped again and the used part of the anonymous
+ * memory is copied.
+ *
+ * @param st	pointer to the storage
+ * @param size	new size of the mapping
+ * @param used	size of the used part of the mapping
+ * @return	the new mapping or MAP_FAILED
+ */
+static void *dfa_storage_remap(struct dfa_storage *st, size_t size,
+			       size_t used)
+{
+#if HAVE_MREMAP
+	(void)used;
+
+	return mremap(st->base, st->size, size, MREMAP_MAYMOVE);
+#else
+	void *base;
+
+	if (st->kind == DFA_STORAGE_FILE)
+		base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			    st->fd, 0);
+	else
+		base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (base == MAP_FAILED)
+		return base;
+
+	if (st->kind != DFA_STORAGE_FILE)
+		memcpy(base, st->base, MIN(used, st->size));
+	munmap(st->base, st->size);
+
+	return base;
+#endif
+}
+
+int dfa_storage_reserve(struct dfa *dfa, size_t size)
+{
+	struct dfa_storage *st = dfa->storage;
+	size_t page = dfa_storage_page(), map_size, used;
+	void *base;
+
+	if (size > SIZE_MAX - st->offset - page)
+		return -1;
+	map_size = _ALIGN_TO(st->offset + size, page);
+
+	/* the file is sparse, only the written pages take the disk */
+	if (st->kind == DFA_STORAGE_FILE && st->file_size < map_size) {
+		if (ftruncate(st->fd, map_size) != 0)
+			return -1;
+		st->file_size = map_size;
+	}
+
+	if (map_size <= st->size)
+		return 0;
+
+	/* the reservation is doubled, the file grows with the states */
+	if (st->kind == DFA_STORAGE_VM && st->size <= (SIZE_MAX - page) / 2)
+		map_size = MAX(map_size, st->size * 2);
+
+	used = st->offset + dfa->state_malloc_cnt * dfa->state_size;
+	base = dfa_storage_remap(st, map_size, used);
+	if (base == MAP_FAILED)
+		return -1;
+
+	st->base = base;
+	st->size = map_size;
+	dfa->trans = (char *)st->base + st->offset;
+
+	return 0;
+}
+
+int dfa_storage_grow(struct dfa *dfa, size_t cnt)
+{
+	size_t new_cnt;
+	uint8_t *flags;
+
+	if (cnt > dfa->state_max_cnt || cnt > SIZE_MAX / dfa->state_size)
+		return -1;
+
+	new_cnt = MAX(cnt, DFA_STORAGE_MIN_CNT);
+	if (dfa->state_malloc_cnt <= SIZE_MAX / 2)
+		new_cnt = MAX(new_cnt, dfa->state_malloc_cnt * 2);
+	new_cnt = MIN(new_cnt, dfa->state_max_cnt);
+	new_cnt = MIN(new_cnt, SIZE_MAX / dfa->state_size);
+
+	if (dfa_storage_reserve(dfa, new_cnt * dfa->state_size) != 0)
+		return -1;
+
+	flags = realloc(dfa->flags, new_cnt * sizeof(*dfa->flags));
+	if (flags == NULL)
+		return -1;
+	dfa->flags = flags;
+	dfa->state_malloc_cnt = new_cnt;
+
+	return 0;
+}
+
+int dfa_storage_sync(struct dfa *dfa)
+{
+	struct dfa_storage *st = dfa->storage;
+	uint64_t trans_size, flags_off, comment_off, entry_off, entry_size = 0;
+	unsigned char buf[4096];
+	bool failure = false;
+	FILE *file;
+	int fd;
+
+	if (st == NULL || st->kind != DFA_STORAGE_FILE || !host_is_le())
+		return -1;
+
+	for (size_t i = 0; i < dfa->entry_cnt; i++)
+		entry_size += 16 + strlen(dfa->entries[i].name) + 1;
+
+	/* the sections follow the transitions that are already in the file */
+	trans_size = (uint64_t)dfa->state_cnt * dfa->state_size;
+	flags_off = st->offset + trans_size;
+	comment_off = flags_off + dfa->state_cnt;
+	entry_off = _ALIGN_TO(comment_off + dfa->comment_size, 8);
+
+	fd = dup(st->fd);
+	if (fd < 0)
+		return -1;
+	file = fdopen(fd, "r+");
+	if (file == NULL) {
+		close(fd);
+		return -1;
+	}
+
+	failure = fseek(file, 0, SEEK_SET) != 0 ||
+		  dfa_save_map_header(dfa, file, comment_off, entry_off,
+				      entry_size, flags_off, st->offset) != 0 ||
+		  fseek(file, flags_off, SEEK_SET) != 0;
+
+	/* acceleration is not stored, it depends on the scanner's CPU */
+	for (size_t i = 0; i < dfa->state_cnt && !failure; i += sizeof(buf)) {
+		size_t len = MIN(dfa->state_cnt - i, sizeof(buf));
+
+		for (size_t j = 0; j < len; j++)
+			buf[j] = dfa->flags[i + j] & (0xFF ^ DFA_FLAG_ACCEL);
+		failure = fwrite(buf, 1, len, file) != len;
+	}
+
+	memset(buf, 0x00, 8);
+	failure = failure ||
+		  fwrite(dfa->comment, 1, dfa->comment_size, file) !=
+		  dfa->comment_size ||
+		  fwrite(buf, 1, entry_off - comment_off - dfa->comment_size,
+			 file) != entry_off - comment_off - dfa->comment_size;
+
+	for (size_t i = 0; i < dfa->entry_cnt && !failure; i++) {
+		size_t len = strlen(dfa->entries[i].name) + 1;
+
+		put_le64(buf, dfa->entries[i].state);
+		put_le64(buf + 8, len);
+		failure = fwrite(buf, 16, 1, file) != 1 ||
+			  fwrite(dfa->entries[i].name, 1, len, file) != len;
+	}
+
+	failure = fclose(file) != 0 || failure;
+
+	/* the pages past the end are not touched until the next growth */
+	failure = failure || ftruncate(st->fd, entry_off + entry_size) != 0;
+	if (!failure) {
+		st->file_size = entry_off + entry_size;
+		dfa->state_malloc_cnt = dfa->state_cnt;
+	}
+
+	failure = failure || msync(st->base, MIN(st->size, st->file_size),
+				   MS_SYNC) != 0 ||
+		  fsync(st->fd) != 0;
+
+	return !failure ? 0 : -1;
+}
+
+void dfa_storage_free(struct dfa *dfa)
+{
+	struct dfa_storage *st = dfa->storage;
+
+	munmap(st->base, st->size);
+	if (st->fd >= 0)
+		close(st->fd);
+	free(st);
+
+	dfa->storage = NULL;
+	dfa->trans = NULL;
+}
@@ -0,0 +1,154 @@
+/*
+ * Growable storage of the transitions of DFA.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup dfa_storage dfa_storage
+ * @{
+ */
+
+#ifndef REFA_DFA_STORAGE_H
+#define REFA_DFA_STORAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "dfa.h"
+
+/**
+ * the transitions are kept in the reserved address space
+ */
+#define DFA_STORAGE_VM		(1)
+
+/**
+ * the transitions are kept in the mapping of the sparse file
+ */
+#define DFA_STORAGE_FILE	(2)
+
+/**
+ * default size of the reserved address space in bytes
+ */
+#define DFA_STORAGE_RESERVE	((size_t)1 << (sizeof(size_t) > 4 ? 32 : 26))
+
+/**
+ * structure that represents the storage of the transitions of DFA
+ *
+ * By default the transition table is allocated with malloc and is
+ * copied by realloc every DFA_CHUNK_SIZE new states. The storage keeps
+ * the table in the mapping instead: the growth only extends the mapping,
+ * the states are never copied and the capacity is doubled, so
+ * dfa_add_state() takes constant amortized time.
+ *
+ * DFA_STORAGE_VM reserves the address space without the backing memory,
+ * the pages are committed by the kernel when they are written first.
+ * The reservation is moved by mremap() when it is exhausted.
+ *
+ * DFA_STORAGE_FILE maps the sparse file that is extended by ftruncate().
+ * The table lies in the file at DFA_MAP_ALIGN as in the mappable image,
+ * so dfa_storage_sync() only appends the flags, the comment and the
+ * entries and the file can be mapped by dfa_map_file().
+ *
+ * The flags are allocated with malloc in both cases, they take one byte
+ * per state.
+ */
+struct dfa_storage {
+	/**
+	 * DFA_STORAGE_VM or DFA_STORAGE_FILE
+	 */
+	int kind;
+
+	/**
+	 * descriptor of the file, -1 for DFA_STORAGE_VM
+	 */
+	int fd;
+
+	/**
+	 * start of the mapping
+	 */
+	void *base;
+
+	/**
+	 * size of the mapping
+	 */
+	size_t size;
+
+	/**
+	 * offset of the transitions in the mapping
+	 */
+	size_t offset;
+
+	/**
+	 * size of the file, less than the mapping after dfa_storage_sync()
+	 */
+	uint64_t file_size;
+};
+
+/**
+ * Keep the transitions of the empty DFA in the reserved address space.
+ *
+ * @param dfa		pointer to the initialized empty dfa structure
+ * @param reserve	size of the reserved address space in bytes,
+ *			0 for DFA_STORAGE_RESERVE
+ * @return		0 on success
+ */
+int dfa_storage_vm(struct dfa *dfa, size_t reserve);
+
+/**
+ * Keep the transitions of the empty DFA in the file.
+ *
+ * The file is created or truncated, it is left on disk by dfa_free().
+ *
+ * @param dfa		pointer to the initialized empty dfa structure
+ * @param filename	path to the file
+ * @return		0 on success
+ */
+int dfa_storage_file(struct dfa *dfa, const char *filename);
+
+/**
+ * Make the file of DFA_STORAGE_FILE the mappable image of the DFA.
+ *
+ * The file is truncated to the size of the image and written to disk.
+ * It stays valid until the DFA is changed, the next call updates it.
+ * Works only on little-endian hosts.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @return	0 on success
+ */
+int dfa_storage_sync(struct dfa *dfa);
+
+/**
+ * Make room for the states of the DFA.
+ *
+ * Called by dfa_add_state() instead of realloc. The transitions and
+ * the flags of the existing states are kept.
+ *
+ * @param dfa	pointer to the dfa structure with the storage
+ * @param cnt	required number of states
+ * @return	0 on success
+ */
+int dfa_storage_grow(struct dfa *dfa, size_t cnt);
+
+/**
+ * Make the transition table at least size bytes long.
+ *
+ * Used when the size of the states changes.
+ *
+ * @param dfa	pointer to the dfa structure with the storage
+ * @param size	required size of the table in bytes
+ * @return	0 on success
+ */
+int dfa_storage_reserve(struct dfa *dfa, size_t size);
+
+/**
+ * Release the storage and the transitions of the DFA.
+ *
+ * Called by dfa_free().
+ *
+ * @param dfa	pointer to the dfa structure with the storage
+ */
+void dfa_storage_free(struct dfa *dfa);
+
+#endif /** REFA_DFA_STORAGE_H @} */
@@ -0,0 +1,166 @@
+/*
+ * Scanning of data with two-byte transition tables.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfa_stride.h"
+
+/**
+ * @brief Flags of the states that stop the scan.
+ */
+#define DFA_STRIDE_STOP_FLAGS	(DFA_FLAG_FINAL | DFA_FLAG_DEADEND)
+
+/**
+ * @brief Size of the tables for the number of states and byte classes.
+ *
+ * @param state_cnt	number of states
+ * @param class_cnt	number of byte classes
+ * @param size		place for the size in bytes
+ * @return		0 on success, -1 if the entries of the pair table
+ *			can not index all states
+ */
+static int dfa_stride_tables_size(size_t state_cnt, size_t class_cnt,
+				  size_t *size)
+{
+	size_t row = class_cnt * class_cnt;
+
+	if (state_cnt != 0 && row > (DFA_STRIDE_ROW + (size_t)1) / state_cnt)
+		return -1;
+
+	*size = sizeof(uint32_t) * state_cnt * (row + class_cnt) + state_cnt;
+
+	return 0;
+}
+
+size_t dfa_stride_size(const struct dfa *dfa)
+{
+	uint8_t classes[256];
+	size_t size;
+
+	if (dfa_stride_tables_size(dfa->state_cnt,
+				   dfa_byte_classes(dfa, classes), &size) != 0)
+		return SIZE_MAX;
+
+	return size;
+}
+
+int dfa_stride_alloc(struct dfa_stride *ds, const struct dfa *dfa,
+		     size_t max_size)
+{
+	int rep[256];
+	size_t row;
+
+	memset(ds, 0x00, sizeof(*ds));
+
+	ds->class_cnt = dfa_byte_classes(dfa, ds->classes);
+	ds->state_cnt = dfa->state_cnt;
+	if (ds->state_cnt == 0 ||
+	    dfa_stride_tables_size(ds->state_cnt, ds->class_cnt,
+				   &ds->size) != 0 ||
+	    ds->size > max_size) {
+		ds->size = 0;
+		return -1;
+	}
+
+	for (int c = 255; c >= 0; c--)
+		rep[ds->classes[c]] = c;
+
+	row = ds->class_cnt * ds->class_cnt;
+	ds->pair = malloc(sizeof(uint32_t) * ds->state_cnt * row);
+	ds->single = malloc(sizeof(uint32_t) * ds->state_cnt * ds->class_cnt);
+	ds->flags = malloc(ds->state_cnt);
+	if (ds->pair == NULL || ds->single == NULL || ds->flags == NULL) {
+		dfa_stride_free(ds);
+		return -1;
+	}
+
+	for (size_t i = 0; i < ds->state_cnt; i++)
+		ds->flags[i] = dfa->flags[i] & DFA_STRIDE_STOP_FLAGS;
+
+	for (size_t i = 0; i < ds->state_cnt; i++) {
+		for (size_t k1 = 0; k1 < ds->class_cnt; k1++) {
+			size_t mid = dfa_get_trans(dfa, i, rep[k1]);
+
+			ds->single[i * ds->class_cnt + k1] = mid;
+
+			for (size_t k2 = 0; k2 < ds->class_cnt; k2++) {
+				uint32_t *entry;
+				size_t to;
+
+				entry = &ds->pair[i * row + k1 * ds->class_cnt + k2];
+
+				if (ds->flags[mid] != 0) {
+					*entry = mid * row | DFA_STRIDE_MID;
+					continue;
+				}
+
+				to = dfa_get_trans(dfa, mid, rep[k2]);
+				*entry = to * row;
+				if (ds->flags[to] != 0)
+					*entry |= DFA_STRIDE_STOP;
+			}
+		}
+	}
+
+	return 0;
+}
+
+void dfa_stride_free(struct dfa_stride *ds)
+{
+	free(ds->pair);
+	free(ds->single);
+	free(ds->flags);
+	memset(ds, 0x00, sizeof(*ds));
+}
+
+size_t dfa_stride_scan(const struct dfa_stride *ds, size_t *state,
+		       const void *data, size_t len)
+{
+	const unsigned char *ptr = data;
+	const uint8_t *classes = ds->classes;
+	const size_t class_cnt = ds->class_cnt;
+	const size_t row = class_cnt * class_cnt;
+	size_t cur = *state * row;
+	size_t i = 0;
+
+	if (ds->flags[*state] & DFA_FLAG_FINAL)
+		return 0;
+
+	if (ds->flags[*state] & DFA_FLAG_DEADEND)
+		return DFA_SCAN_NO_MATCH;
+
+	for (; i + 1 < len; i += 2) {
+		uint32_t entry;
+
+		entry = ds->pair[cur + classes[ptr[i]] * class_cnt +
+				 classes[ptr[i + 1]]];
+		cur = entry & DFA_STRIDE_ROW;
+
+		if (entry & (DFA_STRIDE_MID | DFA_STRIDE_STOP)) {
+			*state = cur / row;
+			if (!(ds->flags[*state] & DFA_FLAG_FINAL))
+				return DFA_SCAN_NO_MATCH;
+
+			return (entry & DFA_STRIDE_MID) ? i + 1 : i + 2;
+		}
+	}
+
+	*state = cur / row;
+
+	/* the last byte of the data with odd length */
+	if (i < len) {
+		*state = ds->single[*state * class_cnt + classes[ptr[i]]];
+		if (ds->flags[*state] & DFA_FLAG_FINAL)
+			return i + 1;
+	}
+
+	return DFA_SCAN_NO_MATCH;
+}
@@ -0,0 +1,123 @@
+/*
+ * Scanning of data with two-byte transition tables.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup scan scan
+ * @{
+ */
+
+#ifndef REFA_DFA_STRIDE_H
+#define REFA_DFA_STRIDE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dfa.h"
+#include "dfa_scan.h"
+
+/** the first byte of the pair leads to a final or a deadend state */
+#define DFA_STRIDE_MID		(0x80000000u)
+
+/** the pair leads to a final or a deadend state */
+#define DFA_STRIDE_STOP		(0x40000000u)
+
+/** mask of the row offset in the entry of the table */
+#define DFA_STRIDE_ROW		(0x3FFFFFFFu)
+
+/**
+ * structure that represents DFA that reads two bytes per transition
+ *
+ * An entry of the pair table is the offset of the next state's row
+ * with DFA_STRIDE_* flags. When the first byte of the pair already
+ * stops the scan, the entry points to the intermediate state instead.
+ */
+struct dfa_stride {
+	/**
+	 * number of states
+	 */
+	size_t state_cnt;
+
+	/**
+	 * classes of bytes (see dfa_byte_classes())
+	 */
+	uint8_t classes[256];
+
+	/**
+	 * number of byte classes
+	 */
+	size_t class_cnt;
+
+	/**
+	 * transitions by pairs of byte classes,
+	 * state_cnt * class_cnt * class_cnt entries
+	 */
+	uint32_t *pair;
+
+	/**
+	 * transitions by single byte classes for the last byte of the data
+	 * with odd length, state_cnt * class_cnt entries
+	 */
+	uint32_t *single;
+
+	/**
+	 * flags of the states (DFA_FLAG_FINAL and DFA_FLAG_DEADEND)
+	 */
+	uint8_t *flags;
+
+	/**
+	 * memory used by the tables in bytes
+	 */
+	size_t size;
+};
+
+/**
+ * Memory needed for two-byte tables of DFA.
+ *
+ * @param dfa	pointer to the dfa structure
+ * @return	size of the tables in bytes, SIZE_MAX if the tables can not
+ *		be built for so many states
+ */
+size_t dfa_stride_size(const struct dfa *dfa);
+
+/**
+ * Build two-byte tables of DFA.
+ *
+ * The size of the pair table grows with the square of the number of byte
+ * classes, so it is worth only for small DFAs.
+ *
+ * @param ds		pointer to the dfa_stride structure
+ * @param dfa		pointer to the source dfa structure
+ * @param max_size	maximum size of the tables in bytes
+ * @return		0 on success, -1 on error, if the tables need more
+ *			than max_size bytes or can not index all states
+ */
+int dfa_stride_alloc(struct dfa_stride *ds, const struct dfa *dfa,
+		     size_t max_size);
+
+/**
+ * Free two-byte tables.
+ *
+ * @param ds	pointer to the dfa_stride structure
+ */
+void dfa_stride_free(struct dfa_stride *ds);
+
+/**
+ * Scan data with two-byte tables.
+ *
+ * Works as dfa_scan() with the source DFA (states are the same) but
+ * makes half as many dependent loads.
+ *
+ * @param ds	pointer to the dfa_stride structure
+ * @param state	pointer to the current state, it is updated
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @return	offset just past the byte that led to an accepting state
+ *		or DFA_SCAN_NO_MATCH
+ */
+size_t dfa_stride_scan(const struct dfa_stride *ds, size_t *state,
+		       const void *data, size_t len);
+
+#endif /** REFA_DFA_STRIDE_H @} */
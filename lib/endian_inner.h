@@ -0,0 +1,106 @@
+/*
+ * Little-endian encoding of the values stored in the files.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#ifndef REFA_ENDIAN_INNER_H
+#define REFA_ENDIAN_INNER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef _ALIGN_TO
+#define _ALIGN_TO(a, b)	((((a) + (b) - 1) / (b)) * (b))
+#endif
+
+/**
+ * @brief Store value in little-endian order.
+ *
+ * @param dst	place for the value
+ * @param val	the value
+ * @param len	size of the value in bytes, at most 8
+ */
+static inline void put_le(unsigned char *dst, uint64_t val, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		dst[i] = val >> (8 * i);
+}
+
+/**
+ * @brief Get value stored in little-endian order.
+ *
+ * @param src	place of the value
+ * @param len	size of the value in bytes, at most 8
+ * @return	the value
+ */
+static inline uint64_t get_le(const unsigned char *src, size_t len)
+{
+	uint64_t val = 0;
+
+	for (size_t i = 0; i < len; i++)
+		val |= (uint64_t)src[i] << (8 * i);
+
+	return val;
+}
+
+/**
+ * @brief Store 64-bit value in little-endian order.
+ *
+ * @param dst	place for the value
+ * @param val	the value
+ */
+static inline void put_le64(unsigned char *dst, uint64_t val)
+{
+	put_le(dst, val, 8);
+}
+
+/**
+ * @brief Get 64-bit value stored in little-endian order.
+ *
+ * @param src	place of the value
+ * @return	the value
+ */
+static inline uint64_t get_le64(const unsigned char *src)
+{
+	return get_le(src, 8);
+}
+
+/**
+ * @brief Check if the values in memory are in little-endian order.
+ *
+ * @return	true on little-endian hosts
+ */
+static inline bool host_is_le(void)
+{
+	const uint16_t one = 1;
+
+	return *(const uint8_t *)&one == 1;
+}
+
+/**
+ * @brief Write zero bytes up to the offset.
+ *
+ * @param file	file being written
+ * @param from	current offset in the file
+ * @param to	offset where the next data starts
+ * @return	0 on success
+ */
+static inline int write_pad(FILE *file, uint64_t from, uint64_t to)
+{
+	static const unsigned char zero[64];
+
+	while (from < to) {
+		size_t len = to - from < sizeof(zero) ? to - from :
+							 sizeof(zero);
+
+		if (fwrite(zero, 1, len, file) != len)
+			return -1;
+		from += len;
+	}
+
+	return 0;
+}
+
+#endif /* REFA_ENDIAN_INNER_H */
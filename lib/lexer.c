@@ -0,0 +1,556 @@
+/*
+ * Longest-match tokenizer built from a set of rules.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer.h"
+#include "literal.h"
+#include "parser.h"
+#include "tree_to_nfa.h"
+
+/**
+ * @brief Marker of the empty slot of the hash table.
+ */
+#define LEXER_EMPTY	((size_t)-1)
+
+/**
+ * @brief Sets of NFA states that are the states of the DFA.
+ */
+struct lexer_sets {
+	/**
+	 * @brief NFA states of all sets.
+	 */
+	size_t *pool;
+
+	/**
+	 * @brief Number of used elements of the pool.
+	 */
+	size_t pool_len;
+
+	/**
+	 * @brief Number of allocated elements of the pool.
+	 */
+	size_t pool_size;
+
+	/**
+	 * @brief Offsets of the sets in the pool, indexed by DFA states.
+	 */
+	size_t *offset;
+
+	/**
+	 * @brief Number of states in the sets, indexed by DFA states.
+	 */
+	size_t *len;
+
+	/**
+	 * @brief Number of allocated sets.
+	 */
+	size_t malloc_cnt;
+
+	/**
+	 * @brief Hash table of the DFA states.
+	 */
+	size_t *slots;
+
+	/**
+	 * @brief Size of the hash table, a power of two.
+	 */
+	size_t slot_cnt;
+};
+
+int lexer_alloc(struct lexer *lx)
+{
+	memset(lx, 0x00, sizeof(*lx));
+
+	return nfa_alloc(&lx->nfa);
+}
+
+void lexer_free(struct lexer *lx)
+{
+	nfa_free(&lx->nfa);
+	if (lx->compiled)
+		dfa_free(&lx->dfa);
+	free(lx->node_rule);
+	free(lx->rule_first);
+	free(lx->state_rule);
+	memset(lx, 0x00, sizeof(*lx));
+}
+
+int lexer_add(struct lexer *lx, const char *regexp, size_t *id)
+{
+	struct regexp_tree *re_tree;
+	const struct regexp_node *core;
+	struct nfa nfa;
+	size_t offset, *tmp;
+	bool floating, failure = false;
+
+	if (lx->rule_cnt == lx->malloc_cnt) {
+		size_t new_cnt = lx->malloc_cnt != 0 ? lx->malloc_cnt * 2 : 16;
+
+		tmp = realloc(lx->rule_first, sizeof(size_t) * new_cnt);
+		if (tmp == NULL)
+			return -1;
+
+		lx->rule_first = tmp;
+		lx->malloc_cnt = new_cnt;
+	}
+
+	re_tree = regexp_to_tree(regexp, NULL);
+	if (re_tree == NULL)
+		return -1;
+
+	core = regexp_tree_core(re_tree, &floating);
+
+	nfa_alloc(&nfa);
+	failure = convert_node_to_lambdanfa(&nfa, core) != 0 ||
+		  nfa_rebuild(&nfa) != 0;
+	regexp_tree_free(re_tree);
+
+	failure = failure ||
+		  nfa_add_node_n(&lx->nfa, nfa.node_cnt, &offset) != 0;
+
+	if (!failure) {
+		tmp = realloc(lx->node_rule, sizeof(size_t) * lx->nfa.node_cnt);
+		failure = tmp == NULL;
+		if (!failure)
+			lx->node_rule = tmp;
+	}
+
+	for (size_t i = 0; i < nfa.node_cnt && !failure; i++) {
+		lx->node_rule[offset + i] = lx->rule_cnt;
+		lx->nfa.nodes[offset + i].isfinal = nfa.nodes[i].isfinal;
+
+		for (int c = 0; c < 256; c++)
+			for (size_t k = 0; k < nfa.nodes[i].trans_cnt[c]; k++)
+				failure = failure ||
+					  nfa_add_trans(&lx->nfa, offset + i, c,
+						offset + nfa.nodes[i].trans[c][k]) != 0;
+	}
+
+	if (!failure) {
+		lx->rule_first[lx->rule_cnt] = offset + nfa.first_index;
+		if (id != NULL)
+			*id = lx->rule_cnt;
+		lx->rule_cnt++;
+	}
+
+	/* the DFA of the previous rules is rebuilt by lexer_compile() */
+	if (!failure && lx->compiled) {
+		dfa_free(&lx->dfa);
+		lx->compiled = false;
+	}
+
+	nfa_free(&nfa);
+
+	return !failure ? 0 : -1;
+}
+
+/**
+ * @brief Hash of the set of NFA states.
+ *
+ * @param set	sorted NFA states
+ * @param len	number of states
+ * @return	hash value
+ */
+static size_t lexer_set_hash(const size_t *set, size_t len)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= set[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash ^ (hash >> 31);
+}
+
+/**
+ * @brief Compare NFA states for qsort().
+ */
+static int lexer_cmp(const void *a, const void *b)
+{
+	size_t x = *(const size_t *)a, y = *(const size_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Grow hash table of the DFA states twice.
+ *
+ * @param sets	pointer to the sets
+ * @param cnt	number of DFA states
+ * @return	0 on success
+ */
+static int lexer_sets_rehash(struct lexer_sets *sets, size_t cnt)
+{
+	size_t slot_cnt = sets->slot_cnt * 2;
+	size_t *slots;
+
+	slots = malloc(sizeof(size_t) * slot_cnt);
+	if (slots == NULL)
+		return -1;
+
+	memset(slots, 0xFF, sizeof(size_t) * slot_cnt);
+
+	for (size_t i = 0; i < cnt; i++) {
+		size_t slot = lexer_set_hash(&sets->pool[sets->offset[i]],
+					     sets->len[i]) & (slot_cnt - 1);
+
+		while (slots[slot] != LEXER_EMPTY)
+			slot = (slot + 1) & (slot_cnt - 1);
+		slots[slot] = i;
+	}
+
+	free(sets->slots);
+	sets->slots = slots;
+	sets->slot_cnt = slot_cnt;
+
+	return 0;
+}
+
+/**
+ * @brief Find DFA state of the set or add the new one.
+ *
+ * @param lx	pointer to the lexer structure
+ * @param sets	pointer to the sets
+ * @param set	sorted NFA states
+ * @param len	number of states
+ * @param index	place for the DFA state
+ * @return	0 on success
+ */
+static int lexer_sets_get(struct lexer *lx, struct lexer_sets *sets,
+			  const size_t *set, size_t len, size_t *index)
+{
+	size_t slot, rule = LEXER_NO_RULE, cnt = lx->dfa.state_cnt;
+
+	slot = lexer_set_hash(set, len) & (sets->slot_cnt - 1);
+	for (; sets->slots[slot] != LEXER_EMPTY;
+	     slot = (slot + 1) & (sets->slot_cnt - 1)) {
+		size_t i = sets->slots[slot];
+
+		if (sets->len[i] == len &&
+		    memcmp(&sets->pool[sets->offset[i]], set,
+			   sizeof(size_t) * len) == 0) {
+			*index = i;
+			return 0;
+		}
+	}
+
+	if (cnt == sets->malloc_cnt) {
+		size_t new_cnt = sets->malloc_cnt * 2;
+		size_t *offset, *lens, *rules;
+
+		offset = realloc(sets->offset, sizeof(size_t) * new_cnt);
+		if (offset != NULL)
+			sets->offset = offset;
+		lens = realloc(sets->len, sizeof(size_t) * new_cnt);
+		if (lens != NULL)
+			sets->len = lens;
+		rules = realloc(lx->state_rule, sizeof(size_t) * new_cnt);
+		if (rules != NULL)
+			lx->state_rule = rules;
+
+		if (offset == NULL || lens == NULL || rules == NULL)
+			return -1;
+		sets->malloc_cnt = new_cnt;
+	}
+
+	if (sets->pool_len + len > sets->pool_size) {
+		size_t new_size = (sets->pool_size + len) * 2;
+		size_t *pool;
+
+		pool = realloc(sets->pool, sizeof(size_t) * new_size);
+		if (pool == NULL)
+			return -1;
+
+		sets->pool = pool;
+		sets->pool_size = new_size;
+	}
+
+	if (dfa_add_state(&lx->dfa, index) != 0)
+		return -1;
+
+	memcpy(&sets->pool[sets->pool_len], set, sizeof(size_t) * len);
+	sets->offset[cnt] = sets->pool_len;
+	sets->len[cnt] = len;
+	sets->pool_len += len;
+	sets->slots[slot] = cnt;
+
+	/* the rule that was added first wins */
+	for (size_t i = 0; i < len; i++)
+		if (lx->nfa.nodes[set[i]].isfinal &&
+		    lx->node_rule[set[i]] < rule)
+			rule = lx->node_rule[set[i]];
+
+	lx->state_rule[cnt] = rule;
+	if (rule != LEXER_NO_RULE)
+		dfa_state_set_final(&lx->dfa, cnt, 1);
+
+	if ((cnt + 1) * 2 > sets->slot_cnt)
+		return lexer_sets_rehash(sets, cnt + 1);
+
+	return 0;
+}
+
+int lexer_compile(struct lexer *lx)
+{
+	struct lexer_sets sets;
+	size_t *next, *stamp;
+	size_t index, cur_stamp = 0;
+	bool failure = false;
+
+	if (lx->rule_cnt == 0)
+		return -1;
+
+	if (lx->compiled) {
+		dfa_free(&lx->dfa);
+		lx->compiled = false;
+	}
+
+	memset(&sets, 0x00, sizeof(sets));
+	sets.malloc_cnt = 64;
+	sets.slot_cnt = 256;
+	sets.offset = malloc(sizeof(size_t) * sets.malloc_cnt);
+	sets.len = malloc(sizeof(size_t) * sets.malloc_cnt);
+	sets.slots = malloc(sizeof(size_t) * sets.slot_cnt);
+	free(lx->state_rule);
+	lx->state_rule = malloc(sizeof(size_t) * sets.malloc_cnt);
+	next = malloc(sizeof(size_t) * (lx->nfa.node_cnt + lx->rule_cnt));
+	stamp = calloc(lx->nfa.node_cnt + 1, sizeof(size_t));
+
+	failure = sets.offset == NULL || sets.len == NULL ||
+		  sets.slots == NULL || lx->state_rule == NULL ||
+		  next == NULL || stamp == NULL || dfa_alloc(&lx->dfa) != 0;
+
+	if (!failure) {
+		size_t len = 0;
+
+		memset(sets.slots, 0xFF, sizeof(size_t) * sets.slot_cnt);
+
+		memcpy(next, lx->rule_first, sizeof(size_t) * lx->rule_cnt);
+		qsort(next, lx->rule_cnt, sizeof(size_t), lexer_cmp);
+		for (size_t i = 0; i < lx->rule_cnt; i++)
+			if (len == 0 || next[len - 1] != next[i])
+				next[len++] = next[i];
+
+		failure = lexer_sets_get(lx, &sets, next, len, &index) != 0;
+		lx->dfa.first_index = index;
+		/* empty tokens are not allowed */
+		lx->state_rule[index] = LEXER_NO_RULE;
+		dfa_state_set_final(&lx->dfa, index, 0);
+	}
+
+	for (size_t i = 0; i < lx->dfa.state_cnt && !failure; i++) {
+		for (int c = 0; c < 256 && !failure; c++) {
+			size_t len = 0;
+
+			cur_stamp++;
+			for (size_t j = 0; j < sets.len[i]; j++) {
+				const struct nfa_node *node;
+
+				node = &lx->nfa.nodes[sets.pool[sets.offset[i] + j]];
+				for (size_t k = 0; k < node->trans_cnt[c]; k++) {
+					size_t to = node->trans[c][k];
+
+					if (stamp[to] != cur_stamp) {
+						stamp[to] = cur_stamp;
+						next[len++] = to;
+					}
+				}
+			}
+
+			qsort(next, len, sizeof(size_t), lexer_cmp);
+			failure = lexer_sets_get(lx, &sets, next, len,
+						 &index) != 0 ||
+				  dfa_add_trans(&lx->dfa, i, c, index) != 0;
+		}
+	}
+
+	/* the empty set is the only state that never returns a token */
+	for (size_t i = 0; i < lx->dfa.state_cnt && !failure; i++)
+		if (sets.len[i] == 0)
+			lx->dfa.flags[i] |= DFA_FLAG_DEADEND;
+
+	failure = failure || dfa_compress(&lx->dfa) != 0;
+
+	free(sets.pool);
+	free(sets.offset);
+	free(sets.len);
+	free(sets.slots);
+	free(next);
+	free(stamp);
+
+	if (failure) {
+		dfa_free(&lx->dfa);
+		return -1;
+	}
+
+	lx->compiled = true;
+
+	return 0;
+}
+
+/**
+ * @brief Report the longest token and start the next one after it.
+ *
+ * @param lx	pointer to the lexer structure
+ * @param st	pointer to the state of the stream
+ * @param cb	callback for the tokens
+ * @param ctx	user's context of the callback
+ * @return	0 on success, 1 if the callback stopped the tokenizer,
+ *		-1 if there is no token
+ */
+static int lexer_token(const struct lexer *lx, struct lexer_stream *st,
+		       lexer_token_cb cb, void *ctx)
+{
+	size_t rule = st->rule, start = st->start;
+
+	if (rule == LEXER_NO_RULE)
+		return -1;
+
+	st->start = st->end;
+	st->pos = st->end;
+	st->state = lx->dfa.first_index;
+	st->rule = LEXER_NO_RULE;
+
+	return cb(rule, start, st->end, ctx) != 0 ? 1 : 0;
+}
+
+/**
+ * @brief Tokenize the chunk of the stream.
+ *
+ * Bytes before the chunk are taken from the buffer of the stream.
+ *
+ * @param lx	pointer to the lexer structure
+ * @param st	pointer to the state of the stream
+ * @param data	the chunk
+ * @param len	size of the chunk
+ * @param eof	the chunk is the last one
+ * @param cb	callback for the tokens
+ * @param ctx	user's context of the callback
+ * @return	0 on success, 1 if the callback stopped the tokenizer,
+ *		-1 if no rule matches at st->start
+ */
+static int lexer_run(const struct lexer *lx, struct lexer_stream *st,
+		     const unsigned char *data, size_t len, bool eof,
+		     lexer_token_cb cb, void *ctx)
+{
+	const struct dfa *dfa = &lx->dfa;
+	size_t buf_base = st->start;
+	size_t base = st->start + st->buf_len;
+	int res;
+
+	for (;;) {
+		while (st->pos < base + len) {
+			unsigned char c = st->pos < base ?
+					  st->buf[st->pos - buf_base] :
+					  data[st->pos - base];
+
+			st->state = dfa_get_trans(dfa, st->state, c);
+			st->pos++;
+
+			if (dfa->flags[st->state] & DFA_FLAG_DEADEND) {
+				res = lexer_token(lx, st, cb, ctx);
+				if (res != 0)
+					return res;
+				continue;
+			}
+
+			if (lx->state_rule[st->state] != LEXER_NO_RULE) {
+				st->rule = lx->state_rule[st->state];
+				st->end = st->pos;
+			}
+		}
+
+		if (!eof || st->start == base + len)
+			return 0;
+
+		res = lexer_token(lx, st, cb, ctx);
+		if (res != 0)
+			return res;
+	}
+}
+
+size_t lexer_scan(const struct lexer *lx, const void *data, size_t len,
+		  lexer_token_cb cb, void *ctx)
+{
+	struct lexer_stream st;
+
+	memset(&st, 0x00, sizeof(st));
+	st.state = lx->dfa.first_index;
+	st.rule = LEXER_NO_RULE;
+
+	lexer_run(lx, &st, data, len, true, cb, ctx);
+
+	return st.start;
+}
+
+int lexer_stream_alloc(const struct lexer *lx, struct lexer_stream *st)
+{
+	memset(st, 0x00, sizeof(*st));
+	st->state = lx->dfa.first_index;
+	st->rule = LEXER_NO_RULE;
+
+	return 0;
+}
+
+void lexer_stream_free(struct lexer_stream *st)
+{
+	free(st->buf);
+	memset(st, 0x00, sizeof(*st));
+}
+
+int lexer_stream_feed(const struct lexer *lx, struct lexer_stream *st,
+		      const void *data, size_t len, lexer_token_cb cb,
+		      void *ctx)
+{
+	size_t buf_base = st->start;
+	size_t base = st->start + st->buf_len;
+	size_t keep, from_buf;
+	int res;
+
+	res = lexer_run(lx, st, data, len, false, cb, ctx);
+
+	/* keep the bytes of the unfinished token */
+	keep = base + len - st->start;
+	from_buf = st->start < base ? base - st->start : 0;
+
+	if (keep > st->buf_size) {
+		size_t new_size = keep * 2;
+		unsigned char *buf;
+
+		buf = realloc(st->buf, new_size);
+		if (buf == NULL)
+			return -1;
+
+		st->buf = buf;
+		st->buf_size = new_size;
+	}
+
+	if (from_buf != 0)
+		memmove(st->buf, st->buf + (st->start - buf_base), from_buf);
+	if (keep != from_buf)
+		memcpy(st->buf + from_buf, (const unsigned char *)data + len -
+		       (keep - from_buf), keep - from_buf);
+	st->buf_len = keep;
+
+	return res;
+}
+
+int lexer_stream_finish(const struct lexer *lx, struct lexer_stream *st,
+			lexer_token_cb cb, void *ctx)
+{
+	int res;
+
+	res = lexer_run(lx, st, NULL, 0, true, cb, ctx);
+
+	return res;
+}
@@ -0,0 +1,238 @@
+/*
+ * Longest-match tokenizer built from a set of rules.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup lexer lexer
+ * @{
+ */
+
+#ifndef REFA_LEXER_H
+#define REFA_LEXER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "dfa.h"
+#include "nfa.h"
+
+/** rule of the state that accepts nothing */
+#define LEXER_NO_RULE	((size_t)-1)
+
+/**
+ * callback that is called for every token
+ *
+ * @param rule	identifier of the rule that matched the token
+ * @param start	offset of the first byte of the token
+ * @param end	offset just past the last byte of the token
+ * @param ctx	user's context
+ * @return	0 to continue, other values stop the tokenizer
+ */
+typedef int (*lexer_token_cb)(size_t rule, size_t start, size_t end,
+			      void *ctx);
+
+/**
+ * structure that represents set of lexer rules
+ *
+ * Rules are anchored at the beginning of the token, the anchors and
+ * '.*' of the regexps are ignored. The DFA is built from the union of
+ * the rules, every accepting state knows the rule with the lowest
+ * identifier among the rules that accept there.
+ */
+struct lexer {
+	/**
+	 * NFA of all rules added so far, without lambda-transitions
+	 */
+	struct nfa nfa;
+
+	/**
+	 * rules of the NFA states
+	 */
+	size_t *node_rule;
+
+	/**
+	 * initial NFA states of the rules
+	 */
+	size_t *rule_first;
+
+	/**
+	 * number of rules
+	 */
+	size_t rule_cnt;
+
+	/**
+	 * number of allocated rules
+	 */
+	size_t malloc_cnt;
+
+	/**
+	 * DFA of the rules, built by lexer_compile()
+	 */
+	struct dfa dfa;
+
+	/**
+	 * accepted rules of the DFA states, LEXER_NO_RULE for not
+	 * accepting states
+	 */
+	size_t *state_rule;
+
+	/**
+	 * DFA is built after the last added rule
+	 */
+	bool compiled;
+};
+
+/**
+ * structure that represents state of the tokenized stream
+ *
+ * Only the bytes of the current token candidate are kept between chunks,
+ * they are read again when the longest match ends before the last read
+ * byte.
+ */
+struct lexer_stream {
+	/**
+	 * current DFA state
+	 */
+	size_t state;
+
+	/**
+	 * offset of the first byte of the current token
+	 */
+	size_t start;
+
+	/**
+	 * offset of the next byte to be read by the DFA
+	 */
+	size_t pos;
+
+	/**
+	 * rule of the longest match of the current token so far
+	 */
+	size_t rule;
+
+	/**
+	 * end of the longest match of the current token so far
+	 */
+	size_t end;
+
+	/**
+	 * bytes of the previous chunks starting with the current token
+	 */
+	unsigned char *buf;
+
+	/**
+	 * number of bytes in the buffer
+	 */
+	size_t buf_len;
+
+	/**
+	 * size of the allocated buffer
+	 */
+	size_t buf_size;
+};
+
+/**
+ * Allocate empty lexer.
+ *
+ * @param lx	pointer to the lexer structure
+ * @return	0 on success
+ */
+int lexer_alloc(struct lexer *lx);
+
+/**
+ * Free lexer.
+ *
+ * @param lx	pointer to the lexer structure
+ */
+void lexer_free(struct lexer *lx);
+
+/**
+ * Add rule to lexer.
+ *
+ * Rules that are added earlier win when several rules match the longest
+ * token.
+ *
+ * @param lx		pointer to the lexer structure
+ * @param regexp	regular expression of the rule
+ * @param id		place for the identifier of the rule, may be NULL
+ * @return		0 on success
+ */
+int lexer_add(struct lexer *lx, const char *regexp, size_t *id);
+
+/**
+ * Build DFA of lexer.
+ *
+ * @param lx	pointer to the lexer structure
+ * @return	0 on success
+ */
+int lexer_compile(struct lexer *lx);
+
+/**
+ * Tokenize data.
+ *
+ * Splits the data into the longest tokens that match any rule.
+ *
+ * @param lx	pointer to the compiled lexer structure
+ * @param data	data to be tokenized
+ * @param len	size of the data
+ * @param cb	callback for the tokens
+ * @param ctx	user's context of the callback
+ * @return	offset just past the last token, it is less than len if
+ *		no rule matches there or the callback stopped the tokenizer
+ */
+size_t lexer_scan(const struct lexer *lx, const void *data, size_t len,
+		  lexer_token_cb cb, void *ctx);
+
+/**
+ * Allocate state of the tokenized stream.
+ *
+ * @param lx	pointer to the compiled lexer structure
+ * @param st	pointer to the state of the stream
+ * @return	0 on success
+ */
+int lexer_stream_alloc(const struct lexer *lx, struct lexer_stream *st);
+
+/**
+ * Free state of the tokenized stream.
+ *
+ * @param st	pointer to the state of the stream
+ */
+void lexer_stream_free(struct lexer_stream *st);
+
+/**
+ * Tokenize the next chunk of the stream.
+ *
+ * Tokens are reported as soon as they cannot become longer, so the last
+ * token of the chunk may be reported by the next call.
+ *
+ * @param lx	pointer to the compiled lexer structure
+ * @param st	pointer to the state of the stream
+ * @param data	the next chunk of the stream
+ * @param len	size of the chunk
+ * @param cb	callback for the tokens
+ * @param ctx	user's context of the callback
+ * @return	0 on success, 1 if the callback stopped the tokenizer,
+ *		-1 if no rule matches at st->start or on error
+ */
+int lexer_stream_feed(const struct lexer *lx, struct lexer_stream *st,
+		      const void *data, size_t len, lexer_token_cb cb,
+		      void *ctx);
+
+/**
+ * Finish the tokenized stream.
+ *
+ * Reports the remaining tokens.
+ *
+ * @param lx	pointer to the compiled lexer structure
+ * @param st	pointer to the state of the stream
+ * @param cb	callback for the tokens
+ * @param ctx	user's context of the callback
+ * @return	0 on success, 1 if the callback stopped the tokenizer,
+ *		-1 if no rule matches at st->start
+ */
+int lexer_stream_finish(const struct lexer *lx, struct lexer_stream *st,
+			lexer_token_cb cb, void *ctx);
+
+#endif /** REFA_LEXER_H @} */
@@ -0,0 +1,615 @@
+/*
+ * Extraction of literals from regular expressions.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <ctype.h>
+#include <string.h>
+
+#include "literal.h"
+
+/**
+ * @brief Literals that are known about strings matched by a node.
+ */
+struct literal_info {
+	/**
+	 * @brief The node matches only the string in prefix.
+	 */
+	bool exact;
+
+	/**
+	 * @brief Every matched string starts with it.
+	 */
+	struct re_literal prefix;
+
+	/**
+	 * @brief Every matched string ends with it.
+	 */
+	struct re_literal suffix;
+
+	/**
+	 * @brief Every matched string contains one of them.
+	 */
+	struct re_literal_set factor;
+};
+
+/**
+ * @brief Make literal caseless.
+ *
+ * @param lit	pointer to the literal
+ */
+static void literal_fold(struct re_literal *lit)
+{
+	for (size_t i = 0; i < lit->len; i++)
+		lit->str[i] = tolower(lit->str[i]);
+
+	lit->caseless = true;
+}
+
+/**
+ * @brief Append one literal to another.
+ *
+ * Literals longer than RE_LITERAL_MAX_LEN are truncated.
+ *
+ * @param dst		pointer to the destination literal
+ * @param src		pointer to the appended literal
+ * @param keep_head	keep the beginning of the too long literal,
+ *			otherwise keep its end
+ * @return		true if the result was truncated
+ */
+static bool literal_append(struct re_literal *dst, const struct re_literal *src,
+			   bool keep_head)
+{
+	struct re_literal tmp = *src;
+	size_t total = dst->len + tmp.len;
+
+	if (dst->caseless != tmp.caseless) {
+		literal_fold(dst);
+		literal_fold(&tmp);
+	}
+
+	if (total <= RE_LITERAL_MAX_LEN) {
+		memcpy(dst->str + dst->len, tmp.str, tmp.len);
+		dst->len = total;
+		return false;
+	}
+
+	if (keep_head) {
+		memcpy(dst->str + dst->len, tmp.str,
+		       RE_LITERAL_MAX_LEN - dst->len);
+	} else if (tmp.len >= RE_LITERAL_MAX_LEN) {
+		memcpy(dst->str, tmp.str + tmp.len - RE_LITERAL_MAX_LEN,
+		       RE_LITERAL_MAX_LEN);
+	} else {
+		size_t keep = RE_LITERAL_MAX_LEN - tmp.len;
+
+		memmove(dst->str, dst->str + dst->len - keep, keep);
+		memcpy(dst->str + keep, tmp.str, tmp.len);
+	}
+	dst->len = RE_LITERAL_MAX_LEN;
+
+	return true;
+}
+
+/**
+ * @brief Get length of the shortest literal of the set.
+ *
+ * @param set	pointer to the set
+ * @return	length of the shortest literal, 0 for the empty set
+ */
+static size_t literal_set_min_len(const struct re_literal_set *set)
+{
+	size_t min = set->cnt != 0 ? RE_LITERAL_MAX_LEN : 0;
+
+	for (size_t i = 0; i < set->cnt; i++)
+		if (set->lit[i].len < min)
+			min = set->lit[i].len;
+
+	return min;
+}
+
+/**
+ * @brief Replace the best set with the candidate if it is better.
+ *
+ * Sets with longer shortest literals are better, for the same length
+ * sets with fewer literals are better.
+ *
+ * @param best	pointer to the best set
+ * @param cand	pointer to the candidate set
+ */
+static void literal_set_consider(struct re_literal_set *best,
+				 const struct re_literal_set *cand)
+{
+	size_t best_len = literal_set_min_len(best);
+	size_t cand_len = literal_set_min_len(cand);
+
+	if (cand_len > best_len ||
+	    (cand_len == best_len && cand_len != 0 && cand->cnt < best->cnt))
+		*best = *cand;
+}
+
+/**
+ * @brief Consider one literal as the best set.
+ *
+ * @param best	pointer to the best set
+ * @param lit	pointer to the literal
+ */
+static void literal_set_consider_one(struct re_literal_set *best,
+				     const struct re_literal *lit)
+{
+	struct re_literal_set cand = {.cnt = 1};
+
+	cand.lit[0] = *lit;
+	literal_set_consider(best, &cand);
+}
+
+/**
+ * @brief Get common prefix or suffix of two literals.
+ *
+ * @param dst		pointer to the first literal and the result
+ * @param src		pointer to the second literal
+ * @param suffix	get common suffix instead of prefix
+ */
+static void literal_common(struct re_literal *dst, const struct re_literal *src,
+			   bool suffix)
+{
+	struct re_literal tmp = *src;
+	size_t len = 0;
+
+	if (dst->caseless != tmp.caseless) {
+		literal_fold(dst);
+		literal_fold(&tmp);
+	}
+
+	while (len < dst->len && len < tmp.len) {
+		size_t i = suffix ? dst->len - len - 1 : len;
+		size_t j = suffix ? tmp.len - len - 1 : len;
+
+		if (dst->str[i] != tmp.str[j])
+			break;
+		len++;
+	}
+
+	if (suffix)
+		memmove(dst->str, dst->str + dst->len - len, len);
+	dst->len = len;
+}
+
+/**
+ * @brief Get the only character of the character class.
+ *
+ * @param node	pointer to the RE_CHAR or RE_CHARCLASS node
+ * @param lit	place for the one character literal
+ * @return	true if the node matches only one character (in any case)
+ */
+static bool literal_from_char(const struct regexp_node *node,
+			      struct re_literal *lit)
+{
+	const struct re_charclass *cc = &node->data.cc_data;
+	int first = -1, cnt = 0;
+
+	lit->len = 1;
+	lit->caseless = false;
+
+	if (node->type == RE_CHAR) {
+		lit->str[0] = node->data.c_val;
+		return true;
+	}
+
+	for (int i = 0; i < 256 && cnt <= 2; i++)
+		if (GET_BIT(cc->data, i) != cc->inverse) {
+			if (first < 0)
+				first = i;
+			cnt++;
+		}
+
+	if (cnt == 1) {
+		lit->str[0] = first;
+		return true;
+	}
+
+	/* upper case letters are lower than lower case ones */
+	if (cnt == 2 && isupper(first) &&
+	    GET_BIT(cc->data, tolower(first)) != cc->inverse) {
+		lit->str[0] = tolower(first);
+		lit->caseless = true;
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Set information about the node that matches one string.
+ *
+ * @param info	pointer to the information
+ * @param lit	pointer to the matched string
+ */
+static void literal_info_exact(struct literal_info *info,
+			       const struct re_literal *lit)
+{
+	info->exact = true;
+	info->prefix = *lit;
+	info->suffix = *lit;
+	info->factor.cnt = 0;
+	literal_set_consider_one(&info->factor, lit);
+}
+
+/**
+ * @brief Apply repetition of the node to the information about it.
+ *
+ * @param info	pointer to the information about one repetition
+ * @param node	pointer to the node
+ */
+static void literal_info_repeat(struct literal_info *info,
+				const struct regexp_node *node)
+{
+	int min = node->repeat.min, max = node->repeat.max;
+
+	if (min == 1 && max == 1)
+		return;
+
+	if (max == 0 || min == 0) {
+		struct re_literal empty = {.len = 0, .caseless = false};
+
+		if (max == 0) {
+			literal_info_exact(info, &empty);
+		} else {
+			info->exact = false;
+			info->prefix = empty;
+			info->suffix = empty;
+			info->factor.cnt = 0;
+		}
+		return;
+	}
+
+	if (info->exact) {
+		struct re_literal unit = info->prefix;
+		struct re_literal head = {.len = 0, .caseless = unit.caseless};
+		struct re_literal tail = head;
+		bool truncated = false;
+
+		for (int i = 0; i < min; i++) {
+			truncated |= literal_append(&head, &unit, true);
+			literal_append(&tail, &unit, false);
+		}
+
+		literal_info_exact(info, &head);
+		info->suffix = tail;
+		info->exact = !truncated && min == max;
+		literal_set_consider_one(&info->factor, &tail);
+	}
+}
+
+static void literal_info_node(struct literal_info *info,
+			      const struct regexp_node *node);
+
+/**
+ * @brief Get information about the concatenation.
+ *
+ * @param info	pointer to the information
+ * @param node	pointer to the RE_CONCAT node
+ */
+static void literal_info_concat(struct literal_info *info,
+				const struct regexp_node *node)
+{
+	struct re_literal run = {.len = 0, .caseless = false};
+	bool prefix_done = false, truncated = false;
+	int cnt = node->data.childs.cnt;
+
+	info->exact = true;
+	info->prefix = run;
+	info->suffix = run;
+	info->factor.cnt = 0;
+
+	for (int i = 0; i < cnt; i++) {
+		struct literal_info child;
+
+		literal_info_node(&child, node->data.childs.ptr[i]);
+
+		if (!prefix_done) {
+			truncated |= literal_append(&info->prefix,
+						    &child.prefix, true);
+			prefix_done = !child.exact;
+		}
+
+		if (child.exact) {
+			literal_set_consider_one(&info->factor, &run);
+			truncated |= literal_append(&run, &child.prefix, false);
+		} else {
+			literal_append(&run, &child.prefix, true);
+			literal_set_consider_one(&info->factor, &run);
+			literal_set_consider(&info->factor, &child.factor);
+			run = child.suffix;
+			info->exact = false;
+		}
+	}
+
+	literal_set_consider_one(&info->factor, &run);
+	info->exact &= !truncated;
+
+	for (int i = cnt - 1; i >= 0; i--) {
+		struct literal_info child;
+		struct re_literal tail;
+
+		literal_info_node(&child, node->data.childs.ptr[i]);
+
+		tail = child.suffix;
+		literal_append(&tail, &info->suffix, false);
+		info->suffix = tail;
+
+		if (!child.exact)
+			break;
+	}
+}
+
+/**
+ * @brief Get information about the union.
+ *
+ * @param info	pointer to the information
+ * @param node	pointer to the RE_UNION node
+ */
+static void literal_info_union(struct literal_info *info,
+			       const struct regexp_node *node)
+{
+	struct re_literal_set all = {.cnt = 0};
+	bool all_valid = true;
+	int cnt = node->data.childs.cnt;
+
+	info->exact = cnt > 0;
+	info->factor.cnt = 0;
+
+	for (int i = 0; i < cnt; i++) {
+		struct literal_info child;
+
+		literal_info_node(&child, node->data.childs.ptr[i]);
+
+		if (i == 0) {
+			info->prefix = child.prefix;
+			info->suffix = child.suffix;
+		} else {
+			size_t len = info->prefix.len;
+
+			literal_common(&info->prefix, &child.prefix, false);
+			literal_common(&info->suffix, &child.suffix, true);
+			info->exact &= child.prefix.len == len &&
+				       info->prefix.len == len;
+		}
+		info->exact &= child.exact;
+
+		if (literal_set_min_len(&child.factor) == 0 ||
+		    all.cnt + child.factor.cnt > RE_LITERAL_MAX_CNT) {
+			all_valid = false;
+			continue;
+		}
+
+		for (size_t j = 0; j < child.factor.cnt; j++)
+			all.lit[all.cnt++] = child.factor.lit[j];
+	}
+
+	if (all_valid)
+		literal_set_consider(&info->factor, &all);
+	literal_set_consider_one(&info->factor, &info->prefix);
+	literal_set_consider_one(&info->factor, &info->suffix);
+}
+
+/**
+ * @brief Get information about any node.
+ *
+ * @param info	pointer to the information
+ * @param node	pointer to the node
+ */
+static void literal_info_node(struct literal_info *info,
+			      const struct regexp_node *node)
+{
+	struct re_literal lit = {.len = 0, .caseless = false};
+
+	switch (node->type) {
+	case RE_CHAR:
+	case RE_CHARCLASS:
+		if (literal_from_char(node, &lit)) {
+			literal_info_exact(info, &lit);
+		} else {
+			lit.len = 0;
+			info->exact = false;
+			info->prefix = lit;
+			info->suffix = lit;
+			info->factor.cnt = 0;
+		}
+		break;
+	case RE_CONCAT:
+		literal_info_concat(info, node);
+		break;
+	case RE_UNION:
+		literal_info_union(info, node);
+		break;
+	default:
+		literal_info_exact(info, &lit);
+		break;
+	}
+
+	literal_info_repeat(info, node);
+}
+
+int regexp_tree_literals(const struct regexp_tree *re_tree,
+			 struct re_literal_set *set)
+{
+	struct literal_info info;
+
+	literal_info_node(&info, &re_tree->root);
+
+	if (literal_set_min_len(&info.factor) == 0) {
+		set->cnt = 0;
+		return -1;
+	}
+
+	*set = info.factor;
+
+	return 0;
+}
+
+const struct regexp_node *regexp_tree_core(const struct regexp_tree *re_tree,
+					   bool *floating)
+{
+	const struct regexp_node *node = &re_tree->root;
+
+	*floating = false;
+
+	if (node->type == RE_CONCAT && node->data.childs.cnt == 2 &&
+	    node->repeat.min == 1 && node->repeat.max == 1 &&
+	    regexp_node_is_any(node->data.childs.ptr[1]))
+		node = node->data.childs.ptr[0];
+
+	if (node->type == RE_CONCAT && node->data.childs.cnt == 2 &&
+	    node->repeat.min == 1 && node->repeat.max == 1 &&
+	    regexp_node_is_any(node->data.childs.ptr[0])) {
+		node = node->data.childs.ptr[1];
+		*floating = true;
+	}
+
+	return node;
+}
+
+size_t regexp_node_max_width(const struct regexp_node *node)
+{
+	size_t width = 0;
+
+	switch (node->type) {
+	case RE_CHAR:
+	case RE_CHARCLASS:
+		width = 1;
+		break;
+	case RE_CONCAT:
+	case RE_UNION:
+		for (int i = 0; i < node->data.childs.cnt; i++) {
+			size_t child;
+
+			child = regexp_node_max_width(node->data.childs.ptr[i]);
+			if (child == RE_WIDTH_INF)
+				return RE_WIDTH_INF;
+
+			if (node->type == RE_UNION)
+				width = child > width ? child : width;
+			else
+				width += child;
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (width == 0)
+		return 0;
+	if (node->repeat.max < 0 ||
+	    width > RE_WIDTH_INF / 2 / (size_t)node->repeat.max)
+		return RE_WIDTH_INF;
+
+	return width * node->repeat.max;
+}
+
+/**
+ * @brief Case sensitivity of the string.
+ */
+enum literal_case {
+	LITERAL_CASE_UNKNOWN,
+	LITERAL_CASE_SENSITIVE,
+	LITERAL_CASE_CASELESS
+};
+
+/**
+ * @brief Append string matched by the node to the buffer.
+ *
+ * @param node	pointer to the node
+ * @param buf	buffer
+ * @param size	size of the buffer
+ * @param len	pointer to the length of the string in the buffer
+ * @param mode	pointer to the case sensitivity of the string
+ * @return	0 on success, -1 if the node is not a string
+ */
+static int literal_node_string(const struct regexp_node *node,
+			       unsigned char *buf, size_t size, size_t *len,
+			       enum literal_case *mode)
+{
+	size_t start = *len, unit;
+	struct re_literal lit;
+
+	if (node->repeat.min != node->repeat.max || node->repeat.min < 1)
+		return -1;
+
+	if (node->type == RE_CHAR || node->type == RE_CHARCLASS) {
+		enum literal_case cur;
+
+		if (!literal_from_char(node, &lit) || *len >= size)
+			return -1;
+
+		cur = lit.caseless ? LITERAL_CASE_CASELESS :
+				     LITERAL_CASE_SENSITIVE;
+		if (isalpha(lit.str[0])) {
+			if (*mode != LITERAL_CASE_UNKNOWN && *mode != cur)
+				return -1;
+			*mode = cur;
+		}
+		buf[(*len)++] = lit.str[0];
+	} else if (node->type == RE_CONCAT) {
+		for (int i = 0; i < node->data.childs.cnt; i++)
+			if (literal_node_string(node->data.childs.ptr[i], buf,
+						size, len, mode) != 0)
+				return -1;
+	} else {
+		return -1;
+	}
+
+	unit = *len - start;
+	if (unit == 0 || (size - start) / unit < (size_t)node->repeat.min)
+		return -1;
+
+	for (int i = 1; i < node->repeat.min; i++) {
+		memcpy(buf + *len, buf + start, unit);
+		*len += unit;
+	}
+
+	return 0;
+}
+
+int regexp_tree_string(const struct regexp_tree *re_tree, unsigned char *buf,
+		       size_t size, size_t *len, bool *caseless)
+{
+	enum literal_case mode = LITERAL_CASE_UNKNOWN;
+	const struct regexp_node *core;
+	const struct regexp_node *root = &re_tree->root;
+	bool floating;
+
+	core = regexp_tree_core(re_tree, &floating);
+	if (!floating || root->type != RE_CONCAT ||
+	    !regexp_node_is_any(root->data.childs.ptr[1]))
+		return -1;
+
+	*len = 0;
+	if (literal_node_string(core, buf, size, len, &mode) != 0)
+		return -1;
+
+	*caseless = mode == LITERAL_CASE_CASELESS;
+	if (*caseless) {
+		for (size_t i = 0; i < *len; i++)
+			buf[i] = tolower(buf[i]);
+	}
+
+	return 0;
+}
+
+bool re_literal_match(const struct re_literal *lit, const unsigned char *data)
+{
+	if (!lit->caseless)
+		return memcmp(lit->str, data, lit->len) == 0;
+
+	for (size_t i = 0; i < lit->len; i++)
+		if (tolower(data[i]) != lit->str[i])
+			return false;
+
+	return true;
+}
@@ -0,0 +1,128 @@
+/*
+ * Extraction of literals from regular expressions.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup literal literal
+ * @{
+ */
+
+#ifndef REFA_LITERAL_H
+#define REFA_LITERAL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "parser.h"
+
+/** maximum length of one literal */
+#define RE_LITERAL_MAX_LEN	(32)
+
+/** maximum number of literals in one set */
+#define RE_LITERAL_MAX_CNT	(8)
+
+/** width of the regular expression that has no upper bound */
+#define RE_WIDTH_INF		((size_t)-1)
+
+/**
+ * structure that represents a literal string
+ */
+struct re_literal {
+	/**
+	 * bytes of the literal, letters are in lower case if it is caseless
+	 */
+	unsigned char str[RE_LITERAL_MAX_LEN];
+
+	/**
+	 * length of the literal
+	 */
+	size_t len;
+
+	/**
+	 * letters match in any case
+	 */
+	bool caseless;
+};
+
+/**
+ * structure that represents a set of literals
+ */
+struct re_literal_set {
+	/**
+	 * literals of the set
+	 */
+	struct re_literal lit[RE_LITERAL_MAX_CNT];
+
+	/**
+	 * number of literals in the set
+	 */
+	size_t cnt;
+};
+
+/**
+ * Extract required literals from regexp tree.
+ *
+ * Finds a set of literals such that every string matched by the regular
+ * expression contains at least one of them. The set with the longest
+ * shortest literal is chosen.
+ *
+ * @param re_tree	pointer to the regexp tree
+ * @param set		pointer to the resulting set
+ * @return		0 on success, -1 if there are no required literals
+ */
+int regexp_tree_literals(const struct regexp_tree *re_tree,
+			 struct re_literal_set *set);
+
+/**
+ * Get core of regexp tree.
+ *
+ * Strips '.*' nodes that were added around the unanchored regular
+ * expression by the parser.
+ *
+ * @param re_tree	pointer to the regexp tree
+ * @param floating	place for the flag, it is set if the beginning
+ *			of the regular expression is not anchored
+ * @return		pointer to the core node
+ */
+const struct regexp_node *regexp_tree_core(const struct regexp_tree *re_tree,
+					   bool *floating);
+
+/**
+ * Get maximum width of node.
+ *
+ * @param node	pointer to the regexp node
+ * @return	maximum length of the matched string or RE_WIDTH_INF
+ */
+size_t regexp_node_max_width(const struct regexp_node *node);
+
+/**
+ * Get string searched by regexp tree.
+ *
+ * Checks that the regular expression is not anchored on both sides and
+ * its core is a concatenation of characters with fixed repetitions.
+ * Letters may match in any case only all together (the 'i' modifier).
+ *
+ * @param re_tree	pointer to the regexp tree
+ * @param buf		place for the string
+ * @param size		size of the buffer
+ * @param len		place for the length of the string
+ * @param caseless	place for the flag, it is set if letters match
+ *			in any case, the string is in lower case then
+ * @return		0 on success, -1 if the regexp is not a literal
+ *			or the buffer is too small
+ */
+int regexp_tree_string(const struct regexp_tree *re_tree, unsigned char *buf,
+		       size_t size, size_t *len, bool *caseless);
+
+/**
+ * Check if literal occurs in data at the position.
+ *
+ * @param lit	pointer to the literal
+ * @param data	data with at least lit->len bytes
+ * @return	true if the data starts with the literal
+ */
+bool re_literal_match(const struct re_literal *lit, const unsigned char *data);
+
+#endif /** REFA_LITERAL_H @} */
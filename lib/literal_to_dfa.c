@@ -0,0 +1,390 @@
+/*
+ * Direct conversion of literal sets into deterministic finite automaton.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "literal.h"
+#include "literal_to_dfa.h"
+
+/**
+ * @brief Marker of the absent node.
+ */
+#define AC_NONE	((size_t)-1)
+
+/**
+ * @brief Node of the trie.
+ */
+struct ac_node {
+	/**
+	 * @brief The first child of the node.
+	 */
+	size_t child;
+
+	/**
+	 * @brief The next child of the node's parent.
+	 */
+	size_t sibling;
+
+	/**
+	 * @brief Label of the edge from the parent.
+	 */
+	unsigned char byte;
+
+	/**
+	 * @brief A string ends at the node.
+	 */
+	bool terminal;
+};
+
+/**
+ * @brief Trie of the strings.
+ */
+struct ac_trie {
+	/**
+	 * @brief Array of nodes, the root is the first one.
+	 */
+	struct ac_node *nodes;
+
+	/**
+	 * @brief Number of nodes.
+	 */
+	size_t cnt;
+
+	/**
+	 * @brief Number of allocated nodes.
+	 */
+	size_t malloc_cnt;
+};
+
+/**
+ * @brief Trie node waiting for its state's transitions.
+ */
+struct ac_item {
+	/**
+	 * @brief Index of the node.
+	 */
+	size_t node;
+
+	/**
+	 * @brief State of the node.
+	 */
+	size_t state;
+
+	/**
+	 * @brief State of the longest proper suffix of the node's string,
+	 * AC_NONE for the root.
+	 */
+	size_t fail;
+};
+
+/**
+ * @brief Get child of the trie's node, create it if necessary.
+ *
+ * @param trie	pointer to the trie
+ * @param node	index of the node
+ * @param byte	label of the edge
+ * @return	index of the child or AC_NONE if there is no memory
+ */
+static size_t ac_trie_child(struct ac_trie *trie, size_t node,
+			    unsigned char byte)
+{
+	struct ac_node *cur;
+	size_t child;
+
+	for (child = trie->nodes[node].child; child != AC_NONE;
+	     child = trie->nodes[child].sibling)
+		if (trie->nodes[child].byte == byte)
+			return child;
+
+	if (trie->cnt == trie->malloc_cnt) {
+		size_t new_cnt = trie->malloc_cnt * 2;
+		struct ac_node *tmp;
+
+		tmp = realloc(trie->nodes, sizeof(struct ac_node) * new_cnt);
+		if (tmp == NULL)
+			return AC_NONE;
+
+		trie->nodes = tmp;
+		trie->malloc_cnt = new_cnt;
+	}
+
+	child = trie->cnt++;
+	cur = &trie->nodes[child];
+	cur->child = AC_NONE;
+	cur->sibling = trie->nodes[node].child;
+	cur->byte = byte;
+	cur->terminal = false;
+	trie->nodes[node].child = child;
+
+	return child;
+}
+
+/**
+ * @brief Insert string into the trie.
+ *
+ * Strings that have a shorter string as their prefix are not needed,
+ * the accepting state is reached before their end anyway.
+ *
+ * @param trie	pointer to the trie
+ * @param str	bytes of the string
+ * @param len	length of the string
+ * @return	0 on success
+ */
+static int ac_trie_insert(struct ac_trie *trie, const unsigned char *str,
+			  size_t len)
+{
+	size_t node = 0;
+
+	for (size_t i = 0; i < len && !trie->nodes[node].terminal; i++) {
+		node = ac_trie_child(trie, node, str[i]);
+		if (node == AC_NONE)
+			return -1;
+	}
+
+	trie->nodes[node].terminal = true;
+
+	return 0;
+}
+
+/**
+ * @brief Insert all case variants of the caseless string into the trie.
+ *
+ * @param trie	pointer to the trie
+ * @param str	bytes of the string
+ * @param len	length of the string
+ * @return	0 on success, -1 if there are too many variants
+ */
+static int ac_trie_insert_variants(struct ac_trie *trie,
+				   const unsigned char *str, size_t len)
+{
+	unsigned char *buf;
+	size_t letters = 0;
+	bool failure = false;
+
+	for (size_t i = 0; i < len; i++)
+		if (isalpha(str[i]) && ++letters > 30)
+			return -1;
+
+	if (((size_t)1 << letters) > LITERAL_DFA_MAX_VARIANTS)
+		return -1;
+
+	buf = malloc(len + 1);
+	if (buf == NULL)
+		return -1;
+
+	for (size_t mask = 0; mask < ((size_t)1 << letters) && !failure;
+	     mask++) {
+		size_t bit = 0;
+
+		for (size_t i = 0; i < len; i++) {
+			buf[i] = tolower(str[i]);
+			if (isalpha(str[i]) && ((mask >> bit++) & 1))
+				buf[i] = toupper(str[i]);
+		}
+
+		failure = ac_trie_insert(trie, buf, len) != 0;
+	}
+
+	free(buf);
+
+	return !failure ? 0 : -1;
+}
+
+/**
+ * @brief Build automaton of the trie.
+ *
+ * States are created in breadth-first order, so the row of the failure
+ * state is complete when the node's row is copied from it. Nodes whose
+ * string or any of its suffixes is a whole string go to the accepting
+ * state, their subtries are not needed.
+ *
+ * @param dfa	pointer to the empty dfa structure
+ * @param trie	pointer to the trie
+ * @param fold	letters of the trie are in lower case and match in any case
+ * @return	0 on success
+ */
+static int ac_trie_to_dfa(struct dfa *dfa, const struct ac_trie *trie,
+			  bool fold)
+{
+	struct ac_item *queue;
+	size_t head = 0, tail = 0;
+	size_t root, final;
+
+	queue = malloc(sizeof(struct ac_item) * trie->cnt);
+	if (queue == NULL)
+		return -1;
+
+	if (dfa_change_max_size(dfa, trie->cnt + 1) != 0 ||
+	    dfa_add_state(dfa, &root) != 0 || dfa_add_state(dfa, &final) != 0) {
+		free(queue);
+		return -1;
+	}
+
+	dfa->first_index = root;
+	dfa_state_set_final(dfa, final, 1);
+	for (int c = 0; c < 256; c++)
+		dfa_add_trans(dfa, final, c, final);
+
+	/* the empty string is found everywhere */
+	if (trie->nodes[0].terminal)
+		dfa->first_index = final;
+	else
+		queue[tail++] = (struct ac_item){0, root, AC_NONE};
+
+	while (head < tail) {
+		struct ac_item item = queue[head++];
+
+		for (int c = 0; c < 256; c++)
+			dfa_add_trans(dfa, item.state, c,
+				      item.fail == AC_NONE ? root :
+				      dfa_get_trans(dfa, item.fail, c));
+
+		for (size_t child = trie->nodes[item.node].child;
+		     child != AC_NONE; child = trie->nodes[child].sibling) {
+			const struct ac_node *node = &trie->nodes[child];
+			size_t fail, to = final;
+
+			fail = item.fail == AC_NONE ? root :
+			       dfa_get_trans(dfa, item.fail, node->byte);
+
+			if (!node->terminal && fail != final) {
+				dfa_add_state(dfa, &to);
+				queue[tail++] = (struct ac_item){child, to, fail};
+			}
+
+			dfa_add_trans(dfa, item.state, node->byte, to);
+			if (fold && isalpha(node->byte))
+				dfa_add_trans(dfa, item.state,
+					      toupper(node->byte), to);
+		}
+	}
+
+	free(queue);
+
+	return 0;
+}
+
+int convert_strings_to_dfa(struct dfa *dfa, const unsigned char *const *str,
+			   const size_t *len, const bool *caseless, size_t cnt)
+{
+	struct ac_trie trie;
+	size_t caseless_cnt = 0;
+	bool fold, failure = false;
+
+	if (cnt == 0)
+		return -1;
+
+	for (size_t i = 0; i < cnt; i++)
+		if (caseless != NULL && caseless[i])
+			caseless_cnt++;
+
+	/* only the mixed sets need case variants in the trie */
+	fold = caseless_cnt == cnt;
+
+	trie.cnt = 1;
+	trie.malloc_cnt = 1024;
+	trie.nodes = malloc(sizeof(struct ac_node) * trie.malloc_cnt);
+	if (trie.nodes == NULL)
+		return -1;
+
+	trie.nodes[0].child = AC_NONE;
+	trie.nodes[0].sibling = AC_NONE;
+	trie.nodes[0].terminal = false;
+
+	for (size_t i = 0; i < cnt && !failure; i++) {
+		if (fold) {
+			unsigned char *buf = malloc(len[i] + 1);
+
+			if (buf == NULL) {
+				failure = true;
+				break;
+			}
+
+			for (size_t j = 0; j < len[i]; j++)
+				buf[j] = tolower(str[i][j]);
+			failure = ac_trie_insert(&trie, buf, len[i]) != 0;
+			free(buf);
+		} else if (caseless != NULL && caseless[i]) {
+			failure = ac_trie_insert_variants(&trie, str[i],
+							  len[i]) != 0;
+		} else {
+			failure = ac_trie_insert(&trie, str[i], len[i]) != 0;
+		}
+	}
+
+	failure = failure || ac_trie_to_dfa(dfa, &trie, fold) != 0 ||
+		  dfa_minimize(dfa) != 0 || dfa_compress(dfa) != 0;
+
+	free(trie.nodes);
+
+	return !failure ? 0 : -1;
+}
+
+int convert_trees_to_dfa(struct dfa *dfa,
+			 const struct regexp_tree *const *re_tree, size_t cnt)
+{
+	unsigned char **str, *buf;
+	size_t *len;
+	bool *caseless;
+	bool failure = false;
+	size_t i;
+
+	str = calloc(cnt + 1, sizeof(unsigned char *));
+	len = malloc(sizeof(size_t) * (cnt + 1));
+	caseless = malloc(sizeof(bool) * (cnt + 1));
+	buf = malloc(LITERAL_DFA_MAX_LEN);
+
+	failure = str == NULL || len == NULL || caseless == NULL || buf == NULL;
+
+	/* every string takes only its own length, the buffer is reused */
+	for (i = 0; i < cnt && !failure; i++) {
+		failure = regexp_tree_string(re_tree[i], buf,
+					     LITERAL_DFA_MAX_LEN, &len[i],
+					     &caseless[i]) != 0 ||
+			  (str[i] = malloc(len[i] + 1)) == NULL;
+		if (!failure)
+			memcpy(str[i], buf, len[i]);
+	}
+	free(buf);
+
+	if (!failure)
+		failure = convert_strings_to_dfa(dfa,
+				(const unsigned char *const *)str,
+				len, caseless, cnt) != 0;
+
+	/* regexps are stored in the comment as by dfa_join() */
+	if (!failure) {
+		size_t offset = 0;
+
+		for (i = 0; i < cnt; i++)
+			dfa->comment_size += re_tree[i]->comment_size;
+
+		dfa->comment = malloc(dfa->comment_size);
+		failure = dfa->comment == NULL && dfa->comment_size != 0;
+
+		for (i = 0; i < cnt && !failure; i++) {
+			memcpy(dfa->comment + offset, re_tree[i]->comment,
+			       re_tree[i]->comment_size);
+			offset += re_tree[i]->comment_size;
+			if (offset > 0 && i + 1 < cnt)
+				dfa->comment[offset - 1] = '\n';
+		}
+	}
+
+	for (i = 0; str != NULL && i < cnt; i++)
+		free(str[i]);
+	free(str);
+	free(len);
+	free(caseless);
+
+	return !failure ? 0 : -1;
+}
@@ -0,0 +1,67 @@
+/*
+ * Direct conversion of literal sets into deterministic finite automaton.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup literal_to_dfa literal_to_dfa
+ * @{
+ */
+
+#ifndef REFA_LITERAL_TO_DFA_H
+#define REFA_LITERAL_TO_DFA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "dfa.h"
+#include "parser.h"
+
+/** maximum length of the literal converted from regexp tree */
+#define LITERAL_DFA_MAX_LEN		(4096)
+
+/**
+ * maximum number of case variants of one caseless literal, they are
+ * needed only if caseless and case sensitive literals are mixed
+ */
+#define LITERAL_DFA_MAX_VARIANTS	(256)
+
+/**
+ * Convert set of strings into DFA.
+ *
+ * Builds Aho-Corasick automaton of the strings: a trie with the failure
+ * links resolved into full transition tables, so the construction is
+ * linear in the total length of the strings. All states that end
+ * a string are merged into one accepting state that loops on all bytes.
+ * The result accepts the same language as the union of unanchored
+ * regular expressions of the strings (e.g. "/abc/"), it is minimized
+ * and can be saved, loaded and joined as any other DFA.
+ *
+ * @param dfa		pointer to the allocated empty dfa structure
+ * @param str		array of strings
+ * @param len		array of strings' lengths
+ * @param caseless	array of flags, letters of the string match in any
+ *			case if it is set, may be NULL
+ * @param cnt		number of strings
+ * @return		0 on success, -1 on error or if mixed case sensitivity
+ *			needs too many case variants
+ */
+int convert_strings_to_dfa(struct dfa *dfa, const unsigned char *const *str,
+			   const size_t *len, const bool *caseless, size_t cnt);
+
+/**
+ * Convert set of literal regexp trees into DFA.
+ *
+ * Every regexp tree must be a literal (see regexp_tree_string()),
+ * the result is the same as the result of convert_strings_to_dfa().
+ *
+ * @param dfa		pointer to the allocated empty dfa structure
+ * @param re_tree	array of pointers to the regexp trees
+ * @param cnt		number of regexp trees
+ * @return		0 on success, -1 if any of the regexps is not a literal
+ */
+int convert_trees_to_dfa(struct dfa *dfa,
+			 const struct regexp_tree *const *re_tree, size_t cnt);
+
+#endif /** REFA_LITERAL_TO_DFA_H @} */
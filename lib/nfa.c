@@ -7,10 +7,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
 
 #include <stdio.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "nfa.h"
+#include "endian_inner.h"
 
 #define NFA_CHUNK_SIZE		(4096 / sizeof(struct nfa_node) > 0	\
 				 ? 4096 / sizeof(struct nfa_node)	\
@@ -24,6 +31,14 @@
 #define MAX(a, b)		((a) > (b) ? (a) : (b))
 #endif
 
+/* size of the header of the nfa file */
+#define NFA_FILE_HEADER_SIZE	(64)
+
+/* flags of the states in the nfa file */
+#define NFA_FILE_FINAL		(0x01)
+#define NFA_FILE_SELF_CLOSED	(0x02)
+#define NFA_FILE_PREFINAL	(0x04)
+
 static int nfa_lambda_reachable(size_t *dst, size_t *cnt, size_t from, struct nfa *src);
 static int nfa_trans_reachable(size_t *dst, size_t *cnt, size_t from, struct nfa *src);
 static void nfa_print(struct nfa *);
@@ -454,6 +469,305 @@ int nfa_remove_lambda(struct nfa *nfa)
 	return 0;
 }
 
+/**
+ * @brief Write the value in little-endian order.
+ *
+ * @param file	file being written
+ * @param val	the value
+ * @param len	size of the value in bytes
+ * @return	0 on success
+ */
+static int nfa_write_le(FILE *file, uint64_t val, size_t len)
+{
+	unsigned char buf[8];
+
+	put_le(buf, val, len);
+
+	return fwrite(buf, 1, len, file) == len ? 0 : -1;
+}
+
+int nfa_save_to_file(const struct nfa *nfa, char *filename)
+{
+	unsigned char header[NFA_FILE_HEADER_SIZE];
+	uint64_t trans_cnt = 0, lambda_cnt = 0, offset;
+	size_t tps;
+	bool failure;
+	FILE *file;
+
+	for (size_t i = 0; i < nfa->node_cnt; i++) {
+		lambda_cnt += nfa->nodes[i].lambda_cnt;
+		for (int c = 0; c < 256; c++)
+			trans_cnt += nfa->nodes[i].trans_cnt[c];
+	}
+
+	tps = (uint64_t)nfa->node_cnt <= UINT32_MAX ? 4 : 8;
+
+	file = fopen(filename, "w");
+	if (file == NULL) {
+		perror(filename);
+		return -1;
+	}
+
+	memset(header, 0x00, sizeof(header));
+	memcpy(header, "\x57""NFA\x16\x16\x16\x16", 8);
+	memcpy(header + 8, "ver#\x00\x01\x00\x00", 8);
+	put_le(header + 16, nfa->node_cnt, 8);
+	put_le(header + 24, nfa->first_index, 8);
+	put_le(header + 32, nfa->comment_size, 8);
+	put_le(header + 40, trans_cnt, 8);
+	put_le(header + 48, lambda_cnt, 8);
+	put_le(header + 56, tps, 8);
+
+	failure = fwrite(header, sizeof(header), 1, file) != 1 ||
+		  fwrite(nfa->comment, 1, nfa->comment_size, file) !=
+		  nfa->comment_size ||
+		  write_pad(file, nfa->comment_size,
+			    _ALIGN_TO(nfa->comment_size, 8)) != 0;
+
+	for (size_t i = 0; i < nfa->node_cnt && !failure; i++) {
+		const struct nfa_node *node = &nfa->nodes[i];
+		unsigned char flags = (node->isfinal ? NFA_FILE_FINAL : 0) |
+			(node->self_closed ? NFA_FILE_SELF_CLOSED : 0) |
+			(node->prefinal ? NFA_FILE_PREFINAL : 0);
+
+		failure = fputc(flags, file) == EOF;
+	}
+	failure = failure ||
+		  write_pad(file, nfa->node_cnt,
+			    _ALIGN_TO(nfa->node_cnt, 8)) != 0;
+
+	/* offsets of the rows, marks and targets of the transitions */
+	offset = 0;
+	failure = failure || nfa_write_le(file, offset, 8) != 0;
+	for (size_t i = 0; i < nfa->node_cnt && !failure; i++) {
+		for (int c = 0; c < 256; c++)
+			offset += nfa->nodes[i].trans_cnt[c];
+		failure = nfa_write_le(file, offset, 8) != 0;
+	}
+
+	for (size_t i = 0; i < nfa->node_cnt && !failure; i++)
+		for (int c = 0; c < 256 && !failure; c++)
+			for (size_t k = 0; k < nfa->nodes[i].trans_cnt[c] &&
+			     !failure; k++)
+				failure = fputc(c, file) == EOF;
+	failure = failure ||
+		  write_pad(file, trans_cnt, _ALIGN_TO(trans_cnt, 8)) != 0;
+
+	for (size_t i = 0; i < nfa->node_cnt && !failure; i++)
+		for (int c = 0; c < 256 && !failure; c++)
+			for (size_t k = 0; k < nfa->nodes[i].trans_cnt[c] &&
+			     !failure; k++)
+				failure = nfa_write_le(file,
+						nfa->nodes[i].trans[c][k], tps) != 0;
+	failure = failure ||
+		  write_pad(file, trans_cnt * tps,
+			    _ALIGN_TO(trans_cnt * tps, 8)) != 0;
+
+	/* offsets of the rows and targets of the lambda-transitions */
+	offset = 0;
+	failure = failure || nfa_write_le(file, offset, 8) != 0;
+	for (size_t i = 0; i < nfa->node_cnt && !failure; i++) {
+		offset += nfa->nodes[i].lambda_cnt;
+		failure = nfa_write_le(file, offset, 8) != 0;
+	}
+
+	for (size_t i = 0; i < nfa->node_cnt && !failure; i++)
+		for (size_t k = 0; k < nfa->nodes[i].lambda_cnt && !failure; k++)
+			failure = nfa_write_le(file, nfa->nodes[i].lambda_trans[k],
+					       tps) != 0;
+
+	failure = fclose(file) != 0 || failure;
+
+	return !failure ? 0 : -1;
+}
+
+/**
+ * @brief Copy the row of the file into the transitions of the node.
+ *
+ * Targets of one mark are stored together, so every mark gets one
+ * array of targets.
+ *
+ * @param node		pointer to the node
+ * @param marks		marks of the row, NULL for the lambda-transitions
+ * @param targets	targets of the row
+ * @param cnt		number of transitions in the row
+ * @param tps		size of the target in bytes
+ * @param node_cnt	number of the NFA's states
+ * @return		0 on success, -1 if the row is corrupted
+ */
+static int nfa_load_row(struct nfa_node *node, const unsigned char *marks,
+			const unsigned char *targets, uint64_t cnt,
+			size_t tps, size_t node_cnt)
+{
+	for (uint64_t i = 0; i < cnt;) {
+		uint64_t len = 1;
+		size_t *dst;
+
+		if (marks != NULL) {
+			if (i != 0 && marks[i] <= marks[i - 1])
+				return -1;
+			while (i + len < cnt && marks[i + len] == marks[i])
+				len++;
+		} else {
+			len = cnt;
+		}
+
+		dst = malloc(sizeof(size_t) * len);
+		if (dst == NULL)
+			return -1;
+
+		if (marks != NULL) {
+			node->trans[marks[i]] = dst;
+			node->trans_cnt[marks[i]] = len;
+		} else {
+			node->lambda_trans = dst;
+			node->lambda_cnt = len;
+		}
+
+		for (uint64_t k = 0; k < len; k++) {
+			uint64_t to = get_le(targets + (i + k) * tps, tps);
+
+			if (to >= node_cnt)
+				return -1;
+			dst[k] = to;
+		}
+
+		i += len;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Read NFA from the contents of the file.
+ *
+ * @param dst	pointer to the nfa structure without states
+ * @param base	contents of the file
+ * @param size	size of the file
+ * @return	0 on success, -1 if the file is corrupted
+ */
+static int nfa_load_parse(struct nfa *dst, const unsigned char *base,
+			  size_t size)
+{
+	uint64_t node_cnt, first_index, comment_size, trans_cnt, lambda_cnt;
+	uint64_t tps, need;
+	const unsigned char *flags, *trans_off, *marks, *trans;
+	const unsigned char *lambda_off, *lambda;
+
+	if (size < NFA_FILE_HEADER_SIZE ||
+	    memcmp(base, "\x57""NFA\x16\x16\x16\x16", 8) != 0 ||
+	    memcmp(base + 8, "ver#\x00\x01\x00\x00", 8) != 0)
+		return -1;
+
+	node_cnt = get_le(base + 16, 8);
+	first_index = get_le(base + 24, 8);
+	comment_size = get_le(base + 32, 8);
+	trans_cnt = get_le(base + 40, 8);
+	lambda_cnt = get_le(base + 48, 8);
+	tps = get_le(base + 56, 8);
+
+	/* the counts are limited by the size, so the sum does not overflow */
+	if ((tps != 4 && tps != 8) || node_cnt > size || comment_size > size ||
+	    trans_cnt > size || lambda_cnt > size ||
+	    (node_cnt != 0 && first_index >= node_cnt) ||
+	    (node_cnt == 0 && (trans_cnt != 0 || lambda_cnt != 0)))
+		return -1;
+
+	need = NFA_FILE_HEADER_SIZE + _ALIGN_TO(comment_size, 8) +
+	       _ALIGN_TO(node_cnt, 8) + (node_cnt + 1) * 8 +
+	       _ALIGN_TO(trans_cnt, 8) + _ALIGN_TO(trans_cnt * tps, 8) +
+	       (node_cnt + 1) * 8 + lambda_cnt * tps;
+	if (need != size)
+		return -1;
+
+	flags = base + NFA_FILE_HEADER_SIZE + _ALIGN_TO(comment_size, 8);
+	trans_off = flags + _ALIGN_TO(node_cnt, 8);
+	marks = trans_off + (node_cnt + 1) * 8;
+	trans = marks + _ALIGN_TO(trans_cnt, 8);
+	lambda_off = trans + _ALIGN_TO(trans_cnt * tps, 8);
+	lambda = lambda_off + (node_cnt + 1) * 8;
+
+	if (get_le(trans_off, 8) != 0 ||
+	    get_le(trans_off + node_cnt * 8, 8) != trans_cnt ||
+	    get_le(lambda_off, 8) != 0 ||
+	    get_le(lambda_off + node_cnt * 8, 8) != lambda_cnt)
+		return -1;
+
+	dst->comment = malloc(comment_size);
+	dst->nodes = malloc(sizeof(struct nfa_node) * node_cnt);
+	if ((dst->comment == NULL && comment_size != 0) ||
+	    (dst->nodes == NULL && node_cnt != 0))
+		return -1;
+
+	memcpy(dst->comment, base + NFA_FILE_HEADER_SIZE, comment_size);
+	dst->comment_size = comment_size;
+
+	for (size_t i = 0; i < node_cnt; i++)
+		nfa_node_alloc(&dst->nodes[i], i);
+	dst->node_cnt = node_cnt;
+	dst->node_mem_size = node_cnt;
+	dst->first_index = first_index;
+
+	for (size_t i = 0; i < node_cnt; i++) {
+		struct nfa_node *node = &dst->nodes[i];
+		uint64_t from = get_le(trans_off + i * 8, 8),
+			 to = get_le(trans_off + (i + 1) * 8, 8),
+			 lfrom = get_le(lambda_off + i * 8, 8),
+			 lto = get_le(lambda_off + (i + 1) * 8, 8);
+
+		if (from > to || to > trans_cnt || lfrom > lto ||
+		    lto > lambda_cnt)
+			return -1;
+
+		node->isfinal = (flags[i] & NFA_FILE_FINAL) != 0;
+		node->self_closed = (flags[i] & NFA_FILE_SELF_CLOSED) != 0;
+		node->prefinal = (flags[i] & NFA_FILE_PREFINAL) != 0;
+
+		if (nfa_load_row(node, marks + from, trans + from * tps,
+				 to - from, tps, node_cnt) != 0 ||
+		    nfa_load_row(node, NULL, lambda + lfrom * tps,
+				 lto - lfrom, tps, node_cnt) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+int nfa_load_from_file(struct nfa *dst, char *filename)
+{
+	struct stat st;
+	void *map;
+	int fd, ret;
+
+	nfa_alloc(dst);
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		perror(filename);
+		return -1;
+	}
+
+	if (fstat(fd, &st) != 0 || st.st_size < NFA_FILE_HEADER_SIZE) {
+		close(fd);
+		return -1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	ret = nfa_load_parse(dst, map, st.st_size);
+	munmap(map, st.st_size);
+
+	if (ret != 0) {
+		nfa_free(dst);
+		nfa_alloc(dst);
+	}
+
+	return ret;
+}
+
 int nfa_lambda_reachable(size_t *dst, size_t *cnt, size_t from, struct nfa *src)
 {
 	*cnt = 0;
@@ -315,4 +315,30 @@ int nfa_copy_trans(struct nfa *nfa, size_t to, size_t from);
  */
 int nfa_remove_lambda(struct nfa *nfa);
 
+/**
+ * Save NFA to the file.
+ *
+ * Transitions of all states are stored in compressed sparse rows: the
+ * offsets of the states' rows followed by the marks and the targets
+ * of the transitions, lambda-transitions are stored the same way.
+ * Targets take 4 bytes if there are less than 2^32 states.
+ *
+ * @param nfa		pointer to the nfa structure
+ * @param filename	path where nfa must be saved
+ * @return		0 on success
+ */
+int nfa_save_to_file(const struct nfa *nfa, char *filename);
+
+/**
+ * Load NFA from the file.
+ *
+ * The file saved by nfa_save_to_file() is mapped into memory and
+ * the transitions are copied from the mapping.
+ *
+ * @param nfa		pointer to the nfa structure
+ * @param filename	path to the file with the saved nfa
+ * @return		0 on success
+ */
+int nfa_load_from_file(struct nfa *nfa, char *filename);
+
 #endif /** REFA_NFA_H @} */
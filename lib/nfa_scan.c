@@ -0,0 +1,376 @@
+/*
+ * Scanning of data with nondeterministic finite automaton.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "nfa_scan.h"
+
+/**
+ * @brief Signature of the transitions of one byte.
+ */
+struct nfa_scan_sig {
+	/**
+	 * @brief Hash of the transitions of the byte in every state.
+	 */
+	uint64_t hash;
+
+	/**
+	 * @brief The byte.
+	 */
+	int c;
+};
+
+/**
+ * @brief Mix the value into the signature.
+ *
+ * @param hash	the signature
+ * @param val	the value
+ * @return	the new signature
+ */
+static uint64_t nfa_scan_mix(uint64_t hash, uint64_t val)
+{
+	hash ^= val;
+	hash *= 0x100000001b3ULL;
+
+	return hash ^ (hash >> 29);
+}
+
+/**
+ * @brief Compare signatures for qsort(), bytes are kept in order.
+ */
+static int nfa_scan_sig_cmp(const void *a, const void *b)
+{
+	const struct nfa_scan_sig *x = a, *y = b;
+
+	if (x->hash != y->hash)
+		return x->hash < y->hash ? -1 : 1;
+
+	return x->c - y->c;
+}
+
+/**
+ * @brief Check if two bytes have the same transitions in every state.
+ *
+ * @param nfa	pointer to the nfa structure
+ * @param c1	the first byte
+ * @param c2	the second byte
+ * @return	true if the bytes are equivalent
+ */
+static bool nfa_scan_same_bytes(const struct nfa *nfa, int c1, int c2)
+{
+	for (size_t i = 0; i < nfa->node_cnt; i++) {
+		const struct nfa_node *node = &nfa->nodes[i];
+
+		if (node->trans_cnt[c1] != node->trans_cnt[c2])
+			return false;
+
+		if (node->trans_cnt[c1] != 0 &&
+		    memcmp(node->trans[c1], node->trans[c2],
+			   sizeof(size_t) * node->trans_cnt[c1]) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Split bytes into classes of equivalent bytes.
+ *
+ * The transitions are walked once to get the signature of every byte.
+ * Bytes are sorted by the signatures, so only the bytes with the same
+ * signature are compared. The classes are numbered in the order of
+ * their first bytes.
+ *
+ * @param ns	pointer to the nfa_scan structure
+ * @param nfa	pointer to the nfa structure
+ * @param rep	place for the first byte of every class
+ */
+static void nfa_scan_classes(struct nfa_scan *ns, const struct nfa *nfa,
+			     int *rep)
+{
+	struct nfa_scan_sig sig[256];
+	int first[256];
+
+	for (int c = 0; c < 256; c++) {
+		sig[c].hash = 0xcbf29ce484222325ULL;
+		sig[c].c = c;
+	}
+
+	for (size_t i = 0; i < nfa->node_cnt; i++) {
+		const struct nfa_node *node = &nfa->nodes[i];
+
+		for (int c = 0; c < 256; c++) {
+			if (node->trans_cnt[c] == 0)
+				continue;
+
+			sig[c].hash = nfa_scan_mix(sig[c].hash, i);
+			sig[c].hash = nfa_scan_mix(sig[c].hash,
+						   node->trans_cnt[c]);
+			for (size_t j = 0; j < node->trans_cnt[c]; j++)
+				sig[c].hash = nfa_scan_mix(sig[c].hash,
+							   node->trans[c][j]);
+		}
+	}
+
+	qsort(sig, 256, sizeof(*sig), nfa_scan_sig_cmp);
+
+	/* the bytes of a class follow its first byte in the same run */
+	for (int s = 0, run = 0; s < 256; s++) {
+		int c = sig[s].c, k;
+
+		if (s != 0 && sig[s].hash != sig[s - 1].hash)
+			run = s;
+
+		for (k = run; k < s; k++)
+			if (first[sig[k].c] == sig[k].c &&
+			    nfa_scan_same_bytes(nfa, sig[k].c, c))
+				break;
+
+		first[c] = k < s ? sig[k].c : c;
+	}
+
+	ns->class_cnt = 0;
+
+	for (int c = 0; c < 256; c++) {
+		if (first[c] == c)
+			rep[ns->class_cnt++] = c;
+
+		ns->classes[c] = first[c] == c ? ns->class_cnt - 1 :
+						 ns->classes[first[c]];
+	}
+}
+
+/**
+ * @brief Compute flags of the state.
+ *
+ * @param nfa	pointer to the nfa structure
+ * @param state	index of the state
+ * @return	flags of the state
+ */
+static uint8_t nfa_scan_state_flags(const struct nfa *nfa, size_t state)
+{
+	const struct nfa_node *node = &nfa->nodes[state];
+	uint8_t flags = 0;
+	bool stuck = !node->isfinal;
+
+	if (node->isfinal)
+		flags |= NFA_SCAN_FLAG_FINAL;
+
+	if (node->prefinal)
+		flags |= NFA_SCAN_FLAG_PREFINAL;
+
+	for (int c = 0; c < 256 && stuck; c++)
+		stuck = node->trans_cnt[c] == 1 && node->trans[c][0] == state;
+
+	if (stuck)
+		flags |= NFA_SCAN_FLAG_STUCK;
+
+	return flags;
+}
+
+int nfa_scan_alloc(struct nfa_scan *ns, const struct nfa *nfa)
+{
+	int rep[256];
+	size_t total = 0;
+
+	memset(ns, 0x00, sizeof(*ns));
+
+	if (nfa->node_cnt == 0)
+		return -1;
+
+	for (size_t i = 0; i < nfa->node_cnt; i++)
+		if (nfa->nodes[i].lambda_cnt != 0)
+			return -1;
+
+	nfa_scan_classes(ns, nfa, rep);
+
+	ns->state_cnt = nfa->node_cnt;
+	ns->first_index = nfa->first_index;
+	ns->offset = malloc(sizeof(size_t) *
+			    (ns->state_cnt * ns->class_cnt + 1));
+	ns->flags = malloc(ns->state_cnt);
+	if (ns->offset == NULL || ns->flags == NULL) {
+		nfa_scan_free(ns);
+		return -1;
+	}
+
+	for (size_t i = 0; i < ns->state_cnt; i++) {
+		ns->flags[i] = nfa_scan_state_flags(nfa, i);
+
+		for (size_t k = 0; k < ns->class_cnt; k++) {
+			ns->offset[i * ns->class_cnt + k] = total;
+			total += nfa->nodes[i].trans_cnt[rep[k]];
+		}
+	}
+	ns->offset[ns->state_cnt * ns->class_cnt] = total;
+
+	ns->succ = malloc(sizeof(size_t) * (total + 1));
+	if (ns->succ == NULL) {
+		nfa_scan_free(ns);
+		return -1;
+	}
+
+	for (size_t i = 0; i < ns->state_cnt; i++)
+		for (size_t k = 0; k < ns->class_cnt; k++)
+			memcpy(&ns->succ[ns->offset[i * ns->class_cnt + k]],
+			       nfa->nodes[i].trans[rep[k]],
+			       sizeof(size_t) * nfa->nodes[i].trans_cnt[rep[k]]);
+
+	return 0;
+}
+
+void nfa_scan_free(struct nfa_scan *ns)
+{
+	free(ns->offset);
+	free(ns->succ);
+	free(ns->flags);
+	memset(ns, 0x00, sizeof(*ns));
+}
+
+/**
+ * @brief Allocate empty set of states.
+ *
+ * @param ns	pointer to the nfa_scan structure
+ * @param set	pointer to the set
+ * @return	0 on success
+ */
+static int nfa_scan_set_alloc(const struct nfa_scan *ns,
+			      struct nfa_scan_set *set)
+{
+	set->dense = malloc(sizeof(size_t) * (ns->state_cnt + 1));
+	set->bits = calloc(ns->state_cnt / 64 + 1, sizeof(uint64_t));
+	set->cnt = 0;
+	set->live_cnt = 0;
+
+	return set->dense != NULL && set->bits != NULL ? 0 : -1;
+}
+
+/**
+ * @brief Remove all states from the set.
+ *
+ * @param set	pointer to the set
+ */
+static inline void nfa_scan_set_clear(struct nfa_scan_set *set)
+{
+	for (size_t i = 0; i < set->cnt; i++)
+		set->bits[set->dense[i] / 64] = 0;
+
+	set->cnt = 0;
+	set->live_cnt = 0;
+}
+
+/**
+ * @brief Add state to the set.
+ *
+ * @param ns	pointer to the nfa_scan structure
+ * @param set	pointer to the set
+ * @param state	index of the state
+ */
+static inline void nfa_scan_set_add(const struct nfa_scan *ns,
+				    struct nfa_scan_set *set, size_t state)
+{
+	uint64_t bit = (uint64_t)1 << (state % 64);
+
+	if (set->bits[state / 64] & bit)
+		return;
+
+	set->bits[state / 64] |= bit;
+	set->dense[set->cnt++] = state;
+	if (!(ns->flags[state] & NFA_SCAN_FLAG_STUCK))
+		set->live_cnt++;
+}
+
+int nfa_scan_state_alloc(const struct nfa_scan *ns, struct nfa_scan_state *st)
+{
+	bool failure = false;
+
+	memset(st, 0x00, sizeof(*st));
+
+	failure = nfa_scan_set_alloc(ns, &st->cur) != 0 ||
+		  nfa_scan_set_alloc(ns, &st->next) != 0;
+
+	if (failure) {
+		nfa_scan_state_free(st);
+		return -1;
+	}
+
+	nfa_scan_state_reset(ns, st);
+
+	return 0;
+}
+
+void nfa_scan_state_reset(const struct nfa_scan *ns, struct nfa_scan_state *st)
+{
+	nfa_scan_set_clear(&st->cur);
+	nfa_scan_set_clear(&st->next);
+	nfa_scan_set_add(ns, &st->cur, ns->first_index);
+	st->matched = false;
+}
+
+void nfa_scan_state_free(struct nfa_scan_state *st)
+{
+	free(st->cur.dense);
+	free(st->cur.bits);
+	free(st->next.dense);
+	free(st->next.bits);
+	memset(st, 0x00, sizeof(*st));
+}
+
+size_t nfa_scan(const struct nfa_scan *ns, struct nfa_scan_state *st,
+		const void *data, size_t len)
+{
+	const unsigned char *ptr = data;
+
+	if (st->matched)
+		return 0;
+
+	for (size_t i = 0; i < len; i++) {
+		size_t base = ns->classes[ptr[i]];
+		struct nfa_scan_set tmp;
+
+		/* nothing but stuck states, the stream will never match */
+		if (st->cur.live_cnt == 0)
+			break;
+
+		nfa_scan_set_clear(&st->next);
+
+		for (size_t j = 0; j < st->cur.cnt; j++) {
+			size_t state = st->cur.dense[j];
+			size_t from, to;
+
+			/* any byte leads to an accepting state */
+			if (ns->flags[state] & NFA_SCAN_FLAG_PREFINAL) {
+				st->matched = true;
+				return i + 1;
+			}
+
+			from = ns->offset[state * ns->class_cnt + base];
+			to = ns->offset[state * ns->class_cnt + base + 1];
+
+			for (size_t k = from; k < to; k++) {
+				size_t next = ns->succ[k];
+
+				if (ns->flags[next] & NFA_SCAN_FLAG_FINAL) {
+					st->matched = true;
+					return i + 1;
+				}
+
+				nfa_scan_set_add(ns, &st->next, next);
+			}
+		}
+
+		tmp = st->cur;
+		st->cur = st->next;
+		st->next = tmp;
+	}
+
+	return DFA_SCAN_NO_MATCH;
+}
@@ -0,0 +1,189 @@
+/*
+ * Scanning of data with nondeterministic finite automaton.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup scan scan
+ * @{
+ */
+
+#ifndef REFA_NFA_SCAN_H
+#define REFA_NFA_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "dfa_scan.h"
+#include "nfa.h"
+
+/** the state is an accepting one */
+#define NFA_SCAN_FLAG_FINAL	(1)
+
+/** all transitions from the state lead to accepting states */
+#define NFA_SCAN_FLAG_PREFINAL	(2)
+
+/** the state is not accepting and all its transitions lead to itself */
+#define NFA_SCAN_FLAG_STUCK	(4)
+
+/**
+ * structure that represents NFA prepared for the simulation
+ *
+ * Transitions are stored in compressed rows: successors of the state by
+ * the byte class are succ[offset[state * class_cnt + class]] ..
+ * succ[offset[state * class_cnt + class + 1] - 1]. Bytes that have the
+ * same transitions in every state share one class.
+ */
+struct nfa_scan {
+	/**
+	 * number of states
+	 */
+	size_t state_cnt;
+
+	/**
+	 * index of the initial state
+	 */
+	size_t first_index;
+
+	/**
+	 * classes of bytes
+	 */
+	uint8_t classes[256];
+
+	/**
+	 * number of byte classes
+	 */
+	size_t class_cnt;
+
+	/**
+	 * offsets of the successors' lists
+	 */
+	size_t *offset;
+
+	/**
+	 * successors of all states
+	 */
+	size_t *succ;
+
+	/**
+	 * flags of the states (NFA_SCAN_FLAG_*)
+	 */
+	uint8_t *flags;
+};
+
+/**
+ * structure that represents set of NFA states
+ *
+ * The list of states is used for the iteration, the bitset is used for
+ * the membership test. Only the bits of the listed states are cleared,
+ * so the cost of the set does not depend on the number of NFA states.
+ */
+struct nfa_scan_set {
+	/**
+	 * list of states in the set
+	 */
+	size_t *dense;
+
+	/**
+	 * bitset of states in the set
+	 */
+	uint64_t *bits;
+
+	/**
+	 * number of states in the set
+	 */
+	size_t cnt;
+
+	/**
+	 * number of states in the set that are not stuck
+	 */
+	size_t live_cnt;
+};
+
+/**
+ * structure that represents state of the scanned stream
+ */
+struct nfa_scan_state {
+	/**
+	 * active states
+	 */
+	struct nfa_scan_set cur;
+
+	/**
+	 * states after the next byte
+	 */
+	struct nfa_scan_set next;
+
+	/**
+	 * an accepting state was reached
+	 */
+	bool matched;
+};
+
+/**
+ * Prepare NFA for the simulation.
+ *
+ * The NFA must not have lambda-transitions (see nfa_rebuild()). Memory
+ * of the result and of the scan is linear in the size of the NFA, so it
+ * is the fallback when the DFA of the NFA is too large to be built.
+ *
+ * @param ns	pointer to the nfa_scan structure
+ * @param nfa	pointer to the lambda-free nfa structure
+ * @return	0 on success, -1 on error or if the NFA has lambda-transitions
+ */
+int nfa_scan_alloc(struct nfa_scan *ns, const struct nfa *nfa);
+
+/**
+ * Free NFA prepared for the simulation.
+ *
+ * @param ns	pointer to the nfa_scan structure
+ */
+void nfa_scan_free(struct nfa_scan *ns);
+
+/**
+ * Allocate state of the stream.
+ *
+ * The state is set to the initial one.
+ *
+ * @param ns	pointer to the nfa_scan structure
+ * @param st	pointer to the state of the stream
+ * @return	0 on success
+ */
+int nfa_scan_state_alloc(const struct nfa_scan *ns, struct nfa_scan_state *st);
+
+/**
+ * Reset state of the stream to the initial one.
+ *
+ * @param ns	pointer to the nfa_scan structure
+ * @param st	pointer to the state of the stream
+ */
+void nfa_scan_state_reset(const struct nfa_scan *ns, struct nfa_scan_state *st);
+
+/**
+ * Free state of the stream.
+ *
+ * @param st	pointer to the state of the stream
+ */
+void nfa_scan_state_free(struct nfa_scan_state *st);
+
+/**
+ * Scan data with NFA.
+ *
+ * Simulates all paths of the NFA at once, the cost of a byte is bounded
+ * by the number of transitions of the active states. Chunks of the stream
+ * are scanned by subsequent calls with the same state. The result is
+ * the same as the result of dfa_scan() with the DFA of the NFA.
+ *
+ * @param ns	pointer to the nfa_scan structure
+ * @param st	pointer to the state of the stream
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @return	offset just past the byte that led to an accepting state
+ *		or DFA_SCAN_NO_MATCH
+ */
+size_t nfa_scan(const struct nfa_scan *ns, struct nfa_scan_state *st,
+		const void *data, size_t len);
+
+#endif /** REFA_NFA_SCAN_H @} */
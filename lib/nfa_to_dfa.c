@@ -740,17 +740,205 @@ static int rb_tree_try_add(struct rb_tree *tree, struct nfa_dfa_pair *pair)
 	return 0;
 }
 
+/**
+ * @brief Tag of the NFA stored in the checkpoint.
+ *
+ * All the transitions and the final states are mixed in, so
+ * the checkpoint of the other NFA of the same size is not resumed.
+ *
+ * @param nfa	the source NFA
+ * @return	the tag
+ */
+static uint64_t nfa_to_dfa_tag(const struct nfa *nfa)
+{
+	uint64_t tag = 0;
+
+	tag = dfa_checkpoint_tag(tag, nfa->node_cnt);
+	tag = dfa_checkpoint_tag(tag, nfa->first_index);
+
+	for (size_t i = 0; i < nfa->node_cnt; i++) {
+		const struct nfa_node *node = &nfa->nodes[i];
+
+		tag = dfa_checkpoint_tag(tag, node->isfinal);
+		tag = dfa_checkpoint_tag(tag, node->lambda_cnt);
+		for (size_t j = 0; j < node->lambda_cnt; j++)
+			tag = dfa_checkpoint_tag(tag, node->lambda_trans[j]);
+
+		for (int c = 0; c < 256; c++) {
+			tag = dfa_checkpoint_tag(tag, node->trans_cnt[c]);
+			for (size_t j = 0; j < node->trans_cnt[c]; j++)
+				tag = dfa_checkpoint_tag(tag, node->trans[c][j]);
+		}
+	}
+
+	return tag;
+}
+
+/**
+ * @brief Write the pairs of the subtree to the checkpoint.
+ *
+ * Every pair is stored as the DFA state, the number of NFA states and
+ * the NFA states set.
+ *
+ * @param tree	pointer to the tree structure
+ * @param node	root of the subtree
+ * @param cp	pointer to the checkpoint being written
+ * @return	0 on success
+ */
+static int rb_tree_save(const struct rb_tree *tree, const struct rb_node *node,
+			struct dfa_checkpoint *cp)
+{
+	bool failure = false;
+
+	while (node != &tree->nil && !failure) {
+		const struct nfa_dfa_pair *pair = node->pair;
+
+		failure = rb_tree_save(tree, node->left, cp) != 0 ||
+			  dfa_checkpoint_put(cp, pair->dfa_state) != 0 ||
+			  dfa_checkpoint_put(cp, pair->nfa_count) != 0;
+
+		for (size_t i = 0; i < pair->nfa_count && !failure; i++)
+			failure = dfa_checkpoint_put(cp, pair->nfa_states[i]) != 0;
+
+		node = node->right;
+	}
+
+	return !failure ? 0 : -1;
+}
+
+/**
+ * @brief Save the state of the conversion.
+ *
+ * The queue is not stored: it holds the pairs of the unprocessed DFA
+ * states in the order of their indices.
+ *
+ * @param cp	pointer to the checkpoint
+ * @param src	the source NFA
+ * @param dst	the DFA built so far
+ * @param t	tree with all found pairs
+ * @param done	number of the processed DFA states
+ * @return	0 on success
+ */
+static int nfa_to_dfa_save(struct dfa_checkpoint *cp, const struct nfa *src,
+			   const struct dfa *dst, const struct rb_tree *t,
+			   size_t done)
+{
+	if (dfa_checkpoint_begin(cp, DFA_CHECKPOINT_NFA_TO_DFA,
+				 nfa_to_dfa_tag(src), done) != 0)
+		return -1;
+
+	if (rb_tree_save(t, t->root, cp) != 0) {
+		dfa_checkpoint_close(cp);
+		return -1;
+	}
+
+	return dfa_checkpoint_commit(cp, dst);
+}
+
+/**
+ * @brief Restore the state of the conversion from the checkpoint.
+ *
+ * Fills the tree with all found pairs and the queue with the pairs of
+ * the unprocessed DFA states, dst is replaced with the saved DFA.
+ *
+ * @param cp	pointer to the checkpoint
+ * @param src	the source NFA
+ * @param dst	the destination DFA
+ * @param t	empty tree
+ * @param q	empty queue
+ * @return	0 on success, 1 if there is no checkpoint, -1 on failure
+ */
+static int nfa_to_dfa_resume(struct dfa_checkpoint *cp, const struct nfa *src,
+			     struct dfa *dst, struct rb_tree *t,
+			     struct ptr_queue *q)
+{
+	struct nfa_dfa_pair **pending = NULL;
+	struct nfa_dfa_pair *pair;
+	uint64_t done, dfa_state, cnt, state;
+	size_t pending_cnt = 0;
+	struct dfa dfa;
+	bool failure;
+	int ret;
+
+	ret = dfa_checkpoint_resume(cp, DFA_CHECKPOINT_NFA_TO_DFA,
+				    nfa_to_dfa_tag(src), &done, &dfa);
+	if (ret != 0)
+		return ret;
+
+	failure = dfa.bps != dst->bps || dfa.state_cnt > dst->state_max_cnt ||
+		  done > dfa.state_cnt;
+
+	if (!failure) {
+		pending_cnt = dfa.state_cnt - done;
+		pending = calloc(pending_cnt + 1, sizeof(*pending));
+		failure = pending == NULL;
+	}
+
+	while (!failure && dfa_checkpoint_get(cp, &dfa_state) == 0) {
+		pair = nfa_dfa_pair_alloc();
+
+		failure = pair == NULL || dfa_checkpoint_get(cp, &cnt) != 0 ||
+			  dfa_state >= dfa.state_cnt;
+
+		for (uint64_t i = 0; i < cnt && !failure; i++)
+			failure = dfa_checkpoint_get(cp, &state) != 0 ||
+				  state >= src->node_cnt ||
+				  nfa_dfa_pair_add(&pair, state) != 0;
+
+		if (!failure) {
+			pair->dfa_state = dfa_state;
+			failure = rb_tree_try_add(t, pair) != 0;
+		}
+
+		if (failure) {
+			nfa_dfa_pair_free(pair);
+		} else if (dfa_state >= done) {
+			failure = pending[dfa_state - done] != NULL;
+			pending[dfa_state - done] = pair;
+		}
+	}
+
+	/* the queue is in the order of the DFA states */
+	for (size_t i = 0; i < pending_cnt && !failure; i++)
+		failure = pending[i] == NULL ||
+			  ptr_queue_push(q, pending[i]) != 0;
+
+	free(pending);
+	dfa_checkpoint_close(cp);
+
+	if (failure) {
+		dfa_free(&dfa);
+		return -1;
+	}
+
+	dfa.state_max_cnt = dst->state_max_cnt;
+	dfa_free(dst);
+	*dst = dfa;
+
+	return 0;
+}
+
 int convert_nfa_to_dfa(struct dfa *dst, const struct nfa *src)
+{
+	return convert_nfa_to_dfa_checkpoint(dst, src, NULL) == 0 ? 0 : 1;
+}
+
+int convert_nfa_to_dfa_checkpoint(struct dfa *dst, const struct nfa *src,
+				  struct dfa_checkpoint *cp)
 {
 	struct ptr_queue q;
 	struct rb_tree t;
-	const struct nfa_dfa_pair *pair;
+	const struct nfa_dfa_pair *pair = NULL;
 	struct nfa_dfa_pair *next_pair = NULL;
 	size_t nfa_index;
 	size_t dfa_index;
+	size_t done;
+	size_t processed = 0;
 	int rb_added;
+	int resumed = 1;
 	bool final;
 	bool failure = false;
+	bool stopped = false;
 
 	nfa_index = nfa_get_initial_state(src);
 
@@ -758,7 +946,14 @@ int convert_nfa_to_dfa(struct dfa *dst, const struct nfa *src)
 
 	rb_tree_init(&t);
 
-	if (dfa_add_state(dst, &dfa_index) != 0) {
+	if (cp != NULL)
+		resumed = nfa_to_dfa_resume(cp, src, dst, &t, &q);
+
+	if (resumed < 0) {
+		failure = true;
+	} else if (resumed == 0) {
+		pair = ptr_queue_pop(&q);
+	} else if (dfa_add_state(dst, &dfa_index) != 0) {
 		failure = true;
 	} else if ((next_pair = nfa_dfa_pair_alloc()) == NULL) {
 		failure = true;
@@ -768,15 +963,14 @@ int convert_nfa_to_dfa(struct dfa *dst, const struct nfa *src)
 		failure = true;
 	} else {
 		next_pair->dfa_state = dfa_index;
+		pair = next_pair;
 	}
 
 	if (failure) {
 		nfa_dfa_pair_free(next_pair);
 	}
 
-	pair = next_pair;
-
-	do {
+	while (pair != NULL && !failure) {
 		for (unsigned int i = 0; i < 256 && !failure; i++) {
 			next_pair = nfa_dfa_pair_next_state(src, pair,
 							    (unsigned char)i,
@@ -811,19 +1005,121 @@ int convert_nfa_to_dfa(struct dfa *dst, const struct nfa *src)
 				failure = true;
 			}
 		}
-	} while ((pair = ptr_queue_pop(&q)) != NULL && !failure);
+
+		done = pair->dfa_state + 1;
+		processed++;
+
+		pair = ptr_queue_pop(&q);
+		if (failure || cp == NULL || pair == NULL)
+			continue;
+
+		if (cp->limit != 0 && processed == cp->limit) {
+			stopped = true;
+			failure = nfa_to_dfa_save(cp, src, dst, &t, done) != 0;
+			break;
+		}
+
+		/* the failed checkpoint does not break the conversion */
+		if (cp->interval != 0 && done % cp->interval == 0)
+			nfa_to_dfa_save(cp, src, dst, &t, done);
+	}
 
 	/*
 	 * @todo Add not so fragile interface for setting up comment property.
 	 */
-	if (!failure) {
+	if (!failure && !stopped) {
 		dst->comment_size = src->comment_size;
 		dst->comment = realloc(dst->comment, dst->comment_size);
 		memcpy(dst->comment, src->comment, dst->comment_size);
+
+		if (cp != NULL)
+			dfa_checkpoint_remove(cp);
 	}
 
 	rb_tree_deinit(&t);
 	ptr_queue_deinit(&q);
 
-	return !failure ? 0 : 1;
+	if (failure)
+		return -1;
+
+	return !stopped ? 0 : 1;
+}
+
+/**
+ * @brief Replace NFA states set of the pair.
+ *
+ * @param pair		pointer to the pair
+ * @param states	sorted NFA states
+ * @param cnt		number of NFA states
+ * @return		0 on success
+ */
+static int nfa_dfa_pair_set(struct nfa_dfa_pair **pair, const size_t *states,
+			    size_t cnt)
+{
+	struct nfa_dfa_pair *mem;
+
+	if ((*pair)->nfa_count_reserved < cnt) {
+		mem = realloc(*pair, sizeof(struct nfa_dfa_pair) +
+				     sizeof(size_t) * cnt);
+		if (mem == NULL)
+			return -1;
+
+		*pair = mem;
+		(*pair)->nfa_count_reserved = cnt;
+	}
+
+	memcpy((*pair)->nfa_states, states, sizeof(size_t) * cnt);
+	(*pair)->nfa_count = cnt;
+
+	return 0;
+}
+
+int convert_nfa_to_dfa_extern(struct dfa *dst, const struct nfa *src,
+			      struct dfa_extern *ext, const char *filename)
+{
+	struct nfa_dfa_pair *pair;
+	struct nfa_dfa_pair *next_pair;
+	const size_t *key;
+	size_t nfa_index;
+	size_t dfa_index;
+	size_t len;
+	bool final;
+	bool failure;
+	int ret = 0;
+
+	nfa_index = nfa_get_initial_state(src);
+
+	/* the initial state is not final, as in convert_nfa_to_dfa() */
+	pair = nfa_dfa_pair_alloc();
+	failure = pair == NULL ||
+		  dfa_extern_begin(ext, dst, filename, false, &nfa_index, 1,
+				   false) != 0;
+
+	while (!failure &&
+	       (ret = dfa_extern_next(ext, &key, &len, &dfa_index)) == 0) {
+		failure = nfa_dfa_pair_set(&pair, key, len) != 0;
+
+		for (unsigned int i = 0; i < 256 && !failure; i++) {
+			next_pair = nfa_dfa_pair_next_state(src, pair,
+							    (unsigned char)i,
+							    &final);
+			failure = next_pair == NULL ||
+				  dfa_extern_trans(ext, (unsigned char)i,
+						   next_pair->nfa_states,
+						   next_pair->nfa_count,
+						   final) != 0;
+			if (next_pair != NULL)
+				nfa_dfa_pair_free(next_pair);
+		}
+	}
+
+	if (pair != NULL)
+		nfa_dfa_pair_free(pair);
+
+	if (failure || ret < 0) {
+		dfa_extern_abort(ext);
+		return -1;
+	}
+
+	return dfa_extern_finish(ext, dst, src->comment, src->comment_size);
 }
@@ -13,6 +13,8 @@
 #define REFA_NFA_TO_DFA_H
 
 #include "dfa.h"
+#include "dfa_checkpoint.h"
+#include "dfa_extern.h"
 #include "nfa.h"
 
 /**
@@ -26,4 +28,43 @@
  */
 int convert_nfa_to_dfa(struct dfa *dfa, const struct nfa *nfa);
 
+/**
+ * Converting lambda-free NFA to DFA with checkpoints.
+ *
+ * Same as convert_nfa_to_dfa(), but saves the state of the conversion
+ * to the checkpoint every cp->interval processed DFA states. If the
+ * checkpoint file exists, the conversion is resumed from it and builds
+ * the same DFA as the uninterrupted one. The checkpoint file is removed
+ * when the conversion is finished. If cp->limit states were processed,
+ * the checkpoint is saved and the conversion stops: dst holds
+ * the unfinished DFA and has to be freed.
+ *
+ * @param dfa	pointer to the existing and initialized empty DFA
+ * @param nfa	pointer to the source NFA without lambda-transitions
+ * @param cp	pointer to the checkpoint or NULL
+ * @return	0 on success, 1 if the conversion is stopped,
+ *		-1 on failure or if the checkpoint is not of this NFA
+ */
+int convert_nfa_to_dfa_checkpoint(struct dfa *dfa, const struct nfa *nfa,
+				  struct dfa_checkpoint *cp);
+
+/**
+ * Converting lambda-free NFA to DFA in the external memory.
+ *
+ * Same as convert_nfa_to_dfa(), but the table of NFA states sets and
+ * the queue of the unprocessed states are kept on disk and the batches
+ * of states take about ext->mem_size bytes (see dfa_extern.h). The DFA is
+ * the same as the one built by convert_nfa_to_dfa(), its transitions are
+ * written straight into the mappable image and dfa is replaced with
+ * the mapping of the image.
+ *
+ * @param dfa		pointer to the existing and initialized empty DFA
+ * @param nfa		pointer to the source NFA without lambda-transitions
+ * @param ext		pointer to the external-memory construction
+ * @param filename	path to the DFA's image, NULL for the temporary file
+ * @return		0 on success
+ */
+int convert_nfa_to_dfa_extern(struct dfa *dfa, const struct nfa *nfa,
+			      struct dfa_extern *ext, const char *filename);
+
 #endif /** REFA_NFA_TO_DFA_H @} */
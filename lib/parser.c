@@ -813,6 +813,20 @@ void regexp_node_free(struct regexp_node *re_node)
 	}
 }
 
+bool regexp_node_is_any(const struct regexp_node *node)
+{
+	if (node->type != RE_CHARCLASS ||
+	    node->repeat.min != 0 || node->repeat.max != -1)
+		return false;
+
+	for (int i = 0; i < 256; i++)
+		if (GET_BIT(node->data.cc_data.data, i) ==
+		    node->data.cc_data.inverse)
+			return false;
+
+	return true;
+}
+
 void first_pass_result_print(struct first_pass_result *result,
 				    const char *pattern,
 				    const char *ptr);
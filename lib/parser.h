@@ -204,4 +204,16 @@ void regexp_tree_free(struct regexp_tree *re_tree);
  */
 void regexp_tree_print(struct regexp_tree *re_tree);
 
+/**
+ * Check if node matches any string.
+ *
+ * Checks if the node is a character class with all characters repeated
+ * from zero to infinity times. Such nodes are added around unanchored
+ * regular expressions.
+ *
+ * @param node	pointer to the regexp node
+ * @return	true if the node matches any string
+ */
+bool regexp_node_is_any(const struct regexp_node *node);
+
 #endif /** REFA_PARSER_H @} */
@@ -0,0 +1,367 @@
+/*
+ * Literal prefilter of regular expressions.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nfa.h"
+#include "nfa_to_dfa.h"
+#include "parser.h"
+#include "prefilter.h"
+#include "tree_to_nfa.h"
+#include "dfa_scan_inner.h"
+
+/**
+ * @brief Marker of the patterns whose literals were not found.
+ */
+#define PREFILTER_NONE	((size_t)-1)
+
+/**
+ * @brief Get rough frequency rank of the byte in typical traffic.
+ *
+ * Literals are searched by their rarest bytes, so the anchor bytes
+ * are found in data as rarely as possible.
+ *
+ * @param c	byte
+ * @return	rank, the higher the more frequent
+ */
+static int prefilter_byte_rank(unsigned char c)
+{
+	if (c == ' ')
+		return 100;
+	if (c != '\0' && strchr("etaoinshrdlu", c) != NULL)
+		return 90;
+	if (islower(c))
+		return 70;
+	if (isdigit(c))
+		return 60;
+	if (c == '\0' || isupper(c))
+		return 50;
+	if (c == '\n' || c == '\r' || c == '\t')
+		return 40;
+	if (isprint(c))
+		return 30;
+
+	return 10;
+}
+
+/**
+ * @brief Choose the anchor byte of the literal.
+ *
+ * @param lit	pointer to the literal
+ * @return	offset of the anchor byte in the literal
+ */
+static size_t prefilter_anchor(const struct re_literal *lit)
+{
+	size_t best = 0;
+	int best_rank = 0;
+
+	for (size_t i = 0; i < lit->len; i++) {
+		unsigned char c = lit->str[i];
+		int rank = prefilter_byte_rank(c);
+
+		if (lit->caseless && isalpha(c))
+			rank += prefilter_byte_rank(toupper(c));
+
+		if (i == 0 || rank < best_rank) {
+			best = i;
+			best_rank = rank;
+		}
+	}
+
+	return best;
+}
+
+/**
+ * @brief Add byte to the set of anchor bytes.
+ *
+ * @param anchors	pointer to the set
+ * @param c		byte
+ */
+static void prefilter_anchor_add(struct dfa_accel *anchors, unsigned char c)
+{
+	uint8_t *set = (c & 0x80) ? anchors->hi : anchors->lo;
+	uint8_t bit = 1 << ((c >> 4) & 0x07);
+
+	if (set[c & 0x0F] & bit)
+		return;
+
+	set[c & 0x0F] |= bit;
+	if (anchors->cnt == 0 || c < anchors->byte)
+		anchors->byte = c;
+	anchors->cnt++;
+}
+
+/**
+ * @brief Call function for every byte that the literal's anchor matches.
+ *
+ * @param pf	pointer to the prefilter structure
+ * @param p	index of the pattern
+ * @param l	index of the literal
+ * @param fill	fill the entries, otherwise only count them
+ */
+static void prefilter_entry_add(struct prefilter *pf, size_t p, size_t l,
+				bool fill)
+{
+	const struct re_literal *lit = &pf->pats[p].lits.lit[l];
+	size_t offset = prefilter_anchor(lit);
+	unsigned char bytes[2];
+	int cnt = 0;
+
+	bytes[cnt++] = lit->str[offset];
+	if (lit->caseless && isalpha(lit->str[offset]))
+		bytes[cnt++] = toupper(lit->str[offset]);
+
+	for (int i = 0; i < cnt; i++) {
+		if (fill) {
+			struct prefilter_entry *entry;
+
+			entry = &pf->entries[pf->bucket[bytes[i]]++];
+			entry->pattern = p;
+			entry->lit = l;
+			entry->offset = offset;
+		} else {
+			pf->bucket[bytes[i] + 1]++;
+			prefilter_anchor_add(&pf->anchors, bytes[i]);
+		}
+	}
+}
+
+/**
+ * @brief Build minimized and accelerated DFA of the regexp tree.
+ *
+ * @param dfa		pointer to the allocated dfa structure
+ * @param re_tree	pointer to the regexp tree
+ * @return		0 on success
+ */
+static int prefilter_build_dfa(struct dfa *dfa, struct regexp_tree *re_tree)
+{
+	struct nfa nfa;
+	bool failure = false;
+
+	if (nfa_alloc(&nfa) != 0)
+		return -1;
+
+	failure = convert_tree_to_lambdanfa(&nfa, re_tree) != 0 ||
+		  nfa_rebuild(&nfa) != 0 ||
+		  convert_nfa_to_dfa(dfa, &nfa) != 0 ||
+		  dfa_minimize(dfa) != 0 ||
+		  dfa_accelerate(dfa) != 0;
+
+	nfa_free(&nfa);
+
+	return !failure ? 0 : -1;
+}
+
+int prefilter_alloc(struct prefilter *pf)
+{
+	memset(pf, 0x00, sizeof(*pf));
+
+	return 0;
+}
+
+void prefilter_free(struct prefilter *pf)
+{
+	for (size_t i = 0; i < pf->cnt; i++)
+		dfa_free(&pf->pats[i].dfa);
+
+	free(pf->pats);
+	free(pf->entries);
+	memset(pf, 0x00, sizeof(*pf));
+}
+
+int prefilter_add(struct prefilter *pf, const char *regexp, size_t *id)
+{
+	struct prefilter_pattern *pat;
+	struct regexp_tree *re_tree;
+	const struct regexp_node *core;
+
+	if (pf->cnt == pf->malloc_cnt) {
+		size_t new_cnt = pf->malloc_cnt != 0 ? pf->malloc_cnt * 2 : 16;
+		struct prefilter_pattern *tmp;
+
+		tmp = realloc(pf->pats, sizeof(struct prefilter_pattern) * new_cnt);
+		if (tmp == NULL)
+			return -1;
+
+		pf->pats = tmp;
+		pf->malloc_cnt = new_cnt;
+	}
+
+	re_tree = regexp_to_tree(regexp, NULL);
+	if (re_tree == NULL)
+		return -1;
+
+	pat = &pf->pats[pf->cnt];
+	if (dfa_alloc(&pat->dfa) != 0) {
+		regexp_tree_free(re_tree);
+		return -1;
+	}
+
+	if (prefilter_build_dfa(&pat->dfa, re_tree) != 0) {
+		dfa_free(&pat->dfa);
+		regexp_tree_free(re_tree);
+		return -1;
+	}
+
+	regexp_tree_literals(re_tree, &pat->lits);
+	core = regexp_tree_core(re_tree, &pat->floating);
+	pat->width = regexp_node_max_width(core);
+	regexp_tree_free(re_tree);
+
+	if (id != NULL)
+		*id = pf->cnt;
+	pf->cnt++;
+	pf->compiled = false;
+
+	return 0;
+}
+
+int prefilter_compile(struct prefilter *pf)
+{
+	size_t total;
+
+	memset(pf->bucket, 0x00, sizeof(pf->bucket));
+	memset(&pf->anchors, 0x00, sizeof(pf->anchors));
+
+	for (size_t p = 0; p < pf->cnt; p++)
+		for (size_t l = 0; l < pf->pats[p].lits.cnt; l++)
+			prefilter_entry_add(pf, p, l, false);
+
+	for (int c = 0; c < 256; c++)
+		pf->bucket[c + 1] += pf->bucket[c];
+	total = pf->bucket[256];
+
+	free(pf->entries);
+	pf->entries = malloc(sizeof(struct prefilter_entry) * (total + 1));
+	if (pf->entries == NULL)
+		return -1;
+
+	/* buckets are shifted by one while filled and restored after it */
+	for (size_t p = 0; p < pf->cnt; p++)
+		for (size_t l = 0; l < pf->pats[p].lits.cnt; l++)
+			prefilter_entry_add(pf, p, l, true);
+
+	memmove(pf->bucket + 1, pf->bucket, sizeof(size_t) * 256);
+	pf->bucket[0] = 0;
+	pf->compiled = true;
+
+	return 0;
+}
+
+/**
+ * @brief Find the first anchor byte of every pattern's literals.
+ *
+ * @param pf	pointer to the prefilter structure
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @param first	place for the offsets of the first anchor bytes
+ * @param stat	pointer to the statistics
+ */
+static void prefilter_scan_literals(const struct prefilter *pf,
+				    const unsigned char *data, size_t len,
+				    size_t *first, struct prefilter_stat *stat)
+{
+	size_t remaining = 0;
+
+	for (size_t p = 0; p < pf->cnt; p++) {
+		first[p] = PREFILTER_NONE;
+		if (pf->pats[p].lits.cnt != 0)
+			remaining++;
+	}
+
+	if (pf->anchors.cnt == 0)
+		return;
+
+	for (size_t i = 0; i < len && remaining > 0; i++) {
+		size_t from, to;
+
+		i += dfa_scan_skip(&pf->anchors, data + i, len - i);
+		if (i >= len)
+			break;
+
+		stat->anchor_hits++;
+		from = pf->bucket[data[i]];
+		to = pf->bucket[data[i] + 1];
+
+		for (size_t e = from; e < to; e++) {
+			const struct prefilter_entry *entry = &pf->entries[e];
+			const struct re_literal *lit;
+			size_t start;
+
+			if (first[entry->pattern] != PREFILTER_NONE ||
+			    i < entry->offset)
+				continue;
+
+			lit = &pf->pats[entry->pattern].lits.lit[entry->lit];
+			start = i - entry->offset;
+			if (len - start < lit->len ||
+			    !re_literal_match(lit, data + start))
+				continue;
+
+			first[entry->pattern] = i;
+			stat->literal_hits++;
+			remaining--;
+		}
+	}
+}
+
+int prefilter_scan(const struct prefilter *pf, const void *data, size_t len,
+		   dfa_match_cb cb, void *ctx, struct prefilter_stat *stat)
+{
+	struct prefilter_stat local;
+	size_t *first;
+
+	if (!pf->compiled)
+		return -1;
+
+	if (stat == NULL)
+		stat = &local;
+	memset(stat, 0x00, sizeof(*stat));
+
+	first = malloc(sizeof(size_t) * (pf->cnt + 1));
+	if (first == NULL)
+		return -1;
+
+	prefilter_scan_literals(pf, data, len, first, stat);
+
+	for (size_t p = 0; p < pf->cnt; p++) {
+		const struct prefilter_pattern *pat = &pf->pats[p];
+		size_t state = pat->dfa.first_index;
+		size_t start = 0;
+		size_t match;
+
+		if (pat->lits.cnt != 0 && first[p] == PREFILTER_NONE)
+			continue;
+
+		/*
+		 * the first match contains a literal whose anchor is not before
+		 * the first found anchor, so it can't start earlier than
+		 * the maximum width before the byte after that anchor
+		 */
+		if (pat->lits.cnt != 0 && pat->floating &&
+		    pat->width != RE_WIDTH_INF && first[p] + 1 > pat->width)
+			start = first[p] + 1 - pat->width;
+
+		match = dfa_scan(&pat->dfa, &state,
+				 (const unsigned char *)data + start,
+				 len - start);
+		stat->dfa_bytes += (match != DFA_SCAN_NO_MATCH ?
+				    match : len - start);
+
+		if (match != DFA_SCAN_NO_MATCH && cb(p, start + match, ctx) != 0)
+			break;
+	}
+
+	free(first);
+
+	return 0;
+}
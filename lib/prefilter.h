@@ -0,0 +1,193 @@
+/*
+ * Literal prefilter of regular expressions.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup prefilter prefilter
+ * @{
+ */
+
+#ifndef REFA_PREFILTER_H
+#define REFA_PREFILTER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "dfa.h"
+#include "dfa_scan.h"
+#include "literal.h"
+
+/**
+ * structure that represents one pattern of the prefilter
+ */
+struct prefilter_pattern {
+	/**
+	 * minimized DFA of the pattern
+	 */
+	struct dfa dfa;
+
+	/**
+	 * literals required by the pattern, empty set if there are none
+	 */
+	struct re_literal_set lits;
+
+	/**
+	 * beginning of the pattern is not anchored
+	 */
+	bool floating;
+
+	/**
+	 * maximum length of the pattern's match or RE_WIDTH_INF
+	 */
+	size_t width;
+};
+
+/**
+ * structure that represents one literal of the prefilter
+ */
+struct prefilter_entry {
+	/**
+	 * index of the pattern
+	 */
+	size_t pattern;
+
+	/**
+	 * index of the literal in the pattern's set
+	 */
+	size_t lit;
+
+	/**
+	 * offset of the anchor byte in the literal
+	 */
+	size_t offset;
+};
+
+/**
+ * structure that represents set of patterns with the literal prefilter
+ */
+struct prefilter {
+	/**
+	 * array of patterns
+	 */
+	struct prefilter_pattern *pats;
+
+	/**
+	 * number of patterns
+	 */
+	size_t cnt;
+
+	/**
+	 * number of allocated patterns
+	 */
+	size_t malloc_cnt;
+
+	/**
+	 * literals sorted by their anchor bytes
+	 */
+	struct prefilter_entry *entries;
+
+	/**
+	 * index of the first literal with the anchor byte,
+	 * the last element is the number of literals
+	 */
+	size_t bucket[257];
+
+	/**
+	 * set of anchor bytes
+	 */
+	struct dfa_accel anchors;
+
+	/**
+	 * prefilter is compiled after the last added pattern
+	 */
+	bool compiled;
+};
+
+/**
+ * structure with statistics of the last scan
+ */
+struct prefilter_stat {
+	/**
+	 * number of anchor bytes found in data
+	 */
+	size_t anchor_hits;
+
+	/**
+	 * number of patterns whose literals were found
+	 */
+	size_t literal_hits;
+
+	/**
+	 * number of bytes fed to DFA
+	 */
+	size_t dfa_bytes;
+};
+
+/**
+ * Allocate prefilter.
+ *
+ * Initializes the empty set of patterns.
+ *
+ * @param pf	pointer to the prefilter structure
+ * @return	0 on success
+ */
+int prefilter_alloc(struct prefilter *pf);
+
+/**
+ * Free prefilter.
+ *
+ * Frees memory used by the patterns and the literals.
+ *
+ * @param pf	pointer to the prefilter structure
+ */
+void prefilter_free(struct prefilter *pf);
+
+/**
+ * Add regular expression to prefilter.
+ *
+ * Parses the regular expression, builds its DFA and extracts its
+ * required literals. The prefilter must be compiled again after it.
+ *
+ * @param pf		pointer to the prefilter structure
+ * @param regexp	regular expression
+ * @param id		place for the identifier of the pattern, may be NULL
+ * @return		0 on success
+ */
+int prefilter_add(struct prefilter *pf, const char *regexp, size_t *id);
+
+/**
+ * Compile prefilter.
+ *
+ * Chooses a rare anchor byte for every literal and builds the table
+ * of literals indexed by their anchor bytes.
+ *
+ * @param pf	pointer to the prefilter structure
+ * @return	0 on success
+ */
+int prefilter_compile(struct prefilter *pf);
+
+/**
+ * Scan data with prefilter.
+ *
+ * First the data is searched for the anchor bytes of all literals, so clean
+ * data is processed only by memchr() or a SIMD set lookup. Then only the
+ * patterns without literals and the patterns whose literals were found
+ * are scanned by their DFA. Floating patterns with bounded width are
+ * scanned only from the window just before the first found literal.
+ * For every matched pattern the callback gets the end of the first match,
+ * exactly as dfa_scan() with the pattern's DFA would report it.
+ *
+ * @param pf	pointer to the compiled prefilter structure
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @param cb	callback for the matches
+ * @param ctx	user's context of the callback
+ * @param stat	place for the statistics, may be NULL
+ * @return	0 on success, -1 on error
+ */
+int prefilter_scan(const struct prefilter *pf, const void *data, size_t len,
+		   dfa_match_cb cb, void *ctx, struct prefilter_stat *stat);
+
+#endif /** REFA_PREFILTER_H @} */
@@ -4,3 +4,22 @@
 #include "nfa_to_dfa.h"
 #include "dfa_to_nfa.h"
 #include "dfa.h"
+#include "dfa_block.h"
+#include "dfa_bundle.h"
+#include "dfa_cache.h"
+#include "dfa_checkpoint.h"
+#include "dfa_extern.h"
+#include "dfa_ruleset.h"
+#include "dfa_scan.h"
+#include "dfa_storage.h"
+#include "nfa_scan.h"
+#include "dfa_stride.h"
+#include "dfa_nibble.h"
+#include "dfa_reverse.h"
+#include "dfa_bndm.h"
+#include "lexer.h"
+#include "literal.h"
+#include "literal_to_dfa.h"
+#include "prefilter.h"
+#include "teddy.h"
+#include "bitnfa.h"
@@ -0,0 +1,456 @@
+/*
+ * SIMD multi-literal matcher.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "literal.h"
+#include "teddy.h"
+#include "dfa_scan_inner.h"
+
+#ifdef DFA_SCAN_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Marker of the end of the hash chain.
+ */
+#define TEDDY_NONE	((size_t)-1)
+
+/**
+ * @brief Literal's fingerprint and index used for sorting into buckets.
+ */
+struct teddy_order {
+	/**
+	 * @brief Fingerprint of the literal in lower case.
+	 */
+	uint32_t key;
+
+	/**
+	 * @brief Index of the literal.
+	 */
+	size_t index;
+};
+
+/**
+ * @brief Convert ASCII letter to lower case.
+ *
+ * @param c	byte
+ * @return	byte in lower case
+ */
+static inline unsigned char teddy_fold(unsigned char c)
+{
+	return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+/**
+ * @brief Get fingerprint of the bytes in lower case.
+ *
+ * @param data	bytes, at least fingerprint bytes
+ * @param fp	length of the fingerprint
+ * @return	fingerprint
+ */
+static inline uint32_t teddy_key(const unsigned char *data, size_t fp)
+{
+	uint32_t key = 0;
+
+	for (size_t k = 0; k < fp; k++)
+		key |= (uint32_t)teddy_fold(data[k]) << (8 * k);
+
+	return key;
+}
+
+/**
+ * @brief Get index of the hash table.
+ *
+ * @param td	pointer to the teddy structure
+ * @param key	fingerprint
+ * @return	index in the hash table
+ */
+static inline size_t teddy_hash(const struct teddy *td, uint32_t key)
+{
+	return ((key * 0x9E3779B97F4A7C15ULL) >> 32) & td->hash_mask;
+}
+
+/**
+ * @brief Compare literals' fingerprints for qsort().
+ */
+static int teddy_order_cmp(const void *a, const void *b)
+{
+	const struct teddy_order *x = a, *y = b;
+
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+
+	return x->index < y->index ? -1 : (x->index > y->index);
+}
+
+/**
+ * @brief Verify literals that may start at the position.
+ *
+ * @param td	pointer to the teddy structure
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @param pos	candidate position
+ * @param cb	callback for the matches
+ * @param ctx	user's context of the callback
+ * @return	non-zero if the callback stopped the scan
+ */
+static int teddy_verify(const struct teddy *td, const unsigned char *data,
+			size_t len, size_t pos, dfa_match_cb cb, void *ctx)
+{
+	size_t cur = td->hash[teddy_hash(td, teddy_key(data + pos,
+							td->fingerprint))];
+
+	for (; cur != TEDDY_NONE; cur = td->lits[cur].next) {
+		const struct teddy_literal *lit = &td->lits[cur];
+		const unsigned char *str = td->pool + lit->offset;
+		size_t i;
+
+		if (lit->len > len - pos)
+			continue;
+
+		if (!lit->caseless) {
+			if (memcmp(str, data + pos, lit->len) != 0)
+				continue;
+		} else {
+			for (i = 0; i < lit->len; i++)
+				if (teddy_fold(data[pos + i]) != str[i])
+					break;
+			if (i < lit->len)
+				continue;
+		}
+
+		if (cb(cur, pos + lit->len, ctx) != 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+#ifdef DFA_SCAN_X86_SIMD
+/**
+ * @brief Check 16 positions at once with SSSE3.
+ *
+ * @param td	pointer to the teddy structure
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @param pos	pointer to the first position, it is replaced with
+ *		the first position that was not checked
+ * @param cb	callback for the matches
+ * @param ctx	user's context of the callback
+ * @return	non-zero if the callback stopped the scan
+ */
+__attribute__((target("ssse3")))
+static int teddy_scan_ssse3(const struct teddy *td, const unsigned char *data,
+			    size_t len, size_t *pos, dfa_match_cb cb, void *ctx)
+{
+	const __m128i nibble = _mm_set1_epi8(0x0F);
+	const size_t fp = td->fingerprint;
+	__m128i lo[TEDDY_MAX_FINGERPRINT], hi[TEDDY_MAX_FINGERPRINT];
+	size_t i;
+
+	for (size_t k = 0; k < fp; k++) {
+		lo[k] = _mm_loadu_si128((const __m128i *)td->lo[k]);
+		hi[k] = _mm_loadu_si128((const __m128i *)td->hi[k]);
+	}
+
+	for (i = *pos; i + 16 + fp - 1 <= len; i += 16) {
+		__m128i res = _mm_set1_epi8(-1);
+		uint32_t mask;
+
+		for (size_t k = 0; k < fp; k++) {
+			__m128i v = _mm_loadu_si128((const __m128i *)
+						    (data + i + k));
+			__m128i l = _mm_shuffle_epi8(lo[k],
+						     _mm_and_si128(v, nibble));
+			__m128i h = _mm_shuffle_epi8(hi[k],
+					_mm_and_si128(_mm_srli_epi16(v, 4),
+						      nibble));
+
+			res = _mm_and_si128(res, _mm_and_si128(l, h));
+		}
+
+		mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(res,
+						_mm_setzero_si128())) & 0xFFFF;
+		for (; mask != 0; mask &= mask - 1)
+			if (teddy_verify(td, data, len,
+					 i + __builtin_ctz(mask), cb, ctx) != 0)
+				return 1;
+	}
+
+	*pos = i;
+
+	return 0;
+}
+
+/**
+ * @brief Check 32 positions at once with AVX2.
+ *
+ * @param td	pointer to the teddy structure
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @param pos	pointer to the first position, it is replaced with
+ *		the first position that was not checked
+ * @param cb	callback for the matches
+ * @param ctx	user's context of the callback
+ * @return	non-zero if the callback stopped the scan
+ */
+__attribute__((target("avx2")))
+static int teddy_scan_avx2(const struct teddy *td, const unsigned char *data,
+			   size_t len, size_t *pos, dfa_match_cb cb, void *ctx)
+{
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+	const size_t fp = td->fingerprint;
+	__m256i lo[TEDDY_MAX_FINGERPRINT], hi[TEDDY_MAX_FINGERPRINT];
+	size_t i;
+
+	for (size_t k = 0; k < fp; k++) {
+		lo[k] = _mm256_broadcastsi128_si256(
+				_mm_loadu_si128((const __m128i *)td->lo[k]));
+		hi[k] = _mm256_broadcastsi128_si256(
+				_mm_loadu_si128((const __m128i *)td->hi[k]));
+	}
+
+	for (i = *pos; i + 32 + fp - 1 <= len; i += 32) {
+		__m256i res = _mm256_set1_epi8(-1);
+		uint32_t mask;
+
+		for (size_t k = 0; k < fp; k++) {
+			__m256i v = _mm256_loadu_si256((const __m256i *)
+						       (data + i + k));
+			__m256i l = _mm256_shuffle_epi8(lo[k],
+					_mm256_and_si256(v, nibble));
+			__m256i h = _mm256_shuffle_epi8(hi[k],
+					_mm256_and_si256(_mm256_srli_epi16(v, 4),
+							 nibble));
+
+			res = _mm256_and_si256(res, _mm256_and_si256(l, h));
+		}
+
+		mask = ~(uint32_t)_mm256_movemask_epi8(
+				_mm256_cmpeq_epi8(res, _mm256_setzero_si256()));
+		for (; mask != 0; mask &= mask - 1)
+			if (teddy_verify(td, data, len,
+					 i + __builtin_ctz(mask), cb, ctx) != 0)
+				return 1;
+	}
+
+	*pos = i;
+
+	return 0;
+}
+#endif /* DFA_SCAN_X86_SIMD */
+
+int teddy_alloc(struct teddy *td)
+{
+	memset(td, 0x00, sizeof(*td));
+
+	return 0;
+}
+
+void teddy_free(struct teddy *td)
+{
+	free(td->pool);
+	free(td->lits);
+	free(td->hash);
+	memset(td, 0x00, sizeof(*td));
+}
+
+int teddy_add(struct teddy *td, const void *str, size_t len, bool caseless,
+	      size_t *id)
+{
+	struct teddy_literal *lit;
+
+	if (len == 0)
+		return -1;
+
+	if (td->cnt == td->malloc_cnt) {
+		size_t new_cnt = td->malloc_cnt != 0 ? td->malloc_cnt * 2 : 64;
+		struct teddy_literal *tmp;
+
+		tmp = realloc(td->lits, sizeof(struct teddy_literal) * new_cnt);
+		if (tmp == NULL)
+			return -1;
+
+		td->lits = tmp;
+		td->malloc_cnt = new_cnt;
+	}
+
+	if (td->pool_size + len > td->pool_malloc_size) {
+		size_t new_size = td->pool_malloc_size != 0 ?
+				  td->pool_malloc_size * 2 : 1024;
+		unsigned char *tmp;
+
+		while (new_size < td->pool_size + len)
+			new_size *= 2;
+
+		tmp = realloc(td->pool, new_size);
+		if (tmp == NULL)
+			return -1;
+
+		td->pool = tmp;
+		td->pool_malloc_size = new_size;
+	}
+
+	lit = &td->lits[td->cnt];
+	lit->offset = td->pool_size;
+	lit->len = len;
+	lit->caseless = caseless;
+	lit->next = TEDDY_NONE;
+
+	memcpy(td->pool + td->pool_size, str, len);
+	if (caseless) {
+		for (size_t i = 0; i < len; i++)
+			td->pool[td->pool_size + i] =
+				teddy_fold(td->pool[td->pool_size + i]);
+	}
+	td->pool_size += len;
+
+	if (id != NULL)
+		*id = td->cnt;
+	td->cnt++;
+	td->compiled = false;
+
+	return 0;
+}
+
+int teddy_add_tree(struct teddy *td, const struct regexp_tree *re_tree,
+		   size_t *id)
+{
+	unsigned char *buf;
+	size_t len;
+	bool caseless;
+	int ret;
+
+	buf = malloc(TEDDY_MAX_TREE_LEN);
+	if (buf == NULL)
+		return -1;
+
+	ret = regexp_tree_string(re_tree, buf, TEDDY_MAX_TREE_LEN, &len,
+				 &caseless);
+	if (ret == 0)
+		ret = teddy_add(td, buf, len, caseless, id);
+	free(buf);
+
+	return ret;
+}
+
+int teddy_compile(struct teddy *td)
+{
+	struct teddy_order *order;
+	size_t hash_size = 16;
+	size_t *hash;
+
+	memset(td->lo, 0x00, sizeof(td->lo));
+	memset(td->hi, 0x00, sizeof(td->hi));
+
+	td->fingerprint = TEDDY_MAX_FINGERPRINT;
+	for (size_t i = 0; i < td->cnt; i++)
+		if (td->lits[i].len < td->fingerprint)
+			td->fingerprint = td->lits[i].len;
+
+	while (hash_size < 2 * td->cnt)
+		hash_size *= 2;
+
+	hash = malloc(sizeof(size_t) * hash_size);
+	order = malloc(sizeof(struct teddy_order) * (td->cnt + 1));
+	if (hash == NULL || order == NULL) {
+		free(hash);
+		free(order);
+		return -1;
+	}
+
+	free(td->hash);
+	td->hash = hash;
+	td->hash_mask = hash_size - 1;
+	for (size_t i = 0; i < hash_size; i++)
+		hash[i] = TEDDY_NONE;
+
+	/* literals are chained in order of their identifiers */
+	for (size_t i = td->cnt; i-- > 0;) {
+		struct teddy_literal *lit = &td->lits[i];
+		uint32_t key = teddy_key(td->pool + lit->offset,
+					 td->fingerprint);
+
+		lit->next = hash[teddy_hash(td, key)];
+		hash[teddy_hash(td, key)] = i;
+
+		order[i].key = key;
+		order[i].index = i;
+	}
+
+	/* literals with similar fingerprints share the bucket */
+	qsort(order, td->cnt, sizeof(struct teddy_order), teddy_order_cmp);
+
+	for (size_t i = 0; i < td->cnt; i++) {
+		const struct teddy_literal *lit = &td->lits[order[i].index];
+		const unsigned char *str = td->pool + lit->offset;
+		uint8_t bit = 1 << (i * TEDDY_BUCKETS / td->cnt);
+
+		for (size_t k = 0; k < td->fingerprint; k++) {
+			unsigned char c = str[k];
+
+			td->lo[k][c & 0x0F] |= bit;
+			td->hi[k][c >> 4] |= bit;
+
+			if (lit->caseless && isalpha(c)) {
+				c = toupper(c);
+				td->lo[k][c & 0x0F] |= bit;
+				td->hi[k][c >> 4] |= bit;
+			}
+		}
+	}
+
+	free(order);
+	td->compiled = true;
+
+	return 0;
+}
+
+int teddy_scan(const struct teddy *td, const void *data, size_t len,
+	       dfa_match_cb cb, void *ctx)
+{
+	const unsigned char *bytes = data;
+	const size_t fp = td->fingerprint;
+	size_t pos = 0;
+
+	if (!td->compiled)
+		return -1;
+
+	if (td->cnt == 0 || len < fp)
+		return 0;
+
+#ifdef DFA_SCAN_X86_SIMD
+	if (dfa_scan_cpu_supports(DFA_SCAN_KERNEL_AVX2)) {
+		if (teddy_scan_avx2(td, bytes, len, &pos, cb, ctx) != 0)
+			return 0;
+	} else if (__builtin_cpu_supports("ssse3")) {
+		if (teddy_scan_ssse3(td, bytes, len, &pos, cb, ctx) != 0)
+			return 0;
+	}
+#endif
+
+	for (; pos + fp <= len; pos++) {
+		uint8_t bits = 0xFF;
+
+		for (size_t k = 0; k < fp; k++) {
+			unsigned char c = bytes[pos + k];
+
+			bits &= td->lo[k][c & 0x0F] & td->hi[k][c >> 4];
+		}
+
+		if (bits != 0 && teddy_verify(td, bytes, len, pos, cb, ctx) != 0)
+			break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * SIMD multi-literal matcher.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+/**
+ * @addtogroup teddy teddy
+ * @{
+ */
+
+#ifndef REFA_TEDDY_H
+#define REFA_TEDDY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "dfa_scan.h"
+#include "parser.h"
+
+/** number of buckets of literals, one bit of the nibble masks per bucket */
+#define TEDDY_BUCKETS		(8)
+
+/** maximum number of the first bytes of literals checked by SIMD */
+#define TEDDY_MAX_FINGERPRINT	(3)
+
+/** maximum length of the literal added as regexp tree */
+#define TEDDY_MAX_TREE_LEN	(4096)
+
+/**
+ * structure that represents one literal of the matcher
+ */
+struct teddy_literal {
+	/**
+	 * offset of the literal's bytes in the pool
+	 */
+	size_t offset;
+
+	/**
+	 * length of the literal
+	 */
+	size_t len;
+
+	/**
+	 * letters match in any case, the literal is in lower case
+	 */
+	bool caseless;
+
+	/**
+	 * next literal with the same hash of the fingerprint
+	 */
+	size_t next;
+};
+
+/**
+ * structure that represents set of literals
+ */
+struct teddy {
+	/**
+	 * bytes of all literals
+	 */
+	unsigned char *pool;
+
+	/**
+	 * size of the used pool
+	 */
+	size_t pool_size;
+
+	/**
+	 * size of the allocated pool
+	 */
+	size_t pool_malloc_size;
+
+	/**
+	 * array of literals, index of the literal is its identifier
+	 */
+	struct teddy_literal *lits;
+
+	/**
+	 * number of literals
+	 */
+	size_t cnt;
+
+	/**
+	 * number of allocated literals
+	 */
+	size_t malloc_cnt;
+
+	/**
+	 * number of the first bytes of literals checked by SIMD
+	 */
+	size_t fingerprint;
+
+	/**
+	 * buckets with the low nibble of the fingerprint's bytes
+	 */
+	uint8_t lo[TEDDY_MAX_FINGERPRINT][16];
+
+	/**
+	 * buckets with the high nibble of the fingerprint's bytes
+	 */
+	uint8_t hi[TEDDY_MAX_FINGERPRINT][16];
+
+	/**
+	 * hash table of literals by their fingerprints (in lower case)
+	 */
+	size_t *hash;
+
+	/**
+	 * mask of the hash table's index
+	 */
+	size_t hash_mask;
+
+	/**
+	 * matcher is compiled after the last added literal
+	 */
+	bool compiled;
+};
+
+/**
+ * Allocate matcher.
+ *
+ * Initializes the empty set of literals.
+ *
+ * @param td	pointer to the teddy structure
+ * @return	0 on success
+ */
+int teddy_alloc(struct teddy *td);
+
+/**
+ * Free matcher.
+ *
+ * @param td	pointer to the teddy structure
+ */
+void teddy_free(struct teddy *td);
+
+/**
+ * Add literal to matcher.
+ *
+ * @param td		pointer to the teddy structure
+ * @param str		bytes of the literal
+ * @param len		length of the literal, must not be 0
+ * @param caseless	letters match in any case
+ * @param id		place for the identifier of the literal, may be NULL
+ * @return		0 on success
+ */
+int teddy_add(struct teddy *td, const void *str, size_t len, bool caseless,
+	      size_t *id);
+
+/**
+ * Add regexp tree to matcher.
+ *
+ * Only unanchored regular expressions that are concatenations of characters
+ * (see regexp_tree_string()) of at most TEDDY_MAX_TREE_LEN bytes are
+ * accepted.
+ *
+ * @param td		pointer to the teddy structure
+ * @param re_tree	pointer to the regexp tree
+ * @param id		place for the identifier of the literal, may be NULL
+ * @return		0 on success, -1 if the regexp is not a literal
+ */
+int teddy_add_tree(struct teddy *td, const struct regexp_tree *re_tree,
+		   size_t *id);
+
+/**
+ * Compile matcher.
+ *
+ * Sorts literals into buckets by their first bytes, builds the nibble
+ * masks of the buckets and the hash table for the verification.
+ *
+ * @param td	pointer to the teddy structure
+ * @return	0 on success
+ */
+int teddy_compile(struct teddy *td);
+
+/**
+ * Scan data with matcher.
+ *
+ * Every position of the data is checked against the nibble masks of
+ * the buckets with pshufb (16 or 32 positions at once with SSSE3 or AVX2),
+ * candidates are verified through the hash table. The callback gets every
+ * occurrence of every literal in order of their starting positions.
+ *
+ * @param td	pointer to the compiled teddy structure
+ * @param data	data to be scanned
+ * @param len	size of the data
+ * @param cb	callback for the matches
+ * @param ctx	user's context of the callback
+ * @return	0 on success, -1 on error
+ */
+int teddy_scan(const struct teddy *td, const void *data, size_t len,
+	       dfa_match_cb cb, void *ctx);
+
+#endif /** REFA_TEDDY_H @} */
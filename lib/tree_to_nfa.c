@@ -34,6 +34,21 @@ int convert_tree_to_lambdanfa(struct nfa *dst, struct regexp_tree *src)
 	return 0;
 }
 
+int convert_node_to_lambdanfa(struct nfa *dst, const struct regexp_node *src)
+{
+	size_t	first, last;
+
+	nfa_add_node(dst, &first);
+	nfa_add_node(dst, &last);
+
+	dst->first_index = first;
+	dst->nodes[last].isfinal = 1;
+
+	/* the node is only read */
+	return regexp_node_to_subnfa(dst, first, last,
+				     (struct regexp_node *)src);
+}
+
 int regexp_node_to_subnfa_norepeat(struct nfa *dst, size_t from, size_t to,
 				      struct regexp_node *src);
 
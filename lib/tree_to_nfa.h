@@ -26,4 +26,16 @@
  */
 int convert_tree_to_lambdanfa(struct nfa *nfa, struct regexp_tree *re_tree);
 
+/**
+ * Converting regexp node to NFA.
+ *
+ * Converts subexpression of regexp tree to initialized empty NFA with
+ * lambda-transitions, the comment of the NFA is not set.
+ *
+ * @param nfa	pointer to the existing and initialized empty NFA
+ * @param node	pointer to the source node of regexp tree
+ * @return	0 on success
+ */
+int convert_node_to_lambdanfa(struct nfa *nfa, const struct regexp_node *node);
+
 #endif /** REFA_TREE_TO_NFA_H @} */
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "test_util.h"
+
+static int collect_match(size_t id, size_t end, void *ctx)
+{
+	std::vector<size_t> *matches = (std::vector<size_t> *)ctx;
+
+	(*matches)[id] = end;
+
+	return 0;
+}
+
+static int stop_match(size_t, size_t, void *ctx)
+{
+	(*(size_t *)ctx)++;
+
+	return 1;
+}
+
+static void expect_equals_dfa_scan(const std::vector<const char *> &regexps,
+				   const char *alphabet, unsigned seed)
+{
+	size_t cnt = regexps.size();
+	struct bitnfa bn;
+	std::vector<struct dfa> dfa(cnt);
+
+	ASSERT_EQ(bitnfa_alloc(&bn), 0);
+	for (size_t i = 0; i < cnt; i++) {
+		struct regexp_tree *re_tree;
+		size_t id;
+
+		re_tree = regexp_to_tree(regexps[i], NULL);
+		ASSERT_NE(re_tree, nullptr);
+		ASSERT_EQ(bitnfa_add(&bn, re_tree, &id), 0) <<
+		"Failed to add regexp " << regexps[i];
+		EXPECT_EQ(id, i);
+		regexp_tree_free(re_tree);
+
+		build_dfa(&dfa[i], regexps[i]);
+	}
+	ASSERT_EQ(bitnfa_compile(&bn), 0);
+
+	srand(seed);
+	for (int iter = 0; iter < 500; iter++) {
+		std::vector<unsigned char> data = random_data(200, alphabet);
+		std::vector<size_t> matches(cnt, DFA_SCAN_NO_MATCH);
+
+		ASSERT_EQ(bitnfa_scan(&bn, data.data(), data.size(),
+				      collect_match, &matches), 0);
+
+		for (size_t i = 0; i < cnt; i++) {
+			size_t state = dfa[i].first_index;
+			size_t match = dfa_scan(&dfa[i], &state, data.data(),
+						data.size());
+
+			EXPECT_EQ(matches[i], match) <<
+			"Bit-parallel automaton must report the first match of "
+			<< regexps[i];
+		}
+	}
+
+	for (size_t i = 0; i < cnt; i++)
+		dfa_free(&dfa[i]);
+	bitnfa_free(&bn);
+}
+
+TEST(bitnfaTests, equals_dfa_scan) {
+	expect_equals_dfa_scan(scan_regexps({"/a(b|c)*d/", "/(a|b?)c/",
+					     "/x{3,}/", "/a*/"}),
+			       TEST_ALPHABET, 33);
+}
+
+TEST(bitnfaTests, wide_vectors) {
+	/* the patterns need more than 128 positions together */
+	std::vector<const char *> regexps = {
+		"/a[bc]{10,20}d/", "/(xy|yz){5,10}q/", "/^[ab]{3}.{20}c/",
+		"/(a|b)*c(a|b){8}d/", "/[a-d]{30}/", "/y{2,}z{2,}/"
+	};
+
+	expect_equals_dfa_scan(regexps, "abcdxyzq", 34);
+}
+
+TEST(bitnfaTests, limits) {
+	struct bitnfa bn;
+	struct regexp_tree *re_tree;
+	std::vector<unsigned char> data(100, 'a');
+	size_t stops = 0;
+
+	ASSERT_EQ(bitnfa_alloc(&bn), 0);
+
+	re_tree = regexp_to_tree("/a{200}/", NULL);
+	ASSERT_EQ(bitnfa_add(&bn, re_tree, NULL), 0);
+	regexp_tree_free(re_tree);
+
+	re_tree = regexp_to_tree("/b{57}/", NULL);
+	EXPECT_EQ(bitnfa_add(&bn, re_tree, NULL), -1) <<
+	"Patterns must not exceed " << BITNFA_MAX_POSITIONS << " positions";
+	regexp_tree_free(re_tree);
+	EXPECT_EQ(bn.pos_cnt, 200u);
+
+	re_tree = regexp_to_tree("/a/", NULL);
+	ASSERT_EQ(bitnfa_add(&bn, re_tree, NULL), 0);
+	regexp_tree_free(re_tree);
+
+	ASSERT_EQ(bitnfa_compile(&bn), 0);
+	EXPECT_EQ(bn.words, 4u);
+
+	ASSERT_EQ(bitnfa_scan(&bn, data.data(), data.size(), stop_match,
+			      &stops), 0);
+	EXPECT_EQ(stops, 1u);
+
+	bitnfa_free(&bn);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
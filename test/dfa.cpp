@@ -1,7 +1,59 @@
 #include <gtest/gtest.h>
 
-extern "C" {
-#include <refa.h>
+#include <cstdlib>
+#include <cstring>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "test_util.h"
+
+static const char *entry_regexps[] = {
+	"/^GET [a-z]+[0-9]{2}/", "/GET [a-z]+[0-9]{2}/",
+	"/(GET|POST) [a-z]+[0-9]{2}/", "/x[0-9]{2}y/"
+};
+
+static const char *entry_names[] = {
+	"anchored", "floating", "methods", "other"
+};
+
+static void build_entries(struct dfa *dfa, struct dfa *single, size_t *sum)
+{
+	dfa_alloc(dfa);
+	*sum = 0;
+
+	for (size_t i = 0; i < 4; i++) {
+		build_dfa(&single[i], entry_regexps[i]);
+		*sum += single[i].state_cnt;
+		ASSERT_EQ(dfa_add_entry(dfa, entry_names[i], &single[i]), 0);
+	}
+
+	ASSERT_EQ(dfa_minimize(dfa), 0);
+	ASSERT_EQ(dfa_compress(dfa), 0);
+}
+
+static void check_entries(const struct dfa *dfa, const struct dfa *single)
+{
+	const char *data[] = {
+		"GET index12", "xx GET abc99 ", "POST form00", "GET 12",
+		"ax12y", "GET a1x33y", ""
+	};
+
+	for (size_t i = 0; i < 4; i++) {
+		size_t entry;
+
+		ASSERT_EQ(dfa_get_entry(dfa, entry_names[i], &entry), 0);
+
+		for (size_t j = 0; j < sizeof(data) / sizeof(data[0]); j++) {
+			size_t len = strlen(data[j]);
+			size_t state = entry, expected = single[i].first_index;
+
+			EXPECT_EQ(dfa_scan(dfa, &state, data[j], len),
+				  dfa_scan(&single[i], &expected, data[j], len)) <<
+			"Entry " << entry_names[i] << " differs on " << data[j];
+		}
+	}
 }
 
 TEST(dfaTests, allocation) {
@@ -302,6 +354,278 @@ TEST(dfaTests, append_fragile) {
 	dfa_free(&dfa2);
 }
 
+TEST(dfaTests, entries_share_states) {
+	struct dfa dfa, single[4];
+	size_t sum, state;
+
+	build_entries(&dfa, single, &sum);
+
+	EXPECT_EQ(dfa.entry_cnt, 4);
+	EXPECT_LT(dfa.state_cnt, sum) <<
+	"Entries must share their states";
+	EXPECT_EQ(dfa_get_entry(&dfa, "none", &state), -1);
+
+	/* the first added entry is the initial state */
+	ASSERT_EQ(dfa_get_entry(&dfa, "anchored", &state), 0);
+	EXPECT_EQ(state, dfa.first_index);
+
+	check_entries(&dfa, single);
+
+	for (size_t i = 0; i < 4; i++)
+		dfa_free(&single[i]);
+	dfa_free(&dfa);
+}
+
+TEST(dfaTests, entries_rename) {
+	struct dfa dfa;
+	size_t state;
+
+	build_dfa(&dfa, "/abc/");
+
+	EXPECT_EQ(dfa_set_entry(&dfa, "start", dfa.first_index), 0);
+	EXPECT_EQ(dfa_set_entry(&dfa, "after_a",
+				dfa_get_trans(&dfa, dfa.first_index, 'a')), 0);
+	EXPECT_EQ(dfa_set_entry(&dfa, "start", 1), 0);
+	EXPECT_EQ(dfa_set_entry(&dfa, "bad", dfa.state_cnt), -1);
+	EXPECT_EQ(dfa.entry_cnt, 2);
+
+	ASSERT_EQ(dfa_get_entry(&dfa, "start", &state), 0);
+	EXPECT_EQ(state, 1);
+	ASSERT_EQ(dfa_get_entry(&dfa, "after_a", &state), 0);
+	EXPECT_EQ(dfa_scan(&dfa, &state, "bc", 2), 2);
+
+	dfa_free(&dfa);
+}
+
+TEST(dfaTests, entries_save_load) {
+	char filename[] = "/tmp/dfa_entries_XXXXXX";
+	struct dfa dfa, loaded, single[4];
+	size_t sum;
+	int fd;
+
+	build_entries(&dfa, single, &sum);
+
+	fd = mkstemp(filename);
+	ASSERT_GE(fd, 0);
+	close(fd);
+
+	ASSERT_EQ(dfa_save_to_file(&dfa, filename), 0);
+	ASSERT_EQ(dfa_load_from_file(&loaded, filename), 0);
+	unlink(filename);
+
+	EXPECT_EQ(loaded.state_cnt, dfa.state_cnt);
+	EXPECT_EQ(loaded.entry_cnt, 4);
+	check_entries(&loaded, single);
+
+	for (size_t i = 0; i < 4; i++)
+		dfa_free(&single[i]);
+	dfa_free(&loaded);
+	dfa_free(&dfa);
+}
+
+TEST(dfaTests, map_file) {
+	char filename[] = "/tmp/dfa_map_XXXXXX";
+	struct dfa dfa, mapped, single[4];
+	size_t sum, state;
+	int fd;
+
+	build_entries(&dfa, single, &sum);
+	dfa.comment = (char *)malloc(6);
+	memcpy(dfa.comment, "ab|cd", 6);
+	dfa.comment_size = 6;
+
+	fd = mkstemp(filename);
+	ASSERT_GE(fd, 0);
+	close(fd);
+
+	ASSERT_EQ(dfa_save_to_map_file(&dfa, filename), 0);
+	ASSERT_EQ(dfa_map_file(&mapped, filename), 0);
+	unlink(filename);
+
+	ASSERT_NE(mapped.map, nullptr);
+	EXPECT_EQ((uintptr_t)mapped.trans % 4096, 0) <<
+	"Transitions must be page-aligned";
+	EXPECT_EQ(mapped.bps, dfa.bps);
+	EXPECT_EQ(mapped.comment_size, 6);
+	EXPECT_STREQ(mapped.comment, "ab|cd");
+	EXPECT_EQ(mapped.entry_cnt, 4);
+	check_same(&dfa, &mapped);
+	check_entries(&mapped, single);
+
+	/* states can not be added to the file */
+	EXPECT_EQ(dfa_add_state(&mapped, &state), -1);
+
+	/* acceleration writes to the private copy of the flags */
+	ASSERT_EQ(dfa_accelerate(&mapped), 0);
+	check_entries(&mapped, single);
+
+	for (size_t i = 0; i < 4; i++)
+		dfa_free(&single[i]);
+	dfa_free(&mapped);
+	dfa_free(&dfa);
+}
+
+TEST(dfaTests, load_map_file) {
+	char filename[] = "/tmp/dfa_map_XXXXXX";
+	struct dfa dfa, loaded;
+	size_t state;
+	int fd;
+
+	build_dfa(&dfa, "/a[0-9]+b/");
+	ASSERT_EQ(dfa_compress(&dfa), 0);
+
+	fd = mkstemp(filename);
+	ASSERT_GE(fd, 0);
+	close(fd);
+
+	ASSERT_EQ(dfa_save_to_map_file(&dfa, filename), 0);
+	ASSERT_EQ(dfa_load_from_file(&loaded, filename), 0);
+
+	EXPECT_EQ(loaded.map, nullptr);
+	EXPECT_EQ(loaded.bps, 8);
+	check_same(&dfa, &loaded);
+
+	/* the loaded DFA is an ordinary one */
+	EXPECT_EQ(dfa_add_state(&loaded, &state), 0);
+	dfa_free(&loaded);
+
+	/* truncated file is rejected */
+	ASSERT_EQ(truncate(filename, 4096), 0);
+	EXPECT_EQ(dfa_map_file(&loaded, filename), -1);
+	EXPECT_EQ(dfa_load_from_file(&loaded, filename), -1);
+	unlink(filename);
+
+	dfa_free(&dfa);
+}
+
+TEST(dfaTests, map_file_untrusted) {
+	char filename[] = "/tmp/dfa_map_XXXXXX";
+	unsigned char header[128];
+	uint64_t flags_off, trans_off;
+	struct dfa dfa, loaded;
+	FILE *file;
+	int fd;
+
+	build_dfa(&dfa, "/a[0-9]+b/");
+	ASSERT_EQ(dfa_compress(&dfa), 0);
+	ASSERT_EQ(dfa.bps, 8);
+
+	fd = mkstemp(filename);
+	ASSERT_GE(fd, 0);
+	close(fd);
+	ASSERT_EQ(dfa_save_to_map_file(&dfa, filename), 0);
+
+	file = fopen(filename, "r+");
+	ASSERT_NE(file, nullptr);
+	ASSERT_EQ(fread(header, 1, sizeof(header), file), sizeof(header));
+	memcpy(&flags_off, header + 80, 8);
+	memcpy(&trans_off, header + 96, 8);
+
+	/* the flag of acceleration without the table is dropped */
+	ASSERT_EQ(fseek(file, flags_off, SEEK_SET), 0);
+	fputc(dfa.flags[0] | DFA_FLAG_ACCEL, file);
+	fflush(file);
+
+	ASSERT_EQ(dfa_map_file(&loaded, filename), 0);
+	EXPECT_EQ(loaded.flags[0] & DFA_FLAG_ACCEL, 0);
+	dfa_free(&loaded);
+
+	/* the transition to the missing state is rejected on load */
+	ASSERT_EQ(fseek(file, trans_off + 'z', SEEK_SET), 0);
+	fputc(dfa.state_cnt, file);
+	fclose(file);
+
+	EXPECT_EQ(dfa_load_from_file(&loaded, filename), -1);
+	unlink(filename);
+
+	dfa_free(&dfa);
+}
+
+TEST(dfaTests, load_flat) {
+	char filename[] = "/tmp/dfa_flat_XXXXXX";
+	struct dfa dfa, loaded;
+	uint64_t tmp64, row[256 + 1];
+	uint32_t tmp32;
+	FILE *file;
+	int fd;
+
+	build_dfa(&dfa, "/x(ab)+y/");
+
+	fd = mkstemp(filename);
+	ASSERT_GE(fd, 0);
+	file = fdopen(fd, "w");
+	ASSERT_NE(file, nullptr);
+
+	/* version 0.1.2 written without zlib */
+	fwrite("\x57""DFA\x16\x16\x16\x16", 8, 1, file);
+	fwrite("ver#\x00\x01\x00\x02", 8, 1, file);
+	fwrite("cnt#", 4, 1, file);
+	tmp64 = dfa.state_cnt;
+	fwrite(&tmp64, sizeof(tmp64), 1, file);
+	tmp32 = dfa.bps;
+	fwrite(&tmp32, sizeof(tmp32), 1, file);
+	fwrite("fst#", 4, 1, file);
+	tmp64 = dfa.first_index;
+	fwrite(&tmp64, sizeof(tmp64), 1, file);
+	tmp64 = dfa.comment_size;
+	fwrite(&tmp64, sizeof(tmp64), 1, file);
+	fwrite(dfa.comment, 1, dfa.comment_size, file);
+	fwrite("alg:flat", 8, 1, file);
+	for (size_t i = 0; i < dfa.state_cnt; i++) {
+		row[0] = dfa.flags[i];
+		for (int c = 0; c < 256; c++)
+			row[c + 1] = dfa_get_trans(&dfa, i, c);
+		fwrite(row, sizeof(row), 1, file);
+	}
+	fclose(file);
+
+	ASSERT_EQ(dfa_load_from_file(&loaded, filename), 0);
+	unlink(filename);
+
+	check_same(&dfa, &loaded);
+
+	dfa_free(&loaded);
+	dfa_free(&dfa);
+}
+
+TEST(dfaTests, load_bad_count) {
+	char filename[] = "/tmp/dfa_count_XXXXXX";
+	uint64_t counts[] = {(uint64_t)1 << 62, 1 << 20};
+	struct dfa loaded;
+	uint64_t tmp64;
+	uint32_t tmp32;
+	FILE *file;
+	int fd;
+
+	fd = mkstemp(filename);
+	ASSERT_GE(fd, 0);
+	close(fd);
+
+	/* the table would overflow or the file is too short for the states */
+	for (auto cnt : counts) {
+		file = fopen(filename, "w");
+		ASSERT_NE(file, nullptr);
+		fwrite("\x57""DFA\x16\x16\x16\x16", 8, 1, file);
+		fwrite("ver#\x00\x01\x00\x06", 8, 1, file);
+		fwrite("cnt#", 4, 1, file);
+		tmp64 = cnt;
+		fwrite(&tmp64, sizeof(tmp64), 1, file);
+		tmp32 = 64;
+		fwrite(&tmp32, sizeof(tmp32), 1, file);
+		fwrite("fst#", 4, 1, file);
+		tmp64 = 0;
+		fwrite(&tmp64, sizeof(tmp64), 1, file);
+		fwrite(&tmp64, sizeof(tmp64), 1, file);
+		fwrite("alg:blks", 8, 1, file);
+		fclose(file);
+
+		EXPECT_EQ(dfa_load_from_file(&loaded, filename), -1) <<
+		"Loaded " << cnt << " states";
+	}
+
+	unlink(filename);
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,302 @@
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <unistd.h>
+
+#include "test_util.h"
+
+static void temp_file(char *filename)
+{
+	int fd = mkstemp(filename);
+
+	ASSERT_GE(fd, 0);
+	close(fd);
+}
+
+TEST(dfa_blockTests, save_load_threads) {
+	char filename[] = "/tmp/dfa_block_XXXXXX";
+	struct dfa dfa, loaded;
+
+	/* a few blocks and the last one is not full */
+	build_dfa(&dfa, "/a[ab]{13}c/", true);
+	ASSERT_GT(dfa.state_cnt, 2 * DFA_BLOCK_STATES);
+	ASSERT_NE(dfa.state_cnt % DFA_BLOCK_STATES, 0);
+
+	temp_file(filename);
+
+	for (size_t save_threads = 1; save_threads <= 4; save_threads += 3) {
+		ASSERT_EQ(dfa_save_to_file2(&dfa, filename, save_threads,
+					    NULL), 0);
+
+		for (size_t load_threads = 1; load_threads <= 3; load_threads++) {
+			ASSERT_EQ(dfa_load_from_file2(&loaded, filename,
+						      load_threads), 0);
+			check_same(&dfa, &loaded);
+			dfa_free(&loaded);
+		}
+	}
+
+	/* truncated file is rejected */
+	ASSERT_EQ(truncate(filename, 4096), 0);
+	EXPECT_EQ(dfa_load_from_file(&loaded, filename), -1);
+	unlink(filename);
+
+	dfa_free(&dfa);
+}
+
+TEST(dfa_blockTests, empty_and_small) {
+	char filename[] = "/tmp/dfa_block_XXXXXX";
+	struct dfa dfa, loaded;
+	size_t state;
+
+	temp_file(filename);
+
+	dfa_alloc(&dfa);
+	ASSERT_EQ(dfa_save_to_file(&dfa, filename), 0);
+	ASSERT_EQ(dfa_load_from_file(&loaded, filename), 0);
+	EXPECT_EQ(loaded.state_cnt, 0);
+	dfa_free(&loaded);
+	dfa_free(&dfa);
+
+	build_dfa(&dfa, "/abc/", true);
+	ASSERT_EQ(dfa_save_to_file2(&dfa, filename, 8, NULL), 0);
+	ASSERT_EQ(dfa_load_from_file(&loaded, filename), 0);
+	check_same(&dfa, &loaded);
+
+	state = loaded.first_index;
+	EXPECT_EQ(dfa_scan(&loaded, &state, "xxabcx", 6), 5);
+
+	unlink(filename);
+	dfa_free(&loaded);
+	dfa_free(&dfa);
+}
+
+TEST(dfa_blockTests, bad_targets) {
+	char filename[] = "/tmp/dfa_block_XXXXXX";
+	struct dfa dfa, loaded;
+
+	temp_file(filename);
+
+	/* the bad target follows the first transition that leaves the state */
+	dfa_alloc(&dfa);
+	ASSERT_EQ(dfa_add_n_state(&dfa, 2, NULL), 0);
+	for (int c = 0; c < 256; c++) {
+		dfa_add_trans(&dfa, 0, c, 0);
+		dfa_add_trans(&dfa, 1, c, 1);
+	}
+	dfa_add_trans(&dfa, 0, 'a', 1);
+	dfa_add_trans(&dfa, 0, 'z', 5);
+
+	ASSERT_EQ(dfa_save_to_file(&dfa, filename), 0);
+	EXPECT_EQ(dfa_load_from_file(&loaded, filename), -1);
+
+	unlink(filename);
+	dfa_free(&dfa);
+}
+
+TEST(dfa_blockTests, version) {
+	char filename[] = "/tmp/dfa_block_XXXXXX";
+	unsigned char ver[8];
+	struct dfa dfa, loaded;
+	FILE *file;
+
+	temp_file(filename);
+
+	/* the files of blocks are not readable by the older versions */
+	build_dfa(&dfa, "/abc/", true);
+	ASSERT_EQ(dfa_save_to_file(&dfa, filename), 0);
+
+	file = fopen(filename, "r+");
+	ASSERT_NE(file, nullptr);
+	ASSERT_EQ(fseek(file, 8, SEEK_SET), 0);
+	ASSERT_EQ(fread(ver, 1, 8, file), 8u);
+	EXPECT_EQ(memcmp(ver, "ver#\x00\x01\x00\x06", 8), 0);
+
+	/* and the blocks are not read as the states of the older versions */
+	ASSERT_EQ(fseek(file, 15, SEEK_SET), 0);
+	fputc(0x02, file);
+	fclose(file);
+	EXPECT_EQ(dfa_load_from_file(&loaded, filename), -1);
+
+	/* the entries are marked as well */
+	ASSERT_EQ(dfa_set_entry(&dfa, "abc", dfa.first_index), 0);
+	ASSERT_EQ(dfa_save_to_file(&dfa, filename), 0);
+
+	file = fopen(filename, "r");
+	ASSERT_NE(file, nullptr);
+	ASSERT_EQ(fseek(file, 8, SEEK_SET), 0);
+	ASSERT_EQ(fread(ver, 1, 8, file), 8u);
+	fclose(file);
+	EXPECT_EQ(memcmp(ver, "ver#\x00\x01\x00\x07", 8), 0);
+
+	ASSERT_EQ(dfa_load_from_file(&loaded, filename), 0);
+	check_same(&dfa, &loaded);
+	EXPECT_EQ(loaded.entry_cnt, 1);
+
+	unlink(filename);
+	dfa_free(&loaded);
+	dfa_free(&dfa);
+}
+
+TEST(dfa_blockTests, rowd_widths) {
+	char filename[] = "/tmp/dfa_block_XXXXXX";
+	const size_t max_cnt[] = {0xFF, 0xFFFF, 0xFFFFFFFF, 0x100000000};
+	const size_t state_cnt = 200;
+
+	temp_file(filename);
+	srand(11);
+
+	for (size_t max : max_cnt) {
+		struct dfa dfa, loaded;
+		size_t first;
+
+		dfa_alloc2(&dfa, max);
+		ASSERT_EQ(dfa_add_n_state(&dfa, state_cnt, &first), 0);
+
+		/* runs of the same, relative and random targets */
+		for (size_t i = 0; i < state_cnt; i++) {
+			for (int c = 0; c < 256; c++) {
+				size_t to;
+
+				if (c < 64)
+					to = (i + 1) % state_cnt;
+				else if (c < 128 && i > 0)
+					to = dfa_get_trans(&dfa, i - 1, c);
+				else if (c < 192)
+					to = c % 3;
+				else
+					to = rand() % state_cnt;
+
+				ASSERT_EQ(dfa_add_trans(&dfa, i, c, to), 0);
+			}
+			if (i % 7 == 0)
+				dfa_state_set_final(&dfa, i, 1);
+		}
+
+		ASSERT_EQ(dfa_save_to_file(&dfa, filename), 0);
+		ASSERT_EQ(dfa_load_from_file(&loaded, filename), 0);
+		check_same(&dfa, &loaded);
+
+		dfa_free(&loaded);
+		dfa_free(&dfa);
+	}
+
+	unlink(filename);
+}
+
+TEST(dfa_blockTests, codecs) {
+	char filename[] = "/tmp/dfa_block_XXXXXX";
+	const char *codecs[] = {"rowd", "none",
+#ifdef USE_ZLIB
+				"zlib",
+#endif
+	};
+	const char alphabet[] = "abcx";
+	struct dfa dfa, loaded;
+	std::vector<char> data(256);
+
+	/* two blocks and the last one has a single state */
+	build_dfa(&dfa, "/a[ab]{11}c/", true);
+	ASSERT_EQ(dfa.state_cnt, DFA_BLOCK_STATES + 1);
+	ASSERT_EQ(dfa_set_entry(&dfa, "a", dfa.first_index), 0);
+
+	temp_file(filename);
+
+	for (const char *codec : codecs) {
+		struct dfa_lazy lz;
+
+		ASSERT_EQ(dfa_save_to_file2(&dfa, filename, 3, codec), 0);
+
+		ASSERT_EQ(dfa_load_from_file2(&loaded, filename, 2), 0);
+		check_same(&dfa, &loaded);
+		EXPECT_EQ(loaded.entry_cnt, 1);
+		dfa_free(&loaded);
+
+		ASSERT_EQ(dfa_lazy_open(&lz, filename), 0);
+		EXPECT_EQ(memcmp(lz.codec, codec, 4), 0);
+
+		srand(5);
+		for (int iter = 0; iter < 50; iter++) {
+			size_t state = dfa.first_index;
+			size_t lazy_state = lz.dfa.first_index;
+			size_t expected;
+
+			for (size_t i = 0; i < data.size(); i++)
+				data[i] = alphabet[rand() % 4];
+
+			expected = dfa_scan(&dfa, &state, data.data(),
+					    data.size());
+			EXPECT_EQ(dfa_lazy_scan(&lz, &lazy_state, data.data(),
+						data.size()), expected);
+			EXPECT_EQ(lazy_state, state);
+		}
+
+		dfa_lazy_free(&lz);
+	}
+
+	/* unknown codecs are not written */
+	EXPECT_EQ(dfa_save_to_file2(&dfa, filename, 1, "lzma"), -1);
+	EXPECT_EQ(dfa_save_to_file2(&dfa, filename, 1, "row"), -1);
+
+	unlink(filename);
+	dfa_free(&dfa);
+}
+
+TEST(dfa_blockTests, lazy_scan) {
+	char filename[] = "/tmp/dfa_block_XXXXXX";
+	const char alphabet[] = "abcx";
+	struct dfa dfa;
+	struct dfa_lazy lz;
+	std::vector<char> data(256);
+
+	build_dfa(&dfa, "/a[ab]{13}c/", true);
+
+	temp_file(filename);
+	ASSERT_EQ(dfa_save_to_file(&dfa, filename), 0);
+	ASSERT_EQ(dfa_lazy_open(&lz, filename), 0);
+	unlink(filename);
+
+	EXPECT_EQ(lz.loaded_cnt, 0);
+
+	/* the data that does not leave the initial state needs one block */
+	{
+		size_t state = lz.dfa.first_index;
+
+		EXPECT_EQ(dfa_lazy_scan(&lz, &state, "xxxxxxxx", 8),
+			  DFA_SCAN_NO_MATCH);
+		EXPECT_EQ(lz.loaded_cnt, 1);
+	}
+
+	srand(7);
+	for (int iter = 0; iter < 200; iter++) {
+		size_t state = dfa.first_index, lazy_state = lz.dfa.first_index;
+		size_t expected;
+
+		for (size_t i = 0; i < data.size(); i++)
+			data[i] = alphabet[rand() % 4];
+
+		expected = dfa_scan(&dfa, &state, data.data(), data.size());
+		EXPECT_EQ(dfa_lazy_scan(&lz, &lazy_state, data.data(),
+					data.size()), expected);
+		EXPECT_EQ(lazy_state, state);
+	}
+
+	EXPECT_LE(lz.loaded_cnt, lz.block_cnt);
+
+	dfa_lazy_free(&lz);
+	dfa_free(&dfa);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "test_util.h"
+
+static int build_bndm(struct dfa_bndm *bm, const char *regexp)
+{
+	struct regexp_tree *re_tree;
+	int res;
+
+	re_tree = regexp_to_tree(regexp, NULL);
+	if (re_tree == NULL)
+		return -2;
+
+	res = dfa_bndm_alloc(bm, re_tree);
+	regexp_tree_free(re_tree);
+
+	return res;
+}
+
+TEST(dfa_bndmTests, equals_dfa_scan) {
+	const char *regexps[] = {
+		"/abcd/", "/foo(bar|baz)/", "/x[0-9]{4,6}y/", "/hello/i",
+		"/q.*zzz/", "/[a-c]+dddd/", "/(ab|cd){2}e/", "/abcd$/",
+		"/(abab|baba)(c|d)/", "/a.{3}b/", "/(ab)+abab/",
+		"/(aaaa|aabb|abcdefghijklmnopqrstuvwxyzabcdefghijklmnop)/"
+	};
+	const char alphabet[] = TEST_ALPHABET;
+
+	srand(38);
+	for (auto regexp : regexps) {
+		struct dfa dfa;
+		struct dfa_bndm bm;
+
+		build_dfa(&dfa, regexp);
+		ASSERT_EQ(build_bndm(&bm, regexp), 0) <<
+		"Backward search must be built for " << regexp;
+		EXPECT_GE(bm.window, (size_t)DFA_BNDM_MIN_WINDOW);
+		EXPECT_LE(bm.window, (size_t)DFA_BNDM_MAX_WINDOW);
+
+		for (int iter = 0; iter < 500; iter++) {
+			std::vector<unsigned char> data(rand() % 300);
+			size_t state = dfa.first_index;
+
+			for (size_t j = 0; j < data.size(); j++)
+				data[j] = alphabet[rand() % (iter % 2 ? 6 :
+						   sizeof(alphabet) - 1)];
+
+			EXPECT_EQ(dfa_bndm_scan(&bm, data.data(), data.size()),
+				  dfa_scan(&dfa, &state, data.data(),
+					   data.size())) <<
+			"Backward search must report the first match of " <<
+			regexp;
+		}
+
+		dfa_bndm_free(&bm);
+		dfa_free(&dfa);
+	}
+}
+
+TEST(dfa_bndmTests, long_candidates) {
+	const char *regexps[] = {"/abcd.*xyz/", "/abcd[0-9]*x/"};
+	const char *fills[] = {"abcd", "abcd0123456789"};
+
+	for (auto regexp : regexps) {
+		struct dfa dfa;
+		struct dfa_bndm bm;
+
+		build_dfa(&dfa, regexp);
+		ASSERT_EQ(build_bndm(&bm, regexp), 0);
+
+		/* every window is a candidate whose check does not fail soon */
+		for (auto fill : fills) {
+			std::string data;
+
+			while (data.size() < 16 * DFA_BNDM_MAX_CHECK)
+				data += fill;
+
+			for (int tail = 0; tail < 2; tail++) {
+				size_t state = dfa.first_index;
+
+				if (tail)
+					data += "xyz";
+
+				EXPECT_EQ(dfa_bndm_scan(&bm, data.data(),
+							data.size()),
+					  dfa_scan(&dfa, &state, data.data(),
+						   data.size())) <<
+				regexp << " on " << fill;
+			}
+		}
+
+		dfa_bndm_free(&bm);
+		dfa_free(&dfa);
+	}
+}
+
+TEST(dfa_bndmTests, not_profitable) {
+	struct dfa_bndm bm;
+
+	EXPECT_EQ(build_bndm(&bm, "/abc/"), -1) <<
+	"Matches shorter than the minimum window must be rejected";
+	EXPECT_EQ(build_bndm(&bm, "/^abcdef/"), -1) <<
+	"Anchored regexps must be rejected";
+	EXPECT_EQ(build_bndm(&bm, "/ab?c?d?/"), -1);
+	EXPECT_EQ(build_bndm(&bm, "/(a|b)*c(a|b){3}/"), 0);
+	dfa_bndm_free(&bm);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+
+#include <csignal>
+#include <cstring>
+#include <string>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "test_util.h"
+
+static void temp_file(char *filename)
+{
+	int fd = mkstemp(filename);
+
+	ASSERT_GE(fd, 0);
+	close(fd);
+}
+
+static const char *regexps[] = {
+	"/abc/", "/a[0-9]+z/", "/(foo|bar)baz/", "/x.{3}y/", "/hello/i"
+};
+static const char *names[] = {
+	"http", "dns", "smtp", "ftp", "ssh"
+};
+
+TEST(dfa_bundleTests, create_open) {
+	char filename[] = "/tmp/dfa_bundle_XXXXXX";
+	const char meta[] = "ruleset 42";
+	struct dfa dfa[5];
+	struct dfa_bundle bundle;
+
+	temp_file(filename);
+
+	ASSERT_EQ(dfa_bundle_create(&bundle, filename, meta, sizeof(meta)), 0);
+	for (int i = 0; i < 5; i++) {
+		build_dfa(&dfa[i], regexps[i], true);
+		ASSERT_EQ(dfa_bundle_add(&bundle, names[i], &dfa[i]), 0);
+	}
+	ASSERT_EQ(dfa_bundle_finish(&bundle), 0);
+
+	ASSERT_EQ(dfa_bundle_open(&bundle, filename), 0);
+	ASSERT_EQ(bundle.cnt, 5);
+	ASSERT_EQ(bundle.meta_size, sizeof(meta));
+	EXPECT_EQ(memcmp(bundle.meta, meta, sizeof(meta)), 0);
+
+	for (int i = 0; i < 5; i++) {
+		struct dfa mapped, loaded;
+		size_t state;
+
+		ASSERT_EQ(dfa_bundle_map(&bundle, names[i], &mapped), 0) <<
+		"Failed to map " << names[i];
+		EXPECT_NE(mapped.map, nullptr);
+		check_same(&dfa[i], &mapped);
+
+		ASSERT_EQ(dfa_bundle_load(&bundle, names[i], &loaded), 0);
+		EXPECT_EQ(loaded.map, nullptr);
+		check_same(&dfa[i], &loaded);
+
+		state = mapped.first_index;
+		EXPECT_EQ(dfa_scan(&mapped, &state, "-abc-", 5),
+			  i == 0 ? 4 : DFA_SCAN_NO_MATCH);
+
+		dfa_free(&loaded);
+		dfa_free(&mapped);
+	}
+
+	{
+		struct dfa dummy;
+		size_t index;
+
+		EXPECT_EQ(dfa_bundle_find(&bundle, "telnet", &index), -1);
+		EXPECT_EQ(dfa_bundle_map(&bundle, "telnet", &dummy), -1);
+	}
+
+	/* the mapped DFA outlives the bundle */
+	{
+		struct dfa mapped;
+
+		ASSERT_EQ(dfa_bundle_map(&bundle, "ssh", &mapped), 0);
+		dfa_bundle_free(&bundle);
+		check_same(&dfa[4], &mapped);
+		dfa_free(&mapped);
+	}
+
+	unlink(filename);
+	for (int i = 0; i < 5; i++)
+		dfa_free(&dfa[i]);
+}
+
+TEST(dfa_bundleTests, bad_files) {
+	char filename[] = "/tmp/dfa_bundle_XXXXXX";
+	struct dfa dfa;
+	struct dfa_bundle bundle;
+
+	temp_file(filename);
+	build_dfa(&dfa, "/abc/", true);
+
+	/* names must be unique */
+	ASSERT_EQ(dfa_bundle_create(&bundle, filename, NULL, 0), 0);
+	ASSERT_EQ(dfa_bundle_add(&bundle, "a", &dfa), 0);
+	ASSERT_EQ(dfa_bundle_add(&bundle, "a", &dfa), 0);
+	EXPECT_EQ(dfa_bundle_finish(&bundle), -1);
+	EXPECT_EQ(dfa_bundle_open(&bundle, filename), -1);
+
+	/* unfinished bundle */
+	ASSERT_EQ(dfa_bundle_create(&bundle, filename, NULL, 0), 0);
+	ASSERT_EQ(dfa_bundle_add(&bundle, "a", &dfa), 0);
+	dfa_bundle_free(&bundle);
+	EXPECT_EQ(dfa_bundle_open(&bundle, filename), -1);
+
+	/* truncated bundle */
+	ASSERT_EQ(dfa_bundle_create(&bundle, filename, NULL, 0), 0);
+	ASSERT_EQ(dfa_bundle_add(&bundle, "a", &dfa), 0);
+	ASSERT_EQ(dfa_bundle_finish(&bundle), 0);
+	ASSERT_EQ(dfa_bundle_open(&bundle, filename), 0);
+	dfa_bundle_free(&bundle);
+	ASSERT_EQ(truncate(filename, DFA_MAP_ALIGN), 0);
+	EXPECT_EQ(dfa_bundle_open(&bundle, filename), -1);
+
+	/* empty bundle */
+	ASSERT_EQ(dfa_bundle_create(&bundle, filename, NULL, 0), 0);
+	ASSERT_EQ(dfa_bundle_finish(&bundle), 0);
+	ASSERT_EQ(dfa_bundle_open(&bundle, filename), 0);
+	EXPECT_EQ(bundle.cnt, 0);
+	dfa_bundle_free(&bundle);
+
+	unlink(filename);
+	dfa_free(&dfa);
+}
+
+TEST(dfa_bundleTests, many) {
+	char filename[] = "/tmp/dfa_bundle_XXXXXX";
+	struct dfa dfa;
+	struct dfa_bundle bundle;
+
+	temp_file(filename);
+	build_dfa(&dfa, "/a[ab]c/", true);
+
+	/* more items than allocated at once */
+	ASSERT_EQ(dfa_bundle_create(&bundle, filename, NULL, 0), 0);
+	for (int i = 0; i < 200; i++)
+		ASSERT_EQ(dfa_bundle_add(&bundle, std::to_string(i).c_str(),
+					 &dfa), 0);
+	ASSERT_EQ(dfa_bundle_finish(&bundle), 0);
+
+	ASSERT_EQ(dfa_bundle_open(&bundle, filename), 0);
+	ASSERT_EQ(bundle.cnt, 200);
+	for (int i = 0; i < 200; i += 17) {
+		struct dfa mapped;
+
+		ASSERT_EQ(dfa_bundle_map(&bundle, std::to_string(i).c_str(),
+					 &mapped), 0);
+		check_same(&dfa, &mapped);
+		dfa_free(&mapped);
+	}
+	dfa_bundle_free(&bundle);
+
+	unlink(filename);
+	dfa_free(&dfa);
+}
+
+TEST(dfa_bundleTests, failed_add) {
+	char filename[] = "/tmp/dfa_bundle_XXXXXX";
+	struct dfa small, large;
+	struct dfa_bundle bundle;
+	struct rlimit old_limit, limit;
+
+	temp_file(filename);
+	build_dfa(&small, "/abc/", true);
+	build_dfa(&large, "/x.{10}y/", true);
+
+	ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &old_limit), 0);
+	limit = old_limit;
+	limit.rlim_cur = 16 * DFA_MAP_ALIGN;
+	signal(SIGXFSZ, SIG_IGN);
+
+	/* the large DFA is written only partly */
+	ASSERT_EQ(dfa_bundle_create(&bundle, filename, NULL, 0), 0);
+	ASSERT_EQ(dfa_bundle_add(&bundle, "a", &small), 0);
+	ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &limit), 0);
+	EXPECT_EQ(dfa_bundle_add(&bundle, "b", &large), -1);
+	ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &old_limit), 0);
+	signal(SIGXFSZ, SIG_DFL);
+
+	EXPECT_EQ(dfa_bundle_add(&bundle, "c", &small), -1);
+	EXPECT_EQ(dfa_bundle_finish(&bundle), -1);
+	EXPECT_EQ(dfa_bundle_open(&bundle, filename), -1);
+
+	unlink(filename);
+	dfa_free(&large);
+	dfa_free(&small);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "test_util.h"
+
+/* names of the files in the directory */
+static std::vector<std::string> list_dir(const char *path)
+{
+	std::vector<std::string> names;
+	DIR *dir = opendir(path);
+	struct dirent *ent;
+
+	while (dir != NULL && (ent = readdir(dir)) != NULL)
+		if (ent->d_name[0] != '.')
+			names.push_back(ent->d_name);
+	if (dir != NULL)
+		closedir(dir);
+
+	return names;
+}
+
+static void remove_dir(const char *path)
+{
+	for (const std::string &name : list_dir(path))
+		unlink((std::string(path) + "/" + name).c_str());
+	rmdir(path);
+}
+
+TEST(dfa_cacheTests, compile_hit) {
+	char dirname[] = "/tmp/dfa_cache_XXXXXX";
+	std::string path;
+	struct dfa_cache cache;
+	struct dfa built, cached;
+
+	ASSERT_NE(mkdtemp(dirname), nullptr);
+	path = std::string(dirname) + "/sub";
+
+	/* the directory is created */
+	ASSERT_EQ(dfa_cache_open(&cache, path.c_str()), 0);
+
+	EXPECT_EQ(dfa_cache_get(&cache, "/a[0-9]+b/i", "minimize", &cached), -1);
+
+	ASSERT_EQ(dfa_cache_compile(&cache, "/a[0-9]+b/i", true, &built), 0);
+	EXPECT_EQ(built.map, nullptr);
+	ASSERT_EQ(list_dir(path.c_str()).size(), 1);
+
+	ASSERT_EQ(dfa_cache_compile(&cache, "/a[0-9]+b/i", true, &cached), 0);
+	EXPECT_NE(cached.map, nullptr);
+	check_same(&built, &cached);
+	dfa_free(&cached);
+
+	/* the repeated modifiers are the same modifiers */
+	ASSERT_EQ(dfa_cache_get(&cache, "/a[0-9]+b/ii", "minimize", &cached), 0);
+	check_same(&built, &cached);
+	dfa_free(&cached);
+
+	/* other options, pattern or modifiers are other entries */
+	EXPECT_EQ(dfa_cache_get(&cache, "/a[0-9]+b/i", "", &cached), -1);
+	EXPECT_EQ(dfa_cache_get(&cache, "/a[0-9]+c/i", "minimize", &cached), -1);
+	EXPECT_EQ(dfa_cache_get(&cache, "/a[0-9]+b/", "minimize", &cached), -1);
+
+	ASSERT_EQ(dfa_cache_compile(&cache, "/a[0-9]+b/i", false, &cached), 0);
+	EXPECT_EQ(cached.map, nullptr);
+	dfa_free(&cached);
+	EXPECT_EQ(list_dir(path.c_str()).size(), 2);
+
+	/* the cache survives reopening */
+	dfa_cache_free(&cache);
+	ASSERT_EQ(dfa_cache_open(&cache, path.c_str()), 0);
+	ASSERT_EQ(dfa_cache_get(&cache, "/a[0-9]+b/i", "minimize", &cached), 0);
+	check_same(&built, &cached);
+	dfa_free(&cached);
+
+	EXPECT_EQ(dfa_cache_compile(&cache, "/a(b/", true, &cached), -1);
+
+	dfa_free(&built);
+	dfa_cache_free(&cache);
+	remove_dir(path.c_str());
+	rmdir(dirname);
+}
+
+TEST(dfa_cacheTests, bad_entry) {
+	char dirname[] = "/tmp/dfa_cache_XXXXXX";
+	struct dfa_cache cache;
+	struct dfa built, cached;
+	std::string entry;
+	FILE *file;
+
+	ASSERT_NE(mkdtemp(dirname), nullptr);
+	ASSERT_EQ(dfa_cache_open(&cache, dirname), 0);
+
+	ASSERT_EQ(dfa_cache_compile(&cache, "/abc/", true, &built), 0);
+	ASSERT_EQ(list_dir(dirname).size(), 1);
+	entry = std::string(dirname) + "/" + list_dir(dirname)[0];
+
+	/* the broken entry is a miss and is replaced */
+	file = fopen(entry.c_str(), "w");
+	ASSERT_NE(file, nullptr);
+	fputs("garbage", file);
+	fclose(file);
+
+	EXPECT_EQ(dfa_cache_get(&cache, "/abc/", "minimize", &cached), -1);
+	ASSERT_EQ(dfa_cache_compile(&cache, "/abc/", true, &cached), 0);
+	dfa_free(&cached);
+	ASSERT_EQ(dfa_cache_get(&cache, "/abc/", "minimize", &cached), 0);
+	check_same(&built, &cached);
+	dfa_free(&cached);
+
+	EXPECT_EQ(list_dir(dirname).size(), 1);
+
+	dfa_free(&built);
+	dfa_cache_free(&cache);
+	remove_dir(dirname);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
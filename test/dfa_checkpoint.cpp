@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <unistd.h>
+
+#include "test_util.h"
+
+static std::string temp_path()
+{
+	char filename[] = "/tmp/dfa_checkpoint_XXXXXX";
+	int fd = mkstemp(filename);
+
+	EXPECT_GE(fd, 0);
+	close(fd);
+	unlink(filename);
+
+	return filename;
+}
+
+TEST(dfa_checkpointTests, nfa_to_dfa_resume) {
+	std::string path = temp_path();
+	struct dfa_checkpoint cp;
+	struct dfa expected, dfa;
+	struct nfa nfa;
+	size_t calls = 0;
+	int ret;
+
+	build_nfa(&nfa, "/a[ab]{8}c/");
+	dfa_alloc(&expected);
+	ASSERT_EQ(convert_nfa_to_dfa(&expected, &nfa), 0);
+
+	ASSERT_EQ(dfa_checkpoint_open(&cp, path.c_str(), 5), 0);
+	cp.limit = 40;
+
+	/* every call processes 40 states and stops as the preempted build */
+	do {
+		dfa_alloc(&dfa);
+		ret = convert_nfa_to_dfa_checkpoint(&dfa, &nfa, &cp);
+		ASSERT_GE(ret, 0);
+		if (ret == 1) {
+			EXPECT_EQ(access(path.c_str(), R_OK), 0);
+			dfa_free(&dfa);
+		}
+		calls++;
+	} while (ret == 1 && calls < 1000);
+
+	EXPECT_GT(calls, 3);
+	EXPECT_EQ(calls, (expected.state_cnt + 39) / 40);
+	check_same(&expected, &dfa);
+
+	/* the finished conversion removes the checkpoint */
+	EXPECT_NE(access(path.c_str(), F_OK), 0);
+	EXPECT_NE(access((path + ".tmp").c_str(), F_OK), 0);
+
+	dfa_free(&dfa);
+	dfa_free(&expected);
+	nfa_free(&nfa);
+	dfa_checkpoint_free(&cp);
+}
+
+TEST(dfa_checkpointTests, join_resume) {
+	std::string path = temp_path();
+	struct dfa_checkpoint cp;
+	struct dfa src1, src2, expected, dfa;
+	size_t calls = 0;
+	int ret;
+
+	build_dfa(&src1, "/a[ab]{6}c/");
+	build_dfa(&src2, "/b[0-9]{3}[ab]d/");
+	dfa_alloc(&expected);
+	ASSERT_EQ(dfa_join2(&expected, &src1, &src2), 0);
+
+	ASSERT_EQ(dfa_checkpoint_open(&cp, path.c_str(), 0), 0);
+	cp.limit = 30;
+
+	do {
+		dfa_alloc(&dfa);
+		ret = dfa_join_checkpoint(&dfa, &src1, &src2, &cp);
+		ASSERT_GE(ret, 0);
+		if (ret == 1)
+			dfa_free(&dfa);
+		calls++;
+	} while (ret == 1 && calls < 1000);
+
+	EXPECT_GT(calls, 3);
+	EXPECT_EQ(cp.save_cnt, calls - 1);
+	check_same(&expected, &dfa);
+	EXPECT_NE(access(path.c_str(), F_OK), 0);
+
+	dfa_free(&dfa);
+	dfa_free(&expected);
+	dfa_free(&src1);
+	dfa_free(&src2);
+	dfa_checkpoint_free(&cp);
+}
+
+TEST(dfa_checkpointTests, periodic) {
+	std::string path = temp_path();
+	struct dfa_checkpoint cp;
+	struct dfa expected, dfa;
+	struct nfa nfa;
+
+	build_nfa(&nfa, "/x[xy]{5}z/");
+	dfa_alloc(&expected);
+	ASSERT_EQ(convert_nfa_to_dfa(&expected, &nfa), 0);
+
+	/* the checkpoints do not change the result */
+	ASSERT_EQ(dfa_checkpoint_open(&cp, path.c_str(), 4), 0);
+	dfa_alloc(&dfa);
+	ASSERT_EQ(convert_nfa_to_dfa_checkpoint(&dfa, &nfa, &cp), 0);
+	EXPECT_EQ(cp.save_cnt, (expected.state_cnt - 1) / 4);
+	check_same(&expected, &dfa);
+	EXPECT_NE(access(path.c_str(), F_OK), 0);
+
+	dfa_free(&dfa);
+	dfa_free(&expected);
+	nfa_free(&nfa);
+	dfa_checkpoint_free(&cp);
+}
+
+TEST(dfa_checkpointTests, other_sources) {
+	std::string path = temp_path();
+	struct dfa_checkpoint cp;
+	struct dfa src1, src2, dfa;
+	struct nfa nfa, other;
+	FILE *file;
+
+	build_nfa(&nfa, "/a[ab]{6}c/");
+	build_nfa(&other, "/a[ab]{7}c/");
+	build_dfa(&src1, "/abc/");
+	build_dfa(&src2, "/b[0-9]+d/");
+
+	ASSERT_EQ(dfa_checkpoint_open(&cp, path.c_str(), 0), 0);
+	cp.limit = 10;
+	dfa_alloc(&dfa);
+	ASSERT_EQ(convert_nfa_to_dfa_checkpoint(&dfa, &nfa, &cp), 1);
+	dfa_free(&dfa);
+
+	/* the checkpoint is kept for the right sources */
+	dfa_alloc(&dfa);
+	EXPECT_EQ(convert_nfa_to_dfa_checkpoint(&dfa, &other, &cp), -1);
+	dfa_free(&dfa);
+	dfa_alloc(&dfa);
+	EXPECT_EQ(dfa_join_checkpoint(&dfa, &src1, &src2, &cp), -1);
+	dfa_free(&dfa);
+	EXPECT_EQ(access(path.c_str(), R_OK), 0);
+
+	/* the broken checkpoint is not used */
+	file = fopen(path.c_str(), "w");
+	ASSERT_NE(file, nullptr);
+	fputs("garbage", file);
+	fclose(file);
+
+	dfa_alloc(&dfa);
+	EXPECT_EQ(convert_nfa_to_dfa_checkpoint(&dfa, &nfa, &cp), -1);
+	dfa_free(&dfa);
+
+	ASSERT_EQ(dfa_checkpoint_remove(&cp), 0);
+	EXPECT_EQ(dfa_checkpoint_remove(&cp), 0);
+
+	dfa_free(&src1);
+	dfa_free(&src2);
+	nfa_free(&nfa);
+	nfa_free(&other);
+	dfa_checkpoint_free(&cp);
+}
+
+TEST(dfa_checkpointTests, same_size_sources) {
+	std::string path = temp_path();
+	struct dfa_checkpoint cp;
+	struct dfa src1, src2, other2, dfa;
+	struct nfa nfa, other;
+
+	/* the sources differ only by the transitions */
+	build_nfa(&nfa, "/a[ab]{6}c/");
+	build_nfa(&other, "/a[ac]{6}b/");
+	ASSERT_EQ(nfa.node_cnt, other.node_cnt);
+	ASSERT_EQ(nfa.first_index, other.first_index);
+
+	build_dfa(&src1, "/a[ab]{6}c/");
+	build_dfa(&src2, "/b[0-9]{3}[ab]d/");
+	build_dfa(&other2, "/b[0-9]{3}[ab]e/");
+	ASSERT_EQ(src2.state_cnt, other2.state_cnt);
+	ASSERT_EQ(src2.first_index, other2.first_index);
+
+	ASSERT_EQ(dfa_checkpoint_open(&cp, path.c_str(), 0), 0);
+	cp.limit = 10;
+	dfa_alloc(&dfa);
+	ASSERT_EQ(convert_nfa_to_dfa_checkpoint(&dfa, &nfa, &cp), 1);
+	dfa_free(&dfa);
+
+	dfa_alloc(&dfa);
+	EXPECT_EQ(convert_nfa_to_dfa_checkpoint(&dfa, &other, &cp), -1);
+	dfa_free(&dfa);
+	ASSERT_EQ(dfa_checkpoint_remove(&cp), 0);
+
+	dfa_alloc(&dfa);
+	ASSERT_EQ(dfa_join_checkpoint(&dfa, &src1, &src2, &cp), 1);
+	dfa_free(&dfa);
+
+	dfa_alloc(&dfa);
+	EXPECT_EQ(dfa_join_checkpoint(&dfa, &src1, &other2, &cp), -1);
+	dfa_free(&dfa);
+	ASSERT_EQ(dfa_checkpoint_remove(&cp), 0);
+
+	dfa_free(&src1);
+	dfa_free(&src2);
+	dfa_free(&other2);
+	nfa_free(&nfa);
+	nfa_free(&other);
+	dfa_checkpoint_free(&cp);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "test_util.h"
+
+/* number of the files in the directory */
+static size_t count_files(const char *path)
+{
+	DIR *dir = opendir(path);
+	struct dirent *ent;
+	size_t cnt = 0;
+
+	while (dir != NULL && (ent = readdir(dir)) != NULL)
+		cnt += ent->d_name[0] != '.';
+	if (dir != NULL)
+		closedir(dir);
+
+	return cnt;
+}
+
+TEST(dfa_externTests, nfa_to_dfa) {
+	char dirname[] = "/tmp/dfa_extern_XXXXXX";
+	struct dfa_extern ext;
+	struct dfa expected, dfa;
+	struct nfa nfa;
+
+	ASSERT_NE(mkdtemp(dirname), nullptr);
+	build_nfa(&nfa, "/a[ab]{8}c/");
+	dfa_alloc(&expected);
+	ASSERT_EQ(convert_nfa_to_dfa(&expected, &nfa), 0);
+
+	/* the batch of about 8 states */
+	ASSERT_EQ(dfa_extern_open(&ext, dirname, 8 * 256 * sizeof(size_t)), 0);
+
+	dfa_alloc(&dfa);
+	ASSERT_EQ(convert_nfa_to_dfa_extern(&dfa, &nfa, &ext, NULL), 0);
+	EXPECT_NE(dfa.map, nullptr);
+	check_same(&expected, &dfa);
+
+	EXPECT_GT(ext.batch_cnt, expected.state_cnt / 16);
+	EXPECT_LE(ext.run_max, 12);
+	EXPECT_EQ(ext.work, nullptr);
+
+	/* the temporary files are removed */
+	EXPECT_EQ(count_files(dirname), 0);
+
+	dfa_free(&dfa);
+
+	/* the batch of one state */
+	ext.mem_size = 0;
+	dfa_alloc(&dfa);
+	ASSERT_EQ(convert_nfa_to_dfa_extern(&dfa, &nfa, &ext, NULL), 0);
+	check_same(&expected, &dfa);
+	EXPECT_EQ(ext.batch_cnt, expected.state_cnt);
+	dfa_free(&dfa);
+
+	dfa_free(&expected);
+	nfa_free(&nfa);
+	dfa_extern_free(&ext);
+	rmdir(dirname);
+}
+
+TEST(dfa_externTests, join) {
+	char dirname[] = "/tmp/dfa_extern_XXXXXX";
+	std::string path;
+	struct dfa_extern ext;
+	struct dfa src1, src2, expected, dfa, saved;
+
+	ASSERT_NE(mkdtemp(dirname), nullptr);
+	path = std::string(dirname) + "/joined.dfa";
+
+	build_dfa(&src1, "/a[ab]{6}c/");
+	build_dfa(&src2, "/b[0-9]{3}[ab]d/");
+	dfa_alloc(&expected);
+	ASSERT_EQ(dfa_join2(&expected, &src1, &src2), 0);
+
+	ASSERT_EQ(dfa_extern_open(&ext, dirname, 4096), 0);
+
+	/* the image is kept in the file */
+	dfa_alloc(&dfa);
+	ASSERT_EQ(dfa_join_extern(&dfa, &src1, &src2, &ext, path.c_str()), 0);
+	check_same(&expected, &dfa);
+	EXPECT_GT(ext.batch_cnt, 1);
+	EXPECT_EQ(count_files(dirname), 1);
+
+	ASSERT_EQ(dfa_map_file(&saved, (char *)path.c_str()), 0);
+	check_same(&expected, &saved);
+	dfa_free(&saved);
+
+	/* the result is an ordinary mapped DFA */
+	{
+		size_t state = dfa.first_index;
+
+		EXPECT_EQ(dfa_scan(&dfa, &state, "xxb123ad", 8), 8);
+	}
+
+	dfa_free(&dfa);
+	dfa_free(&expected);
+	dfa_free(&src1);
+	dfa_free(&src2);
+	dfa_extern_free(&ext);
+	unlink(path.c_str());
+	rmdir(dirname);
+}
+
+TEST(dfa_externTests, too_many_states) {
+	char dirname[] = "/tmp/dfa_extern_XXXXXX";
+	std::string path;
+	struct dfa_extern ext;
+	struct dfa dfa;
+	struct nfa nfa;
+
+	ASSERT_NE(mkdtemp(dirname), nullptr);
+	build_nfa(&nfa, "/a[ab]{8}c/");
+
+	ASSERT_EQ(dfa_extern_open(&ext, dirname, 1 << 20), 0);
+
+	dfa_alloc2(&dfa, 100);
+	EXPECT_EQ(convert_nfa_to_dfa_extern(&dfa, &nfa, &ext, NULL), -1);
+	EXPECT_EQ(ext.work, nullptr);
+	dfa_free(&dfa);
+
+	/* the destination has to be empty */
+	dfa_alloc(&dfa);
+	dfa_add_state(&dfa, NULL);
+	EXPECT_EQ(convert_nfa_to_dfa_extern(&dfa, &nfa, &ext, NULL), -1);
+	dfa_free(&dfa);
+
+	/* the incomplete image is not left in the file */
+	path = std::string(dirname) + "/failed.dfa";
+	dfa_alloc2(&dfa, 100);
+	EXPECT_EQ(convert_nfa_to_dfa_extern(&dfa, &nfa, &ext, path.c_str()),
+		  -1);
+	dfa_free(&dfa);
+
+	EXPECT_EQ(count_files(dirname), 0);
+
+	nfa_free(&nfa);
+	dfa_extern_free(&ext);
+	rmdir(dirname);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
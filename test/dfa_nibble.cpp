@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "test_util.h"
+
+TEST(dfa_nibbleTests, equals_dfa_scan) {
+	srand(36);
+	for (auto regexp : scan_regexps({"/^(ab)*$/",
+					 "/\\xff[\\x80-\\x8f]/"})) {
+		struct dfa dfa;
+		struct dfa_nibble dn;
+
+		build_dfa(&dfa, regexp, true);
+		ASSERT_EQ(dfa_nibble_alloc(&dn, &dfa), 0);
+
+		for (int iter = 0; iter < 300; iter++) {
+			std::vector<unsigned char> data(rand() % 100);
+			size_t state = dfa.first_index;
+			size_t nibble_state = dfa.first_index;
+			size_t match;
+
+			for (size_t j = 0; j < data.size(); j++)
+				data[j] = iter % 2 ? rand() :
+					  TEST_ALPHABET[rand() % 25];
+
+			match = dfa_scan(&dfa, &state, data.data(), data.size());
+			EXPECT_EQ(dfa_nibble_scan(&dn, &nibble_state,
+						  data.data(), data.size()),
+				  match) <<
+			"Nibble-split tables must report the first match of " <<
+			regexp;
+			EXPECT_EQ(nibble_state, state);
+		}
+
+		dfa_nibble_free(&dn);
+		dfa_free(&dfa);
+	}
+}
+
+TEST(dfa_nibbleTests, shared_nodes) {
+	struct dfa dfa;
+	struct dfa_nibble dn;
+
+	build_dfa(&dfa, "/abc/", true);
+	ASSERT_EQ(dfa_nibble_alloc(&dn, &dfa), 0);
+
+	/*
+	 * rows of all states differ only in the node of 0x6X, the other
+	 * nibbles lead to the same node of the initial or the final state
+	 */
+	EXPECT_LE(dn.node_cnt, 2 * dfa.state_cnt);
+	EXPECT_LT(dn.size, dfa.state_cnt * 256 * sizeof(uint32_t) / 4);
+
+	dfa_nibble_free(&dn);
+	dfa_free(&dfa);
+}
+
+TEST(dfa_nibbleTests, many_nodes) {
+	struct dfa dfa;
+	struct dfa_nibble dn;
+
+	/* the nodes and their hash table grow many times */
+	build_dfa(&dfa, "/a[ab]{8}c/", true);
+	ASSERT_EQ(dfa_nibble_alloc(&dn, &dfa), 0);
+	EXPECT_GT(dn.node_cnt, 64u);
+
+	srand(136);
+	for (int iter = 0; iter < 300; iter++) {
+		std::vector<unsigned char> data = random_data(100, "abc");
+		size_t state = dfa.first_index;
+		size_t nibble_state = dfa.first_index;
+
+		EXPECT_EQ(dfa_nibble_scan(&dn, &nibble_state, data.data(),
+					  data.size()),
+			  dfa_scan(&dfa, &state, data.data(), data.size()));
+		EXPECT_EQ(nibble_state, state);
+	}
+
+	dfa_nibble_free(&dn);
+	dfa_free(&dfa);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
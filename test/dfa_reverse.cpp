@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "test_util.h"
+
+static void build_reverse(struct dfa *dfa, const std::string &regexp)
+{
+	struct regexp_tree *re_tree;
+
+	re_tree = regexp_to_tree(regexp.c_str(), NULL);
+	ASSERT_NE(re_tree, nullptr) <<
+	"Failed to parse regexp " << regexp;
+
+	dfa_alloc(dfa);
+	ASSERT_EQ(dfa_reverse(dfa, re_tree), 0);
+	regexp_tree_free(re_tree);
+}
+
+/* DFA of "^(core)$" accepts exactly the matches of the core */
+static bool is_match(const struct dfa *exact, const unsigned char *data,
+		     size_t len)
+{
+	size_t state = exact->first_index;
+
+	if (len == 0)
+		return false;
+
+	for (size_t i = 0; i < len; i++)
+		state = dfa_get_trans(exact, state, data[i]);
+
+	return dfa_state_is_final(exact, state);
+}
+
+TEST(dfa_reverseTests, leftmost_start) {
+	const char *cores[] = {
+		"abc", "foo(bar|baz)", "x[0-9]{2,4}y", "[a-c]+d", "[0-9]+",
+		"(ab|cd){2}e", "a(b|c)*d", "q.*z", "a.{3}b", "(a|ab)(c|bcd)"
+	};
+	const char alphabet[] = "abcdefoqrxyz0123 ";
+
+	srand(37);
+	for (auto core : cores) {
+		std::string regexp = std::string("/") + core + "/";
+		std::string exact_regexp = std::string("/^(") + core + ")$/";
+		struct dfa fwd, rev, exact;
+
+		build_dfa(&fwd, regexp);
+		build_dfa(&exact, exact_regexp);
+		build_reverse(&rev, regexp);
+
+		for (int iter = 0; iter < 300; iter++) {
+			std::vector<unsigned char> data(rand() % 100);
+			size_t start, end, expected = DFA_SCAN_NO_MATCH;
+
+			for (size_t j = 0; j < data.size(); j++)
+				data[j] = alphabet[rand() % (sizeof(alphabet) - 1)];
+
+			end = dfa_scan_span(&fwd, &rev, data.data(), data.size(),
+					    &start);
+			if (end == DFA_SCAN_NO_MATCH) {
+				EXPECT_EQ(start, DFA_SCAN_NO_MATCH);
+				continue;
+			}
+
+			for (size_t s = 0; s < end; s++)
+				if (is_match(&exact, data.data() + s, end - s)) {
+					expected = s;
+					break;
+				}
+
+			EXPECT_EQ(start, expected) <<
+			"Reverse DFA must find the leftmost start of " <<
+			regexp;
+		}
+
+		dfa_free(&fwd);
+		dfa_free(&rev);
+		dfa_free(&exact);
+	}
+}
+
+TEST(dfa_reverseTests, anchored) {
+	const char data[] = "xxabcabc";
+	struct dfa fwd, rev;
+	size_t start;
+
+	build_dfa(&fwd, "/^x*abc/");
+	build_reverse(&rev, "/^x*abc/");
+
+	EXPECT_EQ(dfa_scan_span(&fwd, &rev, data, strlen(data), &start), 5u);
+	EXPECT_EQ(start, 0u);
+
+	dfa_free(&fwd);
+	dfa_free(&rev);
+}
+
+TEST(dfa_reverseTests, reverse_nfa) {
+	const char data[] = "cba";
+	struct regexp_tree *re_tree;
+	struct nfa nfa, rev;
+	struct dfa dfa;
+	size_t state;
+
+	re_tree = regexp_to_tree("/^abc$/", NULL);
+	nfa_alloc(&nfa);
+	convert_tree_to_lambdanfa(&nfa, re_tree);
+	regexp_tree_free(re_tree);
+	nfa_rebuild(&nfa);
+
+	nfa_alloc(&rev);
+	ASSERT_EQ(nfa_reverse(&rev, &nfa), 0);
+
+	dfa_alloc(&dfa);
+	convert_nfa_to_dfa(&dfa, &rev);
+	state = dfa.first_index;
+	EXPECT_EQ(dfa_scan(&dfa, &state, data, strlen(data)), 3u);
+
+	dfa_free(&dfa);
+	nfa_free(&rev);
+	nfa_free(&nfa);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
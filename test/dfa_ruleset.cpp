@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "test_util.h"
+
+static const char *regexps[] = {
+	"/abc/", "/b[0-9]+d/", "/(xy|yx)z/", "/c.{2}a/", "/dd/", "/a[bc]{3}/"
+};
+#define REGEXP_CNT	(sizeof(regexps) / sizeof(regexps[0]))
+
+/* the joined DFA finds the earliest match of the active patterns */
+static void check_joined(struct dfa_ruleset *rs, const std::vector<bool> &active)
+{
+	const char alphabet[] = "abcdxyz0";
+	const struct dfa *joined = dfa_ruleset_get(rs);
+	std::vector<struct dfa> dfa(REGEXP_CNT);
+	bool any = false;
+
+	for (size_t i = 0; i < REGEXP_CNT; i++) {
+		build_dfa(&dfa[i], regexps[i]);
+		any = any || active[i];
+	}
+
+	if (!any) {
+		EXPECT_EQ(joined, nullptr);
+	} else {
+		ASSERT_NE(joined, nullptr);
+
+		srand(3);
+		for (int iter = 0; iter < 200; iter++) {
+			char data[24];
+			size_t expected = DFA_SCAN_NO_MATCH, state;
+
+			for (size_t i = 0; i < sizeof(data); i++)
+				data[i] = alphabet[rand() % 8];
+
+			for (size_t i = 0; i < REGEXP_CNT; i++) {
+				size_t match;
+
+				if (!active[i])
+					continue;
+				state = dfa[i].first_index;
+				match = dfa_scan(&dfa[i], &state, data,
+						 sizeof(data));
+				if (match < expected)
+					expected = match;
+			}
+
+			state = joined->first_index;
+			ASSERT_EQ(dfa_scan(joined, &state, data, sizeof(data)),
+				  expected) << std::string(data, sizeof(data));
+		}
+	}
+
+	for (size_t i = 0; i < REGEXP_CNT; i++)
+		dfa_free(&dfa[i]);
+}
+
+TEST(dfa_rulesetTests, add_remove) {
+	struct dfa_ruleset rs;
+	std::vector<bool> active(REGEXP_CNT, false);
+	size_t id[REGEXP_CNT], joins;
+
+	dfa_ruleset_alloc(&rs, true);
+	EXPECT_EQ(dfa_ruleset_get(&rs), nullptr);
+
+	for (size_t i = 0; i < REGEXP_CNT; i++) {
+		struct dfa dfa;
+
+		build_dfa(&dfa, regexps[i]);
+		ASSERT_EQ(dfa_ruleset_add(&rs, &dfa, &id[i]), 0);
+		EXPECT_EQ(id[i], i);
+		active[i] = true;
+	}
+	EXPECT_EQ(rs.cnt, REGEXP_CNT);
+	EXPECT_EQ(rs.cap, 8);
+
+	/* the first build joins every pair once */
+	check_joined(&rs, active);
+	EXPECT_EQ(rs.join_cnt, REGEXP_CNT - 1);
+
+	/* removal rebuilds the path to the root only */
+	joins = rs.join_cnt;
+	ASSERT_EQ(dfa_ruleset_remove(&rs, id[1]), 0);
+	active[1] = false;
+	check_joined(&rs, active);
+	EXPECT_LE(rs.join_cnt - joins, 3);
+
+	EXPECT_EQ(dfa_ruleset_remove(&rs, id[1]), -1);
+	EXPECT_EQ(dfa_ruleset_remove(&rs, 100), -1);
+
+	/* the id of the removed pattern is reused */
+	{
+		struct dfa dfa;
+		size_t new_id;
+
+		build_dfa(&dfa, regexps[1]);
+		joins = rs.join_cnt;
+		ASSERT_EQ(dfa_ruleset_add(&rs, &dfa, &new_id), 0);
+		EXPECT_EQ(new_id, id[1]);
+		active[1] = true;
+		check_joined(&rs, active);
+		EXPECT_LE(rs.join_cnt - joins, 3);
+	}
+
+	/* nothing changed, nothing is joined */
+	joins = rs.join_cnt;
+	ASSERT_NE(dfa_ruleset_get(&rs), nullptr);
+	EXPECT_EQ(rs.join_cnt, joins);
+
+	for (size_t i = 0; i < REGEXP_CNT; i++) {
+		ASSERT_EQ(dfa_ruleset_remove(&rs, id[i]), 0);
+		active[i] = false;
+		check_joined(&rs, active);
+	}
+	EXPECT_EQ(rs.cnt, 0);
+
+	dfa_ruleset_free(&rs);
+}
+
+TEST(dfa_rulesetTests, single) {
+	struct dfa_ruleset rs;
+	struct dfa dfa, empty;
+	const struct dfa *joined;
+	size_t id, state;
+
+	dfa_ruleset_alloc(&rs, false);
+
+	build_dfa(&dfa, "/abc/");
+	ASSERT_EQ(dfa_ruleset_add(&rs, &dfa, &id), 0);
+
+	/* one pattern is not joined with anything */
+	joined = dfa_ruleset_get(&rs);
+	ASSERT_NE(joined, nullptr);
+	state = joined->first_index;
+	EXPECT_EQ(dfa_scan(joined, &state, "xabc", 4), 4);
+
+	/* DFA without states matches nothing */
+	dfa_alloc(&empty);
+	ASSERT_EQ(dfa_ruleset_add(&rs, &empty, NULL), 0);
+	joined = dfa_ruleset_get(&rs);
+	ASSERT_NE(joined, nullptr);
+	state = joined->first_index;
+	EXPECT_EQ(dfa_scan(joined, &state, "xabc", 4), 4);
+	EXPECT_EQ(rs.join_cnt, 0);
+
+	dfa_ruleset_free(&rs);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,403 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "test_util.h"
+
+TEST(dfa_scanTests, scan_match) {
+	struct dfa dfa;
+	size_t state;
+	size_t match;
+	const char *data = "xxabcyy";
+
+	build_dfa(&dfa, "/abc/");
+
+	state = dfa.first_index;
+	match = dfa_scan(&dfa, &state, data, strlen(data));
+	EXPECT_EQ(match, 5) <<
+	"Match of '/abc/' in '" << data << "' must end at 5";
+	EXPECT_TRUE(dfa_state_is_final(&dfa, state)) <<
+	"Scan must stop in the final state";
+
+	dfa_free(&dfa);
+}
+
+TEST(dfa_scanTests, scan_no_match) {
+	struct dfa dfa;
+	size_t state;
+	size_t match;
+	const char *data = "xxabxcyy";
+
+	build_dfa(&dfa, "/abc/");
+
+	state = dfa.first_index;
+	match = dfa_scan(&dfa, &state, data, strlen(data));
+	EXPECT_EQ(match, DFA_SCAN_NO_MATCH) <<
+	"'/abc/' must not match '" << data << "'";
+
+	dfa_free(&dfa);
+}
+
+TEST(dfa_scanTests, scan_continue_stream) {
+	struct dfa dfa;
+	size_t state;
+	size_t match;
+
+	build_dfa(&dfa, "/abc/");
+
+	state = dfa.first_index;
+	match = dfa_scan(&dfa, &state, "xxab", 4);
+	EXPECT_EQ(match, DFA_SCAN_NO_MATCH) <<
+	"First chunk must not match";
+	match = dfa_scan(&dfa, &state, "cyy", 3);
+	EXPECT_EQ(match, 1) <<
+	"Match must end at 1 in the second chunk";
+
+	dfa_free(&dfa);
+}
+
+TEST(dfa_scanTests, scan_anchored_deadend) {
+	struct dfa dfa;
+	size_t state;
+	size_t match;
+
+	build_dfa(&dfa, "/^abc/");
+
+	state = dfa.first_index;
+	match = dfa_scan(&dfa, &state, "xabc", 4);
+	EXPECT_EQ(match, DFA_SCAN_NO_MATCH) <<
+	"'/^abc/' must not match 'xabc'";
+	EXPECT_TRUE(dfa_state_is_deadend(&dfa, state)) <<
+	"Scan must stop in the deadend state";
+
+	dfa_free(&dfa);
+}
+
+TEST(dfa_scanTests, scan_all_bps) {
+	struct dfa dfa;
+	size_t max_cnt[] = {0xFF, 0xFFFF, 0xFFFFFFFF, (size_t)~0};
+	const char *data = "__a0123b__";
+
+	build_dfa(&dfa, "/a.{4}b/");
+
+	for (size_t i = 0; i < sizeof(max_cnt) / sizeof(max_cnt[0]); i++) {
+		size_t state = dfa.first_index;
+
+		dfa_change_max_size(&dfa, max_cnt[i]);
+		EXPECT_EQ(dfa_scan(&dfa, &state, data, strlen(data)), 8) <<
+		"Wrong match offset with bps " << (int)dfa.bps;
+	}
+
+	dfa_free(&dfa);
+}
+
+TEST(dfa_scanTests, multi_equals_single) {
+	struct dfa dfa;
+	const size_t stream_cnt = 100;
+	std::vector<std::vector<unsigned char>> data(stream_cnt);
+	std::vector<struct dfa_stream> streams(stream_cnt);
+
+	build_dfa(&dfa, "/a[bc].{3}d/");
+
+	srand(1);
+	for (size_t i = 0; i < stream_cnt; i++) {
+		data[i].resize(rand() % 200);
+		for (auto &c : data[i])
+			c = "abcde"[rand() % 5];
+		dfa_stream_init(&dfa, &streams[i], data[i].data(),
+				data[i].size());
+	}
+
+	ASSERT_EQ(dfa_scan_multi(&dfa, streams.data(), stream_cnt), 0) <<
+	"Failed to scan multiple streams";
+
+	for (size_t i = 0; i < stream_cnt; i++) {
+		size_t state = dfa.first_index;
+		size_t match;
+
+		match = dfa_scan(&dfa, &state, data[i].data(), data[i].size());
+		EXPECT_EQ(streams[i].match, match) <<
+		"Stream " << i << " has different match offset";
+		EXPECT_EQ(streams[i].state, state) <<
+		"Stream " << i << " has different state";
+	}
+
+	dfa_free(&dfa);
+}
+
+TEST(dfa_scanTests, batch_kernels_equal_single) {
+	struct dfa dfa;
+	const size_t stream_cnt = 300;
+	std::vector<std::vector<unsigned char>> data(stream_cnt);
+	std::vector<struct dfa_stream> streams(stream_cnt);
+	enum dfa_scan_kernel kernels[] = {DFA_SCAN_KERNEL_AUTO,
+					  DFA_SCAN_KERNEL_SCALAR,
+					  DFA_SCAN_KERNEL_AVX2,
+					  DFA_SCAN_KERNEL_AVX512};
+	size_t max_cnt[] = {0xFF, 0xFFFF, 0xFFFFFFFF, (size_t)~0};
+
+	build_dfa(&dfa, "/a[bc].{3}d|e{2}/");
+
+	srand(2);
+	for (size_t i = 0; i < stream_cnt; i++) {
+		data[i].resize(rand() % 100);
+		for (auto &c : data[i])
+			c = "abcdex"[rand() % 6];
+	}
+
+	for (size_t m = 0; m < sizeof(max_cnt) / sizeof(max_cnt[0]); m++) {
+		dfa_change_max_size(&dfa, max_cnt[m]);
+
+		for (auto kernel : kernels) {
+			if (!dfa_scan_kernel_supported(&dfa, kernel)) {
+				EXPECT_EQ(dfa_scan_batch(&dfa, streams.data(),
+							 0, kernel), -1) <<
+				"Unsupported kernel " << kernel << " was used";
+				continue;
+			}
+
+			for (size_t i = 0; i < stream_cnt; i++)
+				dfa_stream_init(&dfa, &streams[i],
+						data[i].data(), data[i].size());
+
+			ASSERT_EQ(dfa_scan_batch(&dfa, streams.data(),
+						 stream_cnt, kernel), 0) <<
+			"Failed to scan batch with kernel " << kernel;
+
+			for (size_t i = 0; i < stream_cnt; i++) {
+				size_t state = dfa.first_index;
+				size_t match;
+
+				match = dfa_scan(&dfa, &state, data[i].data(),
+						 data[i].size());
+				EXPECT_EQ(streams[i].match, match) <<
+				"Stream " << i << " has different match with"
+				" kernel " << kernel << " and bps " <<
+				(int)dfa.bps;
+				EXPECT_EQ(streams[i].state, state) <<
+				"Stream " << i << " has different state with"
+				" kernel " << kernel << " and bps " <<
+				(int)dfa.bps;
+			}
+		}
+	}
+
+	dfa_free(&dfa);
+}
+
+TEST(dfa_scanTests, batch_last_16bit_transition) {
+	struct dfa dfa;
+	struct dfa_stream streams[20];
+	unsigned char data[2] = {0x00, 0xFF};
+	size_t index;
+
+	/* last state's transition by 0xFF is the last element of the table */
+	dfa_alloc2(&dfa, 0xFFFF);
+	dfa_add_n_state(&dfa, 3, &index);
+	for (unsigned int i = 0; i < 256; i++) {
+		dfa_add_trans(&dfa, 0, i, 0);
+		dfa_add_trans(&dfa, 1, i, 1);
+		dfa_add_trans(&dfa, 2, i, 0);
+	}
+	dfa_add_trans(&dfa, 0, 0x00, 2);
+	dfa_add_trans(&dfa, 2, 0xFF, 1);
+	dfa_state_set_final(&dfa, 1, 1);
+
+	for (auto kernel : {DFA_SCAN_KERNEL_AVX2, DFA_SCAN_KERNEL_AVX512}) {
+		if (!dfa_scan_kernel_supported(&dfa, kernel))
+			continue;
+
+		for (auto &stream : streams)
+			dfa_stream_init(&dfa, &stream, data, sizeof(data));
+
+		ASSERT_EQ(dfa_scan_batch(&dfa, streams, 20, kernel), 0) <<
+		"Failed to scan batch with kernel " << kernel;
+
+		for (auto &stream : streams)
+			EXPECT_EQ(stream.match, 2) <<
+			"Wrong match with kernel " << kernel;
+	}
+
+	dfa_free(&dfa);
+}
+
+TEST(dfa_scanTests, accelerate_equals_plain) {
+	const char *regexps[] = {"/abc/", "/[a-f]x/", "/a.{3}b/",
+				 "/^ab/", "/[\\x80-\\x85\\xf0]z|qq/"};
+	std::vector<unsigned char> data(5000);
+
+	srand(5);
+
+	for (auto regexp : regexps) {
+		struct dfa dfa, accel;
+
+		build_dfa(&dfa, regexp);
+		build_dfa(&accel, regexp);
+		ASSERT_EQ(dfa_accelerate(&accel), 0) <<
+		"Failed to accelerate " << regexp;
+
+		for (int round = 0; round < 20; round++) {
+			size_t state = dfa.first_index;
+			size_t accel_state = accel.first_index;
+			size_t match, accel_match;
+
+			for (auto &c : data)
+				c = round % 2 ? rand() : "abcdefqxz\x80\x85"[rand() % 11];
+
+			match = dfa_scan(&dfa, &state, data.data(),
+					 data.size());
+			accel_match = dfa_scan(&accel, &accel_state,
+					       data.data(), data.size());
+			EXPECT_EQ(accel_match, match) <<
+			"Different match of " << regexp;
+			EXPECT_EQ(accel_state, state) <<
+			"Different state of " << regexp;
+		}
+
+		dfa_free(&dfa);
+		dfa_free(&accel);
+	}
+}
+
+TEST(dfa_scanTests, accelerate_flags) {
+	struct dfa dfa;
+
+	build_dfa(&dfa, "/abc/");
+	dfa_accelerate(&dfa);
+
+	EXPECT_TRUE(dfa.flags[dfa.first_index] & DFA_FLAG_ACCEL) <<
+	"Initial state of the unanchored regexp must be accelerated";
+	EXPECT_EQ(dfa.accel[dfa.first_index].cnt, 1) <<
+	"Initial state must have only one escape byte";
+	EXPECT_EQ(dfa.accel[dfa.first_index].byte, 'a') <<
+	"Escape byte of the initial state must be 'a'";
+
+	for (size_t i = 0; i < dfa.state_cnt; i++) {
+		if (dfa_state_is_final(&dfa, i)) {
+			EXPECT_FALSE(dfa.flags[i] & DFA_FLAG_ACCEL) <<
+			"Final states must not be accelerated";
+		}
+	}
+
+	dfa_minimize(&dfa);
+	EXPECT_EQ(dfa.accel, nullptr) <<
+	"Minimization must drop acceleration";
+	for (size_t i = 0; i < dfa.state_cnt; i++)
+		EXPECT_FALSE(dfa.flags[i] & DFA_FLAG_ACCEL) <<
+		"Minimization must drop acceleration flags";
+
+	dfa_free(&dfa);
+}
+
+static void check_parallel(const struct dfa *dfa,
+			   const std::vector<unsigned char> &data)
+{
+	for (int thread_cnt = 1; thread_cnt <= 8; thread_cnt *= 2) {
+		size_t state = dfa->first_index;
+		size_t par_state = dfa->first_index;
+		size_t match, par_match;
+
+		match = dfa_scan(dfa, &state, data.data(), data.size());
+		ASSERT_EQ(dfa_scan_parallel(dfa, &par_state, data.data(),
+					    data.size(), thread_cnt,
+					    &par_match), 0) <<
+		"Failed to scan in parallel with " << thread_cnt << " threads";
+		EXPECT_EQ(par_match, match) <<
+		"Different match with " << thread_cnt << " threads";
+		EXPECT_EQ(par_state, state) <<
+		"Different state with " << thread_cnt << " threads";
+	}
+}
+
+TEST(dfa_scanTests, parallel_equals_single) {
+	struct dfa dfa;
+	std::vector<unsigned char> data(1 << 20);
+	size_t offsets[] = {100, 300000, 700000, 1048570};
+
+	build_dfa(&dfa, "/a[bc].{3}d/");
+
+	srand(3);
+	for (auto &c : data)
+		c = "abcex"[rand() % 5];
+
+	check_parallel(&dfa, data);
+
+	for (auto offset : offsets) {
+		std::vector<unsigned char> copy(data);
+
+		memcpy(&copy[offset], "ab123d", 6);
+		check_parallel(&dfa, copy);
+	}
+
+	dfa_free(&dfa);
+}
+
+TEST(dfa_scanTests, parallel_likely_states) {
+	struct dfa dfa;
+	std::vector<unsigned char> data(1 << 20);
+	size_t offsets[] = {200000, 600000, 1000000};
+
+	/* too many states to start chunks from all of them */
+	build_dfa(&dfa, "/a.{12}b/");
+	ASSERT_GT(dfa.state_cnt, 4096) <<
+	"DFA is too small for the test";
+
+	srand(4);
+	for (auto &c : data)
+		c = "ac"[rand() % 2];
+
+	check_parallel(&dfa, data);
+
+	for (auto offset : offsets) {
+		std::vector<unsigned char> copy(data);
+
+		copy[offset] = 'a';
+		copy[offset + 13] = 'b';
+		check_parallel(&dfa, copy);
+	}
+
+	dfa_free(&dfa);
+}
+
+TEST(dfa_scanTests, parallel_no_convergence) {
+	struct dfa dfa;
+	std::vector<unsigned char> data(1 << 20, 'a');
+
+	/* the parity of the a's is kept, the paths never converge */
+	build_dfa(&dfa, "/^(aa)*b/");
+
+	check_parallel(&dfa, data);
+
+	data[data.size() - 1] = 'b';
+	check_parallel(&dfa, data);
+	data[data.size() - 2] = 'b';
+	check_parallel(&dfa, data);
+
+	dfa_free(&dfa);
+}
+
+TEST(dfa_scanTests, parallel_anchored) {
+	struct dfa dfa;
+	std::vector<unsigned char> data(1 << 19, 'a');
+
+	build_dfa(&dfa, "/^a*b/");
+
+	check_parallel(&dfa, data);
+
+	data[400000] = 'b';
+	check_parallel(&dfa, data);
+
+	data[1000] = 'c';
+	check_parallel(&dfa, data);
+
+	dfa_free(&dfa);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "test_util.h"
+
+static std::string temp_path()
+{
+	char filename[] = "/tmp/dfa_storage_XXXXXX";
+	int fd = mkstemp(filename);
+
+	EXPECT_GE(fd, 0);
+	close(fd);
+
+	return filename;
+}
+
+TEST(dfa_storageTests, vm) {
+	struct dfa expected, dfa;
+	struct nfa nfa;
+
+	build_nfa(&nfa, "/a[ab]{8}c/");
+	dfa_alloc(&expected);
+	ASSERT_EQ(convert_nfa_to_dfa(&expected, &nfa), 0);
+
+	dfa_alloc(&dfa);
+	ASSERT_EQ(dfa_storage_vm(&dfa, 0), 0);
+	ASSERT_NE(dfa.storage, nullptr);
+	ASSERT_EQ(convert_nfa_to_dfa(&dfa, &nfa), 0);
+	check_same(&expected, &dfa);
+
+	/* the capacity is doubled */
+	EXPECT_GE(dfa.state_malloc_cnt, dfa.state_cnt);
+	EXPECT_LT(dfa.state_malloc_cnt, dfa.state_cnt * 2);
+
+	/* the states are rebuilt in place */
+	dfa_minimize(&expected);
+	dfa_minimize(&dfa);
+	check_same(&expected, &dfa);
+
+	dfa_free(&dfa);
+
+	/* the small reservation is moved when it is exhausted */
+	dfa_alloc(&dfa);
+	ASSERT_EQ(dfa_storage_vm(&dfa, 4096), 0);
+	ASSERT_EQ(convert_nfa_to_dfa(&dfa, &nfa), 0);
+	dfa_minimize(&dfa);
+	check_same(&expected, &dfa);
+	EXPECT_GT(dfa.storage->size, 4096);
+	dfa_free(&dfa);
+
+	dfa_free(&expected);
+	nfa_free(&nfa);
+}
+
+TEST(dfa_storageTests, change_size) {
+	struct dfa dfa;
+	size_t index;
+
+	dfa_alloc2(&dfa, 200);
+	ASSERT_EQ(dfa_storage_vm(&dfa, 0), 0);
+	EXPECT_EQ(dfa.bps, 8);
+
+	for (size_t i = 0; i < 100; i++) {
+		ASSERT_EQ(dfa_add_state(&dfa, &index), 0);
+		for (int j = 0; j < 256; j++)
+			dfa_add_trans(&dfa, index, j, (i + j) % 100);
+	}
+	EXPECT_EQ(dfa.state_malloc_cnt, 128);
+
+	/* the rows become larger inside the storage */
+	ASSERT_EQ(dfa_change_max_size(&dfa, 100000), 0);
+	EXPECT_EQ(dfa.bps, 32);
+	ASSERT_EQ(dfa_add_state(&dfa, &index), 0);
+	for (int j = 0; j < 256; j++)
+		dfa_add_trans(&dfa, index, j, index);
+
+	for (size_t i = 0; i < 100; i++)
+		for (int j = 0; j < 256; j++)
+			ASSERT_EQ(dfa_get_trans(&dfa, i, j), (i + j) % 100);
+
+	/* and smaller again */
+	ASSERT_EQ(dfa_compress(&dfa), 0);
+	EXPECT_EQ(dfa.bps, 8);
+	for (size_t i = 0; i < 100; i++)
+		for (int j = 0; j < 256; j++)
+			ASSERT_EQ(dfa_get_trans(&dfa, i, j), (i + j) % 100);
+	EXPECT_EQ(dfa_get_trans(&dfa, index, 'a'), index);
+
+	dfa_free(&dfa);
+}
+
+TEST(dfa_storageTests, file) {
+	std::string path = temp_path();
+	struct dfa src1, src2, expected, dfa, saved;
+	struct stat st;
+
+	build_dfa(&src1, "/a[ab]{6}c/");
+	build_dfa(&src2, "/b[0-9]{3}[ab]d/");
+	dfa_alloc(&expected);
+	ASSERT_EQ(dfa_join2(&expected, &src1, &src2), 0);
+
+	dfa_alloc(&dfa);
+	ASSERT_EQ(dfa_storage_file(&dfa, path.c_str()), 0);
+	ASSERT_EQ(dfa_join2(&dfa, &src1, &src2), 0);
+	check_same(&expected, &dfa);
+
+	/* the file becomes the mappable image */
+	ASSERT_EQ(dfa_storage_sync(&dfa), 0);
+	ASSERT_EQ(stat(path.c_str(), &st), 0);
+	EXPECT_GE((size_t)st.st_size, DFA_MAP_ALIGN + dfa.state_cnt *
+		  (dfa.state_size + 1) + dfa.comment_size);
+	EXPECT_LT((size_t)st.st_size, DFA_MAP_ALIGN + dfa.state_cnt *
+		  (dfa.state_size + 1) + dfa.comment_size + 8);
+
+	ASSERT_EQ(dfa_map_file(&saved, (char *)path.c_str()), 0);
+	check_same(&expected, &saved);
+	dfa_free(&saved);
+
+	/* the states are added after the sync */
+	ASSERT_EQ(dfa_add_entry(&dfa, "second", &src2), 0);
+	ASSERT_EQ(dfa_add_entry(&expected, "second", &src2), 0);
+	check_same(&expected, &dfa);
+
+	ASSERT_EQ(dfa_storage_sync(&dfa), 0);
+	ASSERT_EQ(dfa_map_file(&saved, (char *)path.c_str()), 0);
+	check_same(&expected, &saved);
+	ASSERT_EQ(saved.entry_cnt, 1);
+	EXPECT_STREQ(saved.entries[0].name, "second");
+	EXPECT_EQ(saved.entries[0].state, expected.entries[0].state);
+	dfa_free(&saved);
+
+	/* the file is kept */
+	dfa_free(&dfa);
+	ASSERT_EQ(dfa_map_file(&saved, (char *)path.c_str()), 0);
+	check_same(&expected, &saved);
+	dfa_free(&saved);
+
+	dfa_free(&expected);
+	dfa_free(&src1);
+	dfa_free(&src2);
+	unlink(path.c_str());
+}
+
+TEST(dfa_storageTests, errors) {
+	std::string path = temp_path();
+	struct dfa dfa;
+
+	/* the DFA has to be empty */
+	dfa_alloc(&dfa);
+	dfa_add_state(&dfa, NULL);
+	EXPECT_EQ(dfa_storage_vm(&dfa, 0), -1);
+	EXPECT_EQ(dfa_storage_file(&dfa, path.c_str()), -1);
+	EXPECT_EQ(dfa.storage, nullptr);
+	dfa_free(&dfa);
+
+	/* only the file is synced */
+	dfa_alloc(&dfa);
+	EXPECT_EQ(dfa_storage_sync(&dfa), -1);
+	ASSERT_EQ(dfa_storage_vm(&dfa, 0), 0);
+	EXPECT_EQ(dfa_storage_vm(&dfa, 0), -1);
+	EXPECT_EQ(dfa_storage_sync(&dfa), -1);
+	dfa_free(&dfa);
+
+	dfa_alloc(&dfa);
+	EXPECT_EQ(dfa_storage_file(&dfa, "/nonexistent/dir/file"), -1);
+	EXPECT_EQ(dfa.storage, nullptr);
+	dfa_free(&dfa);
+
+	/* the size limit is kept */
+	dfa_alloc2(&dfa, 3);
+	ASSERT_EQ(dfa_storage_vm(&dfa, 0), 0);
+	for (int i = 0; i < 3; i++)
+		EXPECT_EQ(dfa_add_state(&dfa, NULL), 0);
+	EXPECT_EQ(dfa_add_state(&dfa, NULL), -1);
+	EXPECT_EQ(dfa.state_malloc_cnt, 3);
+	dfa_free(&dfa);
+
+	unlink(path.c_str());
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "test_util.h"
+
+TEST(dfa_strideTests, equals_dfa_scan) {
+	srand(35);
+	for (auto regexp : scan_regexps({"/^(ab)*$/", "/^a/", "/b/"})) {
+		struct dfa dfa;
+		struct dfa_stride ds;
+
+		build_dfa(&dfa, regexp, true);
+		ASSERT_EQ(dfa_stride_alloc(&ds, &dfa, 1 << 20), 0);
+		EXPECT_EQ(ds.size, dfa_stride_size(&dfa));
+
+		for (int iter = 0; iter < 300; iter++) {
+			std::vector<unsigned char> data = random_data(100);
+			size_t state = dfa.first_index;
+			size_t stride_state = dfa.first_index;
+			size_t match, chunk, first, second;
+
+			match = dfa_scan(&dfa, &state, data.data(), data.size());
+			EXPECT_EQ(dfa_stride_scan(&ds, &stride_state, data.data(),
+						  data.size()), match) <<
+			"Two-byte tables must report the first match of " <<
+			regexp;
+			EXPECT_EQ(stride_state, state);
+
+			/* odd chunks of the same stream */
+			chunk = data.size() / 2 | 1;
+			if (chunk > data.size())
+				continue;
+
+			stride_state = dfa.first_index;
+			first = dfa_stride_scan(&ds, &stride_state, data.data(),
+						chunk);
+			second = dfa_stride_scan(&ds, &stride_state,
+						 data.data() + chunk,
+						 data.size() - chunk);
+			expect_split_match(match, chunk, first, second);
+		}
+
+		dfa_stride_free(&ds);
+		dfa_free(&dfa);
+	}
+}
+
+TEST(dfa_strideTests, byte_classes) {
+	struct dfa dfa;
+	uint8_t classes[256];
+
+	build_dfa(&dfa, "/^a[0-9]+b/", true);
+
+	/* 'a', 'b', digits and all other bytes */
+	EXPECT_EQ(dfa_byte_classes(&dfa, classes), 4u);
+	EXPECT_EQ(classes[0], 0u);
+	EXPECT_EQ(classes['0'], classes['9']);
+	EXPECT_EQ(classes['c'], classes[0]);
+	EXPECT_NE(classes['a'], classes['b']);
+
+	dfa_free(&dfa);
+}
+
+TEST(dfa_strideTests, size_limit) {
+	struct dfa dfa;
+	struct dfa_stride ds;
+	size_t size;
+
+	build_dfa(&dfa, "/(GET|POST|HEAD) \\/[a-z]+ HTTP/", true);
+	size = dfa_stride_size(&dfa);
+
+	EXPECT_EQ(dfa_stride_alloc(&ds, &dfa, size - 1), -1) <<
+	"Tables larger than the limit must not be built";
+	EXPECT_EQ(dfa_stride_alloc(&ds, &dfa, size), 0);
+	EXPECT_EQ(ds.size, size);
+
+	dfa_stride_free(&ds);
+	dfa_free(&dfa);
+}
+
+TEST(dfa_strideTests, too_many_states) {
+	struct dfa dfa;
+	struct dfa_stride ds;
+	const size_t state_cnt = (DFA_STRIDE_ROW + (size_t)1) / (256 * 256) + 1;
+
+	/* every byte is a class of its own */
+	dfa_alloc(&dfa);
+	ASSERT_EQ(dfa_add_n_state(&dfa, state_cnt, NULL), 0);
+	for (int c = 0; c < 256; c++)
+		ASSERT_EQ(dfa_add_trans(&dfa, 0, c, c), 0);
+
+	EXPECT_EQ(dfa_stride_size(&dfa), SIZE_MAX);
+	EXPECT_EQ(dfa_stride_alloc(&ds, &dfa, SIZE_MAX), -1) <<
+	"Tables that can not index all states must not be built";
+
+	dfa_free(&dfa);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
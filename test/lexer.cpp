@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <vector>
+
+extern "C" {
+#include <refa.h>
+}
+
+typedef std::vector<std::tuple<size_t, size_t, size_t>> token_list;
+
+static int collect_token(size_t rule, size_t start, size_t end, void *ctx)
+{
+	((token_list *)ctx)->push_back(std::make_tuple(rule, start, end));
+
+	return 0;
+}
+
+static int stop_token(size_t rule, size_t start, size_t end, void *ctx)
+{
+	((token_list *)ctx)->push_back(std::make_tuple(rule, start, end));
+
+	return 1;
+}
+
+static void build_exact(struct dfa *dfa, const std::string &core)
+{
+	struct regexp_tree *re_tree;
+	struct nfa nfa;
+	std::string regexp = "/^(" + core + ")$/";
+
+	re_tree = regexp_to_tree(regexp.c_str(), NULL);
+	ASSERT_NE(re_tree, nullptr) <<
+	"Failed to parse regexp " << regexp;
+
+	nfa_alloc(&nfa);
+	convert_tree_to_lambdanfa(&nfa, re_tree);
+	regexp_tree_free(re_tree);
+	nfa_rebuild(&nfa);
+
+	dfa_alloc(dfa);
+	convert_nfa_to_dfa(dfa, &nfa);
+	nfa_free(&nfa);
+}
+
+/* the longest match of every rule, the first rule wins the ties */
+static size_t naive_tokens(std::vector<struct dfa> &rules,
+			   const std::vector<unsigned char> &data,
+			   token_list *tokens)
+{
+	size_t pos = 0;
+
+	while (pos < data.size()) {
+		size_t best_len = 0, best_rule = 0;
+
+		for (size_t r = 0; r < rules.size(); r++) {
+			size_t state = rules[r].first_index;
+
+			for (size_t i = pos; i < data.size(); i++) {
+				state = dfa_get_trans(&rules[r], state, data[i]);
+				if (dfa_state_is_final(&rules[r], state) &&
+				    i + 1 - pos > best_len) {
+					best_len = i + 1 - pos;
+					best_rule = r;
+				}
+			}
+		}
+
+		if (best_len == 0)
+			break;
+
+		tokens->push_back(std::make_tuple(best_rule, pos,
+						  pos + best_len));
+		pos += best_len;
+	}
+
+	return pos;
+}
+
+TEST(lexerTests, equals_naive_tokens) {
+	const char *cores[] = {
+		"if", "[a-z]+", "[0-9]+", "[a-z]+[0-9]+", " +", "a\\.b",
+		"\"[^\"]*\"", "[0-9]+\\.[0-9]+", "=|==|=>"
+	};
+	const char alphabet[] = "abfi019. \"=";
+	std::vector<struct dfa> exact(sizeof(cores) / sizeof(cores[0]));
+	struct lexer lx;
+
+	ASSERT_EQ(lexer_alloc(&lx), 0);
+	for (size_t i = 0; i < exact.size(); i++) {
+		std::string regexp = std::string("/") + cores[i] + "/";
+		size_t id;
+
+		ASSERT_EQ(lexer_add(&lx, regexp.c_str(), &id), 0);
+		EXPECT_EQ(id, i);
+		build_exact(&exact[i], cores[i]);
+	}
+	ASSERT_EQ(lexer_compile(&lx), 0);
+
+	srand(39);
+	for (int iter = 0; iter < 500; iter++) {
+		std::vector<unsigned char> data(rand() % 100);
+		token_list expected, tokens, stream_tokens;
+		struct lexer_stream st;
+		size_t stop, pos = 0;
+		int res = 0;
+
+		for (size_t j = 0; j < data.size(); j++)
+			data[j] = alphabet[rand() % (sizeof(alphabet) - 1)];
+
+		stop = naive_tokens(exact, data, &expected);
+
+		EXPECT_EQ(lexer_scan(&lx, data.data(), data.size(),
+				     collect_token, &tokens), stop);
+		EXPECT_EQ(tokens, expected);
+
+		/* the same data in random chunks */
+		ASSERT_EQ(lexer_stream_alloc(&lx, &st), 0);
+		while (pos < data.size() && res == 0) {
+			size_t chunk = rand() % 8;
+
+			if (chunk > data.size() - pos)
+				chunk = data.size() - pos;
+			res = lexer_stream_feed(&lx, &st, data.data() + pos,
+						chunk, collect_token,
+						&stream_tokens);
+			pos += chunk;
+		}
+		if (res == 0)
+			res = lexer_stream_finish(&lx, &st, collect_token,
+						  &stream_tokens);
+
+		EXPECT_EQ(res, stop == data.size() ? 0 : -1);
+		EXPECT_EQ(st.start, stop);
+		EXPECT_EQ(stream_tokens, expected);
+		lexer_stream_free(&st);
+	}
+
+	for (auto &dfa : exact)
+		dfa_free(&dfa);
+	lexer_free(&lx);
+}
+
+TEST(lexerTests, priorities) {
+	const char data[] = "if iffy";
+	struct lexer lx;
+	token_list tokens;
+
+	ASSERT_EQ(lexer_alloc(&lx), 0);
+	ASSERT_EQ(lexer_add(&lx, "/if/", NULL), 0);
+	ASSERT_EQ(lexer_add(&lx, "/[a-z]+/", NULL), 0);
+	ASSERT_EQ(lexer_add(&lx, "/ /", NULL), 0);
+	ASSERT_EQ(lexer_compile(&lx), 0);
+
+	EXPECT_EQ(lexer_scan(&lx, data, strlen(data), collect_token, &tokens),
+		  strlen(data));
+	ASSERT_EQ(tokens.size(), 3u);
+	EXPECT_EQ(tokens[0], std::make_tuple(0, 0, 2)) <<
+	"The first rule must win the tie";
+	EXPECT_EQ(tokens[1], std::make_tuple(2, 2, 3));
+	EXPECT_EQ(tokens[2], std::make_tuple(1, 3, 7)) <<
+	"The longest token must win";
+
+	tokens.clear();
+	EXPECT_EQ(lexer_scan(&lx, data, strlen(data), stop_token, &tokens),
+		  2u);
+	EXPECT_EQ(tokens.size(), 1u);
+
+	lexer_free(&lx);
+}
+
+TEST(lexerTests, add_after_compile) {
+	const char data[] = "if 42";
+	struct lexer lx;
+	token_list tokens;
+
+	ASSERT_EQ(lexer_alloc(&lx), 0);
+	ASSERT_EQ(lexer_add(&lx, "/if/", NULL), 0);
+	ASSERT_EQ(lexer_add(&lx, "/ /", NULL), 0);
+	ASSERT_EQ(lexer_compile(&lx), 0);
+
+	EXPECT_EQ(lexer_scan(&lx, data, strlen(data), collect_token, &tokens),
+		  3u);
+
+	/* the lexer is compiled again with the new rule */
+	ASSERT_EQ(lexer_add(&lx, "/[0-9]+/", NULL), 0);
+	EXPECT_FALSE(lx.compiled);
+	ASSERT_EQ(lexer_compile(&lx), 0);
+
+	tokens.clear();
+	EXPECT_EQ(lexer_scan(&lx, data, strlen(data), collect_token, &tokens),
+		  strlen(data));
+	ASSERT_EQ(tokens.size(), 3u);
+	EXPECT_EQ(tokens[2], std::make_tuple(2, 3, 5));
+
+	lexer_free(&lx);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+extern "C" {
+#include <refa.h>
+}
+
+static std::string literal_str(const struct re_literal *lit)
+{
+	return std::string((const char *)lit->str, lit->len);
+}
+
+static int tree_literals(const char *regexp, struct re_literal_set *set)
+{
+	struct regexp_tree *re_tree;
+	int ret;
+
+	re_tree = regexp_to_tree(regexp, NULL);
+	if (re_tree == NULL)
+		return -2;
+
+	ret = regexp_tree_literals(re_tree, set);
+	regexp_tree_free(re_tree);
+
+	return ret;
+}
+
+TEST(literalTests, concatenation) {
+	struct re_literal_set set;
+
+	ASSERT_EQ(tree_literals("/xxabcdefxx/", &set), 0);
+	ASSERT_EQ(set.cnt, 1);
+	EXPECT_EQ(literal_str(&set.lit[0]), "xxabcdefxx");
+	EXPECT_FALSE(set.lit[0].caseless);
+
+	ASSERT_EQ(tree_literals("/[0-9]+abcd[0-9]*ef/", &set), 0);
+	ASSERT_EQ(set.cnt, 1);
+	EXPECT_EQ(literal_str(&set.lit[0]), "abcd") <<
+	"The longest required literal must be chosen";
+}
+
+TEST(literalTests, union_prefix) {
+	struct re_literal_set set;
+
+	ASSERT_EQ(tree_literals("/foo(bar|baz)qux/", &set), 0);
+	ASSERT_EQ(set.cnt, 1);
+	EXPECT_EQ(literal_str(&set.lit[0]), "fooba") <<
+	"Common prefix of the union must extend the literal";
+}
+
+TEST(literalTests, union_set) {
+	struct re_literal_set set;
+
+	ASSERT_EQ(tree_literals("/(hello|world)[0-9]*x/", &set), 0);
+	ASSERT_EQ(set.cnt, 2);
+	EXPECT_EQ(literal_str(&set.lit[0]), "hello");
+	EXPECT_EQ(literal_str(&set.lit[1]), "world");
+}
+
+TEST(literalTests, repeat) {
+	struct re_literal_set set;
+
+	ASSERT_EQ(tree_literals("/(ab){3}/", &set), 0);
+	ASSERT_EQ(set.cnt, 1);
+	EXPECT_EQ(literal_str(&set.lit[0]), "ababab");
+
+	ASSERT_EQ(tree_literals("/x(ab){2,}y/", &set), 0);
+	ASSERT_EQ(set.cnt, 1);
+	EXPECT_EQ(literal_str(&set.lit[0]), "xabab");
+}
+
+TEST(literalTests, caseless) {
+	struct re_literal_set set;
+	const unsigned char data[] = "xAbCx";
+
+	ASSERT_EQ(tree_literals("/abc/i", &set), 0);
+	ASSERT_EQ(set.cnt, 1);
+	EXPECT_EQ(literal_str(&set.lit[0]), "abc");
+	EXPECT_TRUE(set.lit[0].caseless);
+
+	EXPECT_TRUE(re_literal_match(&set.lit[0], data + 1));
+	EXPECT_FALSE(re_literal_match(&set.lit[0], data));
+}
+
+TEST(literalTests, no_literals) {
+	struct re_literal_set set;
+
+	EXPECT_EQ(tree_literals("/a*b?/", &set), -1);
+	EXPECT_EQ(tree_literals("/[a-z]+/", &set), -1);
+	EXPECT_EQ(tree_literals("/abc|[0-9]/", &set), -1);
+	EXPECT_EQ(set.cnt, 0);
+}
+
+TEST(literalTests, core_and_width) {
+	struct regexp_tree *re_tree;
+	const struct regexp_node *core;
+	bool floating;
+
+	re_tree = regexp_to_tree("/abc/", NULL);
+	ASSERT_NE(re_tree, nullptr);
+	core = regexp_tree_core(re_tree, &floating);
+	EXPECT_TRUE(floating);
+	EXPECT_EQ(regexp_node_max_width(core), 3);
+	EXPECT_EQ(regexp_node_max_width(&re_tree->root), RE_WIDTH_INF);
+	regexp_tree_free(re_tree);
+
+	re_tree = regexp_to_tree("/^a.{2,5}b/", NULL);
+	ASSERT_NE(re_tree, nullptr);
+	core = regexp_tree_core(re_tree, &floating);
+	EXPECT_FALSE(floating);
+	EXPECT_EQ(regexp_node_max_width(core), 7);
+	regexp_tree_free(re_tree);
+
+	re_tree = regexp_to_tree("/ab+/", NULL);
+	ASSERT_NE(re_tree, nullptr);
+	core = regexp_tree_core(re_tree, &floating);
+	EXPECT_TRUE(floating);
+	EXPECT_EQ(regexp_node_max_width(core), RE_WIDTH_INF);
+	regexp_tree_free(re_tree);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "test_util.h"
+
+static void build_joined(struct dfa *dfa, const std::vector<std::string> &lits,
+			 const std::vector<bool> &caseless)
+{
+	for (size_t i = 0; i < lits.size(); i++) {
+		std::string regexp = "/" + lits[i] + (caseless[i] ? "/i" : "/");
+		struct dfa next;
+
+		if (i == 0) {
+			build_dfa(dfa, regexp.c_str());
+			continue;
+		}
+
+		build_dfa(&next, regexp.c_str());
+		dfa_join(dfa, &next);
+		dfa_free(&next);
+		dfa_minimize(dfa);
+	}
+}
+
+static void build_strings(struct dfa *dfa, const std::vector<std::string> &lits,
+			  const std::vector<bool> &caseless)
+{
+	std::vector<const unsigned char *> str;
+	std::vector<size_t> len;
+	bool flags[lits.size()];
+
+	for (size_t i = 0; i < lits.size(); i++) {
+		str.push_back((const unsigned char *)lits[i].data());
+		len.push_back(lits[i].size());
+		flags[i] = caseless[i];
+	}
+
+	dfa_alloc(dfa);
+	ASSERT_EQ(convert_strings_to_dfa(dfa, str.data(), len.data(), flags,
+					 lits.size()), 0);
+}
+
+static void expect_same_scans(const struct dfa *a, const struct dfa *b,
+			      const char *alphabet)
+{
+	size_t alphabet_len = strlen(alphabet);
+
+	for (int iter = 0; iter < 100; iter++) {
+		std::vector<unsigned char> data(rand() % 100);
+		size_t state_a = a->first_index, state_b = b->first_index;
+
+		for (auto &c : data)
+			c = alphabet[rand() % alphabet_len];
+
+		EXPECT_EQ(dfa_scan(a, &state_a, data.data(), data.size()),
+			  dfa_scan(b, &state_b, data.data(), data.size()));
+	}
+}
+
+TEST(literal_to_dfaTests, equals_join) {
+	const char alphabet[] = "abcAB";
+
+	srand(32);
+	for (int iter = 0; iter < 30; iter++) {
+		std::vector<std::string> lits;
+		std::vector<bool> caseless;
+		struct dfa joined, direct;
+		size_t cnt = 1 + rand() % 12;
+
+		for (size_t i = 0; i < cnt; i++) {
+			std::string lit(1 + rand() % 5, 'a');
+
+			for (auto &c : lit)
+				c = alphabet[rand() % (sizeof(alphabet) - 1)];
+			lits.push_back(lit);
+
+			/* case sensitive, caseless and mixed sets */
+			caseless.push_back(iter % 3 == 1 ||
+					   (iter % 3 == 2 && rand() % 2));
+		}
+
+		build_joined(&joined, lits, caseless);
+		build_strings(&direct, lits, caseless);
+
+		EXPECT_EQ(direct.state_cnt, joined.state_cnt) <<
+		"Direct conversion must produce the minimal DFA";
+		expect_same_scans(&direct, &joined, alphabet);
+
+		dfa_free(&joined);
+		dfa_free(&direct);
+	}
+}
+
+TEST(literal_to_dfaTests, trees) {
+	const char *regexps[] = {"/foo/", "/bar/i", "/o{2}b/"};
+	struct regexp_tree *re_tree[4];
+	struct dfa dfa;
+	size_t state;
+	const char *data = "xxfOoBxx";
+
+	for (size_t i = 0; i < 3; i++) {
+		re_tree[i] = regexp_to_tree(regexps[i], NULL);
+		ASSERT_NE(re_tree[i], nullptr);
+	}
+	re_tree[3] = regexp_to_tree("/^baz/", NULL);
+	ASSERT_NE(re_tree[3], nullptr);
+
+	dfa_alloc(&dfa);
+	EXPECT_EQ(convert_trees_to_dfa(&dfa, re_tree, 4), -1) <<
+	"Anchored regexp is not a literal";
+	dfa_free(&dfa);
+
+	dfa_alloc(&dfa);
+	ASSERT_EQ(convert_trees_to_dfa(&dfa, re_tree, 3), 0);
+
+	state = dfa.first_index;
+	EXPECT_EQ(dfa_scan(&dfa, &state, data, strlen(data)),
+		  DFA_SCAN_NO_MATCH);
+	state = dfa.first_index;
+	EXPECT_EQ(dfa_scan(&dfa, &state, "xBAR", 4), 4);
+	state = dfa.first_index;
+	EXPECT_EQ(dfa_scan(&dfa, &state, "foob", 4), 3);
+
+	for (size_t i = 0; i < 4; i++)
+		regexp_tree_free(re_tree[i]);
+	dfa_free(&dfa);
+}
+
+TEST(literal_to_dfaTests, save_load_join) {
+	std::vector<std::string> lits = {"needle", "hay"};
+	std::vector<bool> caseless = {false, true};
+	char filename[] = "/tmp/literal_to_dfa_XXXXXX";
+	struct dfa direct, loaded, other;
+	size_t state;
+	int fd;
+
+	build_strings(&direct, lits, caseless);
+
+	fd = mkstemp(filename);
+	ASSERT_GE(fd, 0);
+	close(fd);
+
+	ASSERT_EQ(dfa_save_to_file(&direct, filename), 0);
+	ASSERT_EQ(dfa_load_from_file(&loaded, filename), 0);
+	unlink(filename);
+	EXPECT_EQ(loaded.state_cnt, direct.state_cnt);
+
+	build_dfa(&other, "/[0-9]+x/");
+	ASSERT_EQ(dfa_join(&loaded, &other), 0);
+
+	state = loaded.first_index;
+	EXPECT_EQ(dfa_scan(&loaded, &state, "ab12x", 5), 5);
+	state = loaded.first_index;
+	EXPECT_EQ(dfa_scan(&loaded, &state, "aHAy", 4), 4);
+	state = loaded.first_index;
+	EXPECT_EQ(dfa_scan(&loaded, &state, "needl", 5), DFA_SCAN_NO_MATCH);
+
+	dfa_free(&direct);
+	dfa_free(&loaded);
+	dfa_free(&other);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#include <unistd.h>
+
 extern "C" {
 #include <refa.h>
 }
@@ -391,6 +393,79 @@ TEST(nfaTests, join_fragile) {
 	nfa_free(&nfa2);
 }
 
+TEST(nfaTests, save_load) {
+	char filename[] = "/tmp/nfa_XXXXXX";
+	struct regexp_tree *re_tree;
+	struct nfa nfa, loaded;
+	struct dfa dfa, dfa_loaded;
+	size_t index;
+	int fd;
+
+	fd = mkstemp(filename);
+	ASSERT_GE(fd, 0);
+	close(fd);
+
+	re_tree = regexp_to_tree("/a(b|c)*[0-9]{2}d/", NULL);
+	ASSERT_NE(re_tree, nullptr);
+	nfa_alloc(&nfa);
+	convert_tree_to_lambdanfa(&nfa, re_tree);
+	regexp_tree_free(re_tree);
+
+	/* lambda-transitions are saved too */
+	ASSERT_EQ(nfa_save_to_file(&nfa, filename), 0);
+	ASSERT_EQ(nfa_load_from_file(&loaded, filename), 0);
+	ASSERT_EQ(loaded.node_cnt, nfa.node_cnt);
+	for (size_t i = 0; i < nfa.node_cnt; i++)
+		ASSERT_EQ(nfa_get_lambda_trans(&loaded, i, NULL),
+			  nfa_get_lambda_trans(&nfa, i, NULL));
+	nfa_free(&loaded);
+
+	nfa_rebuild(&nfa);
+	ASSERT_EQ(nfa_save_to_file(&nfa, filename), 0);
+	ASSERT_EQ(nfa_load_from_file(&loaded, filename), 0);
+
+	ASSERT_EQ(loaded.node_cnt, nfa.node_cnt);
+	EXPECT_EQ(loaded.first_index, nfa.first_index);
+	ASSERT_EQ(loaded.comment_size, nfa.comment_size);
+	EXPECT_EQ(memcmp(loaded.comment, nfa.comment, nfa.comment_size), 0);
+	for (size_t i = 0; i < nfa.node_cnt; i++) {
+		EXPECT_EQ(nfa_state_is_final(&loaded, i),
+			  nfa_state_is_final(&nfa, i));
+		EXPECT_EQ(loaded.nodes[i].self_closed, nfa.nodes[i].self_closed);
+		EXPECT_EQ(loaded.nodes[i].prefinal, nfa.nodes[i].prefinal);
+		for (int c = 0; c < 256; c++) {
+			size_t *trans, *loaded_trans;
+			size_t cnt = nfa_get_trans(&nfa, i, c, &trans);
+
+			ASSERT_EQ(nfa_get_trans(&loaded, i, c, &loaded_trans),
+				  cnt);
+			for (size_t k = 0; k < cnt; k++)
+				EXPECT_EQ(loaded_trans[k], trans[k]);
+		}
+	}
+
+	/* loaded NFA can be changed */
+	ASSERT_EQ(nfa_add_node(&loaded, &index), 0);
+	EXPECT_EQ(nfa_add_trans(&loaded, index, 'x', 0), 0);
+
+	dfa_alloc(&dfa);
+	convert_nfa_to_dfa(&dfa, &nfa);
+	dfa_alloc(&dfa_loaded);
+	convert_nfa_to_dfa(&dfa_loaded, &loaded);
+	EXPECT_EQ(dfa_loaded.state_cnt, dfa.state_cnt);
+	dfa_free(&dfa_loaded);
+	dfa_free(&dfa);
+	nfa_free(&loaded);
+
+	/* truncated file is rejected */
+	ASSERT_EQ(truncate(filename, 100), 0);
+	EXPECT_EQ(nfa_load_from_file(&loaded, filename), -1);
+	nfa_free(&loaded);
+
+	unlink(filename);
+	nfa_free(&nfa);
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "test_util.h"
+
+TEST(nfa_scanTests, equals_dfa_scan) {
+	srand(34);
+	for (auto regexp : scan_regexps({"/a(b|c)*d/", "/a.{6}b/",
+					 "/(a.*b|c.*d|e.*f)/", "/^(ab)*$/"})) {
+		struct nfa nfa;
+		struct dfa dfa;
+		struct nfa_scan ns;
+		struct nfa_scan_state st;
+
+		build_nfa(&nfa, regexp);
+		dfa_alloc(&dfa);
+		ASSERT_EQ(convert_nfa_to_dfa(&dfa, &nfa), 0);
+		ASSERT_EQ(nfa_scan_alloc(&ns, &nfa), 0);
+		ASSERT_EQ(nfa_scan_state_alloc(&ns, &st), 0);
+
+		for (int iter = 0; iter < 300; iter++) {
+			std::vector<unsigned char> data = random_data(200);
+			size_t state = dfa.first_index;
+			size_t match, chunk;
+
+			match = dfa_scan(&dfa, &state, data.data(), data.size());
+
+			nfa_scan_state_reset(&ns, &st);
+			EXPECT_EQ(nfa_scan(&ns, &st, data.data(), data.size()),
+				  match) <<
+			"NFA simulation must report the first match of " <<
+			regexp;
+
+			/* the same stream in two chunks */
+			chunk = data.size() / 2;
+			nfa_scan_state_reset(&ns, &st);
+			size_t first = nfa_scan(&ns, &st, data.data(), chunk);
+			size_t second = nfa_scan(&ns, &st, data.data() + chunk,
+						 data.size() - chunk);
+			expect_split_match(match, chunk, first, second);
+		}
+
+		nfa_scan_state_free(&st);
+		nfa_scan_free(&ns);
+		dfa_free(&dfa);
+		nfa_free(&nfa);
+	}
+}
+
+TEST(nfa_scanTests, byte_classes) {
+	struct nfa nfa;
+	struct nfa_scan ns;
+
+	build_nfa(&nfa, "/^a[0-9]+b/");
+	ASSERT_EQ(nfa_scan_alloc(&ns, &nfa), 0);
+
+	/* 'a', 'b', digits and all other bytes */
+	EXPECT_EQ(ns.class_cnt, 4u);
+	EXPECT_EQ(ns.classes['0'], ns.classes['9']);
+	EXPECT_NE(ns.classes['a'], ns.classes['b']);
+	EXPECT_EQ(ns.classes[0], ns.classes[255]);
+
+	/* the classes are numbered in the order of their first bytes */
+	EXPECT_EQ(ns.classes[0], 0u);
+	EXPECT_EQ(ns.classes['0'], 1u);
+	EXPECT_EQ(ns.classes['a'], 2u);
+	EXPECT_EQ(ns.classes['b'], 3u);
+
+	nfa_scan_free(&ns);
+	nfa_free(&nfa);
+}
+
+TEST(nfa_scanTests, lambda_transitions) {
+	struct regexp_tree *re_tree;
+	struct nfa nfa;
+	struct nfa_scan ns;
+
+	re_tree = regexp_to_tree("/ab*c/", NULL);
+	nfa_alloc(&nfa);
+	convert_tree_to_lambdanfa(&nfa, re_tree);
+	regexp_tree_free(re_tree);
+
+	EXPECT_EQ(nfa_scan_alloc(&ns, &nfa), -1) <<
+	"NFA with lambda-transitions must be rejected";
+
+	nfa_free(&nfa);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "test_util.h"
+
+static int collect_match(size_t id, size_t end, void *ctx)
+{
+	std::vector<size_t> *matches = (std::vector<size_t> *)ctx;
+
+	(*matches)[id] = end;
+
+	return 0;
+}
+
+static int stop_match(size_t, size_t, void *ctx)
+{
+	(*(size_t *)ctx)++;
+
+	return 1;
+}
+
+TEST(prefilterTests, equals_dfa_scan) {
+	std::vector<const char *> regexps = scan_regexps();
+	const size_t cnt = regexps.size();
+	struct prefilter pf;
+	std::vector<struct dfa> dfa(cnt);
+
+	ASSERT_EQ(prefilter_alloc(&pf), 0);
+	for (size_t i = 0; i < cnt; i++) {
+		size_t id;
+
+		ASSERT_EQ(prefilter_add(&pf, regexps[i], &id), 0);
+		EXPECT_EQ(id, i);
+		build_dfa(&dfa[i], regexps[i]);
+	}
+	ASSERT_EQ(prefilter_compile(&pf), 0);
+
+	srand(30);
+	for (int iter = 0; iter < 500; iter++) {
+		std::vector<unsigned char> data = random_data(200);
+		std::vector<size_t> matches(cnt, DFA_SCAN_NO_MATCH);
+
+		ASSERT_EQ(prefilter_scan(&pf, data.data(), data.size(),
+					 collect_match, &matches, NULL), 0);
+
+		for (size_t i = 0; i < cnt; i++) {
+			size_t state = dfa[i].first_index;
+			size_t match = dfa_scan(&dfa[i], &state, data.data(),
+						data.size());
+
+			EXPECT_EQ(matches[i], match) <<
+			"Prefilter must report the first match of " <<
+			regexps[i];
+		}
+	}
+
+	for (size_t i = 0; i < cnt; i++)
+		dfa_free(&dfa[i]);
+	prefilter_free(&pf);
+}
+
+TEST(prefilterTests, clean_data) {
+	struct prefilter pf;
+	struct prefilter_stat stat;
+	std::vector<size_t> matches(2, DFA_SCAN_NO_MATCH);
+	std::vector<unsigned char> data(100000, 'a');
+
+	ASSERT_EQ(prefilter_alloc(&pf), 0);
+	ASSERT_EQ(prefilter_add(&pf, "/needle[0-9]+/", NULL), 0);
+	ASSERT_EQ(prefilter_add(&pf, "/hay(stack|rick)/i", NULL), 0);
+	ASSERT_EQ(prefilter_compile(&pf), 0);
+
+	ASSERT_EQ(prefilter_scan(&pf, data.data(), data.size(),
+				 collect_match, &matches, &stat), 0);
+	EXPECT_EQ(matches[0], DFA_SCAN_NO_MATCH);
+	EXPECT_EQ(matches[1], DFA_SCAN_NO_MATCH);
+	EXPECT_EQ(stat.literal_hits, 0);
+	EXPECT_EQ(stat.dfa_bytes, 0) <<
+	"Clean data must not be scanned by DFA";
+
+	memcpy(data.data() + 70000, "HAYSTACK", 8);
+	ASSERT_EQ(prefilter_scan(&pf, data.data(), data.size(),
+				 collect_match, &matches, &stat), 0);
+	EXPECT_EQ(matches[0], DFA_SCAN_NO_MATCH);
+	EXPECT_EQ(matches[1], 70008);
+	EXPECT_EQ(stat.literal_hits, 1);
+	EXPECT_LE(stat.dfa_bytes, 16) <<
+	"Only the window before the literal must be scanned by DFA";
+
+	prefilter_free(&pf);
+}
+
+TEST(prefilterTests, callback_stops_scan) {
+	struct prefilter pf;
+	size_t calls = 0;
+	const char *data = "abc def";
+
+	ASSERT_EQ(prefilter_alloc(&pf), 0);
+	ASSERT_EQ(prefilter_add(&pf, "/abc/", NULL), 0);
+	ASSERT_EQ(prefilter_add(&pf, "/def/", NULL), 0);
+	EXPECT_EQ(prefilter_scan(&pf, data, strlen(data), stop_match,
+				 &calls, NULL), -1) <<
+	"Scan of not compiled prefilter must fail";
+	ASSERT_EQ(prefilter_compile(&pf), 0);
+
+	ASSERT_EQ(prefilter_scan(&pf, data, strlen(data), stop_match,
+				 &calls, NULL), 0);
+	EXPECT_EQ(calls, 1);
+
+	prefilter_free(&pf);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
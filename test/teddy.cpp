@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <refa.h>
+}
+
+typedef std::vector<std::pair<size_t, size_t>> match_list;
+
+static int collect_match(size_t id, size_t end, void *ctx)
+{
+	((match_list *)ctx)->push_back(std::make_pair(id, end));
+
+	return 0;
+}
+
+static int stop_match(size_t id, size_t end, void *ctx)
+{
+	((match_list *)ctx)->push_back(std::make_pair(id, end));
+
+	return 1;
+}
+
+static bool naive_match(const std::string &lit, bool caseless,
+			const unsigned char *data)
+{
+	for (size_t i = 0; i < lit.size(); i++) {
+		unsigned char c = data[i];
+
+		if (caseless ? tolower(c) != tolower(lit[i]) : c != lit[i])
+			return false;
+	}
+
+	return true;
+}
+
+TEST(teddyTests, equals_naive_search) {
+	const char alphabet[] = "abcdABCD01 ";
+	const size_t alphabet_len = sizeof(alphabet) - 1;
+
+	srand(31);
+	for (int iter = 0; iter < 20; iter++) {
+		struct teddy td;
+		std::vector<std::string> lits;
+		std::vector<bool> caseless;
+		std::vector<unsigned char> data(2000 + rand() % 100);
+		match_list expected, matches;
+		size_t lit_cnt = 1 + rand() % 200;
+
+		ASSERT_EQ(teddy_alloc(&td), 0);
+		for (size_t i = 0; i < lit_cnt; i++) {
+			std::string lit(1 + rand() % (iter % 2 ? 8 : 3), 'a');
+			size_t id;
+
+			for (auto &c : lit)
+				c = alphabet[rand() % alphabet_len];
+
+			lits.push_back(lit);
+			caseless.push_back(rand() % 3 == 0);
+			ASSERT_EQ(teddy_add(&td, lit.data(), lit.size(),
+					    caseless.back(), &id), 0);
+			EXPECT_EQ(id, i);
+		}
+		ASSERT_EQ(teddy_compile(&td), 0);
+
+		for (auto &c : data)
+			c = alphabet[rand() % alphabet_len];
+
+		for (size_t pos = 0; pos < data.size(); pos++)
+			for (size_t i = 0; i < lit_cnt; i++)
+				if (lits[i].size() <= data.size() - pos &&
+				    naive_match(lits[i], caseless[i],
+						data.data() + pos))
+					expected.push_back(std::make_pair(i,
+						pos + lits[i].size()));
+
+		ASSERT_EQ(teddy_scan(&td, data.data(), data.size(),
+				     collect_match, &matches), 0);
+		EXPECT_EQ(matches, expected) <<
+		"All occurrences must be reported in order of their starts";
+
+		teddy_free(&td);
+	}
+}
+
+TEST(teddyTests, add_tree) {
+	const char *accepted[] = {"/abc/", "/abc/i", "/a{3}b/", "/(ab){2}/i"};
+	const char *rejected[] = {"/^abc/", "/abc$/", "/ab*/", "/a|b/",
+				  "/a[bc]/", "/a[bB]c/"};
+	struct teddy td;
+	match_list matches;
+	const char *data = "xxabcABCaaabABAbab";
+
+	ASSERT_EQ(teddy_alloc(&td), 0);
+
+	for (auto regexp : accepted) {
+		struct regexp_tree *re_tree = regexp_to_tree(regexp, NULL);
+
+		ASSERT_NE(re_tree, nullptr);
+		EXPECT_EQ(teddy_add_tree(&td, re_tree, NULL), 0) <<
+		regexp << " must be accepted";
+		regexp_tree_free(re_tree);
+	}
+
+	for (auto regexp : rejected) {
+		struct regexp_tree *re_tree = regexp_to_tree(regexp, NULL);
+
+		ASSERT_NE(re_tree, nullptr);
+		EXPECT_EQ(teddy_add_tree(&td, re_tree, NULL), -1) <<
+		regexp << " must be rejected";
+		regexp_tree_free(re_tree);
+	}
+
+	ASSERT_EQ(td.cnt, 4);
+	ASSERT_EQ(teddy_compile(&td), 0);
+	ASSERT_EQ(teddy_scan(&td, data, strlen(data), collect_match,
+			     &matches), 0);
+
+	match_list expected = {{0, 5}, {1, 5}, {1, 8}, {2, 12}, {3, 14},
+			       {3, 16}, {3, 18}};
+	EXPECT_EQ(matches, expected);
+
+	teddy_free(&td);
+}
+
+TEST(teddyTests, callback_stops_scan) {
+	struct teddy td;
+	match_list matches;
+	std::vector<unsigned char> data(1000, 'x');
+
+	data[100] = 'y';
+	data[900] = 'y';
+
+	ASSERT_EQ(teddy_alloc(&td), 0);
+	ASSERT_EQ(teddy_add(&td, "y", 1, false, NULL), 0);
+	EXPECT_EQ(teddy_scan(&td, data.data(), data.size(), stop_match,
+			     &matches), -1) <<
+	"Scan of not compiled matcher must fail";
+	ASSERT_EQ(teddy_compile(&td), 0);
+
+	ASSERT_EQ(teddy_scan(&td, data.data(), data.size(), stop_match,
+			     &matches), 0);
+	ASSERT_EQ(matches.size(), 1);
+	EXPECT_EQ(matches[0].second, 101);
+
+	teddy_free(&td);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,123 @@
+/*
+ * Helpers shared by the tests.
+ *
+ * Authors: Dmitriy Alexandrov <d06alexandrov@gmail.com>
+ */
+
+#ifndef REFA_TEST_UTIL_H
+#define REFA_TEST_UTIL_H
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <refa.h>
+}
+
+/* bytes of the random data scanned by the tests of the scanners */
+#define TEST_ALPHABET	"abcdefhloqrxyzABCHLO0123 "
+
+static inline void build_nfa(struct nfa *nfa, const std::string &regexp)
+{
+	struct regexp_tree *re_tree;
+
+	re_tree = regexp_to_tree(regexp.c_str(), NULL);
+	ASSERT_NE(re_tree, nullptr) <<
+	"Failed to parse regexp " << regexp;
+
+	nfa_alloc(nfa);
+	convert_tree_to_lambdanfa(nfa, re_tree);
+	regexp_tree_free(re_tree);
+	nfa_rebuild(nfa);
+}
+
+/* minimal DFA of the regexp, optionally with the smallest states */
+static inline void build_dfa(struct dfa *dfa, const std::string &regexp,
+			     bool compress = false)
+{
+	struct nfa nfa;
+
+	build_nfa(&nfa, regexp);
+
+	dfa_alloc(dfa);
+	convert_nfa_to_dfa(dfa, &nfa);
+	nfa_free(&nfa);
+
+	dfa_minimize(dfa);
+	if (compress)
+		dfa_compress(dfa);
+}
+
+/* DFAs are stored the same way, the acceleration is not compared */
+static inline void check_same(const struct dfa *dfa, const struct dfa *other)
+{
+	ASSERT_EQ(dfa->state_cnt, other->state_cnt);
+	ASSERT_EQ(dfa->bps, other->bps);
+	EXPECT_EQ(dfa->first_index, other->first_index);
+	ASSERT_EQ(dfa->comment_size, other->comment_size);
+	if (dfa->comment_size != 0) {
+		EXPECT_EQ(memcmp(dfa->comment, other->comment,
+				 dfa->comment_size), 0);
+	}
+
+	for (size_t i = 0; i < dfa->state_cnt; i++) {
+		ASSERT_EQ(dfa->flags[i] & (0xFF ^ DFA_FLAG_ACCEL),
+			  other->flags[i] & (0xFF ^ DFA_FLAG_ACCEL)) <<
+		"Flags of state " << i << " differ";
+		ASSERT_EQ(memcmp((char *)dfa->trans + i * dfa->state_size,
+				 (char *)other->trans + i * other->state_size,
+				 dfa->state_size), 0) <<
+		"Transitions of state " << i << " differ";
+	}
+}
+
+/* regexps of the tests that compare the scanners with dfa_scan() */
+static inline std::vector<const char *>
+scan_regexps(std::initializer_list<const char *> extra = {})
+{
+	std::vector<const char *> regexps = {
+		"/abc/", "/foo(bar|baz)/", "/x[0-9]{2,4}y/", "/^ab/",
+		"/hello/i", "/q.*z/", "/[a-c]+d/", "/[0-9]+/", "/zz$/",
+		"/(ab|cd){2}e/", "/^[^a]x/"
+	};
+
+	regexps.insert(regexps.end(), extra);
+
+	return regexps;
+}
+
+/* up to max_size - 1 random bytes of the alphabet */
+static inline std::vector<unsigned char>
+random_data(size_t max_size, const char *alphabet = TEST_ALPHABET)
+{
+	std::vector<unsigned char> data(rand() % max_size);
+	size_t len = strlen(alphabet);
+
+	for (size_t j = 0; j < data.size(); j++)
+		data[j] = alphabet[rand() % len];
+
+	return data;
+}
+
+/* results of the scan of the stream split after chunk bytes */
+static inline void expect_split_match(size_t match, size_t chunk,
+				      size_t first, size_t second)
+{
+	if (match == DFA_SCAN_NO_MATCH) {
+		EXPECT_EQ(first, DFA_SCAN_NO_MATCH);
+		EXPECT_EQ(second, DFA_SCAN_NO_MATCH);
+	} else if (match <= chunk) {
+		EXPECT_EQ(first, match);
+		EXPECT_EQ(second, 0u);
+	} else {
+		EXPECT_EQ(first, DFA_SCAN_NO_MATCH);
+		EXPECT_EQ(second, match - chunk);
+	}
+}
+
+#endif /* REFA_TEST_UTIL_H */
@@ -14,6 +14,11 @@
 #include <string.h>
 #include <argp.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <pthread.h>
 
 #include <refa.h>
@@ -29,6 +34,9 @@ static char args_doc[] = "ARG...";
 
 #define OPT_I_TYPE	1
 #define OPT_O_TYPE	2
+#define OPT_SCAN	3
+#define OPT_CACHE	4
+#define OPT_CODEC	5
 
 static struct argp_option options[] = {
 	{"input-type",	OPT_I_TYPE,	"TYPE",	0, "Input type", 0},
@@ -39,6 +47,9 @@ static struct argp_option options[] = {
 	{"join",	'j',		0,	0, "Join inputs into one output", 1},
 	{"minimize",	'm',		0,	0, "Minimize automaton", 1},
 	{"print-gv",	'g',		0,	0, "Print Graphviz representation of automaton", 2},
+	{"scan",	OPT_SCAN,	"FILE",	0, "Scan FILE with automaton and print the match offset", 1},
+	{"cache",	OPT_CACHE,	"DIR",	0, "Keep compiled regexps in DIR and reuse them", 1},
+	{"codec",	OPT_CODEC,	"NAME",	0, "Codec of the dfa-file states: rowd, zlib or none", 1},
 	{0}
 };
 
@@ -55,6 +66,10 @@ struct arguments {
 	int	minimize;
 	int	gv;
 
+	char	*scan_path;
+	char	*cache_dir;
+	char	*codec;
+
 	int	thread_cnt;
 };
 
@@ -64,6 +79,8 @@ struct arguments	arguments;
 #define FAT_REGEXP_FILE	2
 #define FAT_NFA_FILE	4
 #define FAT_DFA_FILE	6
+#define FAT_DFA_MAP_FILE	7
+#define FAT_DFA_BUNDLE	8
 
 struct fa_type {
 	const char	*name;
@@ -74,7 +91,10 @@ struct fa_type {
 static struct fa_type fa_types[] = {
 	{"regexp",	FAT_REGEXP,		0},
 	{"regexp-file",	FAT_REGEXP_FILE,	0},
+	{"nfa-file",	FAT_NFA_FILE,		0},
 	{"dfa-file",	FAT_DFA_FILE,		0},
+	{"dfa-map-file", FAT_DFA_MAP_FILE,	0},
+	{"dfa-bundle",	FAT_DFA_BUNDLE,		0},
 	{0}
 };
 
@@ -115,6 +135,15 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 	case 'g':
 		args->gv = 1;
 		break;
+	case OPT_SCAN:
+		args->scan_path = arg;
+		break;
+	case OPT_CACHE:
+		args->cache_dir = arg;
+		break;
+	case OPT_CODEC:
+		args->codec = arg;
+		break;
 	case ARGP_KEY_ARG:
 		args->input = realloc(args->input,
 				      sizeof(char *) * (args->input_cnt + 1));
@@ -134,9 +163,24 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 static struct argp argp = {options, parse_opt, args_doc, doc, 0, 0, 0};
 
 int main_regexp_to_nfa(struct nfa **, char **, int *);
+/* build joined dfa directly if all regexps are literals */
+int main_literals_to_dfa(struct dfa **dfa, char **regexp, int cnt);
 int main_nfa_to_dfa(struct dfa **, struct nfa *, int *cnt);
+/* build dfa of regexps using the cache */
+int main_regexp_to_dfa_cached(struct dfa **dfa, char **regexp, int *cnt);
+/* save nfa, all of them are joined into one */
+int main_nfa_save(struct nfa *nfa, int cnt, char *path);
 /* join dfa into one */
 int main_dfa_join(struct dfa *dfa, int cnt, int t_cnt);
+/* save dfa in the output format */
+int main_dfa_save(struct dfa *dfa, char *path, int type);
+/* save all dfa into one bundle, names may be NULL */
+int main_dfa_save_bundle(struct dfa *dfa, char **names, int cnt, char *path);
+/* map all dfa of the bundle */
+int main_dfa_bundle_map(struct dfa **dfa, char ***names, int *cnt,
+			char *path);
+/* scan file with dfa */
+int main_dfa_scan(struct dfa *dfa, const char *path, int t_cnt);
 
 int main(int argc, char **argv)
 {
@@ -150,6 +194,9 @@ int main(int argc, char **argv)
 	arguments.gv		= 0;
 	arguments.join		= 0;
 	arguments.minimize	= 0;
+	arguments.scan_path	= NULL;
+	arguments.cache_dir	= NULL;
+	arguments.codec		= NULL;
 	arguments.thread_cnt	= 1;
 
 	argp_parse(&argp, argc, argv, 0, 0, &arguments);
@@ -164,6 +211,7 @@ int main(int argc, char **argv)
 	char		**regexp = NULL;
 	struct nfa	*nfa = NULL;
 	struct dfa	*dfa = NULL;
+	char		**dfa_names = NULL;
 
 	switch (arguments.input_type) {
 	case FAT_REGEXP:
@@ -194,26 +242,88 @@ int main(int argc, char **argv)
 		}
 		if (regexp_cnt == 0)
 			return -1;
+		if (arguments.join &&
+		    main_literals_to_dfa(&dfa, regexp, regexp_cnt) == 0) {
+			for (int i = 0; i < regexp_cnt; i++)
+				free(regexp[i]);
+			free(regexp);
+			dfa_cnt = 1;
+			if (arguments.verbose)
+				fprintf(stderr, "literals converted directly\n");
+			break;
+		}
+		if (arguments.cache_dir != NULL &&
+		    arguments.output_type != FAT_NFA_FILE) {
+			dfa_cnt = regexp_cnt;
+			main_regexp_to_dfa_cached(&dfa, regexp, &dfa_cnt);
+			for (int i = 0; i < regexp_cnt; i++)
+				free(regexp[i]);
+			free(regexp);
+			if (dfa_cnt == 0)
+				return -1;
+			break;
+		}
 	case FAT_NFA_FILE:
 		if (arguments.input_type == FAT_NFA_FILE) {
+			nfa_cnt = 0;
+			nfa = malloc(sizeof(struct nfa) * arguments.input_cnt);
+			for (int i = 0; i < arguments.input_cnt; i++) {
+				if (nfa_load_from_file(&nfa[nfa_cnt],
+						       arguments.input[i]) != 0) {
+					fprintf(stderr, "Bad file %s\n", arguments.input[i]);
+					continue;
+				}
+				nfa_cnt++;
+			}
 		} else {
 			nfa_cnt = regexp_cnt;
 			main_regexp_to_nfa(&nfa, regexp, &nfa_cnt);
 			for (int i = 0; i < regexp_cnt; i++)
 				free(regexp[i]);
 			free(regexp);
-			if (nfa_cnt == 0)
-				return -1;
+			for (int i = 0; i < nfa_cnt; i++)
+				nfa_rebuild(&nfa[i]);
+		}
+		if (nfa_cnt == 0)
+			return -1;
+
+		if (arguments.output_type == FAT_NFA_FILE) {
+			if (arguments.output_path != NULL)
+				ret = main_nfa_save(nfa, nfa_cnt,
+						    arguments.output_path);
+			for (int i = 0; i < nfa_cnt; i++)
+				nfa_free(nfa + i);
+			free(nfa);
+			goto out;
 		}
 	case FAT_DFA_FILE:
-		if (arguments.input_type == FAT_DFA_FILE) {
+	case FAT_DFA_MAP_FILE:
+	case FAT_DFA_BUNDLE:
+		if (arguments.input_type == FAT_DFA_BUNDLE) {
+			dfa_cnt = 0;
+			for (int i = 0; i < arguments.input_cnt; i++)
+				if (main_dfa_bundle_map(&dfa, &dfa_names,
+							&dfa_cnt,
+							arguments.input[i]) != 0)
+					fprintf(stderr, "Bad bundle %s\n",
+						arguments.input[i]);
+		} else if (arguments.input_type == FAT_DFA_FILE ||
+			   arguments.input_type == FAT_DFA_MAP_FILE) {
 			dfa_cnt = 0;
 			dfa = malloc(sizeof(struct dfa) * arguments.input_cnt);
+			dfa_names = malloc(sizeof(char *) * arguments.input_cnt);
 			for (int i = 0; i < arguments.input_cnt; i++) {
-				if (dfa_load_from_file(&dfa[dfa_cnt], arguments.input[i]) != 0) {
+				int	loaded;
+				if (arguments.input_type == FAT_DFA_MAP_FILE)
+					loaded = dfa_map_file(&dfa[dfa_cnt], arguments.input[i]);
+				else
+					loaded = dfa_load_from_file2(&dfa[dfa_cnt], arguments.input[i],
+								     arguments.thread_cnt);
+				if (loaded != 0) {
 					fprintf(stderr, "Bad file %s\n", arguments.input[i]);
 					continue;
 				} else {
+					dfa_names[dfa_cnt] = strdup(arguments.input[i]);
 					dfa_cnt++;
 				}
 			}
@@ -269,20 +379,43 @@ int main(int argc, char **argv)
 			printf("joined dfa %zu\n", dfa->state_cnt);
 
 		if (arguments.output_path != NULL) {
-			dfa_save_to_file(dfa, arguments.output_path);
+			main_dfa_save(dfa, arguments.output_path,
+				      arguments.output_type);
 		}
 
+		if (arguments.scan_path != NULL)
+			ret = main_dfa_scan(dfa, arguments.scan_path,
+					    arguments.thread_cnt);
+
 		dfa_free(dfa);
 		free(dfa);
 	} else {
 
-		if (dfa_cnt == 1 && arguments.output_path != NULL)
-			dfa_save_to_file(dfa, arguments.output_path);
+		if (arguments.output_type == FAT_DFA_BUNDLE &&
+		    arguments.output_path != NULL)
+			main_dfa_save_bundle(dfa, dfa_names, dfa_cnt,
+					     arguments.output_path);
+		else if (dfa_cnt == 1 && arguments.output_path != NULL)
+			main_dfa_save(dfa, arguments.output_path,
+				      arguments.output_type);
+		if (arguments.scan_path != NULL) {
+			if (dfa_cnt == 1)
+				ret = main_dfa_scan(dfa, arguments.scan_path,
+						    arguments.thread_cnt);
+			else
+				fprintf(stderr, "You can scan only with 1 DFA\n");
+		}
 		for (int j = 0; j < dfa_cnt; j++)
 			dfa_free(&dfa[j]);
 		free(dfa);
 	}
 
+	if (dfa_names != NULL) {
+		for (int j = 0; j < dfa_cnt; j++)
+			free(dfa_names[j]);
+		free(dfa_names);
+	}
+
 out:
 	if (arguments.input_cnt != 0)
 		free(arguments.input);
@@ -313,13 +446,46 @@ int main_regexp_to_nfa(struct nfa **nfa, char **regexp, int *cnt)
 	return 0;
 }
 
+int main_literals_to_dfa(struct dfa **dfa, char **regexp, int cnt)
+{
+	struct regexp_tree	**tree;
+	int	parsed = 0, ret = -1;
+
+	tree = malloc(sizeof(struct regexp_tree *) * cnt);
+	if (tree == NULL)
+		return -1;
+
+	for (; parsed < cnt; parsed++) {
+		tree[parsed] = regexp_to_tree(regexp[parsed], NULL);
+		if (tree[parsed] == NULL)
+			break;
+	}
+
+	if (parsed == cnt) {
+		*dfa = malloc(sizeof(struct dfa));
+		dfa_alloc(*dfa);
+		ret = convert_trees_to_dfa(*dfa,
+				(const struct regexp_tree *const *)tree, cnt);
+		if (ret != 0) {
+			dfa_free(*dfa);
+			free(*dfa);
+			*dfa = NULL;
+		}
+	}
+
+	for (int i = 0; i < parsed; i++)
+		regexp_tree_free(tree[i]);
+	free(tree);
+
+	return ret;
+}
+
 int main_nfa_to_dfa(struct dfa **dfa, struct nfa *nfa, int *cnt)
 {
 	int	processed = 0;
 	*dfa = malloc(sizeof(struct dfa) * *cnt);
 
 	for (int i = 0; i < *cnt; i++) {
-		nfa_rebuild(&nfa[i]);
 		dfa_alloc(&(*dfa)[i]);
 		convert_nfa_to_dfa(&(*dfa)[i], &nfa[i]);
 		if (arguments.minimize)
@@ -334,6 +500,169 @@ int main_nfa_to_dfa(struct dfa **dfa, struct nfa *nfa, int *cnt)
 	return 0;
 }
 
+int main_regexp_to_dfa_cached(struct dfa **dfa, char **regexp, int *cnt)
+{
+	struct dfa_cache	cache;
+	int	processed = 0;
+
+	if (dfa_cache_open(&cache, arguments.cache_dir) != 0) {
+		*cnt = 0;
+		return -1;
+	}
+
+	*dfa = malloc(sizeof(struct dfa) * *cnt);
+
+	for (int i = 0; i < *cnt; i++) {
+		if (dfa_cache_compile(&cache, regexp[i], arguments.minimize,
+				      &(*dfa)[processed]) != 0) {
+			fprintf(stderr, "Bad regexp %s\n", regexp[i]);
+			continue;
+		}
+		processed++;
+	}
+
+	dfa_cache_free(&cache);
+
+	*dfa = realloc(*dfa, sizeof(struct dfa) * processed);
+
+	*cnt = processed;
+
+	return 0;
+}
+
+int main_nfa_save(struct nfa *nfa, int cnt, char *path)
+{
+	int	ret;
+
+	if (cnt > 1) {
+		for (int i = 1; i < cnt; i++)
+			nfa_join(&nfa[0], &nfa[i]);
+		nfa_rebuild(&nfa[0]);
+	}
+
+	ret = nfa_save_to_file(&nfa[0], path);
+	if (ret != 0)
+		fprintf(stderr, "Failed to save %s\n", path);
+
+	return ret;
+}
+
+int main_dfa_save(struct dfa *dfa, char *path, int type)
+{
+	int	ret;
+
+	if (type == FAT_DFA_MAP_FILE)
+		ret = dfa_save_to_map_file(dfa, path);
+	else if (type == FAT_DFA_BUNDLE)
+		return main_dfa_save_bundle(dfa, NULL, 1, path);
+	else
+		ret = dfa_save_to_file2(dfa, path, arguments.thread_cnt,
+					arguments.codec);
+
+	if (ret != 0)
+		fprintf(stderr, "Failed to save %s\n", path);
+
+	return ret;
+}
+
+int main_dfa_save_bundle(struct dfa *dfa, char **names, int cnt, char *path)
+{
+	struct dfa_bundle	bundle;
+	char			name[32];
+	int			ret = 0;
+
+	if (dfa_bundle_create(&bundle, path, NULL, 0) != 0) {
+		fprintf(stderr, "Failed to save %s\n", path);
+		return -1;
+	}
+
+	for (int i = 0; i < cnt && ret == 0; i++) {
+		snprintf(name, sizeof(name), "%d", i);
+		ret = dfa_bundle_add(&bundle,
+				     names != NULL ? names[i] : name, &dfa[i]);
+	}
+
+	if (ret != 0)
+		dfa_bundle_free(&bundle);
+	else
+		ret = dfa_bundle_finish(&bundle);
+
+	if (ret != 0)
+		fprintf(stderr, "Failed to save %s\n", path);
+
+	return ret;
+}
+
+int main_dfa_bundle_map(struct dfa **dfa, char ***names, int *cnt,
+			char *path)
+{
+	struct dfa_bundle	bundle;
+
+	if (dfa_bundle_open(&bundle, path) != 0)
+		return -1;
+
+	*dfa = realloc(*dfa, sizeof(struct dfa) * (*cnt + bundle.cnt));
+	*names = realloc(*names, sizeof(char *) * (*cnt + bundle.cnt));
+
+	for (size_t i = 0; i < bundle.cnt; i++) {
+		const char	*name = bundle.items[i].name;
+
+		if (dfa_bundle_map(&bundle, name, &(*dfa)[*cnt]) != 0) {
+			fprintf(stderr, "Bad DFA %s in %s\n", name, path);
+			continue;
+		}
+		(*names)[*cnt] = strdup(name);
+		(*cnt)++;
+	}
+
+	dfa_bundle_free(&bundle);
+
+	return 0;
+}
+
+int main_dfa_scan(struct dfa *dfa, const char *path, int t_cnt)
+{
+	int		fd;
+	struct stat	st;
+	void		*data = NULL;
+	size_t		state = dfa->first_index;
+	size_t		match;
+	int		ret;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(stderr, "Can't open %s\n", path);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	if (st.st_size != 0) {
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			fprintf(stderr, "Can't map %s\n", path);
+			close(fd);
+			return -1;
+		}
+		madvise(data, st.st_size, MADV_SEQUENTIAL);
+	}
+
+	ret = dfa_scan_parallel(dfa, &state, data, st.st_size, t_cnt, &match);
+
+	if (ret != 0)
+		fprintf(stderr, "Failed to scan %s\n", path);
+	else if (match == DFA_SCAN_NO_MATCH)
+		printf("%s: no match\n", path);
+	else
+		printf("%s: match at %zu\n", path, match);
+
+	if (data != NULL)
+		munmap(data, st.st_size);
+	close(fd);
+
+	return ret;
+}
+
 struct thread_task_join {
 	pthread_t	thread_id;
 